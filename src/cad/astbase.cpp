@@ -28,6 +28,24 @@ namespace cad
 
 std::mutex ASTBase::cancel_mtx_;
 std::set<std::thread::id> ASTBase::cancel_requests_;
+std::recursive_mutex ASTBase::serial_build_mtx_;
+
+/**
+ * receives the objects, whose hash is requested
+ * while the dependencies of some object are determined
+ */
+static thread_local std::set<const ASTBase*>* dependencyRecorder = nullptr;
+
+/**
+ * suspends the recording of dependencies during nested
+ * hash computations and builds
+ */
+struct SuspendDependencyRecording
+{
+  std::set<const ASTBase*>* recorder_;
+  SuspendDependencyRecording() : recorder_(dependencyRecorder) { dependencyRecorder=nullptr; }
+  ~SuspendDependencyRecording() { dependencyRecorder=recorder_; }
+};
 
 void ASTBase::cancelRebuild(std::thread::id thread_id)
 {
@@ -35,6 +53,12 @@ void ASTBase::cancelRebuild(std::thread::id thread_id)
   cancel_requests_.insert(thread_id);
 }
 
+bool ASTBase::cancelRequested(std::thread::id thread_id)
+{
+  std::lock_guard<std::mutex> l(cancel_mtx_);
+  return cancel_requests_.erase(thread_id)>0;
+}
+
   
 ASTBase::ASTBase()
 : valid_(false),
@@ -53,6 +77,13 @@ ASTBase::ASTBase(const ASTBase& o)
 ASTBase::~ASTBase()
 {}
 
+ASTBase& ASTBase::operator=(const ASTBase& o)
+{
+  valid_=o.valid_;
+  hash_=o.hash_;
+  return *this;
+}
+
 void ASTBase::setValid()
 {
   valid_=true;
@@ -80,28 +111,72 @@ void ASTBase::checkForBuildDuringAccess() const
       }
   }
 
-  boost::mutex m_mutex;
-  boost::unique_lock<boost::mutex> lock(m_mutex);
+  std::lock_guard<std::recursive_mutex> lock(build_mtx_);
   
   if (!valid()) 
   {
+      SuspendDependencyRecording sdr;
+      std::unique_lock<std::recursive_mutex> serial_lock(serial_build_mtx_, std::defer_lock);
+      if (!buildIsThreadSafe()) serial_lock.lock();
+
       building_=true;
-      const_cast<ASTBase*>(this)->build();
+      try
+      {
+        const_cast<ASTBase*>(this)->build();
+      }
+      catch (...)
+      {
+        building_=false;
+        throw;
+      }
       building_=false;
       const_cast<ASTBase*>(this)->setValid();
   }
 }
 
 
+bool ASTBase::buildIsThreadSafe() const
+{
+  return true;
+}
+
+
 size_t ASTBase::hash() const
 {
+  if (dependencyRecorder)
+    {
+      dependencyRecorder->insert(this);
+    }
   if (hash_==0)
     {
+      SuspendDependencyRecording sdr;
       hash_=calcHash();
     }
   return hash_;
 }
 
 
+std::set<const ASTBase*> ASTBase::dependencies() const
+{
+  std::set<const ASTBase*> deps;
+  {
+    SuspendDependencyRecording sdr;
+    dependencyRecorder=&deps;
+    try
+    {
+      calcHash();
+    }
+    catch (...)
+    {
+      dependencyRecorder=nullptr;
+      throw;
+    }
+    dependencyRecorder=nullptr;
+  }
+  deps.erase(this);
+  return deps;
+}
+
+
 }
 }
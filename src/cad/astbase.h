@@ -43,10 +43,19 @@ class ASTBase
   bool valid_;
   mutable bool building_;
 
+  /**
+   * serialises concurrent build requests of this object
+   */
+  mutable std::recursive_mutex build_mtx_;
   
   static std::mutex cancel_mtx_;
   static std::set<std::thread::id> cancel_requests_;
 
+  /**
+   * held during all builds, which are not thread safe
+   */
+  static std::recursive_mutex serial_build_mtx_;
+
 protected:
   void setValid();
 
@@ -54,18 +63,39 @@ protected:
   virtual size_t calcHash() const =0;
   virtual void build() =0;
 
+  /**
+   * return false, if build() must not run concurrently
+   * with other non-thread-safe builds (e.g. file readers using global OCC settings)
+   */
+  virtual bool buildIsThreadSafe() const;
+
 public:
   static void cancelRebuild(std::thread::id thread_id = std::this_thread::get_id());
 
+  /**
+   * check for a cancel request for the given thread and remove it
+   */
+  static bool cancelRequested(std::thread::id thread_id = std::this_thread::get_id());
+
   ASTBase();
   ASTBase(const ASTBase& o);
   virtual ~ASTBase();
+
+  ASTBase& operator=(const ASTBase& o);
   
   bool valid() const;
   bool building() const;
 
   virtual void checkForBuildDuringAccess() const;
 
+  /**
+   * @brief dependencies
+   * @return
+   * returns all objects, which enter directly into the hash of this object,
+   * i.e. the inputs, which need to be built before this object.
+   */
+  std::set<const ASTBase*> dependencies() const;
+
   /**
    * @brief hash
    * @return
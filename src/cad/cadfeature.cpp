@@ -33,6 +33,7 @@
 #include "boost/make_shared.hpp"
 
 #include "dxfwriter.h"
+#include "stlwriter.h"
 #include "featurefilter.h"
 #include "feature.h"
 #include "gp_Cylinder.hxx"
@@ -80,6 +81,21 @@
 #include "TColStd_HSequenceOfTransient.hxx"
 
 #include "BRepBuilderAPI_Copy.hxx"
+#include "TopTools_MapOfShape.hxx"
+#include "BinTools.hxx"
+
+#include <fstream>
+#include <list>
+#include <tuple>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 
 namespace qi = boost::spirit::qi;
@@ -219,7 +235,18 @@ int FreelyIndexedMapOfShape::Add(const TopoDS_Shape& s, int index)
     
     if (index<=0) index=getMaxIndex()+1;
     
+    iterator j=find(index);
+    if (j!=end()) index_.UnBind(j->second);
+
     (*this)[index]=s;
+    index_.Bind(s, index);
+    return index;
+}
+
+void FreelyIndexedMapOfShape::clear()
+{
+    std::map<int, TopoDS_Shape>::clear();
+    index_.Clear();
 }
 
 bool FreelyIndexedMapOfShape::contains (const TopoDS_Shape& K)  const
@@ -242,27 +269,11 @@ const  TopoDS_Shape& FreelyIndexedMapOfShape::operator() (const Standard_Integer
 
 int FreelyIndexedMapOfShape::FindIndex (const TopoDS_Shape& K)  const
 {
-    if (size()==0) return -1;
-    
-    int k=-1;
-    for (const value_type& i: *this)
+    if (index_.IsBound(K))
     {
-        if (K.IsSame(i.second))
-        {
-            if (k>=0)
-            {
-                insight::Warning(
-                    boost::str(boost::format("Multiple keys for shape! (at least at %d and %d)") % k % i.first)
-                );
-//                 return k;
-            }
-//             else
-//             {
-                k=i.first;
-//             }
-        }
+        return index_.Find(K);
     }
-    return k;
+    return -1;
 }
 
 int FreelyIndexedMapOfShape::getMaxIndex() const
@@ -278,12 +289,406 @@ int FreelyIndexedMapOfShape::getMaxIndex() const
 }
     
 
+
+
+namespace
+{
+
+/**
+ * calls f(begin, end) on chunks of the range [0, n),
+ * concurrently if the range contains more than minParallel items
+ */
+void forEntityChunks(size_t n, size_t minParallel, std::function<void(size_t, size_t)> f)
+{
+  size_t nt=1;
+  if (n>minParallel)
+  {
+    nt=std::max(1u, std::min(std::thread::hardware_concurrency(), unsigned(n/(minParallel/2))));
+  }
+
+  if (nt>1)
+  {
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(nt);
+    size_t chunk=(n+nt-1)/nt;
+    for (size_t k=0; k*chunk<n; k++)
+    {
+      threads.push_back(std::thread(
+        [&, k]()
+        {
+          try
+          {
+            f(k*chunk, std::min(n, (k+1)*chunk));
+          }
+          catch (...)
+          {
+            errors[k]=std::current_exception();
+          }
+        }
+      ));
+    }
+    for (std::thread& t: threads)
+    {
+      t.join();
+    }
+    for (const std::exception_ptr& e: errors)
+    {
+      if (e) std::rethrow_exception(e);
+    }
+  }
+  else
+  {
+    f(0, n);
+  }
+}
+
+}
+
+
+
+
+EntityBoxTree::EntityBoxTree(const FreelyIndexedMapOfShape& entities)
+{
+  std::vector<const TopoDS_Shape*> shapes;
+  for (const auto& e: entities)
+  {
+    items_.push_back(std::make_pair(FeatureID(e.first), Bnd_Box()));
+    shapes.push_back(&e.second);
+  }
+
+  forEntityChunks
+  (
+    items_.size(), 256,
+    [&](size_t begin, size_t end)
+    {
+      for (size_t i=begin; i<end; i++)
+      {
+        BRepBndLib::Add(*shapes[i], items_[i].second);
+      }
+    }
+  );
+
+  if (items_.size()>0)
+  {
+    buildNode(0, items_.size());
+  }
+}
+
+
+
+
+int EntityBoxTree::buildNode(size_t begin, size_t end)
+{
+  int idx=nodes_.size();
+  nodes_.push_back(Node());
+  Node n;
+  n.child1=n.child2=-1;
+  n.begin=begin;
+  n.end=end;
+  for (size_t i=begin; i<end; i++)
+  {
+    n.box.Add(items_[i].second);
+  }
+
+  if (end-begin > 4 && !n.box.IsVoid())
+  {
+    // split at the median of the box centers along the longest extent
+    double x0, y0, z0, x1, y1, z1;
+    n.box.Get(x0, y0, z0, x1, y1, z1);
+    int dir=0;
+    if ( (y1-y0) > std::max(x1-x0, z1-z0) ) dir=1;
+    else if ( (z1-z0) > (x1-x0) ) dir=2;
+
+    auto center = [dir](const Bnd_Box& b)
+    {
+      if (b.IsVoid()) return 0.;
+      double c0[3], c1[3];
+      b.Get(c0[0], c0[1], c0[2], c1[0], c1[1], c1[2]);
+      return 0.5*(c0[dir]+c1[dir]);
+    };
+
+    size_t mid=begin+(end-begin)/2;
+    std::nth_element
+    (
+      items_.begin()+begin, items_.begin()+mid, items_.begin()+end,
+      [&](const std::pair<FeatureID, Bnd_Box>& a, const std::pair<FeatureID, Bnd_Box>& b)
+      {
+        return center(a.second) < center(b.second);
+      }
+    );
+
+    n.child1=buildNode(begin, mid);
+    n.child2=buildNode(mid, end);
+  }
+
+  nodes_[idx]=n;
+  return idx;
+}
+
+
+
+
+std::vector<FeatureID> EntityBoxTree::overlapping(const Bnd_Box& box) const
+{
+  std::vector<FeatureID> result;
+  if (nodes_.size()==0) return result;
+
+  std::vector<int> todo(1, 0);
+  while (!todo.empty())
+  {
+    const Node& n=nodes_[todo.back()];
+    todo.pop_back();
+
+    if (n.box.IsOut(box)) continue;
+
+    if (n.child1<0)
+    {
+      for (size_t i=n.begin; i<n.end; i++)
+      {
+        if (!items_[i].second.IsOut(box))
+        {
+          result.push_back(items_[i].first);
+        }
+      }
+    }
+    else
+    {
+      todo.push_back(n.child1);
+      todo.push_back(n.child2);
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+
+
+
+size_t EntityBoxTree::memoryUsage() const
+{
+  return sizeof(*this)
+      + nodes_.capacity()*sizeof(Node)
+      + items_.capacity()*sizeof(std::pair<FeatureID, Bnd_Box>);
+}
+
+
+
+
+EntityPropertyTable::EntityPropertyTable(const FreelyIndexedMapOfShape& entities, EntityType et)
+: entityType_(et)
+{
+  for (const auto& e: entities)
+  {
+    rows_[e.first]=entities_.size();
+    entities_.push_back(e.second);
+  }
+}
+
+
+
+
+arma::uword EntityPropertyTable::row(FeatureID i) const
+{
+  auto r=rows_.find(i);
+  if (r==rows_.end())
+    throw insight::Exception(boost::str(boost::format("No shape with tag %d") % i));
+  return r->second;
+}
+
+
+
+
+void EntityPropertyTable::computeMassProperties(arma::mat& measure, arma::mat& cog) const
+{
+  measure=arma::zeros(entities_.size(), 1);
+  cog=arma::zeros(entities_.size(), 3);
+
+  forEntityChunks
+  (
+    entities_.size(), 32,
+    [&](size_t begin, size_t end)
+    {
+      for (size_t i=begin; i<end; i++)
+      {
+        const TopoDS_Shape& e=entities_[i];
+        if (e.IsNull()) continue;
+
+        if (entityType_==Vertex)
+        {
+          gp_Pnt p=BRep_Tool::Pnt(TopoDS::Vertex(e));
+          cog(i,0)=p.X(); cog(i,1)=p.Y(); cog(i,2)=p.Z();
+          continue;
+        }
+
+        GProp_GProps props;
+        if (entityType_==Edge)
+        {
+          // the length of degenerated edges is zero, the CoG is still evaluated
+          BRepGProp::LinearProperties(e, props);
+          if (!BRep_Tool::Degenerated(TopoDS::Edge(e))) measure(i)=props.Mass();
+        }
+        else if (entityType_==Face)
+        {
+          BRepGProp::SurfaceProperties(e, props);
+          measure(i)=props.Mass();
+        }
+        else
+        {
+          BRepGProp::VolumeProperties(e, props);
+          measure(i)=props.Mass();
+        }
+        gp_Pnt p=props.CentreOfMass();
+        cog(i,0)=p.X(); cog(i,1)=p.Y(); cog(i,2)=p.Z();
+      }
+    }
+  );
+}
+
+
+
+
+size_t EntityPropertyTable::memoryUsage() const
+{
+  size_t m=sizeof(*this) + entities_.capacity()*sizeof(TopoDS_Shape)
+      + rows_.size()*( sizeof(std::pair<FeatureID, arma::uword>) + 4*sizeof(void*) );
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (const auto& c: columns_)
+  {
+    m+=sizeof(arma::mat) + c.second.n_elem*sizeof(double);
+  }
+  return m;
+}
+
+
+
+
+const arma::mat& EntityPropertyTable::column(Property p) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  auto c=columns_.find(p);
+  if (c!=columns_.end()) return c->second;
+
+  arma::uword n=entities_.size();
+
+  switch (p)
+  {
+    case Measure:
+    case CoG:
+    {
+      arma::mat mc, cc;
+      computeMassProperties(mc, cc);
+      columns_[Measure]=mc;
+      columns_[CoG]=cc;
+    }
+    break;
+
+    case Normal:
+    {
+      arma::mat nc = arma::zeros(n, 3);
+      if (entityType_==Face)
+      {
+        forEntityChunks
+        (
+          n, 32,
+          [&](size_t begin, size_t end)
+          {
+            for (size_t i=begin; i<end; i++)
+            {
+              BRepGProp_Face prop(TopoDS::Face(entities_[i]));
+              double u1,u2,v1,v2;
+              prop.Bounds(u1, u2, v1, v2);
+              gp_Vec vec;
+              gp_Pnt pnt;
+              prop.Normal(0.5*(u1+u2), 0.5*(v1+v2), pnt, vec);
+              vec.Normalize();
+              nc(i,0)=vec.X(); nc(i,1)=vec.Y(); nc(i,2)=vec.Z();
+            }
+          }
+        );
+      }
+      columns_[Normal]=nc;
+    }
+    break;
+
+    case Radius:
+    {
+      arma::mat rc = -arma::ones(n, 1);
+      forEntityChunks
+      (
+        n, 32,
+        [&](size_t begin, size_t end)
+        {
+          for (size_t i=begin; i<end; i++)
+          {
+            const TopoDS_Shape& e=entities_[i];
+            if (e.IsNull()) continue;
+            if (entityType_==Edge && !BRep_Tool::Degenerated(TopoDS::Edge(e)))
+            {
+              double p0, p1;
+              GeomAdaptor_Curve adapt(BRep_Tool::Curve(TopoDS::Edge(e), p0, p1));
+              if (adapt.GetType()==GeomAbs_Circle) rc(i)=adapt.Circle().Radius();
+            }
+            else if (entityType_==Face)
+            {
+              GeomAdaptor_Surface adapt(BRep_Tool::Surface(TopoDS::Face(e)));
+              if (adapt.GetType()==GeomAbs_Cylinder) rc(i)=adapt.Cylinder().Radius();
+            }
+          }
+        }
+      );
+      columns_[Radius]=rc;
+    }
+    break;
+
+    case BoundingBox:
+    {
+      arma::mat bc = arma::zeros(n, 6);
+      forEntityChunks
+      (
+        n, 256,
+        [&](size_t begin, size_t end)
+        {
+          for (size_t i=begin; i<end; i++)
+          {
+            Bnd_Box bb;
+            BRepBndLib::Add(entities_[i], bb);
+            if (!bb.IsVoid())
+            {
+              bb.Get(bc(i,0), bc(i,1), bc(i,2), bc(i,3), bc(i,4), bc(i,5));
+            }
+          }
+        }
+      );
+      columns_[BoundingBox]=bc;
+    }
+    break;
+  }
+
+  return columns_[p];
+}
+
+
+
+
 defineType(Feature);
 defineFactoryTableNoArgs(Feature);
 addToFactoryTable(Feature, Feature);
 
 
 
+namespace
+{
+/**
+ * The IGES and STEP readers use global settings and static data.
+ * Reading of different files is serialized, other features may
+ * be built concurrently.
+ */
+std::mutex exchangeReaderMtx;
+}
+
 void Feature::loadShapeFromFile(const boost::filesystem::path& filename)
 {
     cout<<"Reading "<<filename<<endl;
@@ -300,6 +705,7 @@ void Feature::loadShapeFromFile(const boost::filesystem::path& filename)
     }
     else if ( (ext==".igs") || (ext==".iges") )
     {
+        std::lock_guard<std::mutex> l(exchangeReaderMtx);
         IGESControl_Controller::Init();
         Interface_Static::SetIVal("read.surfacecurve.mode",3);
 //        Interface_Static::SetIVal ("read.precision.mode",1);
@@ -318,6 +724,8 @@ void Feature::loadShapeFromFile(const boost::filesystem::path& filename)
     }
     else if ( (ext==".stp") || (ext==".step") )
     {
+        std::lock_guard<std::mutex> l(exchangeReaderMtx);
+
         // import STEP
         STEPControl_Reader reader;
         reader.ReadFile(filename.c_str());
@@ -446,8 +854,8 @@ size_t Feature::calcShapeHash() const
   size_t hash=0;
   
   boost::hash_combine(hash, boost::hash<double>()(modelVolume()));
-  boost::hash_combine(hash, boost::hash<int>()(vmap_.size()));
-  boost::hash_combine(hash, boost::hash<int>()(fmap_.size()));
+  boost::hash_combine(hash, boost::hash<int>()(entityMap(Vertex).size()));
+  boost::hash_combine(hash, boost::hash<int>()(entityMap(Face).size()));
 
   FeatureSetData vset=allVerticesSet();
   for (const insight::cad::FeatureID& j: vset)
@@ -483,7 +891,28 @@ void Feature::setShape(const TopoDS_Shape& shape)
 {
   volprops_.reset();
   shape_=shape;
-  nameFeatures();
+  {
+    // subshapes are indexed on first query
+    std::lock_guard<std::mutex> lock(topologyMtx_);
+    topology_.reset();
+  }
+  setValid();
+}
+
+
+void Feature::shareShape(const Feature& o)
+{
+  volprops_.reset();
+  shape_=o.shape_;
+  std::shared_ptr<const FeatureTopology> t;
+  {
+    std::lock_guard<std::mutex> lock(o.topologyMtx_);
+    t=o.topology_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(topologyMtx_);
+    topology_=t;
+  }
   setValid();
 }
 
@@ -506,7 +935,7 @@ Feature::Feature(const Feature& o)
   areaWeight_(o.areaWeight_),
   featureSymbolName_(o.featureSymbolName_)
 {
-  setShape(o.shape_);
+  shareShape(o);
 }
 
 Feature::Feature(const TopoDS_Shape& shape)
@@ -702,6 +1131,32 @@ FeatureSetPtr Feature::providedFeatureSet(const std::string& name)
 
 
 
+const FreelyIndexedMapOfShape& Feature::entityMap(EntityType et) const
+{
+  return topology().entityMap(et);
+}
+
+
+
+
+const EntityBoxTree& Feature::entityBoxTree(EntityType et) const
+{
+  checkForBuildDuringAccess();
+  return topology().entityBoxTree(et);
+}
+
+
+
+
+const EntityPropertyTable& Feature::entityProperties(EntityType et) const
+{
+  checkForBuildDuringAccess();
+  return topology().entityProperties(et);
+}
+
+
+
+
 Feature& Feature::operator=(const Feature& o)
 {
   ASTBase::operator=(o);
@@ -720,7 +1175,7 @@ Feature& Feature::operator=(const Feature& o)
 
   if (o.valid())
   {
-    setShape(o.shape_);
+    shareShape(o);
   }
   return *this;
 }
@@ -731,6 +1186,312 @@ bool Feature::operator==(const Feature& o) const
 }
 
 
+
+
+namespace 
+{
+
+/**
+ * format tag of the persistent feature cache entries,
+ * needs to be changed on every modification of the format
+ */
+const char featureCacheFormat[] = "ISCADFC3";
+
+#ifndef INSIGHTCAD_BUILD_ID
+#define INSIGHTCAD_BUILD_ID "unknown"
+#endif
+
+/**
+ * entries written by another build (modified feature build code)
+ * or with another OCC version are treated as misses
+ */
+const std::string featureCacheBuildId = INSIGHTCAD_BUILD_ID "/OCC-" OCC_VERSION_COMPLETE;
+
+/**
+ * FNV-1a checksum of cache entries, detects truncated or damaged files
+ */
+uint64_t cacheEntryChecksum(const char* data, size_t n)
+{
+  uint64_t h=14695981039346656037ULL;
+  for (size_t i=0; i<n; i++)
+  {
+    h^=static_cast<unsigned char>(data[i]);
+    h*=1099511628211ULL;
+  }
+  return h;
+}
+
+template<class T>
+void writeBinary(std::ostream& os, const T& v)
+{
+  os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template<class T>
+T readBinary(std::istream& is)
+{
+  T v;
+  is.read(reinterpret_cast<char*>(&v), sizeof(T));
+  if (!is)
+    throw insight::Exception("unexpected end of CAD feature cache entry!");
+  return v;
+}
+
+void writeString(std::ostream& os, const std::string& s)
+{
+  writeBinary<uint64_t>(os, s.size());
+  os.write(s.data(), s.size());
+}
+
+std::string readString(std::istream& is)
+{
+  std::string s(readBinary<uint64_t>(is), '\0');
+  is.read(&s[0], s.size());
+  if (!is)
+    throw insight::Exception("unexpected end of CAD feature cache entry!");
+  return s;
+}
+
+void writeMatrix(std::ostream& os, const arma::mat& m)
+{
+  writeBinary<uint32_t>(os, m.n_rows);
+  writeBinary<uint32_t>(os, m.n_cols);
+  os.write(reinterpret_cast<const char*>(m.memptr()), m.n_elem*sizeof(double));
+}
+
+arma::mat readMatrix(std::istream& is)
+{
+  uint32_t nr=readBinary<uint32_t>(is);
+  uint32_t nc=readBinary<uint32_t>(is);
+  arma::mat m(nr, nc);
+  is.read(reinterpret_cast<char*>(m.memptr()), m.n_elem*sizeof(double));
+  if (!is)
+    throw insight::Exception("unexpected end of CAD feature cache entry!");
+  return m;
+}
+
+void writeXYZ(std::ostream& os, const gp_XYZ& p)
+{
+  writeBinary(os, p.X());
+  writeBinary(os, p.Y());
+  writeBinary(os, p.Z());
+}
+
+gp_XYZ readXYZ(std::istream& is)
+{
+  double x=readBinary<double>(is);
+  double y=readBinary<double>(is);
+  double z=readBinary<double>(is);
+  return gp_XYZ(x, y, z);
+}
+
+void writeShape(std::ostream& os, const TopoDS_Shape& s)
+{
+  std::ostringstream bs;
+  BinTools::Write(s, bs);
+  writeString(os, bs.str());
+}
+
+TopoDS_Shape readShape(std::istream& is)
+{
+  std::istringstream bs(readString(is));
+  TopoDS_Shape s;
+  BinTools::Read(s, bs);
+  return s;
+}
+
+}
+
+
+
+bool Feature::writeCacheEntry(std::ostream& os) const
+{
+  // check first, if everything can be stored
+  for (const auto& fs: providedFeatureSets_)
+  {
+    if (fs.second->model().get()!=this) return false;
+  }
+  for (const auto& ss: providedSubshapes_)
+  {
+    if (typeid(*ss.second)!=typeid(Feature)) return false;
+  }
+
+  os.write(featureCacheFormat, sizeof(featureCacheFormat));
+  writeBinary<uint64_t>(os, hash());
+  writeString(os, featureCacheBuildId);
+  writeString(os, type());
+
+  writeShape(os, shape_);
+
+  writeBinary<uint32_t>(os, refvalues_.size());
+  for (const auto& rv: refvalues_)
+  {
+    writeString(os, rv.first);
+    writeBinary(os, rv.second);
+  }
+  for (const RefPointsList* rl: { &refpoints_, &refvectors_ })
+  {
+    writeBinary<uint32_t>(os, rl->size());
+    for (const auto& rp: *rl)
+    {
+      writeString(os, rp.first);
+      writeMatrix(os, rp.second);
+    }
+  }
+
+  writeBinary<uint32_t>(os, providedDatums_.size());
+  for (const auto& d: providedDatums_)
+  {
+    writeString(os, d.first);
+    try
+    {
+      if (d.second->providesPlanarReference())
+      {
+        gp_Ax3 cs=d.second->plane();
+        writeBinary<char>(os, 'l');
+        writeXYZ(os, cs.Location().XYZ());
+        writeXYZ(os, cs.Direction().XYZ());
+        writeXYZ(os, cs.XDirection().XYZ());
+      }
+      else if (d.second->providesAxisReference())
+      {
+        gp_Ax1 ax=d.second->axis();
+        writeBinary<char>(os, 'a');
+        writeXYZ(os, ax.Location().XYZ());
+        writeXYZ(os, ax.Direction().XYZ());
+      }
+      else if (d.second->providesPointReference())
+      {
+        writeBinary<char>(os, 'p');
+        writeXYZ(os, d.second->point().XYZ());
+      }
+      else
+      {
+        return false;
+      }
+    }
+    catch (...)
+    {
+      // datum could not be evaluated
+      return false;
+    }
+  }
+
+  writeBinary<uint32_t>(os, providedFeatureSets_.size());
+  for (const auto& fs: providedFeatureSets_)
+  {
+    writeString(os, fs.first);
+    writeBinary<int32_t>(os, fs.second->shape());
+    const FeatureSetData& ids=fs.second->data();
+    writeBinary<uint32_t>(os, ids.size());
+    for (FeatureID id: ids)
+    {
+      writeBinary<int32_t>(os, id);
+    }
+  }
+
+  writeBinary<uint32_t>(os, providedSubshapes_.size());
+  for (const auto& ss: providedSubshapes_)
+  {
+    writeString(os, ss.first);
+    writeShape(os, ss.second->shape());
+  }
+
+  return bool(os);
+}
+
+
+
+
+void Feature::readCacheEntry(std::istream& is)
+{
+  char format[sizeof(featureCacheFormat)];
+  is.read(format, sizeof(format));
+  if (!is || std::string(format, sizeof(format))!=std::string(featureCacheFormat, sizeof(featureCacheFormat)))
+    throw insight::Exception("CAD feature cache entry has an incompatible format!");
+
+  uint64_t h=readBinary<uint64_t>(is);
+  std::string b=readString(is);
+  if (b!=featureCacheBuildId)
+    throw insight::Exception("CAD feature cache entry was written by another build ("+b+")!");
+  std::string t=readString(is);
+  if ( (h!=hash()) || (t!=type()) )
+    throw insight::Exception
+    (
+      str(format("CAD feature cache entry belongs to another feature! (cache: %s/%016x, requested: %s/%016x)")
+          % t % h % type() % hash())
+    );
+
+  // read everything, before anything is modified
+  TopoDS_Shape s=readShape(is);
+
+  RefValuesList refvalues;
+  for (uint32_t n=readBinary<uint32_t>(is); n>0; n--)
+  {
+    std::string name=readString(is);
+    refvalues[name]=readBinary<double>(is);
+  }
+  RefPointsList refpoints, refvectors;
+  for (RefPointsList* rl: { &refpoints, &refvectors })
+  {
+    for (uint32_t n=readBinary<uint32_t>(is); n>0; n--)
+    {
+      std::string name=readString(is);
+      (*rl)[name]=readMatrix(is);
+    }
+  }
+
+  DatumPtrMap providedDatums;
+  for (uint32_t n=readBinary<uint32_t>(is); n>0; n--)
+  {
+    std::string name=readString(is);
+    char kind=readBinary<char>(is);
+    gp_Pnt p(readXYZ(is));
+    if (kind=='l')
+    {
+      gp_Dir n(readXYZ(is)), ex(readXYZ(is));
+      providedDatums[name]=DatumPtr(new FixedDatumPlane(gp_Ax3(p, n, ex)));
+    }
+    else if (kind=='a')
+    {
+      providedDatums[name]=DatumPtr(new FixedDatumAxis(gp_Ax1(p, gp_Dir(readXYZ(is)))));
+    }
+    else
+    {
+      providedDatums[name]=DatumPtr(new FixedDatumPoint(p));
+    }
+  }
+
+  FeatureSetPtrMap providedFeatureSets;
+  for (uint32_t n=readBinary<uint32_t>(is); n>0; n--)
+  {
+    std::string name=readString(is);
+    EntityType et=EntityType(readBinary<int32_t>(is));
+    std::vector<FeatureID> ids(readBinary<uint32_t>(is));
+    for (FeatureID& id: ids)
+    {
+      id=readBinary<int32_t>(is);
+    }
+    providedFeatureSets[name]=FeatureSetPtr(new FeatureSet(shared_from_this(), et, ids));
+  }
+
+  SubfeatureMap providedSubshapes;
+  for (uint32_t n=readBinary<uint32_t>(is); n>0; n--)
+  {
+    std::string name=readString(is);
+    providedSubshapes[name]=FeaturePtr(new Feature(readShape(is)));
+  }
+
+  refvalues_=refvalues;
+  refpoints_=refpoints;
+  refvectors_=refvectors;
+  providedDatums_=providedDatums;
+  providedFeatureSets_=providedFeatureSets;
+  providedSubshapes_=providedSubshapes;
+  setShape(s);
+}
+
+
 GeomAbs_CurveType Feature::edgeType(FeatureID i) const
 {
   const TopoDS_Edge& e = edge(i);
@@ -757,34 +1518,22 @@ arma::mat Feature::vertexLocation(FeatureID i) const
 
 arma::mat Feature::edgeCoG(FeatureID i) const
 {
-  GProp_GProps props;
-  BRepGProp::LinearProperties(edge(i), props);
-  gp_Pnt cog = props.CentreOfMass();
-  return insight::vec3( cog.X(), cog.Y(), cog.Z() );
+  return entityProperties(Edge).cog(i);
 }
 
 arma::mat Feature::faceCoG(FeatureID i) const
 {
-  GProp_GProps props;
-  BRepGProp::SurfaceProperties(face(i), props);
-  gp_Pnt cog = props.CentreOfMass();
-  return insight::vec3( cog.X(), cog.Y(), cog.Z() );
+  return entityProperties(Face).cog(i);
 }
 
 arma::mat Feature::subsolidCoG(FeatureID i) const
 {
-  GProp_GProps props;
-  BRepGProp::VolumeProperties(subsolid(i), props);
-  gp_Pnt cog = props.CentreOfMass();
-  return insight::vec3( cog.X(), cog.Y(), cog.Z() );
+  return entityProperties(Solid).cog(i);
 }
 
 double Feature::subsolidVolume(FeatureID i) const
 {
-  GProp_GProps props;
-  BRepGProp::VolumeProperties(subsolid(i), props);
-  double m = props.Mass();
-  return m;
+  return entityProperties(Solid).measure(i);
 }
 
 
@@ -944,6 +1693,7 @@ arma::mat Feature::modelBndBox(double deflection) const
   
   if (deflection>0)
   {
+      std::lock_guard<std::mutex> lock(meshingMutex());
       BRepMesh_IncrementalMesh Inc(shape(), deflection);
   }
 
@@ -967,16 +1717,7 @@ arma::mat Feature::modelBndBox(double deflection) const
 
 arma::mat Feature::faceNormal(FeatureID i) const
 {
-  BRepGProp_Face prop(face(i));
-  double u1,u2,v1,v2;
-  prop.Bounds(u1, u2, v1, v2);
-  double u = (u1+u2)/2.;
-  double v = (v1+v2)/2.;
-  gp_Vec vec;
-  gp_Pnt pnt;
-  prop.Normal(u,v,pnt,vec);
-  vec.Normalize();
-  return insight::vec3( vec.X(), vec.Y(), vec.Z() );  
+  return entityProperties(Face).normal(i);
 }
 
 FeatureSetData Feature::allVerticesSet() const
@@ -989,8 +1730,8 @@ FeatureSetData Feature::allVerticesSet() const
 //   );
   std::transform
   (
-      vmap_.begin(),
-      vmap_.end(), 
+      entityMap(Vertex).begin(),
+      entityMap(Vertex).end(), 
       std::inserter(fsd, fsd.begin()), 
       [](const FreelyIndexedMapOfShape::value_type& i) { return i.first; } 
   );
@@ -1007,8 +1748,8 @@ FeatureSetData Feature::allEdgesSet() const
 //   );
   std::transform
   (
-      emap_.begin(),
-      emap_.end(), 
+      entityMap(Edge).begin(),
+      entityMap(Edge).end(), 
       std::inserter(fsd, fsd.begin()), 
       [](const FreelyIndexedMapOfShape::value_type& i) { return i.first; } 
   );
@@ -1025,8 +1766,8 @@ FeatureSetData Feature::allFacesSet() const
 //   );
   std::transform
   (
-      fmap_.begin(),
-      fmap_.end(), 
+      entityMap(Face).begin(),
+      entityMap(Face).end(), 
       std::inserter(fsd, fsd.begin()), 
       [](const FreelyIndexedMapOfShape::value_type& i) { return i.first; } 
   );
@@ -1043,8 +1784,8 @@ FeatureSetData Feature::allSolidsSet() const
 //   );
   std::transform
   (
-      somap_.begin(),
-      somap_.end(), 
+      entityMap(Solid).begin(),
+      entityMap(Solid).end(), 
       std::inserter(fsd, fsd.begin()), 
       [](const FreelyIndexedMapOfShape::value_type& i) { return i.first; } 
   );
@@ -1236,8 +1977,8 @@ FeatureSet Feature::verticesOfEdge(const FeatureID& e) const
 {
   FeatureSet vertices(shared_from_this(), Vertex);
   FeatureSetData fsd;
-  fsd.insert(vmap_.FindIndex(TopExp::FirstVertex(edge(e))));
-  fsd.insert(vmap_.FindIndex(TopExp::LastVertex(edge(e))));
+  fsd.insert(entityMap(Vertex).FindIndex(TopExp::FirstVertex(edge(e))));
+  fsd.insert(entityMap(Vertex).FindIndex(TopExp::LastVertex(edge(e))));
   vertices.setData(fsd);
   return vertices;
 }
@@ -1261,7 +2002,7 @@ FeatureSet Feature::verticesOfFace(const FeatureID& f) const
   FeatureSetData fsd;
   for (TopExp_Explorer ex(face(f), TopAbs_VERTEX); ex.More(); ex.Next())
   {
-    fsd.insert(vmap_.FindIndex(TopoDS::Vertex(ex.Current())));
+    fsd.insert(entityMap(Vertex).FindIndex(TopoDS::Vertex(ex.Current())));
   }
   vertices.setData(fsd);
   return vertices;
@@ -1285,7 +2026,8 @@ FeatureSet Feature::verticesOfFaces(const FeatureSet& fs) const
 void Feature::saveAs
 (
   const boost::filesystem::path& filename, 
-  const std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >& namedfeats
+  const std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >& namedfeats,
+  double stlDeflection
 ) const
 {
   checkForBuildDuringAccess();
@@ -1422,55 +2164,114 @@ void Feature::saveAs
    makeHeader.SetOriginatingSystem(headerOriginatingSystem);
    makeHeader.SetDescriptionValue(1, fileDescription);
 
-   // Writing the File (With names associated to Faces/Edges/Vertices)
-   ok=Standard_True;
-   stat = writer.Write(filename.string().c_str());
-   if (stat!=IFSelect_RetDone) ok = Standard_False;
-   
-   if (!ok) throw insight::Exception("STEP export failed!");
-    
-  } 
+   // Writing the File (With names associated to Faces/Edges/Vertices)
+   ok=Standard_True;
+   stat = writer.Write(filename.string().c_str());
+   if (stat!=IFSelect_RetDone) ok = Standard_False;
+   
+   if (!ok) throw insight::Exception("STEP export failed!");
+    
+  } 
+
+  else if ( (ext==".stl") || (ext==".stlb") )
+  {
+    exportSTL(filename, stlDeflection, (ext==".stlb"), namedfeats);
+  }
+  else
+  {
+    throw insight::Exception("Unknown export file format! (Extension "+ext+")");
+  }
+}
+
+void Feature::exportSTL
+(
+  const boost::filesystem::path& filename,
+  double abstol,
+  bool binary,
+  const std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >& namedfeats
+) const
+{
+  // mesh a copy, the triangulation of the original is used for display
+  BRepBuilderAPI_Copy aCopy( shape(), Standard_False );
+  TopoDS_Shape os=aCopy.Shape();
+
+  BRepTools::Clean( os );
+  tessellate(os, abstol);
+
+  STLWriter stl;
+
+  if (namedfeats.size()==0)
+  {
+    stl.addPatch(filename.stem().string(), os);
+  }
+  else
+  {
+    // one solid per named face set, a face goes into the first set containing it
+    TopTools_MapOfShape assigned;
+    for (const auto& nf: namedfeats)
+    {
+      const std::string& name = boost::fusion::get<0>(nf);
+      const FeatureSetPtr& fs = boost::fusion::get<1>(nf);
+
+      if (fs->shape()!=Face)
+      {
+        throw insight::Exception("Given feature set "+name+" not consisting of faces: yet unsupported");
+      }
+
+      STLWriter::Faces faces;
+      for (const FeatureID& id: fs->data())
+      {
+        TopoDS_Shape f;
+        try
+        {
+          f=aCopy.ModifiedShape(fs->model()->face(id));
+        }
+        catch (Standard_Failure e)
+        {
+          insight::Warning(boost::str(boost::format("Feature set face#%d not found in model")%id));
+          continue;
+        }
+
+        if (assigned.Add(f))
+        {
+          faces.push_back(TopoDS::Face(f));
+        }
+        else
+        {
+          insight::Warning(boost::str(boost::format(
+            "STL export: face #%d of %s was already assigned to another patch") % id % name));
+        }
+      }
+      stl.addPatch(name, faces);
+    }
+
+    STLWriter::Faces remaining;
+    for (TopExp_Explorer ex(os, TopAbs_FACE); ex.More(); ex.Next())
+    {
+      if (assigned.Add(ex.Current()))
+      {
+        remaining.push_back(TopoDS::Face(ex.Current()));
+      }
+    }
+    if (remaining.size()>0)
+    {
+      stl.addPatch(filename.stem().string(), remaining);
+    }
+
+    // patch names are only stored in ASCII STL files
+    binary=false;
+  }
 
-  else if ( (ext==".stl") || (ext==".stlb") )
+  if (binary)
   {
-    BRepMesh_IncrementalMesh Inc(shape(), 1e-2);
-    StlAPI_Writer stlwriter;
-
-    stlwriter.ASCIIMode() = (ext==".stl");
-    //stlwriter.RelativeMode()=false;
-    //stlwriter.SetDeflection(maxdefl);
-#if ((OCC_VERSION_MAJOR<7)&&(OCC_VERSION_MINOR<9))
-    stlwriter.SetCoefficient(5e-5);
-#endif
-    stlwriter.Write(shape(), filename.c_str());
+    stl.writeBinary(filename);
   }
   else
   {
-    throw insight::Exception("Unknown export file format! (Extension "+ext+")");
+    stl.writeASCII(filename);
   }
 }
 
-void Feature::exportSTL(const boost::filesystem::path& filename, double abstol, bool binary) const
-{
-  BRepBuilderAPI_Copy aCopy( shape(), Standard_False );
-  TopoDS_Shape os=aCopy.Shape();
-
-  StlAPI_Writer stlwriter;
-  stlwriter.ASCIIMode() = !binary; //false;
-
-#if ((OCC_VERSION_MAJOR<7)&&(OCC_VERSION_MINOR<9))
-  stlwriter.RelativeMode()=false;
-  stlwriter.SetDeflection(abstol);
-#else
-  BRepTools::Clean( os );
-//  ShapeFix_ShapeTolerance sf;
-//  sf.SetTolerance(os, abstol);
-  BRepMesh_IncrementalMesh binc(os, abstol);
-#endif
-
-  stlwriter.Write(os, filename.c_str());
-}
-
 
 void Feature::exportEMesh
 (
@@ -1578,6 +2379,7 @@ const TopoDS_Shape& Feature::shape() const
 
   if (visresolution_)
   {
+    std::lock_guard<std::mutex> lock(meshingMutex());
 //     Bnd_Box box;
 //     BRepMesh_FastDiscret m
 //     (
@@ -1598,6 +2400,69 @@ Handle_AIS_InteractiveObject Feature::buildVisualization() const
 }
 
 
+namespace
+{
+
+/**
+ * identifies a view: the feature hash together with all view parameters.
+ * The parameters are stored and compared completely, not only by their hash.
+ */
+struct ViewKey
+{
+  size_t featureHash;
+  std::vector<double> coords; // p0, n, up and the resolution
+  bool section, poly, skiphl;
+
+  bool operator<(const ViewKey& o) const
+  {
+    return std::tie(featureHash, coords, section, poly, skiphl)
+         < std::tie(o.featureHash, o.coords, o.section, o.poly, o.skiphl);
+  }
+};
+
+/**
+ * results of Feature::createView, keyed by feature hash and view parameters.
+ * The oldest entries are dropped, if the number of views exceeds the limit.
+ */
+class ViewCache
+{
+  std::mutex mtx_;
+  std::map<ViewKey, Feature::View> views_;
+  std::list<ViewKey> order_;
+  const size_t maxViews_ = 64;
+
+public:
+  bool lookup(const ViewKey& key, Feature::View& v)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto i=views_.find(key);
+    if (i==views_.end()) return false;
+    v=i->second;
+    return true;
+  }
+
+  void insert(const ViewKey& key, const Feature::View& v)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (views_.insert(std::make_pair(key, v)).second)
+    {
+      order_.push_back(key);
+      while (order_.size()>maxViews_)
+      {
+        views_.erase(order_.front());
+        order_.pop_front();
+      }
+    }
+  }
+};
+
+ViewCache viewCache;
+
+}
+
+
+
+
 Feature::View Feature::createView
 (
     const arma::mat p0,
@@ -1612,6 +2477,46 @@ Feature::View Feature::createView
 
     TopoDS_Shape dispshape=shape();
 
+    ViewKey key;
+    key.featureHash=hash();
+    for (const arma::mat* m: {&p0, &n, &up})
+    {
+        key.coords.push_back(m->n_elem);
+        key.coords.insert(key.coords.end(), m->begin(), m->end());
+    }
+    if (visresolution_) key.coords.push_back(visresolution_->value());
+    key.section=section;
+    key.poly=poly;
+    key.skiphl=skiphl;
+
+    if (viewCache.lookup(key, result_view))
+    {
+        return result_view;
+    }
+
+    // the polygonal algorithm works on the tessellation of the shape.
+    // Create it once and share it between all views
+    double polyDeflection=-1;
+    if (poly)
+    {
+        if (visresolution_)
+        {
+            polyDeflection=visresolution_->value();
+        }
+        else
+        {
+            Bnd_Box bb;
+            BRepBndLib::Add(dispshape, bb);
+            polyDeflection = bb.IsVoid() ? 1e-3 : 1e-3*sqrt(bb.SquareExtent());
+        }
+
+        if (!section)
+        {
+            std::lock_guard<std::mutex> lock(meshingMutex());
+            BRepMesh_IncrementalMesh aMesher(shape_, polyDeflection);
+        }
+    }
+
     gp_Pnt p_base = gp_Pnt(p0(0), p0(1), p0(2));
     gp_Dir view_dir = -gp_Dir(n(0), n(1), n(2));
 
@@ -1659,6 +2564,12 @@ Feature::View Feature::createView
         }
 //         cout<<"Generated "<<j<<" cross-sections"<<endl;
         dispshape=dispshapes;
+        if (poly)
+        {
+            // the cut result shares the unmodified faces with the feature
+            std::lock_guard<std::mutex> lock(meshingMutex());
+            BRepMesh_IncrementalMesh aMesher(dispshape, polyDeflection);
+        }
 // 	BRepTools::Write(dispshape, "dispshape.brep");
 // 	BRepTools::Write(xsecs, "xsecs.brep");
         result_view.crossSections = xsecs;
@@ -1747,6 +2658,8 @@ Feature::View Feature::createView
     result_view.width=x(0,1)-x(0,0);
     result_view.height=x(1,1)-x(1,0);
 
+    viewCache.insert(key, result_view);
+
     return result_view;
 
 }
@@ -2066,20 +2979,14 @@ arma::mat Feature::getDatumVector(const std::string& name) const
 #undef GMSH_NUMBERING_V1
 #undef GMSH_DEBUG
 
-void Feature::nameFeatures()
+FeatureTopology::FeatureTopology(const TopoDS_Shape& shape)
 {
-  // Don't call "shape()" here!
-  fmap_.clear();
-  emap_.clear(); 
-  vmap_.clear(); 
-  somap_.clear(); 
-  shmap_.clear(); 
-  wmap_.clear();
-  
+  auto t0=std::chrono::steady_clock::now();
+
 #ifdef GMSH_NUMBERING_V1
   // Solids
   TopExp_Explorer exp0, exp1, exp2, exp3, exp4, exp5;
-  for(exp0.Init(shape_, TopAbs_SOLID); exp0.More(); exp0.Next()) {
+  for(exp0.Init(shape, TopAbs_SOLID); exp0.More(); exp0.Next()) {
       TopoDS_Solid solid = TopoDS::Solid(exp0.Current());
       if(somap_.FindIndex(solid) < 1) {
 	  somap_.Add(solid);
@@ -2156,7 +3063,7 @@ void Feature::nameFeatures()
   }
 
   // Free Faces
-  for(exp2.Init(shape_, TopAbs_FACE, TopAbs_SHELL); exp2.More(); exp2.Next()) {
+  for(exp2.Init(shape, TopAbs_FACE, TopAbs_SHELL); exp2.More(); exp2.Next()) {
       TopoDS_Face face = TopoDS::Face(exp2.Current());
       if(fmap_.FindIndex(face) < 1) {
 	  fmap_.Add(face);
@@ -2184,7 +3091,7 @@ void Feature::nameFeatures()
   }
 
   // Free Wires
-  for(exp3.Init(shape_, TopAbs_WIRE, TopAbs_FACE); exp3.More(); exp3.Next()) {
+  for(exp3.Init(shape, TopAbs_WIRE, TopAbs_FACE); exp3.More(); exp3.Next()) {
       TopoDS_Wire wire = TopoDS::Wire(exp3.Current());
       if(wmap_.FindIndex(wire) < 1) {
 	  wmap_.Add(wire);
@@ -2205,7 +3112,7 @@ void Feature::nameFeatures()
   }
 
   // Free Edges
-  for(exp4.Init(shape_, TopAbs_EDGE, TopAbs_WIRE); exp4.More(); exp4.Next()) {
+  for(exp4.Init(shape, TopAbs_EDGE, TopAbs_WIRE); exp4.More(); exp4.Next()) {
       TopoDS_Edge edge = TopoDS::Edge(exp4.Current());
       if(emap_.FindIndex(edge) < 1) {
 	  emap_.Add(edge);
@@ -2219,7 +3126,7 @@ void Feature::nameFeatures()
   }
 
   // Free Vertices
-  for(exp5.Init(shape_, TopAbs_VERTEX, TopAbs_EDGE); exp5.More(); exp5.Next()) {
+  for(exp5.Init(shape, TopAbs_VERTEX, TopAbs_EDGE); exp5.More(); exp5.Next()) {
       TopoDS_Vertex vertex = TopoDS::Vertex(exp5.Current());
       if(vmap_.FindIndex(vertex) < 1)
 	  vmap_.Add(vertex);
@@ -2232,7 +3139,7 @@ void Feature::nameFeatures()
 
   TopExp_Explorer exp0;
   bool first = true;
-  for(exp0.Init(shape_, TopAbs_SOLID); exp0.More(); exp0.Next())
+  for(exp0.Init(shape, TopAbs_SOLID); exp0.More(); exp0.Next())
   {
     int t = tag;
     if(t <= 0)
@@ -2256,7 +3163,7 @@ void Feature::nameFeatures()
     somap_.Add(exp0.Current(), t);
   }
 //   if(highestDimOnly && outTags[3].size()) return;
-  for(exp0.Init(shape_, TopAbs_FACE); exp0.More(); exp0.Next())
+  for(exp0.Init(shape, TopAbs_FACE); exp0.More(); exp0.Next())
   {
     int t = tag;
     if(t <= 0)
@@ -2281,7 +3188,7 @@ void Feature::nameFeatures()
     fmap_.Add(exp0.Current(), t);
   }
 //   if(highestDimOnly && outTags[2].size()) return;
-  for(exp0.Init(shape_, TopAbs_EDGE); exp0.More(); exp0.Next())
+  for(exp0.Init(shape, TopAbs_EDGE); exp0.More(); exp0.Next())
   {
     int t = tag;
     if(t <= 0)
@@ -2305,7 +3212,7 @@ void Feature::nameFeatures()
     emap_.Add(exp0.Current(), t);
   }
 //   if(highestDimOnly && outTags[1].size()) return;
-  for(exp0.Init(shape_, TopAbs_VERTEX); exp0.More(); exp0.Next())
+  for(exp0.Init(shape, TopAbs_VERTEX); exp0.More(); exp0.Next())
   {
     int t = tag;
     if(t <= 0)
@@ -2332,6 +3239,108 @@ void Feature::nameFeatures()
 
 #endif
 //   extractReferenceFeatures();
+
+  namingTime_=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+
+
+
+const FreelyIndexedMapOfShape& FeatureTopology::entityMap(EntityType et) const
+{
+  switch (et)
+  {
+    case Vertex: return vmap_;
+    case Edge: return emap_;
+    case Face: return fmap_;
+    case Solid: return somap_;
+  }
+  throw insight::Exception("Unknown entity type!");
+}
+
+
+
+
+const EntityBoxTree& FeatureTopology::entityBoxTree(EntityType et) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto i=boxTrees_.find(et);
+  if (i==boxTrees_.end())
+  {
+    i=boxTrees_.insert(std::make_pair(et, std::make_shared<EntityBoxTree>(entityMap(et)))).first;
+  }
+  return *(i->second);
+}
+
+
+
+
+const EntityPropertyTable& FeatureTopology::entityProperties(EntityType et) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto i=propertyTables_.find(et);
+  if (i==propertyTables_.end())
+  {
+    i=propertyTables_.insert(std::make_pair(et, std::make_shared<EntityPropertyTable>(entityMap(et), et))).first;
+  }
+  return *(i->second);
+}
+
+
+
+
+size_t FeatureTopology::memoryUsage() const
+{
+  // map node and reverse index node per entry
+  const size_t entrySize =
+      sizeof(FreelyIndexedMapOfShape::value_type) + 4*sizeof(void*)
+    + sizeof(TopoDS_Shape) + sizeof(int) + 2*sizeof(void*);
+
+  size_t m = sizeof(*this) +
+      entrySize*( fmap_.size()+emap_.size()+vmap_.size()+somap_.size()+shmap_.size()+wmap_.size() );
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (const auto& bt: boxTrees_)
+  {
+    m+=bt.second->memoryUsage();
+  }
+  for (const auto& pt: propertyTables_)
+  {
+    m+=pt.second->memoryUsage();
+  }
+  return m;
+}
+
+
+
+
+void Feature::nameFeatures()
+{
+  // Don't call "shape()" here!
+  std::lock_guard<std::mutex> lock(topologyMtx_);
+  topology_.reset(new FeatureTopology(shape_));
+}
+
+
+
+
+const FeatureTopology& Feature::topology() const
+{
+  std::lock_guard<std::mutex> lock(topologyMtx_);
+  if (!topology_)
+  {
+    topology_.reset(new FeatureTopology(shape_));
+  }
+  return *topology_;
+}
+
+
+
+
+bool Feature::hasTopology() const
+{
+  std::lock_guard<std::mutex> lock(topologyMtx_);
+  return bool(topology_);
 }
 
 void Feature::extractReferenceFeatures()
@@ -2340,7 +3349,7 @@ void Feature::extractReferenceFeatures()
   /////////////// save reference points
 
 //   for (int i=1; i<=vmap_.Extent(); i++)
-  for (const FreelyIndexedMapOfShape::value_type& i: vmap_)
+  for (const FreelyIndexedMapOfShape::value_type& i: entityMap(Vertex))
   {
     refpoints_[ str(format("v%d")%i.first) ] = vertexLocation(i.first);
   }
@@ -2564,76 +3573,187 @@ bool SingleVolumeFeature::isSingleVolume() const
   return true;
 }
 
-// FeatureCache::FeatureCache(const filesystem::path& cacheDir)
-// : cacheDir_(cacheDir),
-//   removeCacheDir_(false)
-// {
-//   if (cacheDir.empty())
-//   {
-//     removeCacheDir_=true;
-//     cacheDir_ = boost::filesystem::unique_path
-//     (
-//       boost::filesystem::temp_directory_path()/("iscad_cache_%%%%%%%")
-//     );
-// //     boost::filesystem::create_directories(cacheDir_);
-//   }
-// }
-// 
-// FeatureCache::~FeatureCache()
-// {
-// //   if (removeCacheDir_)
-// //   {
-// //     boost::filesystem::remove_all(cacheDir_);
-// //   }
-// }
-// 
-// void FeatureCache::initRebuild()
-// {
-// //   usedFilesDuringRebuild_.clear();
-// }
-// 
-// void FeatureCache::finishRebuild()
-// {
-//   // remove all cache files that have not been used
-// }
-// 
-// 
-// bool FeatureCache::contains(size_t hash) const
-// {
-// //   return boost::filesystem::exists(fileName(hash));
-//   return false;
-// }
-// 
-// 
-// filesystem::path FeatureCache::markAsUsed(size_t hash)
-// {
-// //   usedFilesDuringRebuild_.insert(fileName(hash));
-//   return fileName(hash);
-// }
-// 
-// filesystem::path FeatureCache::fileName(size_t hash) const
-// {
-//   return boost::filesystem::absolute
-//   (
-//     cacheDir_ /
-//     boost::filesystem::path( str(format("%x")%hash) + ".iscad_cache" )
-//   );
-// }
-
-
 FeatureCache::FeatureCache()
-{}
+: maxCacheSize_(1024),
+  writtenSinceCleanup_(0)
+{
+  if (const char* d=getenv("ISCAD_CACHE_DIR"))
+  {
+    cacheDir_=d;
+  }
+  else if (const char* h=getenv("HOME"))
+  {
+    cacheDir_=boost::filesystem::path(h)/".insight"/"iscad_cache";
+  }
+
+  if (const char* sz=getenv("ISCAD_CACHE_SIZE"))
+  {
+    try
+    {
+      maxCacheSize_=boost::lexical_cast<uintmax_t>(sz);
+    }
+    catch (...)
+    {
+      insight::Warning(std::string("invalid value of ISCAD_CACHE_SIZE: ")+sz+"! Using the default.");
+    }
+  }
+  maxCacheSize_*=1024*1024;
+  // check the size at the first insertion
+  writtenSinceCleanup_=maxCacheSize_;
+}
 
 FeatureCache::~FeatureCache()
 {}
 
+boost::filesystem::path FeatureCache::fileName(size_t hash) const
+{
+  return cacheDir_ / ( str(format("%016x")%hash) + ".iscad_cache" );
+}
+
+bool FeatureCache::persistent() const
+{
+  return (maxCacheSize_>0) && !cacheDir_.empty();
+}
+
+void FeatureCache::writeToDisk(ConstFeaturePtr p) const
+{
+  if (!persistent()) return;
+
+  try
+  {
+    std::ostringstream entry;
+    if (!p->writeCacheEntry(entry)) return;
+
+    boost::filesystem::create_directories(cacheDir_);
+    boost::filesystem::path fn=fileName(p->hash());
+    // write to a temporary file and rename afterwards,
+    // so that concurrent sessions will never see incomplete entries
+    boost::filesystem::path tmp=boost::filesystem::unique_path(fn.string()+".%%%%%%%%");
+    std::string content=entry.str();
+    uint64_t cs=cacheEntryChecksum(content.data(), content.size());
+    content.append(reinterpret_cast<const char*>(&cs), sizeof(cs));
+    {
+      std::ofstream f(tmp.c_str(), std::ios::binary);
+      f.write(content.data(), content.size());
+      if (!f)
+        throw insight::Exception("could not write "+tmp.string());
+    }
+    boost::filesystem::rename(tmp, fn);
+    rejectedEntries_.erase(p->hash());
+
+    // scanning the directory is expensive: 
+    // check the size only after a tenth of the limit was written
+    writtenSinceCleanup_+=content.size();
+    if (writtenSinceCleanup_ > maxCacheSize_/10)
+    {
+      removeLeastRecentlyUsed();
+      writtenSinceCleanup_=0;
+    }
+  }
+  catch (const insight::Exception& e)
+  {
+    insight::Warning("could not store feature in persistent CAD feature cache: "+e.message());
+  }
+  catch (const std::exception& e)
+  {
+    insight::Warning(std::string("could not store feature in persistent CAD feature cache: ")+e.what());
+  }
+}
+
+bool FeatureCache::readFromDisk(size_t hash, Feature& f)
+{
+  auto i=loadedEntries_.find(hash);
+  if (i==loadedEntries_.end())
+    throw insight::Exception
+    (
+      "requested entry in CAD feature cache is not found!"
+    );
+
+  std::istringstream entry(i->second);
+  loadedEntries_.erase(i);
+  try
+  {
+    f.readCacheEntry(entry);
+    return true;
+  }
+  catch (const insight::Exception& e)
+  {
+    insight::Warning("discarding unusable entry of persistent CAD feature cache: "+e.message());
+  }
+  catch (const std::exception& e)
+  {
+    insight::Warning(std::string("discarding unusable entry of persistent CAD feature cache: ")+e.what());
+  }
+  catch (...)
+  {
+    insight::Warning("discarding unusable entry of persistent CAD feature cache: shape could not be read");
+  }
+
+  // don't read it again, even if it cannot be removed
+  rejectedEntries_.insert(hash);
+  boost::system::error_code ec;
+  boost::filesystem::remove(fileName(hash), ec);
+  return false;
+}
+
+void FeatureCache::removeLeastRecentlyUsed() const
+{
+  boost::filesystem::path lockfile=cacheDir_/"lock";
+  int fd=open(lockfile.c_str(), O_RDWR|O_CREAT, 0644);
+  if (fd<0) return;
+  flock(fd, LOCK_EX);
+
+  std::multimap<std::time_t, std::pair<boost::filesystem::path, uintmax_t> > entries;
+  uintmax_t total=0;
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(cacheDir_, ec), end; it!=end; it.increment(ec))
+  {
+    if (ec) break;
+    const boost::filesystem::path& fp=it->path();
+    if (fp.extension()==".iscad_cache")
+    {
+      uintmax_t sz=boost::filesystem::file_size(fp, ec);
+      std::time_t t=boost::filesystem::last_write_time(fp, ec);
+      if (!ec)
+      {
+        entries.insert(std::make_pair(t, std::make_pair(fp, sz)));
+        total+=sz;
+      }
+    }
+  }
+
+  if (total>maxCacheSize_)
+  {
+    // remove down to 90% of the limit to avoid cleanup after every insertion
+    for (auto e=entries.begin(); e!=entries.end() && total>0.9*maxCacheSize_; ++e)
+    {
+      if (boost::filesystem::remove(e->second.first, ec))
+      {
+        total-=e->second.second;
+      }
+    }
+  }
+
+  flock(fd, LOCK_UN);
+  close(fd);
+}
+
+void FeatureCache::registerEntry(FeaturePtr p)
+{
+  size_t h=p->hash();
+  (*this)[h]=p;
+  usedDuringRebuild_.insert(h);
+}
+
 void FeatureCache::initRebuild()
 {
+  std::lock_guard<std::recursive_mutex> lock(mtx_);
    usedDuringRebuild_.clear();
 }
 
 void FeatureCache::finishRebuild()
 {
+  std::lock_guard<std::recursive_mutex> lock(mtx_);
   // remove all cache entries that have not been used
   std::cout<<"== Finish Rebuild: Cache Summary =="<<std::endl;
   std::cout<<"cache size after rebuild: "<<size()<<std::endl;
@@ -2650,29 +3770,91 @@ void FeatureCache::finishRebuild()
       ++it;
     }
   }
+  loadedEntries_.clear();
   std::cout<<"cache size after cleanup: "<<size()<<std::endl;
 }
 
 void FeatureCache::insert(FeaturePtr p)
 {
   size_t h=p->hash();
+  std::lock_guard<std::recursive_mutex> lock(mtx_);
   const_iterator i=find(h);
   if (i!=end())
     {
       std::ostringstream msg;
-      msg<<"Internal error: trying to insert feature into CAD feature cache twice!\n";
+      // features with identical hashes are built one after the other
+      // by the RebuildScheduler, so that the later ones are restored
+      // from the cache. Otherwise, they have been built twice.
+      if (i->second==p)
+        msg<<"Internal error: trying to insert feature into CAD feature cache twice!\n";
+      else
+        msg<<"Internal error: feature with identical hash was built twice (hash collision or concurrent build)!\n";
       msg<<"feature to insert: hash="<<h<<" (of type "<<p->type()<<" named \""<<p->featureSymbolName()<<"\")\n";
       msg<<"present feature: hash="<<i->second->hash()<<" (of type "<<i->second->type()<<" named \""<<i->second->featureSymbolName()<<"\")\n";
       throw insight::cad::CADException(p, msg.str());
     }
-  (*this)[h]=p;
-  usedDuringRebuild_.insert(h);
+  registerEntry(p);
+  writeToDisk(p);
 }
 
 
 bool FeatureCache::contains(size_t hash) const
 {
-  return ( this->find(hash) != end() );
+  std::lock_guard<std::recursive_mutex> lock(mtx_);
+  if ( this->find(hash) != end() ) return true;
+
+  if (persistent())
+  {
+    if (loadedEntries_.find(hash)!=loadedEntries_.end()) return true;
+
+    // could not be removed, e.g. in a read-only cache directory
+    if (rejectedEntries_.count(hash)) return false;
+
+    // read the entry at once: it might be evicted by another session
+    // before it is restored
+    boost::filesystem::path fn=fileName(hash);
+    std::ifstream f(fn.c_str(), std::ios::binary);
+    if (f)
+    {
+      std::ostringstream content;
+      content<<f.rdbuf();
+      f.close();
+      std::string entry=content.str();
+
+      // format tag, key, build id and checksum
+      const size_t nt=sizeof(featureCacheFormat), nh=sizeof(uint64_t), ncs=sizeof(uint64_t);
+      const size_t nb=featureCacheBuildId.size();
+      bool valid = (entry.size() >= nt+nh+nh+nb+ncs)
+          && (entry.compare(0, nt, featureCacheFormat, nt)==0);
+      if (valid)
+      {
+        uint64_t h, bl, cs;
+        memcpy(&h, entry.data()+nt, nh);
+        memcpy(&bl, entry.data()+nt+nh, nh);
+        memcpy(&cs, entry.data()+entry.size()-ncs, ncs);
+        valid = (h==hash) && (bl==nb)
+            && (entry.compare(nt+nh+nh, nb, featureCacheBuildId)==0)
+            && (cs==cacheEntryChecksum(entry.data(), entry.size()-ncs));
+      }
+
+      boost::system::error_code ec;
+      if (valid)
+      {
+        loadedEntries_[hash]=entry;
+        // mark as recently used
+        boost::filesystem::last_write_time(fn, std::time(nullptr), ec);
+        return true;
+      }
+      else
+      {
+        // damaged, from an older version or another build
+        rejectedEntries_.insert(hash);
+        boost::filesystem::remove(fn, ec);
+      }
+    }
+  }
+
+  return false;
 }
 
 
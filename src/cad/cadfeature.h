@@ -25,6 +25,7 @@
 #include <map>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include "base/boost_include.h"
 
@@ -167,8 +168,12 @@ typedef std::vector<FeatureCmdInfo> FeatureCmdInfoList;
 class FreelyIndexedMapOfShape
  : public std::map<int, TopoDS_Shape>
 {
+    // reverse lookup, shapes are compared by IsSame
+    TopTools_DataMapOfShapeInteger index_;
+
 public:
     int Add(const TopoDS_Shape& s, int index=-1);
+    void clear();
     bool contains (const TopoDS_Shape& K)  const;
     const  TopoDS_Shape& FindKey (const Standard_Integer I)  const;
     const  TopoDS_Shape& operator () (const Standard_Integer I)  const;
@@ -176,6 +181,133 @@ public:
     int getMaxIndex() const;
 };
 
+
+
+
+/**
+ * bounding volume hierarchy of the bounding boxes of
+ * the entities (vertices, edges, faces or solids) of a feature.
+ * Used to find the candidates for geometric comparisons.
+ */
+class EntityBoxTree
+{
+  struct Node
+  {
+    Bnd_Box box;
+    int child1, child2; // -1 for leaves
+    size_t begin, end; // range in items_
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<std::pair<FeatureID, Bnd_Box> > items_;
+
+  int buildNode(size_t begin, size_t end);
+
+public:
+  EntityBoxTree(const FreelyIndexedMapOfShape& entities);
+
+  /**
+   * returns the IDs of all entities whose bounding box
+   * is not outside the given box
+   */
+  std::vector<FeatureID> overlapping(const Bnd_Box& box) const;
+
+  /**
+   * approximate memory used by the tree in bytes
+   */
+  size_t memoryUsage() const;
+};
+
+
+
+
+/**
+ * geometric properties of all entities of one type of a feature,
+ * stored column-wise (one row per entity).
+ * Each column is computed for all entities on its first request.
+ */
+class EntityPropertyTable
+{
+public:
+  enum Property
+  {
+    Measure,     // length of edges, area of faces, volume of solids (n x 1)
+    CoG,         // center of gravity, location of vertices (n x 3)
+    Normal,      // normal vector at the parametric center of faces (n x 3)
+    Radius,      // radius of circular edges and cylindrical faces, -1 otherwise (n x 1)
+    BoundingBox  // xmin ymin zmin xmax ymax zmax (n x 6)
+  };
+
+protected:
+  EntityType entityType_;
+  std::vector<TopoDS_Shape> entities_;
+  std::map<FeatureID, arma::uword> rows_;
+
+  mutable std::mutex mtx_;
+  mutable std::map<Property, arma::mat> columns_;
+
+  void computeMassProperties(arma::mat& measure, arma::mat& cog) const;
+
+public:
+  EntityPropertyTable(const FreelyIndexedMapOfShape& entities, EntityType et);
+
+  inline EntityType entityType() const { return entityType_; }
+  inline arma::uword size() const { return entities_.size(); }
+
+  arma::uword row(FeatureID i) const;
+  const arma::mat& column(Property p) const;
+
+  inline double measure(FeatureID i) const { return column(Measure)(row(i), 0); }
+  inline arma::mat cog(FeatureID i) const { return column(CoG).row(row(i)).t(); }
+  inline arma::mat normal(FeatureID i) const { return column(Normal).row(row(i)).t(); }
+  inline double radius(FeatureID i) const { return column(Radius)(row(i), 0); }
+  inline arma::mat boundingBox(FeatureID i) const { return column(BoundingBox).row(row(i)).t(); }
+
+  /**
+   * approximate memory used by the computed columns in bytes
+   */
+  size_t memoryUsage() const;
+};
+
+
+
+
+/**
+ * the indexed subshapes of a feature shape together with
+ * the indices derived from them.
+ * Built on the first query of a feature and not modified afterwards,
+ * so it is shared between copies of the feature.
+ */
+class FeatureTopology
+{
+  FreelyIndexedMapOfShape
+   fmap_, emap_, vmap_, somap_, shmap_, wmap_;
+
+  // spatial indices and property tables of the entities, built on first request
+  mutable std::mutex mtx_;
+  mutable std::map<EntityType, std::shared_ptr<EntityBoxTree> > boxTrees_;
+  mutable std::map<EntityType, std::shared_ptr<EntityPropertyTable> > propertyTables_;
+
+  double namingTime_;
+
+public:
+  FeatureTopology(const TopoDS_Shape& shape);
+
+  const FreelyIndexedMapOfShape& entityMap(EntityType et) const;
+  const EntityBoxTree& entityBoxTree(EntityType et) const;
+  const EntityPropertyTable& entityProperties(EntityType et) const;
+
+  /**
+   * wall time for indexing the subshapes in seconds
+   */
+  inline double namingTime() const { return namingTime_; }
+
+  /**
+   * approximate memory used by the maps and the derived indices in bytes
+   */
+  size_t memoryUsage() const;
+};
+
  
 /**
  * Base class of all CAD modelling features
@@ -186,6 +318,7 @@ class Feature
 {
   
   friend class ParameterListHash;
+  friend class FeatureCache;
   
 public:
   declareFactoryTableNoArgs(Feature); 
@@ -229,12 +362,18 @@ private:
   
   FeatureSetPtr creashapes_;
   
+  // all the (sub) TopoDS_Shapes in 'shape', indexed on first query
+  mutable std::mutex topologyMtx_;
+  mutable std::shared_ptr<const FeatureTopology> topology_;
+
+  /**
+   * take over the shape of another feature together with its topology maps
+   */
+  void shareShape(const Feature& o);
+
 protected:
-  // all the (sub) TopoDS_Shapes in 'shape'
-  /*TopTools_IndexedMapOfShape*/
-  FreelyIndexedMapOfShape
-   fmap_, emap_, vmap_, somap_, shmap_, wmap_;
-  
+  const FreelyIndexedMapOfShape& entityMap(EntityType et) const;
+
   SubfeatureMap providedSubshapes_;
   FeatureSetPtrMap providedFeatureSets_;
   DatumPtrMap providedDatums_;
@@ -275,6 +414,19 @@ protected:
   
   virtual void build();
 
+  /**
+   * write the result of build() (shape, reference values, datums, feature sets and subshapes)
+   * into a persistent cache entry.
+   * Returns false, if some part cannot be stored, e.g. feature sets of other features
+   * or subshapes which are not plain shapes.
+   */
+  bool writeCacheEntry(std::ostream& os) const;
+
+  /**
+   * restore the result of build() from a cache entry, written by writeCacheEntry
+   */
+  void readCacheEntry(std::istream& is);
+
 public:
   declareType("Feature");
   
@@ -318,18 +470,38 @@ public:
   
   bool operator==(const Feature& o) const;
 
+  /**
+   * index the subshapes now instead of on the first query
+   */
   void nameFeatures();
   void extractReferenceFeatures();
+
+  const FeatureTopology& topology() const;
+
+  /**
+   * whether the subshapes have been indexed already
+   */
+  bool hasTopology() const;
+
+  /**
+   * spatial index of all entities of the given type
+   */
+  const EntityBoxTree& entityBoxTree(EntityType et) const;
+
+  /**
+   * geometric properties of all entities of the given type
+   */
+  const EntityPropertyTable& entityProperties(EntityType et) const;
   
-  inline const TopoDS_Face& face(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Face(fmap_.FindKey(i)); }
-  inline const TopoDS_Edge& edge(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Edge(emap_.FindKey(i)); }
-  inline const TopoDS_Vertex& vertex(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Vertex(vmap_.FindKey(i)); }
-  inline const TopoDS_Solid& subsolid(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Solid(somap_.FindKey(i)); }
+  inline const TopoDS_Face& face(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Face(entityMap(Face).FindKey(i)); }
+  inline const TopoDS_Edge& edge(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Edge(entityMap(Edge).FindKey(i)); }
+  inline const TopoDS_Vertex& vertex(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Vertex(entityMap(Vertex).FindKey(i)); }
+  inline const TopoDS_Solid& subsolid(FeatureID i) const { checkForBuildDuringAccess(); return TopoDS::Solid(entityMap(Solid).FindKey(i)); }
 
-  inline FeatureID solidID(const TopoDS_Shape& f) const { checkForBuildDuringAccess(); int i=somap_.FindIndex(f); if (i==0) throw insight::Exception("requested solid not indexed!"); return i; }
-  inline FeatureID faceID(const TopoDS_Shape& f) const { checkForBuildDuringAccess(); int i=fmap_.FindIndex(f); if (i==0) throw insight::Exception("requested face not indexed!"); return i; }
-  inline FeatureID edgeID(const TopoDS_Shape& e) const { checkForBuildDuringAccess(); int i=emap_.FindIndex(e); if (i==0) throw insight::Exception("requested edge not indexed!"); return i; }
-  inline FeatureID vertexID(const TopoDS_Shape& v) const { checkForBuildDuringAccess(); int i=vmap_.FindIndex(v); if (i==0) throw insight::Exception("requested vertex not indexed!"); return i; }
+  inline FeatureID solidID(const TopoDS_Shape& f) const { checkForBuildDuringAccess(); int i=entityMap(Solid).FindIndex(f); if (i==0) throw insight::Exception("requested solid not indexed!"); return i; }
+  inline FeatureID faceID(const TopoDS_Shape& f) const { checkForBuildDuringAccess(); int i=entityMap(Face).FindIndex(f); if (i==0) throw insight::Exception("requested face not indexed!"); return i; }
+  inline FeatureID edgeID(const TopoDS_Shape& e) const { checkForBuildDuringAccess(); int i=entityMap(Edge).FindIndex(e); if (i==0) throw insight::Exception("requested edge not indexed!"); return i; }
+  inline FeatureID vertexID(const TopoDS_Shape& v) const { checkForBuildDuringAccess(); int i=entityMap(Vertex).FindIndex(v); if (i==0) throw insight::Exception("requested vertex not indexed!"); return i; }
   
   GeomAbs_CurveType edgeType(FeatureID i) const;
   GeomAbs_SurfaceType faceType(FeatureID i) const;
@@ -411,14 +583,31 @@ public:
   FeatureSet verticesOfFace(const FeatureID& f) const;
   FeatureSet verticesOfFaces(const FeatureSet& fs) const;
 
+  /**
+   * save in the format determined by the file extension.
+   * STL files are tessellated with absolute deflection stlDeflection.
+   */
   void saveAs
   (
     const boost::filesystem::path& filename,
     const std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >& namedfeats 
-      = std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >()
+      = std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >(),
+    double stlDeflection=1e-2
   ) const;
   
-  void exportSTL(const boost::filesystem::path& filename, double abstol=5e-5, bool binary=true) const;
+  /**
+   * tessellate with absolute deflection abstol and write STL.
+   * If named face sets are given, an ASCII file with one solid per set is written
+   * (the remaining faces go into a solid named like the file).
+   */
+  void exportSTL
+  (
+    const boost::filesystem::path& filename,
+    double abstol=5e-5,
+    bool binary=true,
+    const std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >& namedfeats
+      = std::vector<boost::fusion::vector2<std::string, FeatureSetPtr> >()
+  ) const;
   static void exportEMesh(const boost::filesystem::path& filename, const FeatureSet& fs, double abstol=1e-3, double maxlen=1e10);
   
   operator const TopoDS_Shape& () const;
@@ -426,6 +615,11 @@ public:
 
   virtual Handle_AIS_InteractiveObject buildVisualization() const;
   
+  /**
+   * hidden line projection of the shape.
+   * Safe to call concurrently. The results are cached
+   * by feature hash and view parameters.
+   */
   View createView
   (
     const arma::mat p0,
@@ -537,12 +731,60 @@ public:
 
 
 // #warning cachable feature always have to be stored in shared_ptrs! create functions and private constructors should be issues to ensure this.
+/**
+ * Cache of built features, keyed by Feature::hash().
+ * Besides the entries in memory, built features are stored persistently
+ * in a cache directory, so that they are available in later ISCAD sessions
+ * without rebuilding. The directory is taken from ISCAD_CACHE_DIR
+ * (default: $HOME/.insight/iscad_cache), its size is limited to ISCAD_CACHE_SIZE MB
+ * (default: 1024) by removing the least recently used entries.
+ * ISCAD_CACHE_SIZE=0 disables the persistent cache.
+ * Entries written by another build of insightcad or with another
+ * OCC version are not used.
+ */
 class FeatureCache
 : public std::map<size_t, FeaturePtr>
 {
 
   std::set<size_t> usedDuringRebuild_;
+
+  /**
+   * features are built concurrently during parallel rebuilds
+   */
+  mutable std::recursive_mutex mtx_;
   
+  boost::filesystem::path cacheDir_;
+  uintmax_t maxCacheSize_;
+
+  /**
+   * bytes written to the cache directory since its size was checked last
+   */
+  mutable uintmax_t writtenSinceCleanup_;
+
+  /**
+   * contents of cache files which were found by contains()
+   * and are not yet restored
+   */
+  mutable std::map<size_t, std::string> loadedEntries_;
+
+  /**
+   * entries on disk which turned out to be unusable.
+   * They are ignored, even if the files could not be removed.
+   */
+  mutable std::set<size_t> rejectedEntries_;
+
+  boost::filesystem::path fileName(size_t hash) const;
+  bool persistent() const;
+
+  void writeToDisk(ConstFeaturePtr p) const;
+  /**
+   * returns false and removes the file, if the entry is unusable
+   */
+  bool readFromDisk(size_t hash, Feature& f);
+  void removeLeastRecentlyUsed() const;
+
+  void registerEntry(FeaturePtr p);
+
 public:
   FeatureCache();
   ~FeatureCache();
@@ -556,6 +798,7 @@ public:
   template<class T>
   std::shared_ptr<T> markAsUsed(size_t hash)
   {
+    std::lock_guard<std::recursive_mutex> lock(mtx_);
     iterator i=this->find(hash);
     
     if (i==end()) 
@@ -580,6 +823,35 @@ public:
     return cp;
   }
   
+  /**
+   * restore the build result of feature "self" from the cache.
+   * Entries in memory are copied, entries which are only present
+   * in the cache directory are read from disk. In the latter case,
+   * self is added to the entries in memory.
+   * If the entry on disk turns out to be unusable, it is removed
+   * and self is built.
+   */
+  template<class T>
+  void restore(T& self)
+  {
+    size_t hash=self.hash();
+    {
+      std::lock_guard<std::recursive_mutex> lock(mtx_);
+      if (this->find(hash)!=end())
+      {
+        self.operator=(*markAsUsed<T>(hash));
+        return;
+      }
+      else if (readFromDisk(hash, self))
+      {
+        registerEntry(self.shared_from_this());
+        return;
+      }
+    }
+    // build outside the lock, concurrent builds shall continue
+    static_cast<Feature&>(self).build();
+  }
+
 };
 
 extern FeatureCache cache;
@@ -26,6 +26,7 @@
 #include "booleanintersection.h"                                                                                                    
 #include "booleansubtract.h"                                                                                                        
 #include "booleanunion.h"                                                                                                           
+#include "naryboolean.h"                                                                                                            
 #include "boundedflatface.h"                                                                                                        
 #include "box.h"                                                                                                                    
 #include "chamfer.h"                                                                                                                
@@ -197,7 +197,7 @@ void Bar::build()
     }
     else
     {
-        this->operator=(*cache.markAsUsed<Bar>(hash()));
+        cache.restore<Bar>(*this);
     }
 }
 
@@ -185,7 +185,7 @@ void BooleanIntersection::build()
     }
     else
     {
-        this->operator=(*cache.markAsUsed<BooleanIntersection>(hash()));
+        cache.restore<BooleanIntersection>(*this);
     }
 }
 
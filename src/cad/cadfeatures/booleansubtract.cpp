@@ -106,7 +106,7 @@ void BooleanSubtract::build()
   }
   else
   {
-      this->operator=(*cache.markAsUsed<BooleanSubtract>(hash()));
+      cache.restore<BooleanSubtract>(*this);
   }
   m1_->unsetLeaf();
   m2_->unsetLeaf();
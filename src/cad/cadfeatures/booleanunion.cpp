@@ -18,6 +18,7 @@
  */
 
 #include "booleanunion.h"
+#include "naryboolean.h"
 #include "base/boost_include.h"
 #include <boost/spirit/include/qi.hpp>
 #include "base/tools.h"
@@ -121,7 +122,7 @@ void BooleanUnion::build()
         }
         else
         {
-            this->operator=(*cache.markAsUsed<BooleanUnion>(hash()));
+            cache.restore<BooleanUnion>(*this);
         }
         m1_->unsetLeaf();
         m2_->unsetLeaf();
@@ -131,26 +132,26 @@ void BooleanUnion::build()
         copyDatums(*m1_);
         m1_->unsetLeaf();
 
-        TopoDS_Shape res;
+        std::vector<TopoDS_Shape> solids;
         for (TopExp_Explorer ex(*m1_, TopAbs_SOLID); ex.More(); ex.Next())
         {
-            if (res.IsNull())
+            solids.push_back(ex.Current());
+        }
+
+        TopoDS_Shape res;
+        if (!solids.empty())
+        {
+            try
             {
-                res=TopoDS::Solid(ex.Current());
+                res=NaryBoolean::perform(NaryBoolean::Fuse, solids);
             }
-            else
+            catch (const insight::Exception& e)
             {
-                BRepAlgoAPI_Fuse fuser(res, TopoDS::Solid(ex.Current()));
-                fuser.Build();
-                if (!fuser.IsDone())
-                {
-                    throw CADException
-                    (
-                        shared_from_this(),
-                        "could not perform merge operation."
-                    );
-                }                
-                res=fuser.Shape();
+                throw CADException
+                (
+                    shared_from_this(),
+                    "could not perform merge operation: "+e.message()
+                );
             }
         }
         setShape(res);
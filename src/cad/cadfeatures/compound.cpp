@@ -131,7 +131,7 @@ void Compound::build()
     }
     else
     {
-        this->operator=(*cache.markAsUsed<Compound>(hash()));
+        cache.restore<Compound>(*this);
     }
 }
 
@@ -177,7 +177,7 @@ void Cutaway::build()
     }
   else
     {
-      this->operator=(*cache.markAsUsed<Cutaway>(hash()));
+      cache.restore<Cutaway>(*this);
     }
 }
 
@@ -20,6 +20,7 @@
 #include "freecadmodel.h"
 #include "base/boost_include.h"
 #include "base/tools.h"
+#include "filefingerprints.h"
 
 using namespace boost;
 using namespace boost::filesystem;
@@ -45,7 +46,19 @@ size_t FreeCADModel::calcHash() const
 {
   ParameterListHash h;
   h+=this->type();
-  h+=filename_;
+  h+=filename_.string();
+  try
+  {
+    boost::filesystem::path infilename = filename_;
+    if ( !exists ( infilename ) ) {
+        infilename=sharedModelFilePath ( filename_.string() );
+    }
+    h+=fileFingerprints(infilename);
+  }
+  catch (...)
+  {
+    // file not found, reported during build
+  }
   h+=solidname_;
   for (const FreeCADModelVar& v: vars_)
   {
@@ -156,6 +169,14 @@ void FreeCADModel::build()
 
 
 
+bool FreeCADModel::buildIsThreadSafe() const
+{
+    // runs FreeCAD and reads its BREP output
+    return false;
+}
+
+
+
 
 void FreeCADModel::insertrule ( parser::ISCADParser& ruleset ) const
 {
@@ -44,6 +44,7 @@ class FreeCADModel
 
     virtual size_t calcHash() const;
     virtual void build();
+    virtual bool buildIsThreadSafe() const;
 
 public:
     declareType ( "FreeCADModel" );
@@ -21,6 +21,7 @@
 #include "base/boost_include.h"
 #include <boost/spirit/include/qi.hpp>
 #include "base/tools.h"
+#include "filefingerprints.h"
 
 namespace qi = boost::spirit::qi;
 namespace repo = boost::spirit::repository;
@@ -43,7 +44,16 @@ size_t Import::calcHash() const
 {
   ParameterListHash h;
   h+=this->type();
-  h+=filepath_;
+  h+=filepath_.string();
+  try
+  {
+    // file contents instead of time stamp: touched files remain cache hits
+    h+=fileFingerprints(resolvedFilePath());
+  }
+  catch (...)
+  {
+    // file not found, reported during build
+  }
   return h.getHash();
 }
 
@@ -65,6 +75,19 @@ Import::Import(const filesystem::path& filepath/*, ScalarPtr scale*/)
 
 
 
+boost::filesystem::path Import::resolvedFilePath() const
+{
+  boost::filesystem::path fp = filepath_;
+  if (!boost::filesystem::exists(fp))
+  {
+    fp=sharedModelFilePath(filepath_.string());
+  }
+  return fp;
+}
+
+
+
+
 FeaturePtr Import::create ( const boost::filesystem::path& filepath/*, ScalarPtr scale=ScalarPtr()*/ )
 {
     return FeaturePtr(new Import(filepath));
@@ -79,14 +102,14 @@ void Import::build()
 
   if (!cache.contains(hash()))
   {
-    boost::filesystem::path fp = filepath_;
-    if (!boost::filesystem::exists(fp))
+    boost::filesystem::path fp;
+    try
     {
-      fp=sharedModelFilePath(filepath_.string());
-      if (!boost::filesystem::exists(fp))
-      {
-        throw insight::Exception("File not found: "+filepath_.string());
-      }
+      fp = resolvedFilePath();
+    }
+    catch (...)
+    {
+      throw insight::Exception("File not found: "+filepath_.string());
     }
     loadShapeFromFile(fp);
 
@@ -94,7 +117,7 @@ void Import::build()
   }
   else
   {
-      this->operator=(*cache.markAsUsed<Import>(hash()));
+      cache.restore<Import>(*this);
   }
 
 //   if (scale_)
@@ -109,6 +132,15 @@ void Import::build()
 
 
 
+bool Import::buildIsThreadSafe() const
+{
+  // the STEP/IGES readers use global OCC settings,
+  // they are serialized in loadShapeFromFile only
+  return true;
+}
+
+
+
 
 void Import::insertrule(parser::ISCADParser& ruleset) const
 {
@@ -36,8 +36,15 @@ class Import
 
     Import ( const boost::filesystem::path& filepath/*, ScalarPtr scale=ScalarPtr()*/ );
 
+    /**
+     * the file path, looked up in the shared model directories,
+     * if not existing locally
+     */
+    boost::filesystem::path resolvedFilePath() const;
+
     virtual size_t calcHash() const;
     virtual void build();
+    virtual bool buildIsThreadSafe() const;
 
 public:
     declareType ( "Import" );
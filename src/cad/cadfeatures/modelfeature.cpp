@@ -231,11 +231,19 @@ void ModelFeature::build()
     }
     else
     {
-        this->operator=(*cache.markAsUsed<ModelFeature>(hash()));
+        cache.restore<ModelFeature>(*this);
     }
 }
 
 
+
+bool ModelFeature::buildIsThreadSafe() const
+{
+    // parses and builds a sub model
+    return false;
+}
+
+
 std::string ModelFeature::modelname() const
 {
     if (const boost::filesystem::path* fp = boost::get<boost::filesystem::path>(&modelinput_))
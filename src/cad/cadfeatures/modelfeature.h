@@ -47,6 +47,7 @@ class ModelFeature
 
     virtual size_t calcHash() const;
     virtual void build();
+    virtual bool buildIsThreadSafe() const;
 
 public:
     declareType ( "loadmodel" );
@@ -0,0 +1,689 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "naryboolean.h"
+#include "base/boost_include.h"
+#include <boost/spirit/include/qi.hpp>
+#include "base/tools.h"
+
+#include "TopoDS_Iterator.hxx"
+#include "Precision.hxx"
+#if (OCC_VERSION_HEX>=0x070200)
+#include "BOPAlgo_CellsBuilder.hxx"
+#endif
+
+namespace qi = boost::spirit::qi;
+namespace repo = boost::spirit::repository;
+namespace phx   = boost::phoenix;
+
+using namespace std;
+using namespace boost;
+
+namespace insight
+{
+namespace cad
+{
+
+
+
+
+namespace
+{
+
+std::string operatorSymbol(NaryBoolean::Operation op)
+{
+    switch (op)
+    {
+        case NaryBoolean::Fuse: return " | ";
+        case NaryBoolean::Cut: return " - ";
+        case NaryBoolean::Common: return " & ";
+    }
+    return "";
+}
+
+
+
+
+Bnd_Box boundingBox(const TopoDS_Shape& s, double gap)
+{
+    Bnd_Box bb;
+    BRepBndLib::Add(s, bb);
+    bb.Enlarge(gap);
+    return bb;
+}
+
+
+
+
+/**
+ * replace compounds by their components
+ */
+void explodeCompounds(const TopoDS_Shape& s, std::vector<TopoDS_Shape>& shapes)
+{
+    if (s.ShapeType()==TopAbs_COMPOUND)
+    {
+        for (TopoDS_Iterator it(s); it.More(); it.Next())
+        {
+            explodeCompounds(it.Value(), shapes);
+        }
+    }
+    else
+    {
+        shapes.push_back(s);
+    }
+}
+
+
+
+
+#if (OCC_VERSION_MAJOR>=7)
+
+TopTools_ListOfShape toList(const std::vector<TopoDS_Shape>& shapes)
+{
+    TopTools_ListOfShape l;
+    for (const TopoDS_Shape& s: shapes)
+    {
+        l.Append(s);
+    }
+    return l;
+}
+
+#else
+
+TopoDS_Shape binaryBoolean(NaryBoolean::Operation op, const TopoDS_Shape& a, const TopoDS_Shape& b)
+{
+    std::unique_ptr<BRepAlgoAPI_BooleanOperation> alg;
+    switch (op)
+    {
+        case NaryBoolean::Fuse: alg.reset(new BRepAlgoAPI_Fuse(a, b)); break;
+        case NaryBoolean::Cut: alg.reset(new BRepAlgoAPI_Cut(a, b)); break;
+        case NaryBoolean::Common: alg.reset(new BRepAlgoAPI_Common(a, b)); break;
+    }
+    if (!alg->IsDone())
+    {
+        throw insight::Exception("could not perform boolean operation.");
+    }
+    return alg->Shape();
+}
+
+#endif
+
+
+
+
+#if (OCC_VERSION_HEX>=0x070200)
+
+/**
+ * intersection of all shapes in a single general fuse run:
+ * the result consists of the cells, which are inside of all shapes.
+ * (A common operation with several tools would intersect with their union.)
+ */
+TopoDS_Shape commonRun(const std::vector<TopoDS_Shape>& shapes, double fuzzy)
+{
+    TopTools_ListOfShape all=toList(shapes);
+    BOPAlgo_CellsBuilder cb;
+    cb.SetArguments(all);
+    cb.SetRunParallel(Standard_True);
+    if (fuzzy>0.)
+    {
+        cb.SetFuzzyValue(fuzzy);
+    }
+    cb.Perform();
+    if (cb.HasErrors())
+    {
+        throw insight::Exception("could not perform boolean operation.");
+    }
+    cb.AddToResult(all, TopTools_ListOfShape());
+    cb.RemoveInternalBoundaries();
+    return cb.Shape();
+}
+
+#endif
+
+
+
+
+/**
+ * one boolean operation between arguments and tools
+ */
+TopoDS_Shape booleanRun
+(
+    NaryBoolean::Operation op,
+    const std::vector<TopoDS_Shape>& args,
+    const std::vector<TopoDS_Shape>& tools,
+    double fuzzy
+)
+{
+#if (OCC_VERSION_MAJOR>=7)
+    std::unique_ptr<BRepAlgoAPI_BooleanOperation> alg;
+    switch (op)
+    {
+        case NaryBoolean::Fuse: alg.reset(new BRepAlgoAPI_Fuse); break;
+        case NaryBoolean::Cut: alg.reset(new BRepAlgoAPI_Cut); break;
+        case NaryBoolean::Common: alg.reset(new BRepAlgoAPI_Common); break;
+    }
+    alg->SetArguments(toList(args));
+    alg->SetTools(toList(tools));
+    alg->SetRunParallel(Standard_True);
+    if (fuzzy>0.)
+    {
+        alg->SetFuzzyValue(fuzzy);
+    }
+    alg->Build();
+    if (!alg->IsDone())
+    {
+        throw insight::Exception("could not perform boolean operation.");
+    }
+    return alg->Shape();
+#else
+    // no n-ary booleans available: pairwise operations
+    if (fuzzy>0.)
+    {
+        insight::Warning("fuzzy boolean operations are not supported by this OCC version. Fuzzy value is ignored.");
+    }
+    std::vector<TopoDS_Shape> s(args);
+    s.insert(s.end(), tools.begin(), tools.end());
+    if (op==NaryBoolean::Fuse)
+    {
+        // balanced reduction keeps the intermediate results small
+        while (s.size()>1)
+        {
+            std::vector<TopoDS_Shape> next;
+            for (size_t i=0; i<s.size(); i+=2)
+            {
+                if (i+1<s.size())
+                    next.push_back(binaryBoolean(op, s[i], s[i+1]));
+                else
+                    next.push_back(s[i]);
+            }
+            s.swap(next);
+        }
+        return s[0];
+    }
+    else
+    {
+        TopoDS_Shape r=s[0];
+        for (size_t i=1; i<s.size(); i++)
+        {
+            r=binaryBoolean(op, r, s[i]);
+        }
+        return r;
+    }
+#endif
+}
+
+}
+
+
+
+
+defineType(NaryBoolean);
+addToFactoryTable(Feature, NaryBoolean);
+
+
+
+
+size_t NaryBoolean::calcHash() const
+{
+    ParameterListHash h;
+    h+=this->type();
+    h+=int(op_);
+    h+=chained_;
+    for (const FeaturePtr& a: args_)
+    {
+        h+=*a;
+    }
+    if (fuzzy_) h+=fuzzy_->value();
+    return h.getHash();
+}
+
+
+
+
+NaryBoolean::NaryBoolean()
+: DerivedFeature(),
+  op_(Fuse),
+  chained_(false)
+{}
+
+
+
+
+NaryBoolean::NaryBoolean(Operation op, const std::vector<FeaturePtr>& args, ScalarPtr fuzzy, bool chained)
+: DerivedFeature(args.front()),
+  op_(op),
+  args_(args),
+  fuzzy_(fuzzy),
+  chained_(chained)
+{
+    autoName_="(";
+    for (size_t i=0; i<args_.size(); i++)
+    {
+        if (i>0) autoName_+=operatorSymbol(op_);
+        autoName_+=args_[i]->featureSymbolName();
+    }
+    autoName_+=")";
+    setFeatureSymbolName(autoName_);
+}
+
+
+
+
+FeaturePtr NaryBoolean::create(Operation op, const std::vector<FeaturePtr>& args, ScalarPtr fuzzy)
+{
+    if (args.empty())
+    {
+        throw insight::Exception("boolean operation: no arguments given!");
+    }
+    return FeaturePtr(new NaryBoolean(op, args, fuzzy));
+}
+
+
+
+
+FeaturePtr NaryBoolean::create_fuse(const std::vector<FeaturePtr>& args, ScalarPtr fuzzy)
+{
+    return create(Fuse, args, fuzzy);
+}
+
+
+
+
+FeaturePtr NaryBoolean::create_cut(const std::vector<FeaturePtr>& args, ScalarPtr fuzzy)
+{
+    return create(Cut, args, fuzzy);
+}
+
+
+
+
+FeaturePtr NaryBoolean::create_common(const std::vector<FeaturePtr>& args, ScalarPtr fuzzy)
+{
+    return create(Common, args, fuzzy);
+}
+
+
+
+
+FeaturePtr NaryBoolean::append(Operation op, FeaturePtr m1, FeaturePtr m2)
+{
+    std::vector<FeaturePtr> args;
+
+    // only unnamed chains are extended, explicit Fuse(...) etc. are kept as argument
+    std::shared_ptr<NaryBoolean> nb = std::dynamic_pointer_cast<NaryBoolean>(m1);
+    if ( nb && nb->chained_ && (nb->op_==op) && !nb->fuzzy_ && (nb->featureSymbolName()==nb->autoName_) )
+    {
+        args=nb->args_;
+    }
+    else
+    {
+        args.push_back(m1);
+    }
+    args.push_back(m2);
+
+    return FeaturePtr(new NaryBoolean(op, args, ScalarPtr(), true));
+}
+
+
+
+
+std::string NaryBoolean::datumPrefix(size_t i) const
+{
+    if (!chained_)
+    {
+        return str(format("m%d_") % (i+1));
+    }
+
+    // ((a|b)|c)|...: argument i>0 is the second operand of the i-th union,
+    // which is the first operand of all following unions
+    std::string prefix;
+    for (size_t k=std::max<size_t>(i, 1); k+1<args_.size(); k++) prefix+="m1_";
+    return prefix + (i==0 ? "m1_" : "m2_");
+}
+
+
+
+
+FeaturePtr NaryBoolean::fuse(FeaturePtr m1, FeaturePtr m2)
+{
+    return append(Fuse, m1, m2);
+}
+
+
+
+
+FeaturePtr NaryBoolean::cut(FeaturePtr m1, FeaturePtr m2)
+{
+    return append(Cut, m1, m2);
+}
+
+
+
+
+FeaturePtr NaryBoolean::common(FeaturePtr m1, FeaturePtr m2)
+{
+    return append(Common, m1, m2);
+}
+
+
+
+
+TopoDS_Shape NaryBoolean::perform
+(
+    Operation op,
+    const std::vector<TopoDS_Shape>& shapes,
+    double fuzzy,
+    bool bbFilter
+)
+{
+    if (shapes.empty())
+    {
+        throw insight::Exception("boolean operation: no arguments given!");
+    }
+    if (shapes.size()==1)
+    {
+        return shapes.front();
+    }
+
+    double gap = fuzzy + Precision::Confusion();
+
+    if (op==Fuse)
+    {
+        std::vector<TopoDS_Shape> interacting, isolated;
+        if (bbFilter)
+        {
+            std::vector<Bnd_Box> bbs;
+            for (const TopoDS_Shape& s: shapes)
+            {
+                bbs.push_back(boundingBox(s, gap));
+            }
+            for (size_t i=0; i<shapes.size(); i++)
+            {
+                bool hit=false;
+                for (size_t j=0; j<shapes.size() && !hit; j++)
+                {
+                    hit = (i!=j) && !bbs[i].IsOut(bbs[j]);
+                }
+                if (hit)
+                    interacting.push_back(shapes[i]);
+                else
+                    isolated.push_back(shapes[i]);
+            }
+        }
+        else
+        {
+            interacting=shapes;
+        }
+
+        TopoDS_Shape fused;
+        if (interacting.size()>1)
+        {
+            fused=booleanRun
+            (
+                Fuse,
+                std::vector<TopoDS_Shape>(interacting.begin(), interacting.begin()+1),
+                std::vector<TopoDS_Shape>(interacting.begin()+1, interacting.end()),
+                fuzzy
+            );
+        }
+        if (isolated.empty())
+        {
+            return fused;
+        }
+
+        // non-interacting arguments are just collected
+        TopoDS_Compound res;
+        BRep_Builder builder;
+        builder.MakeCompound(res);
+        if (!fused.IsNull())
+        {
+            std::vector<TopoDS_Shape> fs;
+            explodeCompounds(fused, fs);
+            for (const TopoDS_Shape& s: fs) builder.Add(res, s);
+        }
+        for (const TopoDS_Shape& s: isolated)
+        {
+            builder.Add(res, s);
+        }
+        return res;
+    }
+    else if (op==Cut)
+    {
+        std::vector<TopoDS_Shape> tools;
+        for (size_t i=1; i<shapes.size(); i++)
+        {
+            // pattern instances are filtered individually
+            explodeCompounds(shapes[i], tools);
+        }
+
+        if (bbFilter)
+        {
+            Bnd_Box bb0=boundingBox(shapes.front(), gap);
+            std::vector<TopoDS_Shape> hits;
+            for (const TopoDS_Shape& t: tools)
+            {
+                if (!bb0.IsOut(boundingBox(t, gap))) hits.push_back(t);
+            }
+            tools.swap(hits);
+        }
+
+        if (tools.empty())
+        {
+            return shapes.front();
+        }
+        return booleanRun
+        (
+            Cut,
+            std::vector<TopoDS_Shape>(1, shapes.front()),
+            tools,
+            fuzzy
+        );
+    }
+    else
+    {
+        if (bbFilter)
+        {
+            std::vector<Bnd_Box> bbs;
+            for (const TopoDS_Shape& s: shapes)
+            {
+                bbs.push_back(boundingBox(s, gap));
+            }
+            for (size_t i=0; i<bbs.size(); i++)
+            {
+                for (size_t j=i+1; j<bbs.size(); j++)
+                {
+                    if (bbs[i].IsOut(bbs[j]))
+                    {
+                        // no common volume
+                        TopoDS_Compound res;
+                        BRep_Builder builder;
+                        builder.MakeCompound(res);
+                        return res;
+                    }
+                }
+            }
+        }
+
+#if (OCC_VERSION_HEX>=0x070200)
+        if (shapes.size()>2)
+        {
+            return commonRun(shapes, fuzzy);
+        }
+#endif
+        TopoDS_Shape r=shapes.front();
+        for (size_t i=1; i<shapes.size(); i++)
+        {
+            r=booleanRun
+            (
+                Common,
+                std::vector<TopoDS_Shape>(1, r),
+                std::vector<TopoDS_Shape>(1, shapes[i]),
+                fuzzy
+            );
+        }
+        return r;
+    }
+}
+
+
+
+
+void NaryBoolean::build()
+{
+    ExecTimer t("NaryBoolean::build() ["+featureSymbolName()+"]");
+
+    if (!cache.contains(hash()))
+    {
+        std::vector<TopoDS_Shape> shapes;
+        for (const FeaturePtr& a: args_)
+        {
+            shapes.push_back(*a);
+        }
+
+        try
+        {
+            setShape( perform(op_, shapes, fuzzy_ ? fuzzy_->value() : 0.0) );
+        }
+        catch (const insight::Exception& e)
+        {
+            throw CADException(shared_from_this(), e.message());
+        }
+
+        if (op_==Fuse)
+        {
+            for (size_t i=0; i<args_.size(); i++)
+            {
+                copyDatums(*args_[i], datumPrefix(i));
+            }
+        }
+        else if (op_==Cut)
+        {
+            copyDatums(*args_.front());
+        }
+
+        cache.insert(shared_from_this());
+    }
+    else
+    {
+        cache.restore<NaryBoolean>(*this);
+    }
+
+    for (const FeaturePtr& a: args_)
+    {
+        a->unsetLeaf();
+    }
+}
+
+
+
+
+void NaryBoolean::insertrule(parser::ISCADParser& ruleset) const
+{
+    ruleset.modelstepFunctionRules.add
+    (
+        "Fuse",
+        typename parser::ISCADParser::ModelstepRulePtr(new typename parser::ISCADParser::ModelstepRule(
+
+        ( '(' >> ( ruleset.r_solidmodel_expression % ',' )
+              >> ( ( ',' >> qi::lit("fuzzy") >> ruleset.r_scalarExpression ) | qi::attr(ScalarPtr()) )
+              >> ')' )
+          [ qi::_val = phx::bind(&NaryBoolean::create_fuse, qi::_1, qi::_2) ]
+
+        ))
+    );
+    ruleset.modelstepFunctionRules.add
+    (
+        "Cut",
+        typename parser::ISCADParser::ModelstepRulePtr(new typename parser::ISCADParser::ModelstepRule(
+
+        ( '(' >> ( ruleset.r_solidmodel_expression % ',' )
+              >> ( ( ',' >> qi::lit("fuzzy") >> ruleset.r_scalarExpression ) | qi::attr(ScalarPtr()) )
+              >> ')' )
+          [ qi::_val = phx::bind(&NaryBoolean::create_cut, qi::_1, qi::_2) ]
+
+        ))
+    );
+    ruleset.modelstepFunctionRules.add
+    (
+        "Common",
+        typename parser::ISCADParser::ModelstepRulePtr(new typename parser::ISCADParser::ModelstepRule(
+
+        ( '(' >> ( ruleset.r_solidmodel_expression % ',' )
+              >> ( ( ',' >> qi::lit("fuzzy") >> ruleset.r_scalarExpression ) | qi::attr(ScalarPtr()) )
+              >> ')' )
+          [ qi::_val = phx::bind(&NaryBoolean::create_common, qi::_1, qi::_2) ]
+
+        ))
+    );
+}
+
+
+
+
+FeatureCmdInfoList NaryBoolean::ruleDocumentation() const
+{
+    return boost::assign::list_of
+    (
+        FeatureCmdInfo
+        (
+            "Fuse",
+            "( <feature:f0>, <feature:f1> [, ..., <feature:fn>] [, fuzzy <scalar:tol>] )",
+            "Creates the boolean union of all features f0 to fn in a single parallel operation."
+            " Features whose bounding boxes do not overlap with any other feature are not intersected."
+            " Optionally, a fuzzy tolerance for the intersection of nearly coincident geometry can be given."
+        )
+    )
+    (
+        FeatureCmdInfo
+        (
+            "Cut",
+            "( <feature:base>, <feature:t1> [, ..., <feature:tn>] [, fuzzy <scalar:tol>] )",
+            "Subtracts all tool features t1 to tn from the base feature in a single parallel operation."
+            " Tools (and components of tool compounds) outside the bounding box of the base feature are skipped."
+        )
+    )
+    (
+        FeatureCmdInfo
+        (
+            "Common",
+            "( <feature:f0>, <feature:f1> [, ..., <feature:fn>] [, fuzzy <scalar:tol>] )",
+            "Creates the boolean intersection of all features f0 to fn."
+        )
+    );
+}
+
+
+
+
+void NaryBoolean::operator=(const NaryBoolean& o)
+{
+    op_=o.op_;
+    args_=o.args_;
+    fuzzy_=o.fuzzy_;
+    autoName_=o.autoName_;
+    chained_=o.chained_;
+    Feature::operator=(o);
+}
+
+
+
+
+}
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef INSIGHT_CAD_NARYBOOLEAN_H
+#define INSIGHT_CAD_NARYBOOLEAN_H
+
+#include "cadparameters.h"
+#include "derivedfeature.h"
+
+namespace insight
+{
+namespace cad
+{
+
+
+/**
+ * Boolean operation on an arbitrary number of arguments,
+ * performed in a single parallel OCC boolean run.
+ * Fuse: union of all arguments.
+ * Cut: first argument minus all other arguments.
+ * Common: intersection of all arguments.
+ *
+ * Chained operators in ISCAD expressions (a|b|c, a-b-c, a&b&c)
+ * are collected into a single NaryBoolean.
+ */
+class NaryBoolean
+    : public DerivedFeature
+{
+public:
+    enum Operation { Fuse, Cut, Common };
+
+protected:
+    Operation op_;
+    std::vector<FeaturePtr> args_;
+    ScalarPtr fuzzy_;
+
+    /**
+     * symbol name given at construction.
+     * Only unnamed features are extended by chained operators
+     */
+    std::string autoName_;
+
+    /**
+     * arguments were collected from chained binary operators.
+     * Datums of fused arguments then get the prefixes of nested
+     * binary unions (m1_m1_, m1_m2_, m2_ for a|b|c).
+     */
+    bool chained_;
+
+    NaryBoolean(Operation op, const std::vector<FeaturePtr>& args, ScalarPtr fuzzy = ScalarPtr(), bool chained = false);
+
+    std::string datumPrefix(size_t i) const;
+
+    virtual size_t calcHash() const;
+    virtual void build();
+
+    static FeaturePtr append(Operation op, FeaturePtr m1, FeaturePtr m2);
+
+public:
+    declareType("NaryBoolean");
+    NaryBoolean();
+
+    static FeaturePtr create(Operation op, const std::vector<FeaturePtr>& args, ScalarPtr fuzzy = ScalarPtr());
+    static FeaturePtr create_fuse(const std::vector<FeaturePtr>& args, ScalarPtr fuzzy);
+    static FeaturePtr create_cut(const std::vector<FeaturePtr>& args, ScalarPtr fuzzy);
+    static FeaturePtr create_common(const std::vector<FeaturePtr>& args, ScalarPtr fuzzy);
+
+    /**
+     * binary operations, which extend unnamed operations of the same kind
+     */
+    static FeaturePtr fuse(FeaturePtr m1, FeaturePtr m2);
+    static FeaturePtr cut(FeaturePtr m1, FeaturePtr m2);
+    static FeaturePtr common(FeaturePtr m1, FeaturePtr m2);
+
+    /**
+     * perform the boolean operation on shapes.
+     * For Fuse and Common, all shapes are arguments, for Cut
+     * the first shape is cut by the others.
+     * Arguments with non-overlapping bounding boxes
+     * are excluded from the boolean operation, if bbFilter is set.
+     */
+    static TopoDS_Shape perform
+    (
+        Operation op,
+        const std::vector<TopoDS_Shape>& shapes,
+        double fuzzy = 0.0,
+        bool bbFilter = true
+    );
+
+    virtual void insertrule(parser::ISCADParser& ruleset) const;
+    virtual FeatureCmdInfoList ruleDocumentation() const;
+
+    void operator=(const NaryBoolean& o);
+
+};
+
+
+}
+}
+
+#endif // INSIGHT_CAD_NARYBOOLEAN_H
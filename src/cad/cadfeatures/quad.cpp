@@ -184,7 +184,7 @@ void Quad::build()
         cache.insert ( shared_from_this() );
         
     } else {
-        this->operator= ( *cache.markAsUsed<Quad> ( hash() ) );
+        cache.restore<Quad>(*this);
     }
 }
 
@@ -48,6 +48,7 @@
 #include <boost/spirit/include/qi.hpp>
 
 #include "transform.h"
+#include "filefingerprints.h"
 
 namespace qi = boost::spirit::qi;
 namespace repo = boost::spirit::repository;
@@ -71,7 +72,8 @@ size_t STL::calcHash() const
 {
   ParameterListHash h;
   h+=this->type();
-  h+=fname_;
+  h+=fname_.string();
+  h+=fileFingerprints(fname_);
   if (trsf_) h+=*trsf_;
   if (other_trsf_) h+=*other_trsf_;
   return h.getHash();
@@ -186,12 +188,20 @@ void STL::build()
     }
     else
     {
-        this->operator=(*cache.markAsUsed<STL>(hash()));
+        cache.restore<STL>(*this);
     }
 }
 
 
 
+bool STL::buildIsThreadSafe() const
+{
+    // reads a file
+    return false;
+}
+
+
+
 
 void STL::insertrule(parser::ISCADParser& ruleset) const
 {
@@ -44,6 +44,7 @@ class STL
 protected:
     virtual size_t calcHash() const;
     virtual void build();
+    virtual bool buildIsThreadSafe() const;
 
 public:
     declareType("STL");
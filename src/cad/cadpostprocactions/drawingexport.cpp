@@ -21,6 +21,13 @@
 #include "drawingexport.h"
 #include "dxfwriter.h"
 
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+
+#include "Standard.hxx"
+
 namespace insight 
 {
 namespace cad 
@@ -67,9 +74,53 @@ DrawingExport::DrawingExport
 
 
 
+namespace
+{
+
+/**
+ * parameters of a single projection
+ */
+struct ViewTask
+{
+    std::string name;
+    FeaturePtr model;
+    arma::mat p0, dir, up;
+    bool section, poly, skiphl;
+    Feature::View result;
+};
+
+}
+
+
+
+
 void DrawingExport::build()
 {
-    Feature::Views views;
+    // collect all views, the placement of the additional views
+    // depends on the size of the others and is done afterwards
+    std::vector<ViewTask> tasks;
+    auto addTask = [&](const std::string& name, FeaturePtr model, const arma::mat& p0, const arma::mat& dir,
+                       bool sec, const arma::mat& up, bool poly, bool skiphl)
+    {
+        ViewTask t;
+        t.name=name;
+        t.model=model;
+        t.p0=p0;
+        t.dir=dir;
+        t.up=up;
+        t.section=sec;
+        t.poly=poly;
+        t.skiphl=skiphl;
+        tasks.push_back(t);
+    };
+
+    struct Placement
+    {
+        std::string name;
+        bool left_view, right_view, top_view, bottom_view, back_view;
+    };
+    std::vector<Placement> placements;
+
     for (const DrawingViewDefinitions& vds: viewdefs_)
     {
         FeaturePtr model_=boost::fusion::at_c<0>(vds);
@@ -102,97 +153,94 @@ void DrawingExport::build()
             if (arma::norm(up,2)<1e-6)
                 throw insight::Exception("length of upward direction vector must not be zero!");
 
-            views[name] =
-                model_->createView
-                (
-                    p0,
-                    dir,
-                    sec,
-                    up,
-                    poly,
-                    skiphl
-                );
-                
-            if (left_view)
-            {
-                std::string thisname = name+"_left";
-                
-                views[thisname] =
-                    model_->createView
-                    (
-                        p0,
-                        -right,
-                        false,
-                        up,
-                        poly,
-                        skiphl
-                    );
-                views[thisname].insert_x = +( 0.55 * views[name].width +0.55 * views[thisname].width );
-            }
-            if (back_view)
-            {
-                std::string thisname = name+"_back";
-                
-                views[thisname] =
-                    model_->createView
-                    (
-                        p0,
-                        -dir,
-                        false,
-                        up,
-                        poly,
-                        skiphl
-                    );
-                views[thisname].insert_x = +( 0.55 * views[name].width +1.1 * views[name+"_left"].width +0.55 * views[thisname].width );
-            }
-            if (right_view)
-            {
-                std::string thisname = name+"_right";
-                
-                views[thisname] =
-                    model_->createView
-                    (
-                        p0,
-                        right,
-                        false,
-                        up,
-                        poly,
-                        skiphl
-                    );
-                views[thisname].insert_x = -( 0.55 * views[name].width +0.55 * views[thisname].width );
-            }
-            if (top_view)
-            {
-                std::string thisname = name+"_top";
-                
-                views[thisname] =
-                    model_->createView
-                    (
-                        p0,
-                        up,
-                        false,
-                        -dir,
-                        poly,
-                        skiphl
-                    );
-                views[thisname].insert_y = -( 0.55 * views[name].height +0.55 * views[thisname].height );
-            }
-            if (bottom_view)
+            addTask(name, model_, p0, dir, sec, up, poly, skiphl);
+            if (left_view)   addTask(name+"_left",   model_, p0, -right, false, up,   poly, skiphl);
+            if (back_view)   addTask(name+"_back",   model_, p0, -dir,   false, up,   poly, skiphl);
+            if (right_view)  addTask(name+"_right",  model_, p0, right,  false, up,   poly, skiphl);
+            if (top_view)    addTask(name+"_top",    model_, p0, up,     false, -dir, poly, skiphl);
+            if (bottom_view) addTask(name+"_bottom", model_, p0, -up,    false, dir,  poly, skiphl);
+
+            Placement pl = { name, left_view, right_view, top_view, bottom_view, back_view };
+            placements.push_back(pl);
+        }
+    }
+
+    // the views are independent, project them concurrently
+    {
+#if (OCC_VERSION_MAJOR<7)
+        Standard::SetReentrant(Standard_True);
+#endif
+        std::atomic<size_t> next(0);
+        std::mutex errorMtx;
+        std::exception_ptr error;
+
+        auto worker = [&]()
+        {
+            for (size_t i=next++; i<tasks.size(); i=next++)
             {
-                std::string thisname = name+"_bottom";
-                
-                views[thisname] =
-                    model_->createView
-                    (
-                        p0,
-                        -up,
-                        false,
-                        dir,
-                        poly,
-                        skiphl
-                    );
-                views[thisname].insert_y = +( 0.55 * views[name].height +0.55 * views[thisname].height );
+                try
+                {
+                    ViewTask& t=tasks[i];
+                    t.result = t.model->createView(t.p0, t.dir, t.section, t.up, t.poly, t.skiphl);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> l(errorMtx);
+                    if (!error) error=std::current_exception();
+                }
             }
+        };
+
+        size_t nt=std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), tasks.size()));
+        std::vector<std::thread> threads;
+        for (size_t k=1; k<nt; k++)
+        {
+            threads.push_back(std::thread(worker));
+        }
+        worker();
+        for (std::thread& t: threads)
+        {
+            t.join();
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    Feature::Views views;
+    for (const ViewTask& t: tasks)
+    {
+        views[t.name]=t.result;
+    }
+
+    for (const Placement& pl: placements)
+    {
+        const std::string& name=pl.name;
+        if (pl.left_view)
+        {
+            std::string thisname = name+"_left";
+            views[thisname].insert_x = +( 0.55 * views[name].width +0.55 * views[thisname].width );
+        }
+        if (pl.back_view)
+        {
+            std::string thisname = name+"_back";
+            views[thisname].insert_x = +( 0.55 * views[name].width +1.1 * views[name+"_left"].width +0.55 * views[thisname].width );
+        }
+        if (pl.right_view)
+        {
+            std::string thisname = name+"_right";
+            views[thisname].insert_x = -( 0.55 * views[name].width +0.55 * views[thisname].width );
+        }
+        if (pl.top_view)
+        {
+            std::string thisname = name+"_top";
+            views[thisname].insert_y = -( 0.55 * views[name].height +0.55 * views[thisname].height );
+        }
+        if (pl.bottom_view)
+        {
+            std::string thisname = name+"_bottom";
+            views[thisname].insert_y = +( 0.55 * views[name].height +0.55 * views[thisname].height );
         }
     }
     shape_=views.begin()->second.visibleEdges;
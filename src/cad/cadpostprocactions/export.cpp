@@ -30,6 +30,7 @@ size_t Export::calcHash() const
   ParameterListHash h;
   if (model_) h+=*model_;
   h+=filename_;
+  if (STL_deflection_) h+=STL_deflection_->value();
 #warning extend hash!
   return h.getHash();
 }
@@ -38,17 +39,22 @@ Export::Export
 (
   FeaturePtr model, 
   const boost::filesystem::path& filename,
-  ExportNamedFeatures namedfeats
+  ExportNamedFeatures namedfeats,
+  ScalarPtr STL_deflection
 )
 : model_(model),
   filename_(filename),
-  namedfeats_(namedfeats)
+  namedfeats_(namedfeats),
+  STL_deflection_(STL_deflection)
 {}
 
 
 void Export::build()
 {
-   model_->saveAs(filename_, namedfeats_);
+  if (STL_deflection_)
+    model_->saveAs(filename_, namedfeats_, STL_deflection_->value());
+  else
+    model_->saveAs(filename_, namedfeats_);
 }
 
 Handle_AIS_InteractiveObject Export::createAISRepr() const
@@ -110,16 +116,29 @@ size_t ExportSTL::calcHash() const
   h+=filename_;
   if (STL_accuracy_) h+=STL_accuracy_->value();
   h+=force_binary_;
+  for (const auto& nf: namedfeats_)
+  {
+    h+=boost::fusion::get<0>(nf);
+    h+=*boost::fusion::get<1>(nf);
+  }
   return h.getHash();
 }
 
 
 
-ExportSTL::ExportSTL(FeaturePtr model, const boost::filesystem::path& filename, ScalarPtr STL_accuracy, bool force_binary)
+ExportSTL::ExportSTL
+(
+  FeaturePtr model,
+  const boost::filesystem::path& filename,
+  ScalarPtr STL_accuracy,
+  bool force_binary,
+  ExportNamedFeatures namedfeats
+)
 : model_(model),
   filename_(filename),
   STL_accuracy_(STL_accuracy),
-  force_binary_(force_binary)
+  force_binary_(force_binary),
+  namedfeats_(namedfeats)
 {
 }
 
@@ -144,7 +163,7 @@ void ExportSTL::build()
       if (ext==".stlb") binary=true;
     }
 
-  model_->exportSTL(filename_, abstol, binary);
+  model_->exportSTL(filename_, abstol, binary, namedfeats_);
 }
 
 Handle_AIS_InteractiveObject ExportSTL::createAISRepr() const
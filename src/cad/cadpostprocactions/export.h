@@ -39,12 +39,13 @@ class Export
   boost::filesystem::path filename_;
     
   ExportNamedFeatures namedfeats_;
+  ScalarPtr STL_deflection_;
   
   virtual size_t calcHash() const;
   virtual void build();
 
 public:
-  Export(FeaturePtr model, const boost::filesystem::path& filename, ExportNamedFeatures namedfeats = ExportNamedFeatures() );
+  Export(FeaturePtr model, const boost::filesystem::path& filename, ExportNamedFeatures namedfeats = ExportNamedFeatures(), ScalarPtr STL_deflection = ScalarPtr() );
   
   virtual Handle_AIS_InteractiveObject createAISRepr() const;
   virtual void write(std::ostream& ) const;
@@ -79,11 +80,23 @@ class ExportSTL
   ScalarPtr STL_accuracy_;
   bool force_binary_;
 
+  /**
+   * face sets, which are written as separate solids (ASCII only)
+   */
+  ExportNamedFeatures namedfeats_;
+
   virtual size_t calcHash() const;
   virtual void build();
 
 public:
-  ExportSTL(FeaturePtr model, const boost::filesystem::path& filename, ScalarPtr STL_accuracy, bool force_binary=false);
+  ExportSTL
+  (
+    FeaturePtr model,
+    const boost::filesystem::path& filename,
+    ScalarPtr STL_accuracy,
+    bool force_binary=false,
+    ExportNamedFeatures namedfeats = ExportNamedFeatures()
+  );
 
   virtual Handle_AIS_InteractiveObject createAISRepr() const;
   virtual void write(std::ostream& ) const;
@@ -564,5 +564,65 @@ void XsecAxisPlane::build()
 //   std::cout<<"XSEC="<<p_.X()<<" "<<p_.Y()<<" "<<p_.Z()<<std::endl;
 }
 
+
+
+
+size_t FixedDatumPoint::calcHash() const
+{
+  ParameterListHash plh;
+  plh+=p_;
+  return plh.getHash();
+}
+
+void FixedDatumPoint::build()
+{}
+
+FixedDatumPoint::FixedDatumPoint(const gp_Pnt& p)
+{
+  p_=p;
+  setValid();
+}
+
+
+
+
+size_t FixedDatumAxis::calcHash() const
+{
+  ParameterListHash plh;
+  plh+=ax_.Location();
+  plh+=vec3(ax_.Direction());
+  return plh.getHash();
+}
+
+void FixedDatumAxis::build()
+{}
+
+FixedDatumAxis::FixedDatumAxis(const gp_Ax1& ax)
+{
+  ax_=ax;
+  setValid();
+}
+
+
+
+
+size_t FixedDatumPlane::calcHash() const
+{
+  ParameterListHash plh;
+  plh+=cs_.Location();
+  plh+=vec3(cs_.Direction());
+  plh+=vec3(cs_.XDirection());
+  return plh.getHash();
+}
+
+void FixedDatumPlane::build()
+{}
+
+FixedDatumPlane::FixedDatumPlane(const gp_Ax3& cs)
+{
+  cs_=cs;
+  setValid();
+}
+
 }
 }
@@ -288,6 +288,48 @@ public:
 
 
 
+
+/**
+ * datums with fixed location, e.g. restored from the feature cache
+ */
+
+class FixedDatumPoint
+: public DatumPoint
+{
+  virtual size_t calcHash() const;
+  virtual void build();
+
+public:
+  FixedDatumPoint(const gp_Pnt& p);
+};
+
+
+
+
+class FixedDatumAxis
+: public DatumAxis
+{
+  virtual size_t calcHash() const;
+  virtual void build();
+
+public:
+  FixedDatumAxis(const gp_Ax1& ax);
+};
+
+
+
+
+class FixedDatumPlane
+: public DatumPlaneData
+{
+  virtual size_t calcHash() const;
+  virtual void build();
+
+public:
+  FixedDatumPlane(const gp_Ax3& cs);
+};
+
+
 }
 }
 
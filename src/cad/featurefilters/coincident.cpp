@@ -41,16 +41,24 @@ template<> coincident<Edge>::coincident(FeaturePtr m, scalarQuantityComputer::Pt
 template<>
 bool coincident<Edge>::checkMatch(FeatureID feature) const
 {
-  bool match=false;
-  
-  for (int f: f_.data())
+  const TopoDS_Edge& e1=model_->edge(feature);
+  double tol=tol_->evaluate(feature);
+
+  // only entities with overlapping bounding boxes can contain e1
+  Bnd_Box bb;
+  BRepBndLib::Add(e1, bb);
+  bb.Enlarge(tol);
+
+  for (FeatureID f: f_.model()->entityBoxTree(Edge).overlapping(bb))
   {
-    TopoDS_Edge e1=TopoDS::Edge(model_->edge(feature));
-    TopoDS_Edge e2=TopoDS::Edge(f_.model()->edge(f));
-    match |= isPartOf(e2, e1, tol_->evaluate(feature) );
+    if (f_.data().count(f))
+    {
+      const TopoDS_Edge& e2=f_.model()->edge(f);
+      if (isPartOf(e2, e1, tol)) return true;
+    }
   }
   
-  return match;
+  return false;
 }
 
 template<> coincident<Face>::coincident(FeaturePtr m, scalarQuantityComputerPtr tol)
@@ -62,16 +70,24 @@ template<> coincident<Face>::coincident(FeaturePtr m, scalarQuantityComputerPtr
 template<>
 bool coincident<Face>::checkMatch(FeatureID feature) const
 {
-  bool match=false;
-  
-  for (int f: f_.data())
+  const TopoDS_Face& e1=model_->face(feature);
+  double tol=tol_->evaluate(feature);
+
+  // only entities with overlapping bounding boxes can contain e1
+  Bnd_Box bb;
+  BRepBndLib::Add(e1, bb);
+  bb.Enlarge(tol);
+
+  for (FeatureID f: f_.model()->entityBoxTree(Face).overlapping(bb))
   {
-    TopoDS_Face e1=TopoDS::Face(model_->face(feature));
-    TopoDS_Face e2=TopoDS::Face(f_.model()->face(f));
-    match |= isPartOf(e2, e1, tol_->evaluate(feature) );
+    if (f_.data().count(f))
+    {
+      const TopoDS_Face& e2=f_.model()->face(f);
+      if (isPartOf(e2, e1, tol)) return true;
+    }
   }
   
-  return match;
+  return false;
 }
 
 }
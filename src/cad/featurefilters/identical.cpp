@@ -40,16 +40,23 @@ template<> identical<Edge>::identical(FeaturePtr m)
 template<>
 bool identical<Edge>::checkMatch(FeatureID feature) const
 {
-  bool match=false;
-  
-  for (int f: f_.data())
+  const TopoDS_Edge& e1=model_->edge(feature);
+
+  // identical entities have identical bounding boxes
+  Bnd_Box bb;
+  BRepBndLib::Add(e1, bb);
+  bb.Enlarge(1e-3);
+
+  for (FeatureID f: f_.model()->entityBoxTree(Edge).overlapping(bb))
   {
-    TopoDS_Edge e1=TopoDS::Edge(model_->edge(feature));
-    TopoDS_Edge e2=TopoDS::Edge(f_.model()->edge(f));
-    match |= isEqual(e2, e1);
+    if (f_.data().count(f))
+    {
+      const TopoDS_Edge& e2=f_.model()->edge(f);
+      if (isEqual(e2, e1)) return true;
+    }
   }
   
-  return match;
+  return false;
 }
 
 template<> identical<Face>::identical(FeaturePtr m)
@@ -60,16 +67,23 @@ template<> identical<Face>::identical(FeaturePtr m)
 template<>
 bool identical<Face>::checkMatch(FeatureID feature) const
 {
-  bool match=false;
-  
-  for (int f: f_.data())
+  const TopoDS_Face& e1=model_->face(feature);
+
+  // identical entities have identical bounding boxes
+  Bnd_Box bb;
+  BRepBndLib::Add(e1, bb);
+  bb.Enlarge(1e-3);
+
+  for (FeatureID f: f_.model()->entityBoxTree(Face).overlapping(bb))
   {
-    TopoDS_Face e1=TopoDS::Face(model_->face(feature));
-    TopoDS_Face e2=TopoDS::Face(f_.model()->face(f));
-    match |= isEqual(e2, e1);
+    if (f_.data().count(f))
+    {
+      const TopoDS_Face& e2=f_.model()->face(f);
+      if (isEqual(e2, e1)) return true;
+    }
   }
   
-  return match;
+  return false;
 }
 
 }
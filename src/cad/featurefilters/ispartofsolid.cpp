@@ -35,36 +35,27 @@ namespace cad
 template<> isPartOfSolid<Edge>::isPartOfSolid(FeaturePtr m)
 : s_(TopoDS::Solid(*m))
 {
+  BRepBndLib::Add(s_, sbb_);
 }
 
 template<>
 bool isPartOfSolid<Edge>::checkMatch(FeatureID feature) const
 {
-  bool match=false;
-  
-  TopoDS_Edge e1=TopoDS::Edge(model_->edge(feature));
-  match |= isPartOf(s_, e1);
-  
-  return match;
+  const TopoDS_Edge& e1=model_->edge(feature);
+  return isPartOf(s_, sbb_, e1);
 }
 
 template<> isPartOfSolid<Face>::isPartOfSolid(FeaturePtr m)
 : s_(TopoDS::Solid(*m))
 {
+  BRepBndLib::Add(s_, sbb_);
 }
 
 template<>
 bool isPartOfSolid<Face>::checkMatch(FeatureID feature) const
 {
-  bool match=false;
-  
-//   for (int f: f_)
-  {
-    TopoDS_Face e1=TopoDS::Face(model_->face(feature));
-    match |= isPartOf(s_, e1);
-  }
-  
-  return match;
+  const TopoDS_Face& e1=model_->face(feature);
+  return isPartOf(s_, sbb_, e1);
 }
 
 
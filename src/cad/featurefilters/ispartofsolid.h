@@ -34,10 +34,16 @@ class isPartOfSolid
 protected:
     TopoDS_Solid s_;
 
+    /**
+     * bounding box of the solid, computed once for all entity tests
+     */
+    Bnd_Box sbb_;
+
 public:
     isPartOfSolid(const TopoDS_Solid& s)
     : s_(s)
     {
+        BRepBndLib::Add(s_, sbb_);
     }
 
     isPartOfSolid(FeaturePtr m)
@@ -48,7 +54,9 @@ public:
 
     isPartOfSolid(FeatureSet f)
         : s_(TopoDS::Solid(static_cast<TopoDS_Shape>(*f.model())))
-    {}
+    {
+        BRepBndLib::Add(s_, sbb_);
+    }
 
     bool checkMatch(FeatureID feature) const
     {
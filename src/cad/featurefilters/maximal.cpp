@@ -19,6 +19,8 @@
 
 #include "maximal.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace boost;
 
@@ -43,9 +45,14 @@ void maximal::firstPass(FeatureID feature)
 {
   if (qtc_->isValidForFeature(feature))
     {
-      ranking_.push_back(RankEntry(-qtc_->evaluate(feature), feature));
-      std::sort( ranking_.begin(), ranking_.end(), [](const RankEntry& e1,const RankEntry& e2) -> bool
-       { return e1.first < e2.first; }
+      // keep the ranking sorted by inserting at the right place
+      RankEntry re(-qtc_->evaluate(feature), feature);
+      ranking_.insert
+      (
+        std::upper_bound( ranking_.begin(), ranking_.end(), re, [](const RankEntry& e1,const RankEntry& e2) -> bool
+         { return e1.first < e2.first; }
+        ),
+        re
       );
     }
 }
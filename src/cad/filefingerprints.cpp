@@ -0,0 +1,133 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "filefingerprints.h"
+#include "base/exception.h"
+#include "boost/functional/hash.hpp"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include <sys/stat.h>
+
+namespace insight {
+namespace cad {
+
+
+FileFingerprints fileFingerprints;
+
+
+
+
+size_t FileFingerprints::contentHash(const boost::filesystem::path& file, uintmax_t size)
+{
+  std::ifstream f(file.c_str(), std::ios::binary);
+  if (!f.good())
+  {
+    throw insight::Exception("Could not open file "+file.string()+" for reading!");
+  }
+
+  size_t h=0;
+  boost::hash_combine(h, size);
+
+  // stream through the file, combine in words of 8 bytes
+  const size_t bufSize=1<<20;
+  std::vector<char> buf(bufSize);
+  while (f)
+  {
+    f.read(&buf[0], bufSize);
+    size_t n=f.gcount(), i=0;
+    for (; i+8<=n; i+=8)
+    {
+      uint64_t w;
+      memcpy(&w, &buf[i], 8);
+      boost::hash_combine(h, w);
+    }
+    for (; i<n; i++)
+    {
+      boost::hash_combine(h, buf[i]);
+    }
+  }
+
+  if (!f.eof())
+  {
+    throw insight::Exception("Error while reading file "+file.string()+"!");
+  }
+  return h;
+}
+
+
+
+
+FileFingerprints::FileFingerprints()
+{}
+
+
+
+
+size_t FileFingerprints::operator()(const boost::filesystem::path& file)
+{
+  boost::filesystem::path p=boost::filesystem::absolute(file);
+
+  struct stat st;
+  if ( (stat(p.c_str(), &st)!=0) || !S_ISREG(st.st_mode) )
+  {
+    return 0;
+  }
+  uintmax_t size=st.st_size;
+
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto i=entries_.find(p);
+    if ( (i!=entries_.end())
+         && (i->second.size==size)
+         && (i->second.mtime==st.st_mtim.tv_sec)
+         && (i->second.mtime_nsec==st.st_mtim.tv_nsec) )
+    {
+      return i->second.fingerprint;
+    }
+  }
+
+  // hash outside of the lock, different files may be hashed concurrently
+  Entry e;
+  e.size=size;
+  e.mtime=st.st_mtim.tv_sec;
+  e.mtime_nsec=st.st_mtim.tv_nsec;
+  e.fingerprint=contentHash(p, size);
+
+  std::lock_guard<std::mutex> l(mtx_);
+  entries_[p]=e;
+  return e.fingerprint;
+}
+
+
+
+
+void FileFingerprints::clear()
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  entries_.clear();
+}
+
+
+}
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef INSIGHT_CAD_FILEFINGERPRINTS_H
+#define INSIGHT_CAD_FILEFINGERPRINTS_H
+
+#include <map>
+#include <mutex>
+#include <ctime>
+
+#include "base/boost_include.h"
+
+namespace insight {
+namespace cad {
+
+
+/**
+ * Identifies the contents of files, which are read by features.
+ * Enters the feature hashes, so that cache entries remain valid,
+ * as long as the file contents do not change.
+ *
+ * The content hash of a file is computed once per process. It is reused,
+ * as long as size and modification time of the file are unchanged.
+ */
+class FileFingerprints
+{
+  struct Entry
+  {
+    uintmax_t size;
+    std::time_t mtime;
+    long mtime_nsec;
+    size_t fingerprint;
+  };
+
+  std::mutex mtx_;
+  std::map<boost::filesystem::path, Entry> entries_;
+
+  static size_t contentHash(const boost::filesystem::path& file, uintmax_t size);
+
+public:
+  FileFingerprints();
+
+  /**
+   * fingerprint of the file contents.
+   * Returns 0, if the file does not exist.
+   */
+  size_t operator()(const boost::filesystem::path& file);
+
+  void clear();
+};
+
+
+extern FileFingerprints fileFingerprints;
+
+
+}
+}
+
+#endif // INSIGHT_CAD_FILEFINGERPRINTS_H
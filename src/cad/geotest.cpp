@@ -19,6 +19,7 @@
  */
 
 #include "geotest.h"
+#include "stlwriter.h"
 #include "base/exception.h"
 
 #include <algorithm>
@@ -394,6 +395,8 @@ bool isPartOf(const TopoDS_Face& big, const TopoDS_Face& small, double tolerance
             box = getBoundingBox(small);
             tri = BRep_Tool::Triangulation (small, L);
             if (tri.IsNull()){
+              // the face belongs to a feature, which may be meshed concurrently
+              std::lock_guard<std::mutex> lock(meshingMutex());
               BRepTools::Clean(small);
               BRep_Builder b;
               b.UpdateFace(small, tolerance);
@@ -423,8 +426,9 @@ bool isPartOf(const TopoDS_Face& big, const TopoDS_Face& small, double tolerance
             ShapeFix_Face fix(small);
             fix.Perform();
             TopoDS_Face f = TopoDS::Face(fix.Result());
-            BRepTools::Clean(f);
             TopLoc_Location L;
+            std::lock_guard<std::mutex> lock(meshingMutex());
+            BRepTools::Clean(f);
             //BRepMesh::Mesh(f, 0.3);
             BRepMesh_IncrementalMesh(f, 0.3);
             tri = BRep_Tool::Triangulation(f, L);
@@ -484,7 +488,12 @@ bool isPartOf(const TopoDS_Shell& big, const TopoDS_Face& small, double toleranc
 //SolidTest
 bool isPartOf(const TopoDS_Solid& big, const TopoDS_Shape& small, double tolerance, int nSamples)
 {
-    bool ok = isPartOf(getBoundingBox(big), getBoundingBox(small));
+    return isPartOf(big, getBoundingBox(big), small, tolerance, nSamples);
+}
+
+bool isPartOf(const TopoDS_Solid& big, const Bnd_Box& bigBox, const TopoDS_Shape& small, double tolerance, int nSamples)
+{
+    bool ok = isPartOf(bigBox, getBoundingBox(small));
     bool found = false;
 
     if (ok){
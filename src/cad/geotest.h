@@ -75,6 +75,10 @@ bool isPartOf(const TopoDS_Face& big, const TopoDS_Face& small, double tolerance
 bool isPartOf(const TopoDS_Shell& big, const TopoDS_Face& small, double tolerance=0.001, int nSamples=10);
 //SolidTest
 bool isPartOf(const TopoDS_Solid& big, const TopoDS_Shape& small, double tolerance=.0001, int nSamples=10);
+/**
+ * same as above, with the bounding box of big precomputed for repeated tests
+ */
+bool isPartOf(const TopoDS_Solid& big, const Bnd_Box& bigBox, const TopoDS_Shape& small, double tolerance=.0001, int nSamples=10);
 //Allgemein
 bool isPartOf(const TopoDS_Shape& big, const TopoDS_Shape& small, double tolerance=0.001, int nSamples=10);
 
@@ -22,11 +22,13 @@
 #include "cadfeature.h"
 #include "cadmodel.h"
 #include "datum.h"
+#include "rebuildscheduler.h"
 
 #include <thread>
 
 BGParsingThread::BGParsingThread()
-: action_(Parse)
+: action_(Parse),
+  resetParser_(false)
 {
 }
 
@@ -80,10 +82,13 @@ void BGParsingThread::run()
 {
     thread_id_=std::this_thread::get_id();
 
-    std::istringstream is(script_);
-
     int failloc=-1;
 
+    if (resetParser_.exchange(false))
+    {
+      parser_.clear();
+    }
+
 
     insight::cad::ModelPtr oldmodel = last_rebuilt_model_;
     model_.reset(new insight::cad::Model);
@@ -95,7 +100,7 @@ void BGParsingThread::run()
 
       try
       {
-          r=insight::cad::parseISCADModelStream(is, model_.get(), &failloc, &syn_elem_dir_);
+          r=parser_.parse(script_, model_.get(), &failloc, &syn_elem_dir_);
       }
       catch (insight::cad::parser::iscadParserException e)
       {
@@ -111,7 +116,8 @@ void BGParsingThread::run()
       else
       {
 
-          emit statusMessage("Model parsed successfully.");
+          emit statusMessage(QString("Model parsed successfully (%1 statements parsed, %2 unchanged).")
+                             .arg(parser_.nParsed()).arg(parser_.nReused()));
 
           if (action_ >= Rebuild)
           {
@@ -169,6 +175,15 @@ void BGParsingThread::run()
                   }
               }
 
+              {
+                  // build independent features concurrently
+                  emit statusMessage("Building features...");
+                  insight::cad::RebuildScheduler scheduler;
+                  scheduler.addModel(model_);
+                  scheduler.run();
+                  scheduler.printTimingReport();
+              }
+
               {
                   MapDirectory<insight::cad::Model::ModelstepTableContents> removedFeatures;
                   if (oldmodel) removedFeatures.set(oldmodel->modelsteps());
@@ -272,3 +287,9 @@ void BGParsingThread::cancelRebuild()
 {
   insight::cad::Feature::cancelRebuild(thread_id_);
 }
+
+
+void BGParsingThread::resetIncrementalParser()
+{
+  resetParser_=true;
+}
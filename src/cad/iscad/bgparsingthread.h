@@ -24,6 +24,8 @@
 #include <QString>
 #include <QMetaType>
 
+#include <atomic>
+
 #ifndef Q_MOC_RUN
 #include "cadmodel.h"
 #include "cadtypes.h"
@@ -51,6 +53,12 @@ protected:
     Action action_;
     std::thread::id thread_id_;
 
+    /**
+     * keeps the results of unchanged statements between runs
+     */
+    insight::cad::IncrementalModelParser parser_;
+    std::atomic<bool> resetParser_;
+
 public:
     insight::cad::ModelPtr last_rebuilt_model_, model_;
     insight::cad::parser::SyntaxElementDirectoryPtr syn_elem_dir_;
@@ -69,6 +77,11 @@ public:
     inline Action action() const { return action_; }
     void cancelRebuild();
 
+    /**
+     * reparse all statements during the next run
+     */
+    void resetIncrementalParser();
+
 signals:
 
     void createdVariable    (const QString& sn, insight::cad::ScalarPtr sv);
@@ -54,7 +54,9 @@ ISCADModel::ISCADModel(QWidget* parent, bool dobgparsing)
   unsaved_(false),
   doBgParsing_(dobgparsing),
   bgparsethread_(),
-  skipPostprocActions_(true)
+  skipPostprocActions_(true),
+  rebuildPending_(false),
+  rebuildPendingUpToCursor_(false)
 {
     setFontFamily("Courier New");
     setContextMenuPolicy(Qt::CustomContextMenu);
@@ -275,6 +277,13 @@ void ISCADModel::onBgParseFinished()
         emit modelUpdated();
     }
     emit statusProgress(1, 1);
+
+    if (rebuildPending_)
+    {
+        rebuildPending_=false;
+        bgparsethread_.wait(); // finished() is emitted before the thread has stopped
+        rebuildModel(rebuildPendingUpToCursor_);
+    }
 }
 
 
@@ -471,7 +480,9 @@ void ISCADModel::rebuildModel(bool upToCursor)
     }
     else
     {
-        emit displayStatusMessage("Background model parsing in progress, rebuild is currently disabled!...");
+        rebuildPending_=true;
+        rebuildPendingUpToCursor_=upToCursor;
+        emit displayStatusMessage("Background model parsing in progress, rebuild will start afterwards...");
     }
 }
 
@@ -484,6 +495,7 @@ void ISCADModel::rebuildModelUpToCursor()
 void ISCADModel::clearCache()
 {
     insight::cad::cache.clear();
+    bgparsethread_.resetIncrementalParser();
 }
 
 
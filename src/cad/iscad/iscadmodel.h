@@ -79,6 +79,12 @@ protected:
     
     bool skipPostprocActions_;
 
+    /**
+     * rebuild requested while the background parser was running.
+     * Will be started, when the parser has finished.
+     */
+    bool rebuildPending_, rebuildPendingUpToCursor_;
+
     QSize sizehint_;
 
     
@@ -34,6 +34,7 @@
 #include "boost/locale.hpp"
 #include "base/boost_include.h"
 #include "boost/make_shared.hpp"
+#include "boost/functional/hash.hpp"
 #include <boost/fusion/adapted.hpp>
 #include <boost/phoenix/fusion.hpp>
 
@@ -440,5 +441,355 @@ bool parseISCADModelStream ( std::istream& in, Model* m, int* failloc, parser::S
 
 
 
+namespace
+{
+
+template<class Table>
+void hashBinding(size_t& h, const Table& t, const std::string& name, const std::set<const void*>& initial)
+{
+  const void* p=NULL;
+  if (auto* v=t.find(name)) p=v->get();
+  // predefined symbols are recreated with every model, but are constant
+  if (initial.count(p)) boost::hash_combine(h, std::string("(predefined)"));
+  else boost::hash_combine(h, p);
+}
+
+template<class T>
+T lookupSymbol(const qi::symbols<char, T>& t, const std::string& name)
+{
+  const T* v=t.find(name);
+  return v ? *v : T();
+}
+
+template<class Table>
+void collectBindings(std::set<const void*>& ptrs, const Table& t)
+{
+  for (const auto& e: t) ptrs.insert(e.second.get());
+}
+
+IncrementalModelParser::SymbolBinding currentBinding(const Model* m, const std::string& name)
+{
+  IncrementalModelParser::SymbolBinding b;
+  b.scalar=lookupSymbol(m->scalarSymbols(), name);
+  b.vector=lookupSymbol(m->vectorSymbols(), name);
+  b.datum=lookupSymbol(m->datumSymbols(), name);
+  b.modelstep=lookupSymbol(m->modelstepSymbols(), name);
+  b.component=m->components().count(name)>0;
+  b.vertexFeature=lookupSymbol(m->vertexFeatureSymbols(), name);
+  b.edgeFeature=lookupSymbol(m->edgeFeatureSymbols(), name);
+  b.faceFeature=lookupSymbol(m->faceFeatureSymbols(), name);
+  b.solidFeature=lookupSymbol(m->solidFeatureSymbols(), name);
+  b.model=lookupSymbol(m->modelSymbols(), name);
+  return b;
+}
+
+bool sameBinding(const IncrementalModelParser::SymbolBinding& a, const IncrementalModelParser::SymbolBinding& b)
+{
+  return (a.scalar==b.scalar) && (a.vector==b.vector) && (a.datum==b.datum)
+      && (a.modelstep==b.modelstep) && (a.component==b.component)
+      && (a.vertexFeature==b.vertexFeature) && (a.edgeFeature==b.edgeFeature)
+      && (a.faceFeature==b.faceFeature) && (a.solidFeature==b.solidFeature)
+      && (a.model==b.model);
+}
+
+void rebind(Model* m, const std::string& name, const IncrementalModelParser::SymbolBinding& b)
+{
+  if (b.scalar) m->addScalar(name, b.scalar);
+  if (b.vector) m->addVector(name, b.vector);
+  if (b.datum) m->addDatum(name, b.datum);
+  if (b.modelstep)
+  {
+    if (b.component) m->addComponent(name, b.modelstep);
+    else m->addModelstep(name, b.modelstep);
+  }
+  if (b.vertexFeature) m->addVertexFeature(name, b.vertexFeature);
+  if (b.edgeFeature) m->addEdgeFeature(name, b.edgeFeature);
+  if (b.faceFeature) m->addFaceFeature(name, b.faceFeature);
+  if (b.solidFeature) m->addSolidFeature(name, b.solidFeature);
+  if (b.model) m->addModel(name, b.model);
+}
+
+}
+
+
+
+
+IncrementalModelParser::IncrementalModelParser()
+: nReused_(0),
+  nParsed_(0)
+{}
+
+
+
+
+size_t IncrementalModelParser::splitStatements(const std::string& s, std::vector<Statement>& statements)
+{
+  statements.clear();
+
+  size_t n=s.size(), i=0, sb=0;
+  int depth=0;
+
+  Statement st;
+  auto resetStatement = [&]()
+  {
+    st.symbol.clear();
+    st.identifiers.clear();
+    st.reusable=true;
+    st.propertyAssignment=false;
+  };
+  resetStatement();
+
+  while (i<n)
+  {
+    char c=s[i];
+
+    if ( (c=='/') && (i+1<n) && (s[i+1]=='*') )
+    {
+      size_t e=s.find("*/", i+2);
+      i = (e==std::string::npos) ? n : e+2;
+    }
+    else if ( (c=='#') || ( (c=='/') && (i+1<n) && (s[i+1]=='/') ) )
+    {
+      size_t e=s.find('\n', i);
+      i = (e==std::string::npos) ? n : e+1;
+    }
+    else if ( (c=='\"') || (c=='\'') )
+    {
+      // file paths: the file contents might have changed
+      if (c=='\"') st.reusable=false;
+      size_t e=s.find(c, i+1);
+      i = (e==std::string::npos) ? n : e+1;
+    }
+    else if (isalpha(static_cast<unsigned char>(c)))
+    {
+      size_t b=i;
+      while ( (i<n) && (isalnum(static_cast<unsigned char>(s[i])) || (s[i]=='_')) ) i++;
+      std::string id=s.substr(b, i-b);
+      if (st.identifiers.empty() && (depth==0))
+      {
+        st.symbol=id;
+        size_t j=s.find_first_not_of(" \t\r\n", i);
+        if ( (j!=std::string::npos) && (s.compare(j, 2, "->")==0) )
+        {
+          st.propertyAssignment=true;
+          st.reusable=false;
+        }
+      }
+      st.identifiers.insert(id);
+    }
+    else if (isdigit(static_cast<unsigned char>(c)))
+    {
+      while ( (i<n) && (isalnum(static_cast<unsigned char>(s[i])) || (s[i]=='_') || (s[i]=='.')) ) i++;
+    }
+    else if ( (c=='@') && (depth==0) )
+    {
+      // @doc and @post sections are not split
+      return sb;
+    }
+    else
+    {
+      if ( (c=='(') || (c=='[') || (c=='{') ) depth++;
+      else if ( (c==')') || (c==']') || (c=='}') ) depth--;
+      else if ( (c==';') && (depth==0) )
+      {
+        st.begin=sb;
+        st.end=i+1;
+        st.hash=boost::hash_range(s.begin()+st.begin, s.begin()+st.end);
+        if (st.symbol.empty()) st.reusable=false;
+        statements.push_back(st);
+        resetStatement();
+        sb=i+1;
+      }
+      i++;
+    }
+  }
+
+  return sb;
+}
+
+
+
+
+bool IncrementalModelParser::parse
+(
+    const std::string& script,
+    Model* m,
+    int* failloc,
+    parser::SyntaxElementDirectoryPtr* sd,
+    const boost::filesystem::path& filenameinfo
+)
+{
+  using namespace parser;
+
+  std::string contents(script);
+  std::vector<Statement> statements;
+  size_t tail=splitStatements(contents, statements);
+
+  std::set<const void*> initial;
+  collectBindings(initial, m->scalars());
+  collectBindings(initial, m->vectors());
+  collectBindings(initial, m->datums());
+  collectBindings(initial, m->modelsteps());
+  initial.erase(NULL);
+
+  auto contextHash = [&](const Statement& st)
+  {
+    size_t h=0;
+    for (const std::string& id: st.identifiers)
+    {
+      boost::hash_combine(h, id);
+      hashBinding(h, m->scalarSymbols(), id, initial);
+      hashBinding(h, m->vectorSymbols(), id, initial);
+      hashBinding(h, m->datumSymbols(), id, initial);
+      hashBinding(h, m->modelstepSymbols(), id, initial);
+      hashBinding(h, m->vertexFeatureSymbols(), id, initial);
+      hashBinding(h, m->edgeFeatureSymbols(), id, initial);
+      hashBinding(h, m->faceFeatureSymbols(), id, initial);
+      hashBinding(h, m->solidFeatureSymbols(), id, initial);
+      hashBinding(h, m->modelSymbols(), id, initial);
+    }
+    return h;
+  };
+
+  std::string::iterator orgbegin=contents.begin();
+  ISCADParser parser(m, filenameinfo);
+  skip_grammar skip;
+  parser.current_pos.setStartPos(orgbegin);
+  SyntaxElementDirectory& sed=*parser.syntax_element_locations;
+
+  Records records;
+  std::set<const Feature*> modified;
+  nReused_=nParsed_=0;
+
+  auto parseRange = [&](size_t b, size_t e)
+  {
+    std::string::iterator first=orgbegin+b, last=orgbegin+e;
+    try
+    {
+      bool r=qi::phrase_parse(first, last, parser, skip);
+      if ( !r || (first!=last) )
+      {
+        if (failloc) *failloc=int(first-orgbegin);
+        return false;
+      }
+    }
+    catch ( qi::expectation_failure<std::string::iterator> e )
+    {
+      std::ostringstream os;
+      os << e.what_;
+      throw iscadParserException(os.str(), int(e.first-orgbegin), int(e.last-orgbegin));
+    }
+    return true;
+  };
+
+  for (const Statement& st: statements)
+  {
+    std::pair<size_t,size_t> key(st.hash, 0);
+    std::string text=contents.substr(st.begin, st.end-st.begin);
+    if (st.reusable)
+    {
+      key.second=contextHash(st);
+      auto i=records_.find(key);
+      if ( (i!=records_.end()) && (i->second.text==text) && !records.count(key) )
+      {
+        // unchanged: re-insert the previous results
+        const Record& rec=i->second;
+        for (const auto& b: rec.bindings)
+        {
+          rebind(m, b.first, b.second);
+        }
+        for (const auto& se: rec.syntaxElements)
+        {
+          sed.addEntry
+          (
+            SyntaxElementLocation(filenameinfo, SyntaxElementPos(st.begin+se.first.first, st.begin+se.first.second)),
+            se.second
+          );
+        }
+        records[key]=rec;
+        nReused_++;
+        continue;
+      }
+    }
+
+    // remember the bindings of all identifiers, to find out afterwards,
+    // which of them were defined by this statement
+    std::map<std::string, SymbolBinding> before;
+    if (st.reusable)
+    {
+      for (const std::string& id: st.identifiers)
+      {
+        before[id]=currentBinding(m, id);
+      }
+    }
+
+    if (!parseRange(st.begin, st.end)) return false;
+    nParsed_++;
+
+    if (st.propertyAssignment)
+    {
+      if (auto* f=m->modelstepSymbols().find(st.symbol)) modified.insert(f->get());
+    }
+    else if (st.reusable && !records.count(key))
+    {
+      Record rec;
+      rec.text=text;
+      for (const auto& b: before)
+      {
+        SymbolBinding now=currentBinding(m, b.first);
+        if (!sameBinding(now, b.second))
+        {
+          rec.bindings[b.first]=now;
+        }
+      }
+
+      for (auto i=sed.lower_bound(SyntaxElementLocation(filenameinfo, SyntaxElementPos(st.begin, 0)));
+           (i!=sed.end()) && (i->first.first==filenameinfo) && (i->first.second.first<long(st.end));
+           ++i)
+      {
+        rec.syntaxElements.push_back
+        (
+          std::make_pair
+          (
+            SyntaxElementPos(i->first.second.first-st.begin, i->first.second.second-st.begin),
+            i->second
+          )
+        );
+      }
+
+      records[key]=rec;
+    }
+  }
+
+  if (!parseRange(tail, contents.size())) return false;
+
+  // features, which were modified by property assignments, have to be recreated
+  for (auto i=records.begin(); i!=records.end(); )
+  {
+    bool isModified=false;
+    for (const auto& b: i->second.bindings)
+    {
+      if (modified.count(b.second.modelstep.get())) isModified=true;
+    }
+    if (isModified)
+      i=records.erase(i);
+    else
+      ++i;
+  }
+  records_.swap(records);
+
+  if (sd) *sd=parser.syntax_element_locations;
+  return true;
+}
+
+
+
+
+void IncrementalModelParser::clear()
+{
+  records_.clear();
+}
+
+
 }
 }
@@ -26,6 +26,9 @@
 #include "base/linearalgebra.h"
 #include "drawingexport.h"
 
+#include <set>
+#include <map>
+
 #ifndef Q_MOC_RUN
 #include "boost/spirit/include/qi.hpp"
 #include "boost/variant/recursive_variant.hpp"
@@ -214,6 +217,97 @@ bool parseISCADModelFile
 );
 
 
+
+
+/**
+ * Parser for scripts, which are edited interactively and reparsed repeatedly.
+ *
+ * The script is split into its top-level statements. A statement is only
+ * reparsed, if its text or the objects bound to the symbols it references
+ * have changed since the previous parse. Otherwise, the symbols created
+ * by the statement during the previous parse are re-inserted into the model,
+ * so that unchanged features keep their built shapes. Changes thus only
+ * invalidate the statements downstream of a modified symbol.
+ *
+ * Statements, which contain file paths, and the @doc and @post sections
+ * are always reparsed. Features, which are modified by property assignments,
+ * are not reused.
+ */
+class IncrementalModelParser
+{
+public:
+    struct Statement
+    {
+        size_t begin, end;
+        size_t hash;
+        std::string symbol;
+        std::set<std::string> identifiers;
+        bool reusable;
+        bool propertyAssignment;
+    };
+
+    struct SymbolBinding
+    {
+        ScalarPtr scalar;
+        VectorPtr vector;
+        DatumPtr datum;
+        FeaturePtr modelstep;
+        bool component;
+        FeatureSetPtr vertexFeature, edgeFeature, faceFeature, solidFeature;
+        ModelPtr model;
+    };
+
+protected:
+    struct Record
+    {
+        /**
+         * statement text, compared on reuse to rule out hash collisions
+         */
+        std::string text;
+        /**
+         * all symbols, which were (re-)defined by the statement
+         */
+        std::map<std::string, SymbolBinding> bindings;
+        std::vector<std::pair<parser::SyntaxElementPos, FeaturePtr> > syntaxElements;
+    };
+
+    /**
+     * key: statement text hash and hash of the referenced symbol bindings
+     */
+    typedef std::map<std::pair<size_t, size_t>, Record> Records;
+    Records records_;
+
+    int nReused_, nParsed_;
+
+public:
+    IncrementalModelParser();
+
+    /**
+     * split script into top-level statements.
+     * Returns the begin of the unsplit remainder (@doc and @post sections
+     * and incomplete statements)
+     */
+    static size_t splitStatements(const std::string& script, std::vector<Statement>& statements);
+
+    bool parse
+    (
+        const std::string& script,
+        Model* m,
+        int* failloc=NULL,
+        parser::SyntaxElementDirectoryPtr* sd=NULL,
+        const boost::filesystem::path& filenameinfo=""
+    );
+
+    /**
+     * forget all previous parse results
+     */
+    void clear();
+
+    inline int nReused() const { return nReused_; }
+    inline int nParsed() const { return nParsed_; }
+};
+
+
 }
 }
 
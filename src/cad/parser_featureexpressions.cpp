@@ -64,7 +64,7 @@ void ISCADParser::createFeatureExpressions()
     r_solidmodel_expression =
         r_solidmodel_term [_val=qi::_1 ]
         >>
-        *( '-' >> r_solidmodel_term [ _val = phx::bind(&BooleanSubtract::create, qi::_val, qi::_1) ] )
+        *( '-' >> r_solidmodel_term [ _val = phx::bind(&NaryBoolean::cut, qi::_val, qi::_1) ] )
         ;
     r_solidmodel_expression.name("feature expression");
 
@@ -79,10 +79,10 @@ void ISCADParser::createFeatureExpressions()
         -( lit("*") >> r_scalarExpression [ _val = phx::bind(&Transform::create_scale, qi::_val, qi::_1) ] )
         >>
         *(
-            ('|' >> r_solidmodel_primary [ _val = phx::bind(&BooleanUnion::create, qi::_val, qi::_1) ] )
+            ('|' >> r_solidmodel_primary [ _val = phx::bind(&NaryBoolean::fuse, qi::_val, qi::_1) ] )
             |
             ('&' >> (
-                 r_solidmodel_primary [ _val = phx::bind(&BooleanIntersection::create, qi::_val, qi::_1) ]
+                 r_solidmodel_primary [ _val = phx::bind(&NaryBoolean::common, qi::_val, qi::_1) ]
                  |
                  r_datumExpression [ _val = phx::bind(&BooleanIntersection::create_plane, qi::_val, qi::_1) ]
              )
@@ -121,23 +121,35 @@ void ISCADParser::createPostProcExpressions()
         *
         * Syntax:
         *
-        * <b>saveAs(\ref iscad_filename_expression "<filename>") << \ref iscad_feature_expression "<feature:feature to save>" </b>
+        * <b>saveAs(\ref iscad_filename_expression "<filename>" [, <scalar:STL deflection>]) << \ref iscad_feature_expression "<feature:feature to save>" </b>
         *
         */
-        ( lit("saveAs") >> '(' >> r_path >> ')' >> lit("<<")
+        ( lit("saveAs") >> '(' >> r_path
+          >> ( (',' >> r_scalarExpression)|qi::attr(ScalarPtr()) )
+          >> ')' >> lit("<<")
           >> r_solidmodel_expression
           >> *( r_identifier >> '=' >> r_faceFeaturesExpression )
           >> ';' )
         [ phx::bind(&Model::addPostprocActionUnnamed, model_,
-                    phx::construct<PostprocActionPtr>(new_<Export>(qi::_2, qi::_1, qi::_3))) ]
+                    phx::construct<PostprocActionPtr>(new_<Export>(qi::_3, qi::_1, qi::_4, qi::_2))) ]
         |
+        /** \page iscad_postprocessing_exportstl exportSTL: Tessellate model geometry and save as STL
+        *
+        * Syntax:
+        *
+        * <b>exportSTL(\ref iscad_filename_expression "<filename>" [, <scalar:deflection>] [, ascii]) << \ref iscad_feature_expression "<feature:feature to save>" [\ref iscad_identifier_expression "<identifier:patch name>" = \ref iscad_facefeat_expression "<face features:patch faces>" ...] </b>
+        *
+        * If face sets are given, an ASCII file with one solid per face set is written.
+        */
         ( (lit("exportSTL")|lit("STL")) >> '('
                             >> r_path
                             >> ( (',' >> r_scalarExpression)|qi::attr(ScalarPtr()) )
                             >> ( (',' >> lit("ascii") >> qi::attr(false) )|qi::attr(true) )
-                          >> ')' >> lit("<<") >> r_solidmodel_expression >> ';' )
+                          >> ')' >> lit("<<") >> r_solidmodel_expression
+                          >> *( r_identifier >> '=' >> r_faceFeaturesExpression )
+                          >> ';' )
         [ phx::bind(&Model::addPostprocActionUnnamed, model_,
-                    phx::construct<PostprocActionPtr>(new_<ExportSTL>(qi::_4, qi::_1, qi::_2, qi::_3))) ]
+                    phx::construct<PostprocActionPtr>(new_<ExportSTL>(qi::_4, qi::_1, qi::_2, qi::_3, qi::_5))) ]
         |
         ( lit("exportEMesh") >> '(' >> r_path >> ',' >> r_scalarExpression >> ',' >> r_scalarExpression >> ')'
           >> lit("<<") >> r_edgeFeaturesExpression >> ';' )
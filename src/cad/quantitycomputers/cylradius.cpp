@@ -36,18 +36,13 @@ cylRadius::~cylRadius()
 
 bool cylRadius::isValidForFeature(FeatureID f) const
 {
-  return model_->faceType(f) == GeomAbs_Cylinder;
+  return model_->entityProperties(Face).radius(f) >= 0.;
 }
   
 double cylRadius::evaluate(FeatureID fi)
 {
-  if (model_->faceType(fi)==GeomAbs_Cylinder)
-  {
-      GeomAdaptor_Surface adapt(BRep_Tool::Surface(model_->face(fi)));
-      gp_Cylinder icyl=adapt.Cylinder();
-      return icyl.Radius();
-  }
-  else return -1.0;
+  // -1 for non-cylindrical faces
+  return model_->entityProperties(Face).radius(fi);
 }
   
 QuantityComputer<double>::Ptr cylRadius::clone() const 
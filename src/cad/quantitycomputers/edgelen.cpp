@@ -39,14 +39,7 @@ edgeLen::~edgeLen()
 
 double edgeLen::evaluate(FeatureID ei)
 {
-  GProp_GProps gpr;
-  TopoDS_Edge e=model_->edge(ei);
-  double l = 0.;
-  if (!e.IsNull() && !BRep_Tool::Degenerated(e)) {
-    BRepGProp::LinearProperties(e, gpr);
-    l = gpr.Mass();
-  }
-  return l;
+  return model_->entityProperties(Edge).measure(ei);
 }
 
 QuantityComputer< double >::Ptr edgeLen::clone() const
@@ -67,18 +60,8 @@ circRadius::~circRadius()
 
 double circRadius::evaluate(FeatureID ei)
 {
-  TopoDS_Edge e=model_->edge(ei);
-  if (!e.IsNull() && !BRep_Tool::Degenerated(e))
-    {
-      double p0, p1;
-      GeomAdaptor_Curve adapt(BRep_Tool::Curve(e, p0, p1));
-      if (adapt.GetType()==GeomAbs_Circle)
-        {
-          gp_Circ ic=adapt.Circle();
-          return ic.Radius();
-        }
-    }
-  return 0;
+  // -1 in the property table for non-circular edges
+  return std::max(0., model_->entityProperties(Edge).radius(ei));
 }
 
 QuantityComputer< double >::Ptr circRadius::clone() const
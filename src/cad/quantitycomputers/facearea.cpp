@@ -38,14 +38,7 @@ faceArea::~faceArea()
 
 double faceArea::evaluate(FeatureID ei)
 {
-  GProp_GProps gpr;
-  TopoDS_Face e=model_->face(ei);
-  double l = 0.;
-  if (!e.IsNull() /*&& !BRep_Tool::Degenerated(e)*/) {
-    BRepGProp::SurfaceProperties(e, gpr);
-    l = gpr.Mass();
-  }
-  return l;
+  return model_->entityProperties(Face).measure(ei);
 }
 
 QuantityComputer< double >::Ptr faceArea::clone() const
@@ -0,0 +1,450 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "rebuildscheduler.h"
+#include "cadfeature.h"
+#include "cadmodel.h"
+#include "datum.h"
+
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+
+#include "Standard.hxx"
+
+#include "boost/format.hpp"
+#include "boost/lexical_cast.hpp"
+
+
+namespace insight
+{
+namespace cad
+{
+
+
+namespace
+{
+
+/**
+ * pending builds of one worker thread
+ */
+struct WorkQueue
+{
+  std::mutex mtx;
+  std::deque<size_t> tasks;
+};
+
+}
+
+
+
+
+size_t RebuildScheduler::addNode(const ASTBase* o, const std::string& label)
+{
+  auto i=nodeIndex_.find(o);
+  if (i!=nodeIndex_.end())
+  {
+    if (!label.empty()) nodes_[i->second].label=label;
+    return i->second;
+  }
+
+  auto newNode = [&](const ASTBase* d, const std::string& l)
+  {
+    Node n;
+    n.object=d;
+    n.isFeature=false;
+    n.label=l;
+    if (const Feature* f=dynamic_cast<const Feature*>(d))
+    {
+      n.isFeature=true;
+      if (n.label.empty()) n.label=f->featureSymbolName();
+    }
+    else if (n.label.empty())
+    {
+      n.label = dynamic_cast<const Datum*>(d) ? "(datum)" :
+                dynamic_cast<const FeatureSet*>(d) ? "(feature set)" : "(other)";
+    }
+    n.thread=-1;
+    n.start=n.duration=n.criticalPathEnd=0.;
+    n.criticalPredecessor=-1;
+
+    size_t idx=nodes_.size();
+    nodes_.push_back(n);
+    nodeIndex_[d]=idx;
+
+    if (n.isFeature)
+    {
+      auto fi=featureHashIndex_.find(d->hash());
+      if (fi==featureHashIndex_.end())
+      {
+        featureHashIndex_[d->hash()]=idx;
+      }
+      else
+      {
+        // build after the identical feature, to restore from the cache
+        nodes_[idx].dependencies.push_back(fi->second);
+        nodes_[fi->second].dependents.push_back(idx);
+      }
+    }
+    return idx;
+  };
+
+  size_t idx=newNode(o, label);
+
+  std::vector<size_t> todo(1, idx);
+  while (!todo.empty())
+  {
+    size_t k=todo.back();
+    todo.pop_back();
+
+    std::set<const ASTBase*> deps=nodes_[k].object->dependencies();
+    for (const ASTBase* d: deps)
+    {
+      size_t j;
+      auto di=nodeIndex_.find(d);
+      if (di==nodeIndex_.end())
+      {
+        j=newNode(d, "");
+        todo.push_back(j);
+      }
+      else
+      {
+        j=di->second;
+      }
+      nodes_[k].dependencies.push_back(j);
+      nodes_[j].dependents.push_back(k);
+    }
+  }
+
+  return idx;
+}
+
+
+
+
+RebuildScheduler::RebuildScheduler(int nThreads)
+: nThreads_(nThreads),
+  wallTime_(0.)
+{
+  if (nThreads_<=0)
+  {
+    if (const char* nt=getenv("ISCAD_REBUILD_THREADS"))
+    {
+      try
+      {
+        nThreads_=boost::lexical_cast<int>(nt);
+      }
+      catch (...)
+      {
+        insight::Warning(std::string("invalid value of ISCAD_REBUILD_THREADS: ")+nt+"! Using the number of CPU cores.");
+      }
+    }
+  }
+  if (nThreads_<=0)
+  {
+    nThreads_=std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+
+
+
+void RebuildScheduler::addFeature(const std::string& name, ConstFeaturePtr feat)
+{
+  addNode(feat.get(), name);
+}
+
+
+
+
+void RebuildScheduler::addModel(ConstModelPtr model)
+{
+  for (const auto& ms: model->modelsteps())
+  {
+    addFeature(ms.first, ms.second);
+  }
+}
+
+
+
+
+void RebuildScheduler::run()
+{
+  size_t n=nodes_.size();
+  if (n==0) return;
+
+#if (OCC_VERSION_MAJOR<7)
+  Standard::SetReentrant(Standard_True);
+#endif
+
+  std::vector<std::atomic<size_t> > pending(n);
+  int nw=std::max<int>(1, std::min<int>(nThreads_, n));
+  std::vector<WorkQueue> queues(nw);
+
+  // distribute the builds without inputs
+  int w0=0;
+  for (size_t i=0; i<n; i++)
+  {
+    pending[i]=nodes_[i].dependencies.size();
+    if (pending[i]==0)
+    {
+      queues[(w0++)%nw].tasks.push_back(i);
+    }
+  }
+
+  std::atomic<size_t> nDone(0);
+  std::atomic<bool> stop(false);
+  std::mutex signalMtx;
+  std::condition_variable signal;
+  std::mutex errorMtx;
+  std::exception_ptr error;
+
+  auto t0=std::chrono::steady_clock::now();
+  auto elapsed = [&]()
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  };
+
+  // take from the back of the own queue, steal from the front of the others
+  auto nextTask = [&](int w, size_t& task)
+  {
+    for (int k=0; k<nw; k++)
+    {
+      WorkQueue& q=queues[(w+k)%nw];
+      std::lock_guard<std::mutex> l(q.mtx);
+      if (!q.tasks.empty())
+      {
+        if (k==0)
+        {
+          task=q.tasks.back();
+          q.tasks.pop_back();
+        }
+        else
+        {
+          task=q.tasks.front();
+          q.tasks.pop_front();
+        }
+        return true;
+      }
+    }
+    return false;
+  };
+
+  auto worker = [&](int w)
+  {
+    while (!stop && nDone<n)
+    {
+      size_t i;
+      if (!nextTask(w, i))
+      {
+        std::unique_lock<std::mutex> l(signalMtx);
+        signal.wait_for(l, std::chrono::milliseconds(10));
+        continue;
+      }
+
+      Node& nd=nodes_[i];
+      nd.thread=w;
+      nd.start=elapsed();
+      try
+      {
+        nd.object->checkForBuildDuringAccess();
+      }
+      catch (...)
+      {
+        {
+          std::lock_guard<std::mutex> l(errorMtx);
+          if (!error) error=std::current_exception();
+        }
+        stop=true;
+        signal.notify_all();
+        break;
+      }
+      nd.duration=elapsed()-nd.start;
+
+      for (size_t d: nd.dependents)
+      {
+        if (--pending[d]==0)
+        {
+          std::lock_guard<std::mutex> l(queues[w].mtx);
+          queues[w].tasks.push_back(d);
+        }
+      }
+      ++nDone;
+      signal.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<std::thread::id> workerIds;
+  for (int w=0; w<nw; w++)
+  {
+    workers.push_back(std::thread(worker, w));
+    workerIds.push_back(workers.back().get_id());
+  }
+
+  // wait for completion and forward cancel requests to the workers
+  bool cancelled=false;
+  {
+    std::unique_lock<std::mutex> l(signalMtx);
+    while (!stop && nDone<n)
+    {
+      signal.wait_for(l, std::chrono::milliseconds(50));
+      if (ASTBase::cancelRequested())
+      {
+        cancelled=true;
+        stop=true;
+        for (const std::thread::id& id: workerIds)
+        {
+          ASTBase::cancelRebuild(id);
+        }
+      }
+    }
+  }
+  signal.notify_all();
+
+  for (std::thread& t: workers)
+  {
+    t.join();
+  }
+  // remove requests, which were not received by the workers
+  for (const std::thread::id& id: workerIds)
+  {
+    ASTBase::cancelRequested(id);
+  }
+
+  wallTime_=elapsed();
+
+  if (cancelled)
+  {
+    throw RebuildCancelException();
+  }
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+
+  // critical path: all inputs of a node finished before its start
+  std::vector<size_t> order(n);
+  for (size_t i=0; i<n; i++) order[i]=i;
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return nodes_[a].start < nodes_[b].start; });
+  for (size_t i: order)
+  {
+    Node& nd=nodes_[i];
+    double depEnd=0.;
+    for (size_t d: nd.dependencies)
+    {
+      if (nodes_[d].criticalPathEnd>=depEnd)
+      {
+        depEnd=nodes_[d].criticalPathEnd;
+        nd.criticalPredecessor=d;
+      }
+    }
+    nd.criticalPathEnd=depEnd+nd.duration;
+  }
+}
+
+
+
+
+std::vector<size_t> RebuildScheduler::criticalPath() const
+{
+  std::vector<size_t> path;
+  if (nodes_.empty()) return path;
+
+  int i=0;
+  for (size_t j=1; j<nodes_.size(); j++)
+  {
+    if (nodes_[j].criticalPathEnd > nodes_[i].criticalPathEnd) i=j;
+  }
+  for (; i>=0; i=nodes_[i].criticalPredecessor)
+  {
+    path.push_back(i);
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+
+
+
+void RebuildScheduler::printTimingReport(std::ostream& os) const
+{
+  std::vector<size_t> order;
+  for (size_t i=0; i<nodes_.size(); i++)
+  {
+    if (nodes_[i].isFeature) order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return nodes_[a].start < nodes_[b].start; });
+
+  std::vector<size_t> cp=criticalPath();
+  std::set<size_t> oncp(cp.begin(), cp.end());
+
+  os<<"== Rebuild timing ("<<nThreads_<<" threads) =="<<std::endl;
+  os<<boost::format("%-30s %6s %10s %10s %10s %10s %10s")
+      % "feature" % "thread" % "start/s" % "build/s" % "path/s" % "naming/s" % "maps/kB"<<std::endl;
+  size_t topoMem=0;
+  std::set<const FeatureTopology*> counted; // copies share their maps
+  for (size_t i: order)
+  {
+    const Node& nd=nodes_[i];
+
+    // subshapes are only indexed for features, which were queried
+    std::string naming="-", maps="-";
+    const Feature* f=dynamic_cast<const Feature*>(nd.object);
+    if (f && f->hasTopology())
+    {
+      const FeatureTopology& t=f->topology();
+      size_t m=t.memoryUsage();
+      if (counted.insert(&t).second) topoMem+=m;
+      naming=boost::str(boost::format("%.3f") % t.namingTime());
+      maps=boost::str(boost::format("%.1f") % (double(m)/1024.));
+    }
+
+    os << boost::format("%-30s %6d %10.3f %10.3f %10.3f %10s %10s %s")
+          % nd.label % nd.thread % nd.start % nd.duration % nd.criticalPathEnd
+          % naming % maps
+          % (oncp.count(i) ? "*" : "")
+       << std::endl;
+  }
+  os<<boost::format("topology maps: %.1f kB") % (double(topoMem)/1024.)<<std::endl;
+
+  if (!cp.empty())
+  {
+    os<<"critical path ("<<nodes_[cp.back()].criticalPathEnd<<" s of "<<wallTime_<<" s wall time):";
+    std::string sep=" ";
+    for (size_t i: cp)
+    {
+      if (nodes_[i].isFeature)
+      {
+        os<<sep<<nodes_[i].label;
+        sep=" -> ";
+      }
+    }
+    os<<std::endl;
+  }
+}
+
+
+}
+}
@@ -0,0 +1,115 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef INSIGHT_CAD_REBUILDSCHEDULER_H
+#define INSIGHT_CAD_REBUILDSCHEDULER_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "cadtypes.h"
+#include "astbase.h"
+
+
+namespace insight
+{
+namespace cad
+{
+
+
+/**
+ * Builds a set of features concurrently.
+ * The dependency graph is extracted from the objects, which enter the hashes
+ * of the requested features (see ASTBase::dependencies()). Each object is built
+ * as soon as all its inputs are available. Idle worker threads steal
+ * pending builds from the other workers.
+ *
+ * Features with identical hashes are built one after the other,
+ * so that only the first one is built and the others are restored
+ * from the feature cache.
+ *
+ * A cancel request for the calling thread (ASTBase::cancelRebuild)
+ * is forwarded to all workers and run() throws RebuildCancelException.
+ */
+class RebuildScheduler
+{
+public:
+  struct Node
+  {
+    const ASTBase* object;
+    std::string label;
+    bool isFeature;
+    std::vector<size_t> dependencies, dependents;
+
+    int thread;
+    double start, duration;
+    /**
+     * earliest possible end of build, if an unlimited number of threads was available
+     */
+    double criticalPathEnd;
+    int criticalPredecessor;
+  };
+
+protected:
+  int nThreads_;
+  std::vector<Node> nodes_;
+  std::map<const ASTBase*, size_t> nodeIndex_;
+  /**
+   * first node of each feature hash
+   */
+  std::map<size_t, size_t> featureHashIndex_;
+  double wallTime_;
+
+  size_t addNode(const ASTBase* o, const std::string& label);
+
+public:
+  /**
+   * nThreads<=0: take the number from ISCAD_REBUILD_THREADS
+   * or the number of CPU cores
+   */
+  RebuildScheduler(int nThreads=0);
+
+  /**
+   * add a feature and (recursively) all its inputs
+   */
+  void addFeature(const std::string& name, ConstFeaturePtr feat);
+  void addModel(ConstModelPtr model);
+
+  /**
+   * build all added features
+   */
+  void run();
+
+  inline const std::vector<Node>& nodes() const { return nodes_; }
+
+  /**
+   * the chain of builds which determines the rebuild time
+   */
+  std::vector<size_t> criticalPath() const;
+
+  void printTimingReport(std::ostream& os = std::cout) const;
+};
+
+
+}
+}
+
+#endif // INSIGHT_CAD_REBUILDSCHEDULER_H
@@ -25,6 +25,7 @@
 #include "base/tools.h"
 
 #include "datum.h"
+#include "filefingerprints.h"
 
 #include "TColStd_Array1OfInteger.hxx"
 #include "GC_MakeArcOfCircle.hxx"
@@ -51,15 +52,15 @@ size_t Sketch::calcHash() const
 {
   ParameterListHash p;
   p+=*pl_;
+  p+=fn_.string();
   try
   {
-    // try to incorporate file time stamp etc
-    p+=sharedModelFilePath(fn_.string());
+    // incorporate file contents
+    p+=fileFingerprints(sharedModelFilePath(fn_.string()));
   }
   catch (...)
   {
     // if file is non-existing, use filename only
-    p+=fn_.string();
   }
   p+=ln_;
   for (SketchVarList::const_iterator it=vars_.begin(); it!=vars_.end(); it++)
@@ -252,12 +253,20 @@ void Sketch::build()
     }
     else
     {
-        this->operator=(*cache.markAsUsed<Sketch>(hash()));
+        cache.restore<Sketch>(*this);
     }
 }
 
 
 
+bool Sketch::buildIsThreadSafe() const
+{
+    // may run FreeCAD and reads DXF files
+    return false;
+}
+
+
+
 
 void Sketch::executeEditor()
 {
@@ -57,6 +57,7 @@ class Sketch
 
   virtual size_t calcHash() const;
   virtual void build();
+  virtual bool buildIsThreadSafe() const;
 
 public:
   declareType("Sketch");
@@ -0,0 +1,310 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "stlwriter.h"
+#include "base/exception.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+
+namespace insight {
+namespace cad {
+
+
+
+
+std::mutex& meshingMutex()
+{
+  static std::mutex m;
+  return m;
+}
+
+
+
+
+void tessellate(const TopoDS_Shape& shape, double deflection, double angle)
+{
+  std::lock_guard<std::mutex> lock(meshingMutex());
+#if (OCC_VERSION_MAJOR>=7)||(OCC_VERSION_MINOR>=7)
+  BRepMesh_IncrementalMesh mesh(shape, deflection, Standard_False, angle, Standard_True);
+#else
+  BRepMesh_IncrementalMesh mesh(shape, deflection, Standard_False, angle);
+#endif
+}
+
+
+
+
+namespace
+{
+
+/**
+ * stores v at b in little endian byte order, independent of the host
+ */
+inline void putLE32(char* b, uint32_t v)
+{
+  b[0]=char(v & 0xff);
+  b[1]=char((v>>8) & 0xff);
+  b[2]=char((v>>16) & 0xff);
+  b[3]=char((v>>24) & 0xff);
+}
+
+inline void putLE32(char* b, float v)
+{
+  static_assert(sizeof(float)==4, "binary STL requires 32 bit floats");
+  uint32_t u;
+  memcpy(&u, &v, 4);
+  putLE32(b, u);
+}
+
+/**
+ * calls f(normal, p1, p2, p3) for all triangles of the face,
+ * oriented according to the face orientation.
+ * Returns false, if the face has no triangulation.
+ */
+template<class F>
+bool forEachTriangle(const TopoDS_Face& face, F f)
+{
+  TopLoc_Location loc;
+  Handle_Poly_Triangulation tri=BRep_Tool::Triangulation(face, loc);
+  if (tri.IsNull()) return false;
+
+  const TColgp_Array1OfPnt& nodes = tri->Nodes();
+  const Poly_Array1OfTriangle& triangles = tri->Triangles();
+  bool reversed = (face.Orientation()==TopAbs_REVERSED);
+  bool transform = !loc.IsIdentity();
+  gp_Trsf trsf = loc.Transformation();
+
+  for (int i=triangles.Lower(); i<=triangles.Upper(); i++)
+  {
+    int n1, n2, n3;
+    triangles(i).Get(n1, n2, n3);
+    if (reversed) std::swap(n2, n3);
+
+    gp_Pnt p1=nodes(n1), p2=nodes(n2), p3=nodes(n3);
+    if (transform)
+    {
+      p1.Transform(trsf);
+      p2.Transform(trsf);
+      p3.Transform(trsf);
+    }
+
+    gp_Vec n = gp_Vec(p1, p2).Crossed(gp_Vec(p1, p3));
+    double mag = n.Magnitude();
+    if (mag > gp::Resolution())
+      n /= mag;
+    else
+      n = gp_Vec(0, 0, 0);
+
+    f(n, p1, p2, p3);
+  }
+
+  return true;
+}
+
+
+void warnUntessellated(int n)
+{
+  if (n>0)
+  {
+    insight::Warning(boost::str(boost::format(
+      "STL export: %d faces without triangulation were skipped!") % n));
+  }
+}
+
+}
+
+
+
+
+STLWriter::STLWriter()
+{}
+
+
+
+
+void STLWriter::addPatch(const std::string& name, const TopoDS_Shape& shape)
+{
+  Faces faces;
+  for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next())
+  {
+    faces.push_back(TopoDS::Face(ex.Current()));
+  }
+  addPatch(name, faces);
+}
+
+
+
+
+void STLWriter::addPatch(const std::string& name, const Faces& faces)
+{
+  patches_.push_back(std::make_pair(name, faces));
+}
+
+
+
+
+size_t STLWriter::nTriangles() const
+{
+  size_t n=0;
+  for (const auto& p: patches_)
+  {
+    for (const TopoDS_Face& f: p.second)
+    {
+      TopLoc_Location loc;
+      Handle_Poly_Triangulation tri=BRep_Tool::Triangulation(f, loc);
+      if (!tri.IsNull()) n+=tri->NbTriangles();
+    }
+  }
+  return n;
+}
+
+
+
+
+void STLWriter::writeBinary(const boost::filesystem::path& filename) const
+{
+  size_t nt=nTriangles();
+  if (nt > size_t(UINT32_MAX))
+  {
+    throw insight::Exception("Too many triangles for binary STL format!");
+  }
+
+  std::ofstream f(filename.c_str(), std::ios::binary);
+  if (!f.good())
+  {
+    throw insight::Exception("Could not open file "+filename.string()+" for writing!");
+  }
+
+  // the header must not start with "solid"
+  char header[80];
+  memset(header, ' ', 80);
+  const char title[]="binary STL, written by Insight CAD";
+  memcpy(header, title, sizeof(title)-1);
+  f.write(header, 80);
+
+  // STL binary data is little endian
+  char n32[4];
+  putLE32(n32, uint32_t(nt));
+  f.write(n32, 4);
+
+  // 50 bytes per triangle: normal, 3 vertices (float) and attribute (uint16)
+  const size_t recSize=50, bufRecs=8192;
+  std::vector<char> buf(recSize*bufRecs);
+  size_t nInBuf=0;
+
+  int nUntessellated=0;
+  for (const auto& p: patches_)
+  {
+    for (const TopoDS_Face& face: p.second)
+    {
+      bool ok = forEachTriangle
+      (
+        face,
+        [&](const gp_Vec& n, const gp_Pnt& p1, const gp_Pnt& p2, const gp_Pnt& p3)
+        {
+          float rec[12] = {
+            float(n.X()), float(n.Y()), float(n.Z()),
+            float(p1.X()), float(p1.Y()), float(p1.Z()),
+            float(p2.X()), float(p2.Y()), float(p2.Z()),
+            float(p3.X()), float(p3.Y()), float(p3.Z())
+          };
+          char* r=&buf[recSize*nInBuf];
+          for (int j=0; j<12; j++)
+          {
+            putLE32(r+4*j, rec[j]);
+          }
+          r[48]=r[49]=0;
+
+          if (++nInBuf==bufRecs)
+          {
+            f.write(&buf[0], recSize*nInBuf);
+            nInBuf=0;
+          }
+        }
+      );
+      if (!ok) nUntessellated++;
+    }
+  }
+  f.write(&buf[0], recSize*nInBuf);
+
+  if (!f.good())
+  {
+    throw insight::Exception("Error while writing file "+filename.string()+"!");
+  }
+  warnUntessellated(nUntessellated);
+}
+
+
+
+
+void STLWriter::writeASCII(const boost::filesystem::path& filename) const
+{
+  FILE* f=fopen(filename.c_str(), "w");
+  if (!f)
+  {
+    throw insight::Exception("Could not open file "+filename.string()+" for writing!");
+  }
+
+  int nUntessellated=0;
+  for (const auto& p: patches_)
+  {
+    fprintf(f, "solid %s\n", p.first.c_str());
+    for (const TopoDS_Face& face: p.second)
+    {
+      bool ok = forEachTriangle
+      (
+        face,
+        [&](const gp_Vec& n, const gp_Pnt& p1, const gp_Pnt& p2, const gp_Pnt& p3)
+        {
+          fprintf(f,
+            "  facet normal %g %g %g\n"
+            "    outer loop\n"
+            "      vertex %.9g %.9g %.9g\n"
+            "      vertex %.9g %.9g %.9g\n"
+            "      vertex %.9g %.9g %.9g\n"
+            "    endloop\n"
+            "  endfacet\n",
+            n.X(), n.Y(), n.Z(),
+            p1.X(), p1.Y(), p1.Z(),
+            p2.X(), p2.Y(), p2.Z(),
+            p3.X(), p3.Y(), p3.Z()
+          );
+        }
+      );
+      if (!ok) nUntessellated++;
+    }
+    fprintf(f, "endsolid %s\n", p.first.c_str());
+  }
+
+  bool err = ferror(f);
+  fclose(f);
+  if (err)
+  {
+    throw insight::Exception("Error while writing file "+filename.string()+"!");
+  }
+  warnUntessellated(nUntessellated);
+}
+
+
+}
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef INSIGHT_CAD_STLWRITER_H
+#define INSIGHT_CAD_STLWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "base/boost_include.h"
+#include "occinclude.h"
+
+#include <mutex>
+
+namespace insight {
+namespace cad {
+
+
+/**
+ * BRepMesh stores the triangulation in the faces, which are shared between
+ * features (e.g. a compound and its parts, transformed or imported copies).
+ * All meshing of feature shapes has to be serialised by this mutex.
+ */
+std::mutex& meshingMutex();
+
+/**
+ * tessellate all faces of a shape.
+ * The faces are meshed concurrently by OCC (OCC>=6.7).
+ */
+void tessellate(const TopoDS_Shape& shape, double deflection, double angle=0.5);
+
+
+
+
+/**
+ * Writes the triangulations of faces directly into STL files,
+ * without building an intermediate mesh.
+ * The faces need to be tessellated before (see tessellate).
+ *
+ * The faces are grouped into patches. Binary files contain all patches
+ * in a single solid, ASCII files contain one named solid per patch
+ * (as read e.g. by snappyHexMesh).
+ */
+class STLWriter
+{
+public:
+  typedef std::vector<TopoDS_Face> Faces;
+
+protected:
+  std::vector<std::pair<std::string, Faces> > patches_;
+
+public:
+  STLWriter();
+
+  /**
+   * add all faces of a shape as one patch
+   */
+  void addPatch(const std::string& name, const TopoDS_Shape& shape);
+  void addPatch(const std::string& name, const Faces& faces);
+
+  /**
+   * number of triangles in all patches
+   */
+  size_t nTriangles() const;
+
+  void writeBinary(const boost::filesystem::path& filename) const;
+  void writeASCII(const boost::filesystem::path& filename) const;
+};
+
+
+}
+}
+
+#endif // INSIGHT_CAD_STLWRITER_H
@@ -445,21 +445,23 @@ tmp<Field<T> > linearProfile<T>::atInstant(int idx, const pointField& target) co
 // //   Info<<ey<<tt<<endl;
   
 
+  // evaluate all target points in one batch
+  arma::mat t(target.size(), 1);
+  forAll(target, pi)
+  {
+    t(pi) = base_.t(target[pi]);
+  }
+  arma::mat q = (*values_.find(idx)->second)(t);
+
   forAll(target, pi)
   {
-    double t = base_.t(target[pi]);
-    
-    arma::mat q = (*values_.find(idx)->second)(t);
-    
-//     std::cout<<target[pi].x()<<" "<<target[pi].y()<<" "<<target[pi].z()<<" >> "<<t<<" >> "<<q<<std::endl;
-    
 //     Info<<cols_<<endl;
 //     std::cout<<q<<std::endl;
-    for (size_t c=0; c<q.n_elem; c++)
+    for (size_t c=0; c<q.n_cols; c++)
     {
 //       if (cols_.found(c)) //(cmap[c]>=0) // if column is used
 //       {
-	setComponent( res[pi], /*cols_[c]*/ c ) = q(c);
+	setComponent( res[pi], /*cols_[c]*/ c ) = q(pi, c);
 //       }
     }
     res[pi]=base_(res[pi]); //transform(tt, res[pi]);
@@ -545,21 +547,23 @@ tmp<Field<T> > radialProfile<T>::atInstant(int idx, const pointField& target) co
   Field<T>& res=UNIOF_TMP_NONCONST(resPtr);
   
 
+  // evaluate all target points in one batch
+  arma::mat t(target.size(), 1);
+  forAll(target, pi)
+  {
+    t(pi) = base_.t(target[pi]);
+  }
+  arma::mat q = (*values_.find(idx)->second)(t);
+
   forAll(target, pi)
   {
-    double t = base_.t(target[pi]);
-    
-    arma::mat q = (*values_.find(idx)->second)(t);
-    
-//     std::cout<<target[pi].x()<<" "<<target[pi].y()<<" "<<target[pi].z()<<" >> "<<t<<" >> "<<q<<std::endl;
-    
 //     Info<<cols_<<endl;
 //     std::cout<<q<<std::endl;
-    for (size_t c=0; c<q.n_elem; c++)
+    for (size_t c=0; c<q.n_cols; c++)
     {
 //       if (cols_.found(c)) //(cmap[c]>=0) // if column is used
 //       {
-	setComponent( res[pi], /*cols_[c]*/ c ) = q(c);
+	setComponent( res[pi], /*cols_[c]*/ c ) = q(pi, c);
 //       }
     }
     res[pi]=base_(res[pi], target[pi]); //transform(tt, res[pi]);
@@ -375,9 +375,14 @@ ResultSetPtr InternalPressureLoss::evaluateResults(OpenFOAMCase& cm)
     patchArea inletprops(cm, executionPath(), "inlet");
     double D=sqrt(inletprops.A_*4./M_PI);
 
-    patchIntegrate pi(cm, executionPath(), "p", "inlet", std::vector<std::string>() ); // time, int p, A
+    // time, A and int p of both patches from a single run
+    batchedPatchIntegrate pi(cm, executionPath(),
+                             list_of<std::string>("p"), list_of<std::string>("inlet")("outlet"),
+                             std::vector<std::string>() );
     
-    arma::mat pmean=pi.integral_values_/pi.A_;
+    arma::mat pmean =
+        pi.integral("p", "inlet")/pi.area("inlet")
+      - pi.integral("p", "outlet")/pi.area("outlet");
     
     addPlot
     (
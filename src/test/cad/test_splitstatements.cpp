@@ -0,0 +1,59 @@
+#include "parser.h"
+
+#include <iostream>
+
+using namespace insight::cad;
+
+/**
+ * Splits a script with comments, strings and statements spanning
+ * several lines into its top-level statements.
+ */
+
+int main(int argc, char*argv[])
+{
+  std::string script =
+      "a = 1; # comment; with semicolon\n"
+      "b = [a, 2,\n"
+      "     3]; // another; one\n"
+      "/* block; comment */ c = import(\"file;name.brep\");\n"
+      "c -> density = 1;\n"
+      "d = 'a;b';\n"
+      "@doc\n"
+      "text; with semicolons\n";
+
+  std::vector<IncrementalModelParser::Statement> st;
+  size_t tail = IncrementalModelParser::splitStatements(script, st);
+
+  int nbad=0;
+
+  if (st.size()!=5)
+  {
+    std::cout << "expected 5 statements, got " << st.size() << std::endl;
+    return -1;
+  }
+
+  auto text = [&](size_t i) { return script.substr(st[i].begin, st[i].end-st[i].begin); };
+
+  if (text(0)!="a = 1;") nbad++;
+  if (st[0].symbol!="a" || !st[0].reusable) nbad++;
+
+  // comments belong to the following statement and are not split
+  if (text(1)!=" # comment; with semicolon\nb = [a, 2,\n     3];") nbad++;
+  if (st[1].symbol!="b" || !st[1].reusable) nbad++;
+  if (st[1].identifiers!=std::set<std::string>({"a", "b"})) nbad++;
+
+  // file paths are always reparsed
+  if (st[2].symbol!="c" || st[2].reusable) nbad++;
+  if (st[2].identifiers.count("file")||st[2].identifiers.count("comment")) nbad++;
+
+  if (!st[3].propertyAssignment || st[3].reusable) nbad++;
+
+  if (st[4].symbol!="d" || !st[4].reusable) nbad++;
+
+  // the @doc section is not split
+  if (script.compare(tail, 6, "\n@doc\n")!=0) nbad++;
+
+  std::cout << nbad << " failed checks" << std::endl;
+
+  return nbad>0 ? -1 : 0;
+}
@@ -0,0 +1,151 @@
+#include "base/analysis.h"
+
+#include <iostream>
+
+using namespace insight;
+
+/**
+ * Makespan benchmark for the resource aware scheduler:
+ * a set of synthetic analyses with different core demands and durations
+ * is executed once by a fixed number of worker threads (the former
+ * ParameterStudy behaviour) and once by the ResourceAwareAnalysisScheduler.
+ * The peak number of occupied cores is tracked in both cases.
+ */
+
+const int nHostCores = 8;
+
+boost::mutex usageMutex;
+int coresInUse = 0;
+int peakCoresInUse = 0;
+
+
+class SleepAnalysis
+: public Analysis
+{
+  int np_;
+  int duration_; // ms
+
+public:
+  SleepAnalysis(const std::string& name, int np, int duration)
+  : Analysis(name, "", ParameterSet(), ""),
+    np_(np), duration_(duration)
+  {}
+
+  virtual int requiredCores() const
+  {
+    return np_;
+  }
+
+  virtual double expectedCost() const
+  {
+    return double(np_*duration_);
+  }
+
+  virtual ResultSetPtr operator()(ProgressDisplayer* =nullptr)
+  {
+    {
+      boost::mutex::scoped_lock lock(usageMutex);
+      coresInUse+=np_;
+      peakCoresInUse=std::max(peakCoresInUse, coresInUse);
+    }
+
+    // emulate a parallel run with np_ ranks on a host with nHostCores cores:
+    // if the host is oversubscribed, all running ranks progress slower
+    double done=0.0;
+    while (done<duration_)
+    {
+      boost::this_thread::sleep_for( boost::chrono::milliseconds(5) );
+      boost::mutex::scoped_lock lock(usageMutex);
+      done += 5.0*std::min(1.0, double(nHostCores)/double(coresInUse));
+    }
+
+    {
+      boost::mutex::scoped_lock lock(usageMutex);
+      coresInUse-=np_;
+    }
+
+    return ResultSetPtr(new ResultSet(ParameterSet(), getName(), ""));
+  }
+};
+
+
+void fillQueue(SynchronisedAnalysisQueue& queue)
+{
+  queue.clear();
+  // mixture of small serial and large parallel instances, short ones first
+  int np[]       = { 1,  1,  1,  1,  2,  2,  4,  4,  8,  1,  1,  2 };
+  int duration[] = { 50, 50, 50, 50, 100,100,200,200,300,50, 50, 100 };
+  for (size_t i=0; i<sizeof(np)/sizeof(int); i++)
+  {
+    std::string n="subcase"+boost::lexical_cast<std::string>(i);
+    queue.enqueue
+    (
+      AnalysisInstance
+      (
+        n,
+        AnalysisPtr(new SleepAnalysis(n, np[i], duration[i])),
+        ResultSetPtr(new ResultSet(ParameterSet(), n, ""))
+      )
+    );
+  }
+}
+
+
+void resetUsage()
+{
+  boost::mutex::scoped_lock lock(usageMutex);
+  coresInUse=0;
+  peakCoresInUse=0;
+}
+
+
+int main(int argc, char*argv[])
+{
+  SynchronisedAnalysisQueue queue;
+
+  // fixed number of worker threads, core demand ignored
+  {
+    fillQueue(queue);
+    resetUsage();
+    boost::timer::cpu_timer timer;
+    boost::thread_group workers;
+    boost::ptr_vector<AnalysisWorkerThread> threads;
+    for (int i=0; i<4; i++)
+    {
+      threads.push_back(new AnalysisWorkerThread(&queue, nullptr));
+      workers.create_thread(boost::ref(threads.back()));
+    }
+    workers.join_all();
+    std::cout
+      << "fixed 4 workers: makespan "<<double(timer.elapsed().wall)*1e-9<<" s, "
+      << "peak cores "<<peakCoresInUse<<" of "<<nHostCores
+      << std::endl;
+  }
+
+  // resource aware scheduler
+  {
+    fillQueue(queue);
+    resetUsage();
+    boost::timer::cpu_timer timer;
+    boost::thread_group workers;
+    ResourceAwareAnalysisScheduler scheduler(&queue, nullptr, nHostCores, -1, 0, false);
+    scheduler.run(workers);
+    std::cout
+      << "resource aware:  makespan "<<double(timer.elapsed().wall)*1e-9<<" s, "
+      << "peak cores "<<peakCoresInUse<<" of "<<nHostCores
+      << std::endl;
+
+    if (queue.processed().size()!=12)
+    {
+      std::cerr<<"Not all instances were processed!"<<std::endl;
+      return -1;
+    }
+    if (peakCoresInUse>nHostCores)
+    {
+      std::cerr<<"Host was oversubscribed!"<<std::endl;
+      return -1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "openfoam/openfoamtools.h"
+
+#include <iostream>
+
+using namespace insight;
+
+/**
+ * Evaluates captured postProcess output with several patchIntegrate
+ * function objects. The areas are only reported at initialisation
+ * and have to be assigned to the right patches in all later time steps.
+ */
+
+int main(int argc, char*argv[])
+{
+  std::vector<std::string> output = {
+    "Time = 1",
+    "",
+    "surfaceFieldValue patchIntegrate(name=inlet,p):",
+    "    total faces  = 20",
+    "    total area   = 0.5",
+    "",
+    "surfaceFieldValue patchIntegrate(name=outlet,p):",
+    "    total faces  = 40",
+    "    total area   = 2",
+    "",
+    "surfaceFieldValue patchIntegrate(name=inlet,p) write:",
+    "    areaIntegrate(inlet) of p = 1",
+    "",
+    "surfaceFieldValue patchIntegrate(name=outlet,p) write:",
+    "    areaIntegrate(outlet) of p = 4",
+    "",
+    "Time = 2",
+    "",
+    "surfaceFieldValue patchIntegrate(name=inlet,p) write:",
+    "    areaIntegrate(inlet) of p = 1.5",
+    "",
+    "surfaceFieldValue patchIntegrate(name=outlet,p) write:",
+    "    areaIntegrate(outlet) of p = 6",
+    "",
+    "Time = 3",
+    "",
+    "surfaceFieldValue patchIntegrate(name=inlet,p) write:",
+    "    areaIntegrate(inlet) of p = 2",
+    "",
+    "surfaceFieldValue patchIntegrate(name=outlet,p) write:",
+    "    areaIntegrate(outlet) of p = 8",
+    "",
+    "End"
+  };
+
+  try
+  {
+    batchedPatchIntegrate pi(
+          std::vector<std::string>{"p"},
+          std::vector<std::string>{"inlet", "outlet"},
+          output );
+
+    std::cout<<"t="<<pi.t_.t()<<"A="<<std::endl<<pi.A_<<std::endl;
+
+    if (pi.n()!=3) return -1;
+    for (arma::uword i=0; i<pi.n(); i++)
+    {
+      if ( fabs(pi.A_(i,0)-0.5)>1e-12 ) return -1;
+      if ( fabs(pi.A_(i,1)-2.0)>1e-12 ) return -1;
+    }
+
+    arma::mat pin=pi.integral("p", "inlet"), pout=pi.integral("p", "outlet");
+    if ( fabs(pin(2,0)-2.0)>1e-12 || fabs(pout(2,0)-8.0)>1e-12 ) return -1;
+
+    std::vector<std::string> cn;
+    arma::mat tab=pi.table(&cn);
+    if ( (cn.size()!=5) || (tab.n_cols!=5) ) return -1;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr<<e.what()<<std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include "openfoam/blockmesh.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+using namespace insight;
+using namespace insight::bmd;
+
+/**
+ * Benchmark of the vertex and edge lookup for large synthetic block templates:
+ * a lattice of n^3 blocks and a stack of O-grids. The corners of neighbouring
+ * blocks are computed independently, so that they differ by round-off errors.
+ * Usage: test_blockmeshpoints [n]
+ */
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds(const Clock::time_point& t0)
+{
+  return std::chrono::duration<double>(Clock::now()-t0).count();
+}
+
+
+/**
+ * registers the corners and the twelve edges of a block
+ */
+void addBlock(PointMap& pts, EdgeIndex& edges, const PointList& c)
+{
+  static const int e[12][2]={
+    {0,1},{1,2},{2,3},{3,0}, {4,5},{5,6},{6,7},{7,4}, {0,4},{1,5},{2,6},{3,7}
+  };
+  std::vector<int> idx(8);
+  for (int k=0; k<8; k++)
+  {
+    pts[c[k]]=0;
+    idx[k]=pts.index(c[k]);
+  }
+  for (int k=0; k<12; k++)
+  {
+    edges.insert(idx[e[k][0]], idx[e[k][1]]);
+  }
+}
+
+
+int main(int argc, char*argv[])
+{
+  int ret=0;
+  int n = argc>1 ? atoi(argv[1]) : 40;
+
+  // lattice of n^3 blocks
+  {
+    double h=1./3.;
+    Clock::time_point t0=Clock::now();
+    PointMap pts;
+    EdgeIndex edges;
+    for (int i=0; i<n; i++)
+      for (int j=0; j<n; j++)
+        for (int k=0; k<n; k++)
+        {
+          // lower corner by multiplication, upper corner by addition
+          double x0=h*i, y0=h*j, z0=h*k;
+          double x1=x0+h, y1=y0+h, z1=z0+h;
+          addBlock(pts, edges, P_8(
+            vec3(x0, y0, z0), vec3(x1, y0, z0), vec3(x1, y1, z0), vec3(x0, y1, z0),
+            vec3(x0, y0, z1), vec3(x1, y0, z1), vec3(x1, y1, z1), vec3(x0, y1, z1)
+          ));
+        }
+    double t=seconds(t0);
+
+    size_t np=(n+1)*(n+1)*(n+1);
+    bool ok = (pts.size()==np)
+      && edges.contains(pts.index(vec3(h, 0, 0)), pts.index(vec3(0, 0, 0)))
+      && !edges.contains(pts.index(vec3(h, h, 0)), pts.index(vec3(0, 0, 0)));
+    std::cout<<"lattice: "<<n*n*n<<" blocks, "<<pts.size()<<" vertices (expected "<<np<<"), "
+             <<t<<" s"<<(ok?"":" FAILED")<<std::endl;
+    if (!ok) ret=-1;
+  }
+
+  // stack of O-grids: core block and four outer blocks per layer
+  {
+    int nl=n*n*n/5, nr=4;
+    Clock::time_point t0=Clock::now();
+    PointMap pts;
+    EdgeIndex edges;
+    for (int l=0; l<nl; l++)
+    {
+      double z0=0.1*l, z1=0.1*(l+1);
+      double a=0.5/sqrt(2.), R=1.;
+      PointList core;
+      for (double z: {z0, z1})
+      {
+        core.push_back(vec3(-a, -a, z));
+        core.push_back(vec3( a, -a, z));
+        core.push_back(vec3( a,  a, z));
+        core.push_back(vec3(-a,  a, z));
+      }
+      addBlock(pts, edges, core);
+
+      for (int s=0; s<nr; s++)
+      {
+        double p0=M_PI*(0.5*s-0.75), p1=p0+0.5*M_PI;
+        PointList c;
+        for (double z: {z0, z1})
+        {
+          c.push_back(vec3(sqrt(2.)*a*cos(p0), sqrt(2.)*a*sin(p0), z));
+          c.push_back(vec3(R*cos(p0), R*sin(p0), z));
+          c.push_back(vec3(R*cos(p1), R*sin(p1), z));
+          c.push_back(vec3(sqrt(2.)*a*cos(p1), sqrt(2.)*a*sin(p1), z));
+        }
+        addBlock(pts, edges, c);
+      }
+    }
+    double t=seconds(t0);
+
+    size_t np=8*(nl+1);
+    bool ok = (pts.size()==np);
+    std::cout<<"o-grid: "<<5*nl<<" blocks, "<<pts.size()<<" vertices (expected "<<np<<"), "
+             <<t<<" s"<<(ok?"":" FAILED")<<std::endl;
+    if (!ok) ret=-1;
+  }
+
+  return ret;
+}
@@ -0,0 +1,67 @@
+
+#include "base/analysis.h"
+
+#include <sstream>
+#include <cmath>
+
+using namespace insight;
+
+/**
+ * Micro-benchmark for the convergence detectors:
+ * feeds a synthetic residual history into each detector
+ * and reports the time per sample
+ */
+
+double syntheticHistory(size_t i)
+{
+  // decaying oscillation towards 1 with some deterministic noise
+  double t=double(i);
+  return 1.0 
+    + exp(-t/4000.)*(0.5*sin(t/50.))
+    + 1e-6*sin(1.7*t)*cos(0.31*t);
+}
+
+int runBenchmark(const std::string& label, ConvergenceAnalysisDisplayer& cad, size_t nmax)
+{
+  std::ostringstream sink;
+  std::streambuf* orgbuf = std::cout.rdbuf(sink.rdbuf());
+
+  size_t iconv=0;
+  boost::timer::cpu_timer timer;
+  for (size_t i=0; i<nmax; i++)
+  {
+    ProgressVariableList pvl;
+    pvl[cad.progressVariable()]=syntheticHistory(i);
+    cad.update( ProgressState(double(i), pvl) );
+    if (!iconv && cad.stopRun()) iconv=i;
+    if (sink.tellp()>(1<<20)) sink.str("");
+  }
+  timer.stop();
+
+  std::cout.rdbuf(orgbuf);
+
+  double t=double(timer.elapsed().user+timer.elapsed().system)*1e-9;
+  std::cout
+    << label << ": "
+    << nmax << " samples in " << t << " s ("<< 1e9*t/double(nmax)<<" ns/sample), "
+    << "converged at iteration "<<iconv
+    << std::endl;
+
+  return iconv>0 ? 0 : -1;
+}
+
+int main(int argc, char*argv[])
+{
+  size_t nmax=200000;
+
+  ConvergenceAnalysisDisplayer c1("Fx", 1e-5);
+  WindowedVarianceConvergenceDisplayer c2("Fx", 1e-4, 500);
+  StationarityConvergenceDisplayer c3("Fx", 1.96, 1000);
+
+  int ret=0;
+  ret+=runBenchmark("relative change", c1, nmax);
+  ret+=runBenchmark("windowed variance", c2, nmax);
+  ret+=runBenchmark("stationarity", c3, nmax);
+
+  return ret;
+}
@@ -0,0 +1,90 @@
+#include "base/linearalgebra.h"
+
+#include <iostream>
+#include <cmath>
+
+#include "boost/thread.hpp"
+#include "boost/timer/timer.hpp"
+
+using namespace insight;
+
+/**
+ * Compares the native batch kernel of the Interpolator against GSL,
+ * evaluates one interpolator concurrently from several threads
+ * and reports the throughput of the batch evaluation.
+ */
+
+double maxDeviation(const Interpolator& ipol, const arma::mat& x)
+{
+  arma::mat ref(x.n_rows, ipol.ncol());
+  for (arma::uword i=0; i<x.n_rows; i++)
+  {
+    ref.row(i)=ipol(x(i));
+  }
+  return arma::abs(ipol(x)-ref).max();
+}
+
+
+int main(int argc, char*argv[])
+{
+  arma::mat xy(50, 4);
+  for (arma::uword i=0; i<xy.n_rows; i++)
+  {
+    double x = double(i) + 0.3*sin(double(i));
+    xy(i,0)=x;
+    xy(i,1)=sin(0.2*x);
+    xy(i,2)=0.01*x*x;
+    xy(i,3)=exp(-0.1*x);
+  }
+
+  // unsorted query points, including some outside the data range
+  arma::mat x = arma::randu(10000, 1)*60. - 5.;
+
+  int ret=0;
+  for (int lin=0; lin<2; lin++)
+  {
+    Interpolator ipol(xy, lin==1);
+    double dev=maxDeviation(ipol, x);
+    std::cout<<(lin?"linear":"cubic")<<": max deviation native/GSL = "<<dev<<std::endl;
+    if (dev>1e-10) ret=-1;
+
+    Interpolator::OutOfBounds oob;
+    ipol(x, &oob);
+    if (oob==Interpolator::IP_INBOUND) ret=-1;
+  }
+
+  // concurrent evaluation
+  {
+    Interpolator ipol(xy);
+    arma::mat ref=ipol(x);
+    std::vector<arma::mat> res(4);
+    boost::thread_group g;
+    for (int t=0; t<4; t++)
+    {
+      g.create_thread( [&,t]() { for (int j=0; j<10; j++) res[t]=ipol(x); } );
+    }
+    g.join_all();
+    for (int t=0; t<4; t++)
+    {
+      if (arma::abs(res[t]-ref).max()>0.) ret=-1;
+    }
+  }
+
+  // throughput
+  {
+    Interpolator ipol(xy, true);
+    arma::mat xs=arma::sort(x);
+    boost::timer::cpu_timer timer;
+    for (int j=0; j<100; j++) ipol(xs);
+    timer.stop();
+    double tn=double(timer.elapsed().wall)*1e-9;
+    ipol.setNativeKernel(false);
+    timer.start();
+    for (int j=0; j<100; j++) ipol(xs);
+    timer.stop();
+    double tg=double(timer.elapsed().wall)*1e-9;
+    std::cout<<"batch evaluation of "<<100*xs.n_rows<<" points: native "<<tn<<" s, GSL "<<tg<<" s"<<std::endl;
+  }
+
+  return ret;
+}
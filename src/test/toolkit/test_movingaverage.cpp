@@ -0,0 +1,94 @@
+#include "base/linearalgebra.h"
+
+#include <iostream>
+#include <cmath>
+
+#include "boost/timer/timer.hpp"
+
+using namespace insight;
+
+/**
+ * Checks movingAverage against a direct evaluation of the windows,
+ * compares the serial and the multi-threaded mode, tests the streaming
+ * variant and reports the runtime for a long time series.
+ */
+
+arma::mat referenceAverage(const arma::mat& tp, double fraction)
+{
+  arma::uword n_raw=tp.n_rows;
+  double x0=tp(0,0), dx_raw=tp(n_raw-1,0)-x0;
+  double window=fraction*dx_raw, avgdx=dx_raw/double(n_raw);
+  arma::uword n_avg=std::min(n_raw, std::max(arma::uword(2), arma::uword((dx_raw-window)/avgdx) ));
+
+  arma::mat r=arma::zeros(n_avg, tp.n_cols);
+  for (arma::uword i=0; i<n_avg; i++)
+  {
+    double from=x0+double(i)*avgdx, to=from+window;
+    r(i,0)=from+window;
+    arma::mat sel=tp.rows( arma::find( (tp.col(0)>=from) && (tp.col(0)<=to) ) );
+    for (arma::uword j=1; j<tp.n_cols; j++)
+    {
+      double I=0;
+      for (arma::uword k=1; k<sel.n_rows; k++)
+        I+=0.5*(sel(k,j)+sel(k-1,j))*(sel(k,0)-sel(k-1,0));
+      r(i,j)=I/(sel(sel.n_rows-1,0)-sel(0,0));
+    }
+  }
+  return r;
+}
+
+
+int main(int argc, char*argv[])
+{
+  int ret=0;
+
+  // non-uniform time spacing
+  arma::mat tp(2000, 3);
+  double t=0;
+  for (arma::uword k=0; k<tp.n_rows; k++)
+  {
+    t+=0.5+0.5*sin(0.1*double(k))*sin(0.1*double(k));
+    tp(k,0)=t;
+    tp(k,1)=sin(t);
+    tp(k,2)=100.+cos(0.3*t);
+  }
+
+  arma::mat ref=referenceAverage(tp, 0.3);
+  arma::mat avg=movingAverage(tp, 0.3);
+  arma::mat avgp=movingAverage(tp, 0.3, true, false, 2);
+  double dev=arma::abs(avg-ref).max(), devp=arma::abs(avgp-avg).max();
+  std::cout<<"max deviation from reference: "<<dev<<", parallel/serial: "<<devp<<std::endl;
+  if (dev>1e-10 || devp>0.) ret=-1;
+
+  // streaming: the last window of the full series equals the trailing window average
+  {
+    double window=0.3*(tp(tp.n_rows-1,0)-tp(0,0));
+    SlidingWindowAverage swa(window);
+    arma::mat s1=swa.update(tp.rows(0, 999));
+    arma::mat s2=swa.update(tp.rows(1000, tp.n_rows-1));
+    arma::uvec last=arma::find( tp.col(0) >= tp(tp.n_rows-1,0)-window );
+    arma::mat sel=tp.rows(last);
+    double I=0;
+    for (arma::uword k=1; k<sel.n_rows; k++)
+      I+=0.5*(sel(k,1)+sel(k-1,1))*(sel(k,0)-sel(k-1,0));
+    double sdev=fabs( s2(s2.n_rows-1,1) - I/(sel(sel.n_rows-1,0)-sel(0,0)) );
+    std::cout<<"streaming deviation: "<<sdev<<std::endl;
+    if (sdev>1e-10) ret=-1;
+  }
+
+  // runtime for a long series
+  {
+    arma::mat big(5000000, 4);
+    for (arma::uword k=0; k<big.n_rows; k++)
+    {
+      double tk=1e-3*double(k);
+      big(k,0)=tk; big(k,1)=sin(tk); big(k,2)=cos(tk); big(k,3)=tk*tk;
+    }
+    boost::timer::cpu_timer timer;
+    movingAverage(big, 0.5);
+    timer.stop();
+    std::cout<<"moving average of "<<big.n_rows<<" rows: "<<double(timer.elapsed().wall)*1e-9<<" s"<<std::endl;
+  }
+
+  return ret;
+}
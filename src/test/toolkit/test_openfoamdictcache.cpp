@@ -0,0 +1,64 @@
+#include "openfoam/openfoamdictcache.h"
+
+#include <iostream>
+#include <thread>
+
+using namespace insight;
+
+/**
+ * Reads a dictionary repeatedly from several threads and checks,
+ * that rewrites and the switch to the compressed variant are detected.
+ */
+
+int main(int argc, char*argv[])
+{
+  int ret=0;
+
+  boost::filesystem::path dir=boost::filesystem::unique_path(boost::filesystem::temp_directory_path()/"%%%%-%%%%");
+  boost::filesystem::create_directories(dir/"system");
+  boost::filesystem::path cdp=dir/"system"/"controlDict";
+
+  OFDictData::dictFile cd;
+  cd["application"]="simpleFoam";
+  cd.write(cdp);
+
+  std::vector<std::thread> threads;
+  for (int k=0; k<4; k++)
+  {
+    threads.push_back(std::thread([&]()
+    {
+      for (int i=0; i<100; i++)
+      {
+        OpenFOAMDictCache::DictPtr d=openFOAMDictCache.get(dir/"system"/".."/"system"/"controlDict");
+        if (d->getString("application")!="simpleFoam") ret=-1;
+      }
+    }));
+  }
+  for (std::thread& t: threads) t.join();
+
+  OpenFOAMDictCache::Statistics s=openFOAMDictCache.statistics();
+  std::cout<<"hits="<<s.hits<<" misses="<<s.misses<<std::endl;
+  if ( (s.hits+s.misses!=400) || (s.misses<1) || (s.misses>4) ) ret=-1;
+
+  OFDictData::dict d;
+  cd["application"]="pimpleFoam";
+  cd.write(cdp);
+  readOpenFOAMDict(cdp, d);
+  std::cout<<"after rewrite: "<<d.getString("application")<<std::endl;
+  if (d.getString("application")!="pimpleFoam") ret=-1;
+
+  cd.compressed=true;
+  cd["application"]="interFoam";
+  cd.write(cdp);
+  readOpenFOAMDict(cdp, d);
+  std::cout<<"compressed: "<<d.getString("application")<<std::endl;
+  if (d.getString("application")!="interFoam") ret=-1;
+
+  // modifying the copy does not affect the cached snapshot
+  d["application"]="modified";
+  if (openFOAMDictCache.get(cdp)->getString("application")!="interFoam") ret=-1;
+
+  boost::filesystem::remove_all(dir);
+
+  return ret;
+}
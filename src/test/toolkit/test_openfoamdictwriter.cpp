@@ -0,0 +1,96 @@
+#include "openfoam/openfoamdict.h"
+#include "openfoam/openfoamfieldreader.h"
+
+#include <iostream>
+#include <cmath>
+
+using namespace insight;
+
+/**
+ * Writes a field file with nonuniform lists in ascii, binary and
+ * compressed binary format and reads it back with the field reader.
+ */
+
+double value(size_t i, int j)
+{
+  return j==0 ? double(i)/3. : j==1 ? -0.1*double(i) : 1e-7*double(i*i);
+}
+
+
+int main(int argc, char*argv[])
+{
+  int ret=0;
+  const size_t n=100000;
+
+  boost::filesystem::path dir=boost::filesystem::unique_path(boost::filesystem::temp_directory_path()/"%%%%-%%%%");
+  boost::filesystem::create_directories(dir);
+
+  arma::mat U(n, 3), p(7, 1), ids(5, 1);
+  for (size_t i=0; i<n; i++)
+    for (int j=0; j<3; j++)
+      U(i,j)=value(i,j);
+  for (size_t i=0; i<p.n_rows; i++)
+    p(i,0)=M_PI*double(i);
+  for (size_t i=0; i<ids.n_rows; i++)
+    ids(i,0)=double(100000*i);
+
+  OFDictData::dictFile df;
+  df.className="volVectorField";
+  df["dimensions"]="[0 1 -1 0 0 0 0]";
+  df.setNonuniformList("internalField", U);
+  df.setNonuniformList("boundaryField/wall/value", p);
+  df.setNonuniformList("boundaryField/wall/ids", ids, "label");
+  df.subDict("boundaryField").subDict("wall")["type"]="calculated";
+  df.subDict("boundaryField").addSubDictIfNonexistent("inlet")["type"]="zeroGradient";
+
+  struct Case { std::string name; OFDictData::dictFile::Format format; bool compressed; };
+  Case cases[]={
+    {"Uascii", OFDictData::dictFile::ASCII, false},
+    {"Ubinary", OFDictData::dictFile::Binary, false},
+    {"Ucompressed", OFDictData::dictFile::Binary, true}
+  };
+
+  for (const Case& c: cases)
+  {
+    df.format=c.format;
+    df.compressed=c.compressed;
+    boost::filesystem::path fn=dir/c.name;
+    df.write(fn);
+
+    OpenFOAMFieldReader r(fn);
+    const arma::mat& U2=r.list("internalField");
+    const arma::mat& p2=r.list("boundaryField/wall/value");
+    const arma::mat& ids2=r.list("boundaryField/wall/ids");
+    double dev=0;
+    for (size_t i=0; i<n; i++)
+      for (int j=0; j<3; j++)
+        dev=std::max(dev, fabs(U2(i,j)-U(i,j)));
+    for (size_t i=0; i<p.n_rows; i++)
+      dev=std::max(dev, fabs(p2(i,0)-p(i,0)));
+    // labels are written as 32 bit integers
+    if (ids2.n_rows!=ids.n_rows) dev=1;
+    else
+      for (size_t i=0; i<ids.n_rows; i++)
+        dev=std::max(dev, fabs(ids2(i,0)-ids(i,0)));
+
+    bool gz=boost::filesystem::exists(fn.string()+".gz");
+    std::cout<<c.name<<": binary="<<r.isBinary()<<" gz="<<gz<<" size="<<U2.n_rows<<"x"<<U2.n_cols
+             <<" deviation="<<dev<<std::endl;
+    if ( (U2.n_rows!=n) || (U2.n_cols!=3) || (p2.n_rows!=p.n_rows) || (dev>0.)
+         || (r.isBinary()!=(c.format==OFDictData::dictFile::Binary))
+         || (gz!=c.compressed) || (boost::filesystem::exists(fn)==c.compressed)
+         || (r.dict().getString("dimensions")!="[0 1 -1 0 0 0 0]")
+         || (r.dict().subDict("boundaryField").subDict("inlet").getString("type")!="zeroGradient") )
+      ret=-1;
+  }
+
+  // switching to uncompressed removes the compressed file
+  df.compressed=false;
+  df.write(dir/"Ucompressed");
+  if (boost::filesystem::exists(dir/"Ucompressed.gz") || !boost::filesystem::exists(dir/"Ucompressed"))
+    ret=-1;
+
+  boost::filesystem::remove_all(dir);
+
+  return ret;
+}
@@ -0,0 +1,89 @@
+#include "openfoam/openfoamanalysis.h"
+#include "openfoam/openfoamfieldreader.h"
+
+#include <iostream>
+#include <cmath>
+
+using namespace insight;
+
+/**
+ * Writes the dictionaries of a case through OpenFOAMAnalysis with the
+ * field format selected by run/fieldFormat and run/compressFields and
+ * reads the field file back.
+ */
+
+class DummyOpenFOAMAnalysis
+: public OpenFOAMAnalysis
+{
+public:
+  DummyOpenFOAMAnalysis(const ParameterSet& ps, const boost::filesystem::path& exepath)
+  : OpenFOAMAnalysis("Dummy", "", ps, exepath)
+  {}
+
+  virtual void createMesh(OpenFOAMCase&) {}
+  virtual void createCase(OpenFOAMCase&) {}
+};
+
+
+int main(int argc, char*argv[])
+{
+  int ret=0;
+
+  boost::filesystem::path dir=boost::filesystem::unique_path(
+    boost::filesystem::temp_directory_path()/"fieldformat-%%%%-%%%%");
+
+  try
+  {
+    struct Case { std::string format; bool compressed; };
+    Case cases[]={ {"ascii", false}, {"binary", false}, {"binary", true} };
+
+    for (const Case& c: cases)
+    {
+      ParameterSet ps=OpenFOAMAnalysis::defaultParameters();
+      ps.get<SelectionParameter>("run/fieldFormat").setSelection(c.format);
+      ps.getBool("run/compressFields")=c.compressed;
+
+      boost::filesystem::path exepath=dir/(c.format+(c.compressed?"_gz":""));
+      DummyOpenFOAMAnalysis a(ps, exepath);
+      OpenFOAMCase cm(OFEnvironment(230, ""));
+
+      std::shared_ptr<OFdicts> dicts(new OFdicts);
+      dicts->addDictionaryIfNonexistent("system/controlDict")["application"]="simpleFoam";
+      OFDictData::dictFile& U=dicts->addDictionaryIfNonexistent("0/U");
+      U.className="volVectorField";
+      U["dimensions"]="[0 1 -1 0 0 0 0]";
+      arma::mat v(1000, 3);
+      for (arma::uword i=0; i<v.n_rows; i++)
+        for (arma::uword j=0; j<3; j++)
+          v(i,j)=double(i)/7.+j;
+      U.setNonuniformList("internalField", v);
+      U.addSubDictIfNonexistent("boundaryField").addSubDictIfNonexistent("wall")["type"]="zeroGradient";
+
+      a.writeDictsToDisk(cm, dicts);
+
+      OpenFOAMFieldReader r(exepath/"0"/"U");
+      const arma::mat& v2=r.list("internalField");
+      double dev=0;
+      if ( (v2.n_rows!=v.n_rows) || (v2.n_cols!=v.n_cols) ) dev=1;
+      else dev=arma::max(arma::max(arma::abs(v2-v)));
+
+      bool gz=boost::filesystem::exists(exepath/"0"/"U.gz");
+      // only field files are affected
+      bool controlDictAscii=boost::filesystem::exists(exepath/"system"/"controlDict");
+
+      std::cout<<c.format<<" compressed="<<c.compressed<<": binary="<<r.isBinary()
+               <<" gz="<<gz<<" deviation="<<dev<<std::endl;
+      if ( (dev>0.) || (r.isBinary()!=(c.format=="binary")) || (gz!=c.compressed) || !controlDictAscii )
+        ret=-1;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cout<<"error: "<<e.what()<<std::endl;
+    ret=-1;
+  }
+
+  boost::filesystem::remove_all(dir);
+
+  return ret;
+}
@@ -0,0 +1,119 @@
+#include "openfoam/openfoamfieldreader.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+
+#include "boost/iostreams/filtering_stream.hpp"
+#include "boost/iostreams/filter/gzip.hpp"
+
+using namespace insight;
+
+/**
+ * Writes a vector field in ascii, binary and compressed binary format
+ * and checks the decoded lists, the small entries and the skipping
+ * of unselected lists.
+ */
+
+std::string header(const std::string& format)
+{
+  return
+    "FoamFile\n{\n version 2.0;\n format "+format+";\n class volVectorField;\n"
+    " arch \"LSB;label=32;scalar=64\";\n object U;\n}\n"
+    "// comment\n"
+    "dimensions [0 1 -1 0 0 0 0];\n";
+}
+
+double value(size_t i, int j)
+{
+  return j==0 ? double(i) : j==1 ? 0.5*double(i) : -1e-3*double(i);
+}
+
+
+int main(int argc, char*argv[])
+{
+  int ret=0;
+  const size_t n=1000;
+
+  boost::filesystem::path dir=boost::filesystem::unique_path(boost::filesystem::temp_directory_path()/"%%%%-%%%%");
+  boost::filesystem::create_directories(dir);
+
+  {
+    std::ofstream f((dir/"Uascii").c_str());
+    f<<header("ascii")<<"internalField nonuniform List<vector> "<<n<<"\n(\n";
+    f.precision(17);
+    for (size_t i=0; i<n; i++)
+      f<<"("<<value(i,0)<<" "<<value(i,1)<<" "<<value(i,2)<<")\n";
+    f<<")\n;\n"
+       "boundaryField\n{\n"
+       " inlet { type fixedValue; value uniform (1 0 0); }\n"
+       " wall { type calculated; value nonuniform List<scalar> 3(1 2 3); }\n"
+       " sym { type calculated; value nonuniform List<vector> 2{(1 2 3)}; }\n"
+       "}\n";
+  }
+
+  std::ostringstream b;
+  b<<header("binary")<<"internalField nonuniform List<vector> "<<n<<"(";
+  for (size_t i=0; i<n; i++)
+  {
+    double v[3]={value(i,0), value(i,1), value(i,2)};
+    b.write(reinterpret_cast<const char*>(v), sizeof(v));
+  }
+  b<<");\nboundaryField\n{\n wall { type calculated; value nonuniform List<scalar> 3(";
+  {
+    double v[3]={1, 2, 3};
+    b.write(reinterpret_cast<const char*>(v), sizeof(v));
+  }
+  b<<"); }\n}\n";
+  {
+    std::ofstream f((dir/"Ubinary").c_str(), std::ios::binary);
+    f<<b.str();
+  }
+  {
+    std::ofstream f((dir/"Ucompressed.gz").c_str(), std::ios::binary);
+    boost::iostreams::filtering_ostream o;
+    o.push(boost::iostreams::gzip_compressor());
+    o.push(f);
+    o<<b.str();
+  }
+
+  for (const std::string fn: {"Uascii", "Ubinary", "Ucompressed"})
+  {
+    OpenFOAMFieldReader r(dir/fn);
+    const arma::mat& U=r.list("internalField");
+    const arma::mat& w=r.list("boundaryField/wall/value");
+    double dev=0;
+    for (size_t i=0; i<n; i++)
+      for (int j=0; j<3; j++)
+        dev=std::max(dev, fabs(U(i,j)-value(i,j)));
+    std::cout<<fn<<": binary="<<r.isBinary()<<" size="<<U.n_rows<<"x"<<U.n_cols
+             <<" deviation="<<dev<<" class="<<r.header().getString("class")<<std::endl;
+    if ( (U.n_rows!=n) || (U.n_cols!=3) || (dev>0.)
+         || (w.n_rows!=3) || (w(2,0)!=3.)
+         || (r.dict().getString("dimensions")!="[0 1 -1 0 0 0 0]")
+         || (r.isBinary()==(fn=="Uascii")) )
+      ret=-1;
+  }
+
+  {
+    OpenFOAMFieldReader r(dir/"Uascii", [](const std::string& p) { return p!="internalField"; });
+    const OFDictData::dict& bf=r.dict().subDict("boundaryField");
+    std::cout<<"skipped: "<<!r.hasList("internalField")
+             <<", inlet value: "<<bf.subDict("inlet").getString("value")<<std::endl;
+    if ( r.hasList("internalField")
+         || (r.list("boundaryField/sym/value").n_rows!=2)
+         || (bf.subDict("inlet").getString("value")!="uniform (1 0 0)") )
+      ret=-1;
+  }
+
+  {
+    OpenFOAMFieldReader r(dir/"Ubinary", [](const std::string& p) { return p!="internalField"; });
+    if ( r.hasList("internalField") || (r.list("boundaryField/wall/value")(1,0)!=2.) )
+      ret=-1;
+  }
+
+  boost::filesystem::remove_all(dir);
+
+  return ret;
+}
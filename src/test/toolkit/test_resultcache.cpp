@@ -0,0 +1,83 @@
+#include "base/analysis.h"
+#include "base/resultcache.h"
+
+#include <iostream>
+#include <cmath>
+
+using namespace insight;
+
+/**
+ * Round trip through the result cache:
+ * results stored for one parameter set are found again for an identical
+ * parameter set, but not for a modified one.
+ */
+
+class DummyAnalysis
+: public Analysis
+{
+public:
+  DummyAnalysis(const ParameterSet& ps)
+  : Analysis("Dummy", "", ps, "")
+  {}
+
+  virtual ResultSetPtr operator()(ProgressDisplayer* =nullptr)
+  {
+    ResultSetPtr r(new ResultSet(parameters(), "Dummy", ""));
+    r->insert("x", ResultElementPtr(new ScalarResult(parameters().getDouble("x"), "x", "", "")));
+    return r;
+  }
+};
+
+
+int main(int argc, char*argv[])
+{
+  boost::filesystem::path store = boost::filesystem::unique_path(
+    boost::filesystem::temp_directory_path()/"resultcache-%%%%-%%%%"
+  );
+
+  int ret=0;
+  try
+  {
+    AnalysisResultCache cache(store);
+
+    std::string pn("x");
+
+    ParameterSet ps;
+    ps.insert(pn, new DoubleParameter(1.5, "x"));
+    DummyAnalysis a1(ps);
+
+    ResultSet r(ps, "", "");
+    if (cache.lookup(a1, ps, r))
+    {
+      std::cerr<<"Unexpected hit in empty cache"<<std::endl;
+      ret=-1;
+    }
+
+    cache.insert(a1, ps, *a1());
+
+    ParameterSet ps2;
+    ps2.insert(pn, new DoubleParameter(1.5, "x"));
+    DummyAnalysis a2(ps2);
+    if (!cache.lookup(a2, ps2, r) || fabs(r.getScalar("x")-1.5)>1e-12)
+    {
+      std::cerr<<"Cached results of identical parameters not found"<<std::endl;
+      ret=-1;
+    }
+
+    ps2.getDouble("x")=2.5;
+    ResultSet r2(ps2, "", "");
+    if (cache.lookup(a2, ps2, r2))
+    {
+      std::cerr<<"Cached results found for modified parameters"<<std::endl;
+      ret=-1;
+    }
+  }
+  catch (insight::Exception e)
+  {
+    std::cerr<<e<<std::endl;
+    ret=-1;
+  }
+
+  boost::filesystem::remove_all(store);
+  return ret;
+}
@@ -0,0 +1,116 @@
+
+#include "base/analysis.h"
+#include "openfoam/openfoamcase.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace insight;
+
+/**
+ * Replay benchmark for the solver output analyzer:
+ * feeds an archived solver log (first argument) or a synthetic log
+ * into the analyzer and reports the parsing rate
+ */
+
+class CountingProgressDisplayer
+: public ProgressDisplayer
+{
+public:
+  size_t nSteps_;
+  ProgressVariableList last_;
+  
+  CountingProgressDisplayer() : nSteps_(0) {}
+  
+  virtual void update ( const ProgressState& pi )
+  {
+    nSteps_++;
+    last_=pi.second;
+  }
+};
+
+void syntheticLog(std::vector<std::string>& lines, int nsteps)
+{
+  for (int i=1; i<=nsteps; i++)
+  {
+    double f=1.0/double(i);
+    std::ostringstream os;
+    os<<"Time = "<<i;
+    lines.push_back(os.str());
+    lines.push_back("");
+    for (const char* fn: {"Ux", "Uy", "Uz", "p", "k", "omega"})
+    {
+      std::ostringstream os;
+      os<<"smoothSolver:  Solving for "<<fn<<", Initial residual = "<<f<<", Final residual = "<<0.01*f<<", No Iterations 3";
+      lines.push_back(os.str());
+    }
+    lines.push_back("time step continuity errors : sum local = 1.0e-06, global = 1.0e-08, cumulative = 1.0e-05");
+    lines.push_back("ExecutionTime = 10.5 s  ClockTime = 11 s");
+    lines.push_back("");
+    lines.push_back("forces forces output:");
+    lines.push_back("    Sum of forces");
+    lines.push_back("        Pressure : (1.5 "+boost::lexical_cast<std::string>(f)+" 0)");
+    lines.push_back("        Viscous  : (0.5 0 0)");
+    lines.push_back("        Porous   : (0 0 0)");
+    lines.push_back("    Sum of moments");
+    lines.push_back("        Pressure : (0 0 2.5)");
+    lines.push_back("        Viscous  : (0 0 0.25)");
+    lines.push_back("        Porous   : (0 0 0)");
+    lines.push_back("");
+  }
+}
+
+int main(int argc, char*argv[])
+{
+  std::vector<std::string> lines;
+  
+  if (argc>1)
+  {
+    std::ifstream f(argv[1]);
+    std::string line;
+    while (std::getline(f, line)) lines.push_back(line);
+  }
+  else
+  {
+    syntheticLog(lines, 20000);
+  }
+  
+  CountingProgressDisplayer cpd;
+  SolverOutputAnalyzer analyzer(cpd);
+  
+  std::ostringstream sink;
+  std::streambuf* orgbuf = std::cout.rdbuf(sink.rdbuf());
+  
+  boost::timer::cpu_timer timer;
+  for (const std::string& line: lines)
+  {
+    analyzer.update(line);
+    if (sink.tellp()>(1<<20)) sink.str("");
+  }
+  timer.stop();
+  
+  std::cout.rdbuf(orgbuf);
+  
+  double t=double(timer.elapsed().user+timer.elapsed().system)*1e-9;
+  std::cout
+    << lines.size() << " lines in " << t << " s ("<<double(lines.size())/std::max(t, 1e-9)<<" lines/s), "
+    << cpd.nSteps_ << " time steps recognized" 
+    << std::endl;
+    
+  for (const ProgressVariableList::value_type& v: cpd.last_)
+  {
+    std::cout<<v.first<<" = "<<v.second<<std::endl;
+  }
+  
+  if (argc<=1)
+  {
+    // check the synthetic log
+    if (cpd.nSteps_ != 19999) return -1;
+    if (cpd.last_.size() != 6+12) return -1;
+    if (fabs(cpd.last_["Ux"]-1.0/19999.)>1e-9) return -1;
+    if (fabs(cpd.last_["forces_fpx"]-1.5)>1e-12) return -1;
+    if (fabs(cpd.last_["forces_mvz"]-0.25)>1e-12) return -1;
+  }
+  
+  return 0;
+}
@@ -0,0 +1,196 @@
+
+#include "base/tabulardatareader.h"
+
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <unistd.h>
+
+using namespace insight;
+
+int checkFastParseDouble()
+{
+  const char* numbers[] = {
+    "0", "-0.0", "1e5", "1.5E-3", "+2.25", "123456789.123456789", 
+    "0.000000000000000000000001234", "123456789012345678901234", 
+    "1.7976931348623157e308", "4.9e-324", "0.1", "2.718281828459045"
+  };
+  int nbad=0;
+  for (const char* s: numbers)
+  {
+    const char* p=s;
+    double v;
+    if ( !fastParseDouble(p, s+strlen(s), v) || (*p!=0) || (v!=strtod(s, NULL)) )
+    {
+      std::cout<<"failed to parse "<<s<<std::endl;
+      nbad++;
+    }
+  }
+  return nbad;
+}
+
+int checkIncrementalRead()
+{
+  boost::filesystem::path fn = boost::filesystem::unique_path("%%%%-%%%%-probes.dat");
+  
+  {
+    std::ofstream f(fn.c_str());
+    f << "# Probe 0 (0 0 0)\n"
+         "# Probe 1 (1 0 0)\n"
+         "#   Time\n"
+         "0.1 (1 2 3) (4 5 6)\n"
+         "0.2 (7 8 9) (10 11 12)\n"
+         "0.3 (1 2";
+  }
+  
+  IncrementalTabularFile itf(fn);
+  
+  int nbad=0;
+  
+  // incomplete last line must be left out
+  if (itf.update()!=2) nbad++;
+  if (itf.reader().nCols()!=7) nbad++;
+  if (itf.reader().bracketGroupSize()!=3) nbad++;
+  
+  {
+    std::ofstream f(fn.c_str(), std::ios::app);
+    f << " 3) (4 5 6)\n"
+         "0.4 (1 2 3)\n";
+  }
+  
+  // completed line is read, line with wrong number of values is skipped
+  if (itf.update()!=1) nbad++;
+  if (itf.reader().nSkippedRows()!=1) nbad++;
+  
+  arma::mat d=itf.data();
+  if ( (d.n_rows!=3) || (d.n_cols!=7) ) nbad++;
+  else
+  {
+    if (d(2,0)!=0.3) nbad++;
+    if (d(1,6)!=12.) nbad++;
+  }
+  
+  boost::filesystem::remove(fn);
+  
+  return nbad;
+}
+
+int checkCSV()
+{
+  boost::filesystem::path fn = boost::filesystem::unique_path("%%%%-%%%%-data.csv");
+  
+  {
+    std::ofstream f(fn.c_str());
+    f << "\"a\",\"b\"\r\n"
+         "1,2\r\n"
+         "3,4.5e-3\r\n";
+  }
+  
+  TabularDataReader r(fn, ",", '#', 1);
+  arma::mat d=r.readAll();
+  
+  boost::filesystem::remove(fn);
+  
+  int nbad=0;
+  if (r.headerLines().size()!=1 || r.headerLines()[0]!="\"a\",\"b\"") nbad++;
+  if ( (d.n_rows!=2) || (d.n_cols!=2) ) nbad++;
+  else if (d(1,1)!=4.5e-3) nbad++;
+  
+  return nbad;
+}
+
+int checkUnterminatedLastLine()
+{
+  boost::filesystem::path fn = boost::filesystem::unique_path("%%%%-%%%%-forces.dat");
+  
+  {
+    std::ofstream f(fn.c_str());
+    f << "1 2 3\n"
+         "4 5 6";
+  }
+  
+  int nbad=0;
+  
+  // a complete read includes the last line
+  TabularDataReader r(fn);
+  arma::mat d=r.readAll();
+  if ( (d.n_rows!=2) || (d.n_cols!=3) ) nbad++;
+  else if (d(1,2)!=6.) nbad++;
+  
+  // an incremental read leaves it out
+  TabularDataReader ri(fn);
+  if (ri.readNewRows().n_rows!=1) nbad++;
+  
+  boost::filesystem::remove(fn);
+  
+  return nbad;
+}
+
+int checkSlowPathAtEndOfFile()
+{
+  boost::filesystem::path fn = boost::filesystem::unique_path("%%%%-%%%%-pagesize.dat");
+  
+  // the number at the end of the file is parsed by strtod.
+  // With a size of exactly one page, any read beyond the end faults
+  std::string last="2 1e-30";
+  {
+    std::ofstream f(fn.c_str());
+    size_t ps=sysconf(_SC_PAGESIZE);
+    f << "#" << std::string(ps-last.size()-2, '-') << "\n" << last;
+  }
+  
+  int nbad=0;
+  if (boost::filesystem::file_size(fn)!=size_t(sysconf(_SC_PAGESIZE))) nbad++;
+  
+  TabularDataReader r(fn);
+  arma::mat d=r.readAll();
+  if ( (d.n_rows!=1) || (d.n_cols!=2) ) nbad++;
+  else if (d(0,1)!=1e-30) nbad++;
+  
+  boost::filesystem::remove(fn);
+  
+  return nbad;
+}
+
+int checkRewrittenLayout()
+{
+  boost::filesystem::path fn = boost::filesystem::unique_path("%%%%-%%%%-probes.dat");
+  
+  {
+    std::ofstream f(fn.c_str());
+    f << "0.1 (1 2 3)\n"
+         "0.2 (4 5 6)\n";
+  }
+  
+  IncrementalTabularFile itf(fn);
+  
+  int nbad=0;
+  if (itf.update()!=2) nbad++;
+  
+  // restart with a different number of columns
+  {
+    std::ofstream f(fn.c_str());
+    f << "0.1 1\n";
+  }
+  
+  if (itf.update()!=1) nbad++;
+  if (!itf.reader().restarted()) nbad++;
+  if (itf.reader().nCols()!=2) nbad++;
+  if (itf.reader().bracketGroupSize()!=1) nbad++;
+  if (itf.reader().nSkippedRows()!=0) nbad++;
+  
+  boost::filesystem::remove(fn);
+  
+  return nbad;
+}
+
+int main(int argc, char*argv[])
+{
+  int nbad = checkFastParseDouble() + checkIncrementalRead() + checkCSV()
+           + checkUnterminatedLastLine() + checkSlowPathAtEndOfFile()
+           + checkRewrittenLayout();
+  
+  std::cout << nbad << " failed checks" << std::endl;
+  
+  return nbad>0 ? -1 : 0;
+}
@@ -0,0 +1,146 @@
+#include "base/taskspoolerclient.h"
+
+#include "boost/process.hpp"
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <map>
+
+using namespace insight;
+
+/**
+ * Runs jobs on a private instance of the bundled task spooler server
+ * (path of the tsp executable as first argument) and checks the client
+ * and the job watcher, also when the server goes away.
+ */
+
+template<class Cond>
+bool waitFor(Cond c, int timeout_ms=10000)
+{
+  for (int t=0; t<timeout_ms; t+=10)
+  {
+    if (c()) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return c();
+}
+
+
+int main(int argc, char*argv[])
+{
+  if (argc<2)
+  {
+    std::cout << "usage: " << argv[0] << " <path to tsp>" << std::endl;
+    return -1;
+  }
+
+  boost::filesystem::path tsp=boost::filesystem::absolute(argv[1]);
+  std::string path=tsp.parent_path().string();
+  if (const char* p=getenv("PATH")) path+=":"+std::string(p);
+  setenv("PATH", path.c_str(), 1);
+
+  boost::filesystem::path socket=boost::filesystem::unique_path(
+        boost::filesystem::temp_directory_path()/"ts-test-%%%%-%%%%");
+  setenv("TS_SOCKET", socket.c_str(), 1);
+
+  int nbad=0;
+  TaskSpoolerClient client(socket);
+
+  if (client.serverRunning())
+  {
+    std::cout << "unexpected server at " << socket << std::endl;
+    nbad++;
+  }
+
+  // tsp starts the server with the first job
+  int id=client.enqueue({"sh", "-c", "exit 3"});
+  int errorlevel=-1;
+  if (!client.wait(id, &errorlevel, 10000) || (errorlevel!=3))
+  {
+    std::cout << "job " << id << " did not finish with errorlevel 3: " << errorlevel << std::endl;
+    nbad++;
+  }
+  if (!client.serverRunning()) nbad++;
+  if (client.state(id)!=TaskSpoolerClient::Finished) nbad++;
+
+  bool listed=false;
+  for (const TaskSpoolerClient::JobInfo& j: client.jobs())
+  {
+    if (j.id==id) listed=(j.state==TaskSpoolerClient::Finished);
+  }
+  if (!listed) nbad++;
+
+  // a finished job must not be signalled
+  if (client.kill(id)) nbad++;
+
+  {
+    // jobs beyond the connection limit are polled
+    std::mutex mtx;
+    std::map<int, int> finished;
+    TaskSpoolerJobWatcher watcher
+    (
+      client,
+      [&](int jobid, int el) { std::lock_guard<std::mutex> l(mtx); finished[jobid]=el; },
+      1, 100
+    );
+
+    std::map<int, int> expected;
+    for (int el=0; el<4; el++)
+    {
+      int jid=client.enqueue({"sh", "-c", "sleep 0.1; exit "+std::to_string(el)});
+      watcher.watch(jid);
+      expected[jid]=el;
+    }
+    if (!waitFor([&]() { std::lock_guard<std::mutex> l(mtx); return finished.size()==expected.size(); })
+        || (finished!=expected) )
+    {
+      std::cout << "watcher did not report all polled jobs correctly" << std::endl;
+      nbad++;
+    }
+    if (watcher.nWatched()!=0) nbad++;
+  }
+
+  {
+    std::atomic<int> finishedId(-1), finishedErrorlevel(-2);
+    TaskSpoolerJobWatcher watcher
+    (
+      client,
+      [&](int jobid, int el) { finishedErrorlevel=el; finishedId=jobid; }
+    );
+
+    int id2=client.enqueue({"sleep", "0.2"});
+    watcher.watch(id2);
+    if (!waitFor([&]() { return finishedId==id2; }) || (finishedErrorlevel!=0))
+    {
+      std::cout << "watcher did not report the end of job " << id2 << std::endl;
+      nbad++;
+    }
+
+    // the server goes away without reporting the end of the job:
+    // the callback is called nevertheless
+    int id3=client.enqueue({"sleep", "1"});
+    watcher.watch(id3);
+    boost::process::system(tsp, "-K");
+    if (!waitFor([&]() { return finishedId==id3; }) || (finishedErrorlevel!=-1))
+    {
+      std::cout << "watcher did not report the lost job " << id3 << std::endl;
+      nbad++;
+    }
+    if (watcher.nWatched()!=0) nbad++;
+  }
+
+  if (!waitFor([&]() { return !client.serverRunning(); }))
+  {
+    std::cout << "server still running after kill" << std::endl;
+    nbad++;
+  }
+
+  boost::filesystem::remove(socket);
+
+  std::cout << nbad << " failed checks" << std::endl;
+
+  return nbad>0 ? -1 : 0;
+}
@@ -24,10 +24,17 @@
 
 #include <fstream>
 #include <cstdlib>
+#include <cmath>
+#include <limits>
 #include <dlfcn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
 
 #include "base/boost_include.h"
 #include "boost/function.hpp"
+#include "boost/bind.hpp"
 
 using namespace std;
 using namespace boost;
@@ -110,12 +117,18 @@ void TextProgressDisplayer::update ( const ProgressState& pi )
 
 
 
-ConvergenceAnalysisDisplayer::ConvergenceAnalysisDisplayer ( const std::string& progvar, double threshold )
+ConvergenceAnalysisDisplayer::ConvergenceAnalysisDisplayer ( const std::string& progvar, double threshold, size_t maxAveragingWindow )
     : progvar_ ( progvar ),
+      threshold_ ( threshold ),
+      converged_ ( false ),
+      nSamples_ ( 0 ),
       istart_ ( 10 ),
       co_ ( 15 ),
-      threshold_ ( threshold ),
-      converged_ ( false )
+      maxAveragingWindow_ ( maxAveragingWindow ),
+      prefixSums_ ( 1, 0.0 ),
+      prefixStart_ ( 0 ),
+      ym_ ( co_+1 ),
+      nym_ ( 0 )
 {}
 
 void ConvergenceAnalysisDisplayer::update ( const ProgressState& pi )
@@ -123,38 +136,61 @@ void ConvergenceAnalysisDisplayer::update ( const ProgressState& pi )
     decltype ( pi.second ) ::const_iterator pv=pi.second.find ( progvar_ );
 
     if ( pv != pi.second.end() ) {
-//     std::cout << progvar_ << "=" << pv->second <<std::endl;
-        trackedValues_.push_back ( pv->second );
+        nSamples_++;
+        if ( checkConvergence ( pv->second ) ) {
+            converged_=true;
+        }
     }
+}
 
-    if ( trackedValues_.size() > istart_ ) {
-        std::vector<double> ym;
-        for ( size_t i=istart_; i<trackedValues_.size(); i++ ) {
-            size_t i0=i/2;
-            double sum=0.0;
-            for ( size_t j=i0; j<i; j++ ) {
-                sum+=trackedValues_[j];
-            }
-            ym.push_back ( sum/double ( i-i0 ) );
+bool ConvergenceAnalysisDisplayer::checkConvergence ( double y )
+{
+    // prefixSums_ holds S[prefixStart_] ... S[nSamples_]
+    prefixSums_.push_back ( prefixSums_.back() + y );
+
+    if ( nSamples_ > istart_ ) {
+        // mean over the second half of the history, excluding the latest sample
+        size_t i=nSamples_-1;
+        size_t i0=i/2;
+        if ( ( maxAveragingWindow_>0 ) && ( i-i0 > maxAveragingWindow_ ) ) {
+            i0=i-maxAveragingWindow_;
         }
 
-        if ( ym.size() >co_ ) {
-            double maxrely=0.0;
-            for ( size_t j=ym.size()-1; j>=ym.size()-co_; j-- ) {
-                double rely=fabs ( ym[j]-ym[j-1] ) / ( fabs ( ym[j] )+1e-10 );
-                maxrely=std::max ( rely, maxrely );
-            }
+        ym_.push_back
+        (
+            ( prefixSums_[i-prefixStart_] - prefixSums_[i0-prefixStart_] ) / double ( i-i0 )
+        );
+        nym_++;
 
-            std::cout<<"max rel. change of "<<progvar_<<" = "<<maxrely;
+        // drop prefix sums, which are not needed by any later update
+        size_t i0next=nSamples_/2;
+        if ( ( maxAveragingWindow_>0 ) && ( nSamples_-i0next > maxAveragingWindow_ ) ) {
+            i0next=nSamples_-maxAveragingWindow_;
+        }
+        while ( prefixStart_ < i0next ) {
+            prefixSums_.pop_front();
+            prefixStart_++;
+        }
+    }
 
-            if ( maxrely<threshold_ ) {
-                std::cout<<" >>> CONVERGED"<<std::endl;
-                converged_=true;
-            } else {
-                std::cout<<", not converged"<<std::endl;
-            }
+    if ( nym_ > co_ ) {
+        double maxrely=0.0;
+        for ( size_t j=1; j<ym_.size(); j++ ) {
+            double rely=fabs ( ym_[j]-ym_[j-1] ) / ( fabs ( ym_[j] )+1e-10 );
+            maxrely=std::max ( rely, maxrely );
+        }
+
+        std::cout<<"max rel. change of "<<progvar_<<" = "<<maxrely;
+
+        if ( maxrely<threshold_ ) {
+            std::cout<<" >>> CONVERGED"<<std::endl;
+            return true;
+        } else {
+            std::cout<<", not converged"<<std::endl;
         }
     }
+
+    return false;
 }
 
 bool ConvergenceAnalysisDisplayer::stopRun() const
@@ -162,10 +198,141 @@ bool ConvergenceAnalysisDisplayer::stopRun() const
     return converged_;
 }
 
-  
-  
-  
-  
+
+
+
+RunningWindowStatistics::RunningWindowStatistics ( size_t length )
+    : values_ ( std::max<size_t> ( 2, length ) ),
+      shift_ ( 0.0 ),
+      sum_ ( 0.0 ),
+      sumsq_ ( 0.0 ),
+      nUpdates_ ( 0 )
+{}
+
+void RunningWindowStatistics::recompute()
+{
+    // shift the stored values to their current mean for accuracy
+    // and get rid of the accumulated round-off
+    double m=sum_/double ( values_.size() );
+    shift_+=m;
+    sum_=0.0;
+    sumsq_=0.0;
+    for ( double& v: values_ ) {
+        v-=m;
+        sum_+=v;
+        sumsq_+=v*v;
+    }
+}
+
+double RunningWindowStatistics::push ( double y )
+{
+    if ( nUpdates_==0 ) {
+        shift_=y;
+    }
+
+    double dropped=std::numeric_limits<double>::quiet_NaN();
+    if ( values_.full() ) {
+        double d0=values_.front();
+        sum_-=d0;
+        sumsq_-=d0*d0;
+        dropped=d0+shift_;
+    }
+
+    double d=y-shift_;
+    values_.push_back ( d );
+    sum_+=d;
+    sumsq_+=d*d;
+
+    if ( ( ++nUpdates_ % values_.capacity() ) == 0 ) {
+        recompute();
+    }
+
+    return dropped;
+}
+
+double RunningWindowStatistics::mean() const
+{
+    if ( values_.empty() ) {
+        return 0.0;
+    }
+    return shift_ + sum_/double ( values_.size() );
+}
+
+double RunningWindowStatistics::variance() const
+{
+    double n=values_.size();
+    if ( n<2 ) {
+        return 0.0;
+    }
+    return std::max ( 0.0, ( sumsq_ - sum_*sum_/n ) / ( n-1.0 ) );
+}
+
+
+
+
+WindowedVarianceConvergenceDisplayer::WindowedVarianceConvergenceDisplayer ( const std::string& progvar, double threshold, size_t window )
+    : ConvergenceAnalysisDisplayer ( progvar, threshold ),
+      window_ ( window )
+{}
+
+bool WindowedVarianceConvergenceDisplayer::checkConvergence ( double y )
+{
+    window_.push ( y );
+
+    if ( window_.full() ) {
+        double relsd=sqrt ( window_.variance() ) / ( fabs ( window_.mean() )+1e-10 );
+
+        std::cout<<"rel. std. dev. of "<<progvar_<<" over last "<<window_.size()<<" samples = "<<relsd;
+
+        if ( relsd<threshold_ ) {
+            std::cout<<" >>> CONVERGED"<<std::endl;
+            return true;
+        } else {
+            std::cout<<", not converged"<<std::endl;
+        }
+    }
+
+    return false;
+}
+
+
+
+
+StationarityConvergenceDisplayer::StationarityConvergenceDisplayer ( const std::string& progvar, double zThreshold, size_t window )
+    : ConvergenceAnalysisDisplayer ( progvar, zThreshold ),
+      window1_ ( window ),
+      window2_ ( window )
+{}
+
+bool StationarityConvergenceDisplayer::checkConvergence ( double y )
+{
+    // samples leaving the recent window enter the preceding one
+    double yd=window2_.push ( y );
+    if ( !std::isnan ( yd ) ) {
+        window1_.push ( yd );
+    }
+
+    if ( window1_.full() ) {
+        double m1=window1_.mean(), m2=window2_.mean();
+        double se=sqrt ( ( window1_.variance()+window2_.variance() ) / double ( window1_.size() ) );
+        double z=fabs ( m2-m1 ) / ( se + 1e-10* ( fabs ( m1 )+fabs ( m2 ) ) + 1e-300 );
+
+        std::cout<<"stationarity z-score of "<<progvar_<<" = "<<z;
+
+        if ( z<threshold_ ) {
+            std::cout<<" >>> CONVERGED"<<std::endl;
+            return true;
+        } else {
+            std::cout<<", not converged"<<std::endl;
+        }
+    }
+
+    return false;
+}
+
+
+
+
 defineType ( Analysis );
 
 defineFactoryTable 
@@ -282,6 +449,30 @@ void Analysis::cancel()
 {
 }
 
+int Analysis::requiredCores() const
+{
+    int np=1;
+    try
+    {
+        np=parameters_.get<IntParameter>("run/np")();
+    }
+    catch ( insight::Exception e )
+    {
+        // no parallel run parameter: serial analysis
+    }
+    return std::max(1, np);
+}
+
+double Analysis::requiredMemory() const
+{
+    return 0.0;
+}
+
+double Analysis::expectedCost() const
+{
+    return requiredCores();
+}
+
 boost::filesystem::path Analysis::getSharedFilePath ( const boost::filesystem::path& file )
 {
     return sharedSearchPath_.getSharedFilePath ( file );
@@ -348,7 +539,7 @@ void SynchronisedAnalysisQueue::enqueue ( const AnalysisInstance& data )
     // Acquire lock on the queue
     boost::unique_lock<boost::mutex> lock ( m_mutex );
     // Add the data to the queue
-    m_queue.push ( data );
+    m_queue.push_back ( data );
     // Notify others that data is ready
     m_cond.notify_one();
 } // Lock is automatically released here
@@ -370,16 +561,339 @@ AnalysisInstance SynchronisedAnalysisQueue::dequeue()
     // Retrieve the data from the queue
     AnalysisInstance result=m_queue.front();
     processed_.push_back ( result );
-    m_queue.pop();
+    m_queue.pop_front();
     return result;
 } // Lock is automatically released here
 
 
+bool SynchronisedAnalysisQueue::dequeueFirst
+(
+    AnalysisInstance& result,
+    const boost::function<bool(const AnalysisInstance&)>& fits
+)
+{
+    boost::unique_lock<boost::mutex> lock ( m_mutex );
+
+    for ( std::deque<AnalysisInstance>::iterator i=m_queue.begin(); i!=m_queue.end(); ++i )
+    {
+        if ( fits(*i) )
+        {
+            result=*i;
+            processed_.push_back ( result );
+            m_queue.erase(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+struct ai_expectedcost_pred
+{
+    bool operator() ( const std::pair<double, AnalysisInstance>& ai1, const std::pair<double, AnalysisInstance>& ai2 ) const
+    {
+        return ai1.first > ai2.first;
+    }
+};
+
+void SynchronisedAnalysisQueue::sortByExpectedCost()
+{
+    boost::unique_lock<boost::mutex> lock ( m_mutex );
+
+    // evaluate the estimate only once per instance
+    std::vector<std::pair<double, AnalysisInstance> > sorted;
+    for ( const AnalysisInstance& ai: m_queue )
+    {
+        sorted.push_back ( std::make_pair ( boost::get<1> ( ai )->expectedCost(), ai ) );
+    }
+    std::stable_sort ( sorted.begin(), sorted.end(), ai_expectedcost_pred() );
+
+    m_queue.clear();
+    for ( const std::pair<double, AnalysisInstance>& sai: sorted )
+    {
+        m_queue.push_back ( sai.second );
+    }
+}
+
+
+void SynchronisedAnalysisQueue::addProcessed ( const AnalysisInstance& data )
+{
+    boost::unique_lock<boost::mutex> lock ( m_mutex );
+    processed_.push_back ( data );
+}
+
+
 void SynchronisedAnalysisQueue::cancelAll()
 {
-    while ( !isEmpty() ) {
-        boost::get<1> ( dequeue() )->cancel();
+    std::vector<AnalysisInstance> cancelled;
+    {
+        boost::unique_lock<boost::mutex> lock ( m_mutex );
+        cancelled.assign ( m_queue.begin(), m_queue.end() );
+        processed_.insert ( processed_.end(), m_queue.begin(), m_queue.end() );
+        m_queue.clear();
+    }
+    for ( const AnalysisInstance& ai: cancelled )
+    {
+        boost::get<1> ( ai )->cancel();
+    }
+}
+
+
+
+
+ResourceAwareAnalysisScheduler::ResourceAwareAnalysisScheduler
+(
+    SynchronisedAnalysisQueue* queue,
+    ProgressDisplayer* displayer,
+    int nCores,
+    double memory,
+    int maxInstances,
+    bool pinCPUs
+)
+: queue_ ( queue ),
+  displayer_ ( displayer ),
+  cpus_ ( availableCPUs() ),
+  memory_ ( memory ),
+  maxInstances_ ( maxInstances ),
+  pinCPUs_ ( pinCPUs ),
+  nRunning_ ( 0 ),
+  cancelled_ ( false )
+{
+    if ( nCores>0 && nCores<int(cpus_.size()) )
+    {
+        cpus_.resize ( nCores );
+    }
+    else if ( nCores>int(cpus_.size()) )
+    {
+        // more cores requested than available: no pinning possible
+        // for the excess cores, but the capacity is honoured
+        if ( pinCPUs_ )
+        {
+            insight::Warning
+            (
+                str( format("%d cores requested, but only %d CPUs available. CPU pinning disabled.")
+                     % nCores % cpus_.size() )
+            );
+            pinCPUs_=false;
+        }
+        for ( int i=int(cpus_.size()); i<nCores; i++ )
+        {
+            cpus_.push_back ( -1 );
+        }
+    }
+
+    if ( memory_==0 )
+    {
+        memory_=hostMemory();
+    }
+
+    cpuInUse_.resize ( cpus_.size(), false );
+    freeCores_=int(cpus_.size());
+    freeMemory_=memory_;
+}
+
+
+std::vector<int> ResourceAwareAnalysisScheduler::availableCPUs()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO ( &set );
+    if ( sched_getaffinity ( 0, sizeof ( set ), &set ) ==0 )
+    {
+        for ( int i=0; i<CPU_SETSIZE; i++ )
+        {
+            if ( CPU_ISSET ( i, &set ) )
+            {
+                cpus.push_back ( i );
+            }
+        }
+    }
+#endif
+    if ( cpus.size() ==0 )
+    {
+        int n=std::max ( 1u, boost::thread::hardware_concurrency() );
+        for ( int i=0; i<n; i++ )
+        {
+            cpus.push_back ( i );
+        }
+    }
+    return cpus;
+}
+
+
+double ResourceAwareAnalysisScheduler::hostMemory()
+{
+    long pages=sysconf ( _SC_PHYS_PAGES );
+    long pagesize=sysconf ( _SC_PAGE_SIZE );
+    if ( pages>0 && pagesize>0 )
+    {
+        return double ( pages ) *double ( pagesize ) /1024./1024.;
+    }
+    return -1; // unknown: do not limit
+}
+
+
+bool ResourceAwareAnalysisScheduler::fits ( const AnalysisInstance& ai ) const
+{
+    const Analysis& a=*boost::get<1> ( ai );
+    int nc=std::min ( a.requiredCores(), nCores() );
+    if ( nc>freeCores_ ) return false;
+    if ( memory_>0 )
+    {
+        double mem=std::min ( a.requiredMemory(), memory_ );
+        if ( mem>freeMemory_ ) return false;
+    }
+    return true;
+}
+
+
+std::vector<int> ResourceAwareAnalysisScheduler::allocateCPUs ( int n )
+{
+    std::vector<int> cpus;
+    for ( size_t i=0; i<cpuInUse_.size() && int(cpus.size())<n; i++ )
+    {
+        if ( !cpuInUse_[i] )
+        {
+            cpuInUse_[i]=true;
+            cpus.push_back ( int(i) );
+        }
+    }
+    freeCores_-=int(cpus.size());
+    return cpus;
+}
+
+
+void ResourceAwareAnalysisScheduler::runInstance ( AnalysisInstance ai, std::vector<int> cpus, double memory )
+{
+#ifdef __linux__
+    if ( pinCPUs_ )
+    {
+        cpu_set_t set;
+        CPU_ZERO ( &set );
+        for ( int i: cpus )
+        {
+            CPU_SET ( cpus_[i], &set );
+        }
+        int err=pthread_setaffinity_np ( pthread_self(), sizeof ( set ), &set );
+        if ( err!=0 )
+        {
+            insight::Warning ( "Could not pin analysis "+boost::get<0> ( ai )+" to its CPUs: "+strerror ( err ) );
+        }
+    }
+#endif
+
+    try
+    {
+        // run analysis and transfer results into given ResultSet object
+        CollectingProgressDisplayer pd ( boost::get<0> ( ai ), displayer_ );
+        boost::get<2> ( ai )->transfer ( * ( *boost::get<1> ( ai ) ) ( &pd ) );
+
+        bool cancelled;
+        {
+            boost::unique_lock<boost::mutex> lock ( mutex_ );
+            cancelled=cancelled_;
+        }
+        if ( completionHandler_ && !cancelled )
+        {
+            completionHandler_ ( ai );
+        }
+    }
+    catch ( insight::Exception e )
+    {
+        std::cerr<<"Exception occurred:"<<std::endl<<e<<std::endl;
+    }
+    catch ( boost::thread_interrupted )
+    {
+        // cancelled: just release the resources
+    }
+
+    boost::unique_lock<boost::mutex> lock ( mutex_ );
+    for ( int i: cpus )
+    {
+        cpuInUse_[i]=false;
+    }
+    freeCores_+=int(cpus.size());
+    freeMemory_+=memory;
+    nRunning_--;
+    cond_.notify_all();
+}
+
+
+void ResourceAwareAnalysisScheduler::run ( boost::thread_group& workers )
+{
+    queue_->sortByExpectedCost();
+
+    {
+        boost::unique_lock<boost::mutex> lock ( mutex_ );
+
+        while ( !cancelled_ && !queue_->isEmpty() )
+        {
+            AnalysisInstance ai;
+            bool start=false;
+
+            if ( maxInstances_<=0 || nRunning_<maxInstances_ )
+            {
+                start=queue_->dequeueFirst
+                      (
+                          ai,
+                          boost::bind ( &ResourceAwareAnalysisScheduler::fits, this, _1 )
+                      );
+
+                if ( !start && nRunning_==0 )
+                {
+                    // nothing fits into the idle machine: the demand of the
+                    // next instance exceeds the capacity. Run it alone.
+                    start=queue_->dequeueFirst
+                          (
+                              ai,
+                              [] ( const AnalysisInstance& ) { return true; }
+                          );
+                    if ( start )
+                    {
+                        insight::Warning
+                        (
+                            "The resource demand of analysis "+boost::get<0> ( ai )
+                            +" exceeds the capacity of the scheduler. Running it exclusively."
+                        );
+                    }
+                }
+            }
+
+            if ( start )
+            {
+                const Analysis& a=*boost::get<1> ( ai );
+                std::vector<int> cpus=allocateCPUs ( std::min ( a.requiredCores(), nCores() ) );
+                double mem=0;
+                if ( memory_>0 )
+                {
+                    mem=std::min ( a.requiredMemory(), freeMemory_ );
+                    freeMemory_-=mem;
+                }
+                nRunning_++;
+                workers.create_thread
+                (
+                    boost::bind ( &ResourceAwareAnalysisScheduler::runInstance, this, ai, cpus, mem )
+                );
+            }
+            else
+            {
+                // wait for a running instance to finish
+                cond_.wait ( lock );
+            }
+        }
     }
+
+    //wait for computation to finish
+    workers.join_all();
+}
+
+
+void ResourceAwareAnalysisScheduler::cancel()
+{
+    boost::unique_lock<boost::mutex> lock ( mutex_ );
+    cancelled_=true;
+    cond_.notify_all();
 }
 
     
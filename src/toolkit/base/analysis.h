@@ -29,9 +29,11 @@
 #include "base/tools.h"
 
 #include <queue>
+#include <deque>
 
 #include "base/boost_include.h"
 #include "boost/thread.hpp"
+#include "boost/circular_buffer.hpp"
 
 namespace insight
 {
@@ -92,23 +94,139 @@ public:
 
 
 
+/**
+ * Monitors a single progress variable and requests a stop of the run,
+ * once the variable is considered converged.
+ *
+ * The base implementation checks the relative change of the running mean
+ * over the second half of the history. All samples are processed
+ * incrementally, i.e. each update costs O(1) and the memory is bounded
+ * by maxAveragingWindow. Derived classes implement alternative criteria
+ * by overriding checkConvergence().
+ */
 class ConvergenceAnalysisDisplayer
   : public ProgressDisplayer
 {
+protected:
   std::string progvar_;
-  std::vector<double> trackedValues_;
-
-  int istart_, co_;
   double threshold_;
 
   bool converged_;
+  size_t nSamples_;
+
+  /**
+   * process the next sample of the tracked variable
+   * @return true, if the criterion is fulfilled
+   */
+  virtual bool checkConvergence ( double y );
+
+private:
+  size_t istart_, co_, maxAveragingWindow_;
+
+  /**
+   * prefix sums S[i]=sum_{j<i} y_j for i=prefixStart_ ... nSamples_
+   */
+  std::deque<double> prefixSums_;
+  size_t prefixStart_;
+
+  /**
+   * the last co_+1 running mean values
+   */
+  boost::circular_buffer<double> ym_;
+  size_t nym_;
 
 public:
-  ConvergenceAnalysisDisplayer ( const std::string &progvar, double threshold = 1e-5 );
+  /**
+   * @param progvar name of the tracked progress variable
+   * @param threshold max. relative change of the running mean
+   * @param maxAveragingWindow max. number of samples, over which the running mean is computed (0: unbounded)
+   */
+  ConvergenceAnalysisDisplayer ( const std::string &progvar, double threshold = 1e-5, size_t maxAveragingWindow = 50000 );
 
   virtual void update ( const ProgressState &pi );
 
   virtual bool stopRun() const;
+
+  inline const std::string& progressVariable() const
+  {
+      return progvar_;
+  }
+};
+
+
+
+
+/**
+ * Sliding window of fixed length with incrementally updated
+ * mean and variance.
+ */
+class RunningWindowStatistics
+{
+  boost::circular_buffer<double> values_;
+  double shift_, sum_, sumsq_;
+  size_t nUpdates_;
+
+  void recompute();
+
+public:
+  RunningWindowStatistics ( size_t length );
+
+  /**
+   * append value, returns the value which dropped out of the window
+   * or NaN, if the window was not yet filled
+   */
+  double push ( double y );
+
+  inline bool full() const
+  {
+      return values_.full();
+  }
+  inline size_t size() const
+  {
+      return values_.size();
+  }
+
+  double mean() const;
+  double variance() const;
+};
+
+
+
+
+/**
+ * Considers the variable converged, when the standard deviation over
+ * the last window samples relative to their mean falls below the threshold
+ */
+class WindowedVarianceConvergenceDisplayer
+  : public ConvergenceAnalysisDisplayer
+{
+  RunningWindowStatistics window_;
+
+protected:
+  virtual bool checkConvergence ( double y );
+
+public:
+  WindowedVarianceConvergenceDisplayer ( const std::string &progvar, double threshold = 1e-3, size_t window = 500 );
+};
+
+
+
+
+/**
+ * Stationarity test: compares the means of two consecutive windows
+ * of equal length (Geweke-type z-score). The variable is considered
+ * converged, when the score drops below the threshold.
+ */
+class StationarityConvergenceDisplayer
+  : public ConvergenceAnalysisDisplayer
+{
+  RunningWindowStatistics window1_, window2_;
+
+protected:
+  virtual bool checkConvergence ( double y );
+
+public:
+  StationarityConvergenceDisplayer ( const std::string &progvar, double zThreshold = 1.96, size_t window = 1000 );
 };
 
 
@@ -235,6 +353,25 @@ public:
     virtual ResultSetPtr operator() ( ProgressDisplayer* displayer=nullptr ) =0;
     virtual void cancel();
 
+    /**
+     * Number of CPU cores, which are occupied while this analysis is running.
+     * Used by schedulers, which execute several analyses concurrently.
+     * Defaults to the parameter "run/np", if present, and 1 otherwise.
+     */
+    virtual int requiredCores() const;
+
+    /**
+     * Expected peak memory demand in MB. 0 means unknown.
+     */
+    virtual double requiredMemory() const;
+
+    /**
+     * Relative estimate of the execution time. Only the ratios between
+     * different instances matter. Expensive instances are started first.
+     * Defaults to requiredCores().
+     */
+    virtual double expectedCost() const;
+
     virtual boost::filesystem::path getSharedFilePath ( const boost::filesystem::path& file );
 
     virtual Analysis* clone() const;
@@ -255,7 +392,7 @@ class SynchronisedAnalysisQueue
 {
 
 private:
-    std::queue<AnalysisInstance> m_queue; // Use STL queue to store data
+    std::deque<AnalysisInstance> m_queue; // Use STL deque to store data
     boost::mutex m_mutex; // The mutex to synchronise on
     boost::condition_variable m_cond; // The condition to wait for
     AnalysisInstanceList processed_;
@@ -265,6 +402,12 @@ public:
     void enqueue ( const AnalysisInstance& data );
     // Get data from the queue. Wait for data if not available
     AnalysisInstance dequeue();
+    // Remove the first instance, for which fits returns true. Does not wait.
+    bool dequeueFirst ( AnalysisInstance& result, const boost::function<bool(const AnalysisInstance&)>& fits );
+    // Reorder the waiting instances by decreasing expected cost
+    void sortByExpectedCost();
+    // Record an instance as processed without running it (e.g. results taken from a cache)
+    void addProcessed ( const AnalysisInstance& data );
     inline size_t n_instances() const
     {
         return m_queue.size();
@@ -272,7 +415,7 @@ public:
 
     inline void clear()
     {
-        m_queue=std::queue<AnalysisInstance>();
+        m_queue.clear();
         processed_.clear();
     }
     inline bool isEmpty()
@@ -326,6 +469,94 @@ public:
 
 
 
+/**
+ * Executes the instances of a SynchronisedAnalysisQueue concurrently, such
+ * that the cores and memory declared by the running instances
+ * (Analysis::requiredCores, Analysis::requiredMemory) do not exceed the
+ * capacity of the host. Instances are started in the order of decreasing
+ * Analysis::expectedCost, the first waiting instance that fits into the
+ * free resources is taken. Optionally, each instance is pinned to its own
+ * disjoint set of CPUs. The affinity is inherited by all processes, which
+ * the analysis spawns.
+ */
+class ResourceAwareAnalysisScheduler
+    : boost::noncopyable
+{
+protected:
+    SynchronisedAnalysisQueue* queue_;
+    ProgressDisplayer* displayer_;
+
+    std::vector<int> cpus_;
+    double memory_;
+    int maxInstances_;
+    bool pinCPUs_;
+    boost::function<void(const AnalysisInstance&)> completionHandler_;
+
+    boost::mutex mutex_;
+    boost::condition_variable cond_;
+    std::vector<bool> cpuInUse_;
+    int freeCores_;
+    double freeMemory_;
+    int nRunning_;
+    bool cancelled_;
+
+    bool fits ( const AnalysisInstance& ai ) const;
+    std::vector<int> allocateCPUs ( int n );
+    void runInstance ( AnalysisInstance ai, std::vector<int> cpus, double memory );
+
+public:
+    /**
+     * @param nCores Number of cores to use, <=0 means all cores available to this process
+     * @param memory Memory in MB to use, 0 means physical memory of host, <0 means no memory limit
+     * @param maxInstances Maximum number of concurrently running instances, <=0 means unlimited
+     */
+    ResourceAwareAnalysisScheduler
+    (
+        SynchronisedAnalysisQueue* queue,
+        ProgressDisplayer* displayer=nullptr,
+        int nCores=0,
+        double memory=0,
+        int maxInstances=0,
+        bool pinCPUs=false
+    );
+
+    /**
+     * list of CPU ids, on which this process is allowed to run
+     */
+    static std::vector<int> availableCPUs();
+
+    /**
+     * physical memory of the host in MB
+     */
+    static double hostMemory();
+
+    inline int nCores() const { return int(cpus_.size()); }
+
+    /**
+     * Set a function, which is called from the worker thread after an instance
+     * has completed successfully. Not called for instances, which finished
+     * after the scheduler was cancelled.
+     */
+    inline void setCompletionHandler ( const boost::function<void(const AnalysisInstance&)>& h )
+    {
+        completionHandler_=h;
+    }
+
+    /**
+     * Start all queued instances as threads in the given group and
+     * wait until they have finished.
+     */
+    void run ( boost::thread_group& workers );
+
+    /**
+     * Stop starting new instances. Running instances are not affected.
+     */
+    void cancel();
+};
+
+
+
+
 class AnalysisLibraryLoader
 {
 protected:
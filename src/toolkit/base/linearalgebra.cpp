@@ -25,6 +25,8 @@
 #include "boost/lexical_cast.hpp"
 #include "boost/tuple/tuple.hpp"
 #include "boost/format.hpp"
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
 #include "base/exception.h"
 
 // #include "minpack.h"
@@ -600,12 +602,62 @@ arma::mat nonlinearMinimizeND(const ObjectiveND& model, const arma::mat& x0, dou
     return arma::zeros(x0.n_elem)+DBL_MAX;
 }
 
-arma::mat movingAverage(const arma::mat& timeProfs, double fraction, bool first_col_is_time, bool centerwindow)
+namespace
+{
+
+inline double trapezoid(const double* t, const double* y, arma::uword k)
+{
+  return 0.5*(y[k]+y[k-1])*(t[k]-t[k-1]);
+}
+
+/**
+ * averages the columns c0..c1-1 over the row ranges [a[i], b[i])
+ * The ranges with more than one row are non-decreasing in i. The integral is kept as a running
+ * sum: each segment between two rows is added and removed only once.
+ */
+void movingAverageColumns
+(
+  const arma::mat& timeProfs,
+  const std::vector<arma::uword>& a,
+  const std::vector<arma::uword>& b,
+  arma::mat& result,
+  arma::uword c0, arma::uword c1
+)
+{
+  const double* t=timeProfs.colptr(0);
+
+  for (arma::uword j=c0; j<c1; j++)
+  {
+    const double* y=timeProfs.colptr(j);
+
+    long double I=0.0; // sum of trapezoids over the segments sl+1..sh
+    arma::uword sl=0, sh=0;
+
+    for (size_t i=0; i<a.size(); i++)
+    {
+      if (b[i]-a[i]==1)
+      {
+        result(i,j)=y[a[i]];
+      }
+      else
+      {
+        if (sh<a[i]) { sl=sh=a[i]; I=0.0; }
+        while (sh<b[i]-1) { sh++; I+=trapezoid(t, y, sh); }
+        while (sl<a[i]) { sl++; I-=trapezoid(t, y, sl); }
+        result(i,j) = double(I)/(t[b[i]-1]-t[a[i]]);
+      }
+    }
+  }
+}
+
+}
+
+
+arma::mat movingAverage(const arma::mat& timeProfs, double fraction, bool first_col_is_time, bool centerwindow, int nThreads)
 {
   std::ostringstream msg;
   msg<<"Computing moving average for "
-       "t="<<valueList_to_string(timeProfs.col(0))<<" and "
-       "y="<<valueList_to_string(timeProfs.cols(1,timeProfs.n_cols-1))<<
+     <<timeProfs.n_rows<<" rows and "<<timeProfs.n_cols<<" columns"
        " with fraction="<<fraction<<", first_col_is_time="<<first_col_is_time<<" and centerwindow="<<centerwindow;
   CurrentExceptionContext ce(msg.str());
 
@@ -618,10 +670,26 @@ arma::mat movingAverage(const arma::mat& timeProfs, double fraction, bool first_
 
   if (timeProfs.n_rows>1)
   {
+    // the sweep requires ascending time
+    bool sorted=true;
+    for (arma::uword k=1; k<timeProfs.n_rows; k++)
+    {
+      if (timeProfs(k,0)<timeProfs(k-1,0)) { sorted=false; break; }
+    }
+    if (!sorted)
+    {
+      return movingAverage
+      (
+        timeProfs.rows(arma::stable_sort_index(timeProfs.col(0))), 
+        fraction, first_col_is_time, centerwindow, nThreads
+      );
+    }
+
     arma::uword n_raw=timeProfs.n_rows;
+    const double* t=timeProfs.colptr(0);
 
-    double x0=arma::min(timeProfs.col(0));
-    double dx_raw=arma::max(timeProfs.col(0))-x0;
+    double x0=t[0];
+    double dx_raw=t[n_raw-1]-x0;
 
 //    std::cout<<"mvg avg: range ["<<x0<<":"<<timeProfs.col(0).max()<<"]"<<std::endl;
 
@@ -639,59 +707,59 @@ arma::mat movingAverage(const arma::mat& timeProfs, double fraction, bool first_
     }
 
     arma::mat result=zeros(n_avg, timeProfs.n_cols);
-    
+
+    // row ranges of all windows in a single sweep
+    std::vector<arma::uword> a(n_avg), b(n_avg);
+    arma::uword ia=0, ib=0;
     for (arma::uword i=0; i<n_avg; i++)
     {
         double x = x0 + window_ofs + double(i)*avgdx;
-
         double from = x - window_ofs, to = from + window;
+        result(i,0)=x;
 
 //        std::cout<<"avg from "<<from<<" to "<<to<<std::endl;
 
-        arma::uword j0=0;
-        if (first_col_is_time)
-        {
-            j0=1;
-            result(i,0)=x;
-        }
-        arma::uvec indices = arma::find( (timeProfs.col(0)>=from) && (timeProfs.col(0)<=to) );
-        arma::mat selrows=timeProfs.rows( indices );
-        if (selrows.n_rows==0) // nothing selected: take the closest row
+        while (ia<n_raw && t[ia]<from) ia++;
+        if (ib<ia) ib=ia;
+        while (ib<n_raw && t[ib]<=to) ib++;
+        a[i]=ia;
+        b[i]=ib;
+        if (ib<=ia) // nothing selected: take the closest row
         {
-            indices = arma::sort_index(arma::mat(pow(timeProfs.col(0) - 0.5*(from+to), 2)));
-            selrows=timeProfs.row( indices(0) );
+            double c=0.5*(from+to);
+            arma::uword k;
+            if (ia==0) k=0;
+            else if (ia>=n_raw) k=n_raw-1;
+            else k = ( fabs(t[ia-1]-c) <= fabs(t[ia]-c) ) ? ia-1 : ia;
+            a[i]=k;
+            b[i]=k+1;
         }
-//        if (i==n_avg-1) std::cout<<"sel rows="<<selrows<<std::endl;
+    }
 
-        if (selrows.n_rows==1)
-        {
-            for (arma::uword j=j0; j<timeProfs.n_cols; j++)
-            {
-               result(i, j) = arma::as_scalar(selrows.col(j));
-            }
-        }
-        else
+    if (nThreads<=0) nThreads=boost::thread::hardware_concurrency();
+    arma::uword nc=timeProfs.n_cols-1;
+    arma::uword nt=std::max(arma::uword(1), std::min(arma::uword(nThreads), nc));
+    if (nt==1)
+    {
+        movingAverageColumns(timeProfs, a, b, result, 1, timeProfs.n_cols);
+    }
+    else
+    {
+        boost::thread_group threads;
+        for (arma::uword k=0; k<nt; k++)
         {
-
-            arma::mat xcol=selrows.col(0);
-            for (arma::uword j=j0; j<timeProfs.n_cols; j++)
-            {
-              arma::mat ccol=selrows.col(j);
-              double I=0;
-              for (arma::uword k=1; k<xcol.n_rows; k++)
-              {
-                I+=0.5*(ccol(k)+ccol(k-1))*(xcol(k)-xcol(k-1));
-              }
-              result(i, j) = I/(xcol.max()-xcol.min());
-
-//              if (i==n_avg-1)
-//              {
-//                  std::cout<<j<<" >> "<<result(i, j)<<" "<<ccol.min()<<" "<<ccol.max()<<std::endl;
-//              }
-            }
+            threads.create_thread
+            (
+                boost::bind
+                (
+                    &movingAverageColumns, boost::cref(timeProfs), boost::cref(a), boost::cref(b), boost::ref(result),
+                    1+(k*nc)/nt, 1+((k+1)*nc)/nt
+                )
+            );
         }
+        threads.join_all();
     }
-    
+
     return result;
     
   }
@@ -701,6 +769,71 @@ arma::mat movingAverage(const arma::mat& timeProfs, double fraction, bool first_
   }
 }
 
+
+
+
+SlidingWindowAverage::SlidingWindowAverage(double window)
+: window_(window)
+{}
+
+
+void SlidingWindowAverage::reset()
+{
+  rows_.clear();
+  I_.clear();
+}
+
+
+arma::mat SlidingWindowAverage::update(const arma::mat& newRows)
+{
+  arma::mat result=zeros(newRows.n_rows, newRows.n_cols);
+
+  for (arma::uword r=0; r<newRows.n_rows; r++)
+  {
+    arma::rowvec row=newRows.row(r);
+    const arma::uword nc=row.n_elem;
+
+    if ( rows_.size()>0 && ( (row(0)<rows_.back()(0)) || (rows_.back().n_elem!=nc) ) )
+    {
+      // time went backwards (e.g. restarted run) or layout changed
+      reset();
+    }
+
+    if (I_.size()!=nc) I_.assign(nc, 0.0);
+
+    if (rows_.size()>0)
+    {
+      const arma::rowvec& p=rows_.back();
+      for (arma::uword j=1; j<nc; j++)
+      {
+        I_[j]+=0.5*(row(j)+p(j))*(row(0)-p(0));
+      }
+    }
+    rows_.push_back(row);
+
+    // drop rows, which left the window
+    while ( rows_.size()>1 && rows_[0](0) < row(0)-window_ )
+    {
+      const arma::rowvec& f=rows_[0], &s=rows_[1];
+      for (arma::uword j=1; j<nc; j++)
+      {
+        I_[j]-=0.5*(s(j)+f(j))*(s(0)-f(0));
+      }
+      rows_.pop_front();
+    }
+
+    result(r,0)=row(0);
+    double dt=rows_.back()(0)-rows_.front()(0);
+    for (arma::uword j=1; j<nc; j++)
+    {
+      result(r,j) = (rows_.size()>1 && dt>0) ? double(I_[j])/dt : row(j);
+    }
+  }
+
+  return result;
+}
+
+
 arma::mat sortedByCol(const arma::mat&m, int c)
 {
 
@@ -749,21 +882,51 @@ void Interpolator::initialize(const arma::mat& xy_us, bool force_linear)
 
         int nf=xy.n_cols-1;
         int nrows=xy.n_rows;
+        linear_ = (xy.n_rows==2) || force_linear;
+        nativeKernel_ = true;
 
-        acc.reset( gsl_interp_accel_alloc () );
         for (int i=0; i<nf; i++)
         {
 //             cout<<"building interpolator for col "<<i<<endl;
-            if ( (xy.n_rows==2) || force_linear )
-                spline.push_back( gsl_spline_alloc (gsl_interp_linear, nrows) );
+            if ( linear_ )
+                spline.push_back( std::shared_ptr<gsl_spline>(gsl_spline_alloc (gsl_interp_linear, nrows), gsl_spline_free) );
             else
-                spline.push_back( gsl_spline_alloc (gsl_interp_cspline, nrows) );
+                spline.push_back( std::shared_ptr<gsl_spline>(gsl_spline_alloc (gsl_interp_cspline, nrows), gsl_spline_free) );
             //cout<<"x="<<xy.col(0)<<endl<<"y="<<xy.col(i+1)<<endl;
-            gsl_spline_init (&spline[i], xy.colptr(0), xy.colptr(i+1), nrows);
+            gsl_spline_init (spline[i].get(), xy.colptr(0), xy.colptr(i+1), nrows);
         }
 
         first_=xy.row(0);
         last_=xy.row(xy.n_rows-1);
+
+        // data for native kernel
+        yt_ = arma::trans( xy.cols(1, nf) );
+        y2t_ = arma::zeros(nf, nrows);
+        if (!linear_)
+        {
+            // natural cubic spline: solve the tridiagonal system for the 
+            // second derivatives of all columns at once (Thomas algorithm)
+            const double* x=xy.colptr(0);
+            std::vector<double> cp(nrows, 0.0);
+            for (int i=1; i<nrows-1; i++)
+            {
+                double hl=x[i]-x[i-1], hr=x[i+1]-x[i];
+                double diag = 2.*(hl+hr) - hl*cp[i-1];
+                cp[i] = hr/diag;
+                for (int c=0; c<nf; c++)
+                {
+                    double rhs = 6.*( (yt_(c,i+1)-yt_(c,i))/hr - (yt_(c,i)-yt_(c,i-1))/hl );
+                    y2t_(c,i) = ( rhs - hl*y2t_(c,i-1) ) / diag;
+                }
+            }
+            for (int i=nrows-2; i>0; i--)
+            {
+                for (int c=0; c<nf; c++)
+                {
+                    y2t_(c,i) -= cp[i]*y2t_(c,i+1);
+                }
+            }
+        }
     }
     catch (...)
     {
@@ -791,9 +954,6 @@ Interpolator::Interpolator(const arma::mat& x, const arma::mat& y, bool force_li
 
 Interpolator::~Interpolator()
 {
-//   for (int i=0; i<spline.size(); i++)
-//     gsl_spline_free (spline[i]);
-//   gsl_interp_accel_free (acc);
 }
 
 double Interpolator::integrate(double a, double b, int col) const
@@ -816,7 +976,8 @@ double Interpolator::integrate(double a, double b, int col) const
 //     throw insight::Exception(str(format("End of integration interval (%g) after end of definition interval (%g)!")
 // 			    % b % last(0)));
   
-  return gsl_spline_eval_integ( &(spline[col]), a, b, &(*acc) );
+  // no accelerator: binary search, reentrant
+  return gsl_spline_eval_integ( spline[col].get(), a, b, NULL );
 }
 
 double Interpolator::y(double x, int col, OutOfBounds* outOfBounds) const
@@ -829,7 +990,7 @@ double Interpolator::y(double x, int col, OutOfBounds* outOfBounds) const
   if (x>last_(0)) { if (outOfBounds) *outOfBounds=IP_OUTBOUND_LARGE; return last_(col+1); }
   if (outOfBounds) *outOfBounds=IP_INBOUND;
 
-  double v=gsl_spline_eval (&(spline[col]), x, &(*acc));
+  double v=gsl_spline_eval (spline[col].get(), x, NULL);
   return v;
 }
 
@@ -843,7 +1004,7 @@ double Interpolator::dydx(double x, int col, OutOfBounds* outOfBounds) const
   if (x>last_(0)) { if (outOfBounds) *outOfBounds=IP_OUTBOUND_LARGE; return dydx(last_(0), col); }
   if (outOfBounds) *outOfBounds=IP_INBOUND;
 
-  double v=gsl_spline_eval_deriv (&(spline[col]), x, &(*acc));
+  double v=gsl_spline_eval_deriv (spline[col].get(), x, NULL);
   return v;
 }
 
@@ -863,24 +1024,95 @@ arma::mat Interpolator::dydxs(double x, OutOfBounds* outOfBounds) const
   return result;
 }
 
-arma::mat Interpolator::operator()(const arma::mat& x, OutOfBounds* outOfBounds) const
+arma::mat Interpolator::evaluateSorted(const arma::mat& x, bool derivative, OutOfBounds* outOfBounds) const
 {
-  arma::mat result=zeros(x.n_rows, spline.size());
-  for (int j=0; j<x.n_rows; j++)
+  const arma::uword n=xy_.n_rows, nf=spline.size(), nq=x.n_elem;
+  const double* xd=xy_.colptr(0);
+
+  // visit the query locations in ascending order
+  bool sorted=true;
+  for (arma::uword k=1; k<nq; k++)
   {
-    result.row(j) = this->operator()(x(j), outOfBounds);
+    if (x(k)<x(k-1)) { sorted=false; break; }
   }
-  return result;
+  arma::uvec order;
+  if (!sorted) order=arma::sort_index(arma::vectorise(x));
+
+  OutOfBounds status=IP_INBOUND;
+  arma::mat resultt(nf, nq); // one column per location, transposed at the end
+
+  if (nativeKernel_)
+  {
+    arma::uword i=0; // current interval
+    for (arma::uword kk=0; kk<nq; kk++)
+    {
+      arma::uword k = sorted ? kk : order(kk);
+      double xq=x(k);
+      if (xq<xd[0]) { status=IP_OUTBOUND_SMALL; xq=xd[0]; }
+      else if (xq>xd[n-1]) { status=IP_OUTBOUND_LARGE; xq=xd[n-1]; }
+
+      while ( (i+2<n) && (xd[i+1]<=xq) ) i++;
+
+      double h=xd[i+1]-xd[i];
+      double A=(xd[i+1]-xq)/h, B=1.-A;
+      double ca, cb, cc, cd;
+      if (derivative)
+      {
+        ca=-1./h; cb=1./h;
+        cc=-(3.*A*A-1.)*h/6.; cd=(3.*B*B-1.)*h/6.;
+      }
+      else
+      {
+        ca=A; cb=B;
+        cc=(A*A*A-A)*h*h/6.; cd=(B*B*B-B)*h*h/6.;
+      }
+
+      const double *y0=yt_.colptr(i), *y1=yt_.colptr(i+1);
+      double *r=resultt.colptr(k);
+      if (linear_)
+      {
+        for (arma::uword c=0; c<nf; c++)
+          r[c] = ca*y0[c] + cb*y1[c];
+      }
+      else
+      {
+        const double *m0=y2t_.colptr(i), *m1=y2t_.colptr(i+1);
+        for (arma::uword c=0; c<nf; c++)
+          r[c] = ca*y0[c] + cb*y1[c] + cc*m0[c] + cd*m1[c];
+      }
+    }
+  }
+  else
+  {
+    // GSL with a private accelerator per column
+    for (arma::uword c=0; c<nf; c++)
+    {
+      std::shared_ptr<gsl_interp_accel> acc(gsl_interp_accel_alloc(), gsl_interp_accel_free);
+      for (arma::uword kk=0; kk<nq; kk++)
+      {
+        arma::uword k = sorted ? kk : order(kk);
+        double xq=x(k);
+        if (xq<xd[0]) { status=IP_OUTBOUND_SMALL; xq=xd[0]; }
+        else if (xq>xd[n-1]) { status=IP_OUTBOUND_LARGE; xq=xd[n-1]; }
+        resultt(c,k) = derivative ?
+              gsl_spline_eval_deriv (spline[c].get(), xq, acc.get())
+            : gsl_spline_eval (spline[c].get(), xq, acc.get());
+      }
+    }
+  }
+
+  if (outOfBounds) *outOfBounds=status;
+  return arma::trans(resultt);
+}
+
+arma::mat Interpolator::operator()(const arma::mat& x, OutOfBounds* outOfBounds) const
+{
+  return evaluateSorted(x, false, outOfBounds);
 }
 
 arma::mat Interpolator::dydxs(const arma::mat& x, OutOfBounds* outOfBounds) const
 {
-  arma::mat result=zeros(x.n_rows, spline.size());
-  for (int j=0; j<x.n_rows; j++)
-  {
-    result.row(j) = this->dydxs(x(j), outOfBounds);
-  }
-  return result;
+  return evaluateSorted(x, true, outOfBounds);
 }
 
 arma::mat Interpolator::xy(const arma::mat& x, OutOfBounds* outOfBounds) const
@@ -23,6 +23,9 @@
 
 #include <armadillo>
 #include <map>
+#include <memory>
+#include <vector>
+#include <deque>
 
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_spline.h>
@@ -170,7 +173,39 @@ double nonlinearSolve1D(const Objective1D& model, double x_min, double x_max);
 double nonlinearMinimize1D(const Objective1D& model, double x_min, double x_max);
 arma::mat nonlinearMinimizeND(const ObjectiveND& model, const arma::mat& x0, double tol=1e-3, const arma::mat& steps = arma::mat());
 
-arma::mat movingAverage(const arma::mat& timeProfs, double fraction=0.5, bool first_col_is_time=true, bool centerwindow=false);
+/**
+ * moving average of time series. The first column contains the time.
+ * Each window covers the given fraction of the time range. The average 
+ * is the trapezoidal integral over the samples in the window divided by their time span.
+ * Runs in O(n) for ascending time, unsorted data is sorted first.
+ * nThreads>1 distributes the columns over multiple threads (0: number of cores).
+ */
+arma::mat movingAverage(const arma::mat& timeProfs, double fraction=0.5, bool first_col_is_time=true, bool centerwindow=false, int nThreads=1);
+
+/**
+ * moving average over a trailing time window of fixed width,
+ * which is updated as new rows arrive (e.g. from a running solver).
+ * The first column contains the time.
+ */
+class SlidingWindowAverage
+{
+  double window_;
+  std::deque<arma::rowvec> rows_;
+  std::vector<long double> I_;
+
+public:
+  SlidingWindowAverage(double window);
+
+  /**
+   * append rows (ascending time) and return for each of them
+   * the average over the window which ends at its time.
+   * If the time decreases, the window is restarted.
+   */
+  arma::mat update(const arma::mat& newRows);
+  void reset();
+
+  inline double window() const { return window_; }
+};
 
 arma::mat sortedByCol(const arma::mat&m, int c);
 
@@ -178,6 +213,14 @@ arma::mat sortedByCol(const arma::mat&m, int c);
  * interpolates in a 2D-matrix using GSL spline routines.
  * The first column is assumed to contain the x-values.
  * All remaining columns are dependents and to be interpolated.
+ *
+ * All const member functions are reentrant: no accelerator state is shared
+ * between calls, so that one interpolator can be used from several threads.
+ *
+ * The evaluation at multiple locations uses a native kernel (no GSL), which 
+ * computes the same linear or natural cubic spline. The locations are visited 
+ * in ascending order in a single sweep over the intervals and all columns 
+ * are evaluated at once. The native kernel can be switched off by setNativeKernel(false).
  */
 class Interpolator
 {
@@ -190,12 +233,25 @@ public:
 
 private:
   arma::mat xy_, first_, last_;
-  std::shared_ptr<gsl_interp_accel> acc;
-  boost::ptr_vector<gsl_spline> spline ;
+  std::vector<std::shared_ptr<gsl_spline> > spline ;
+  
+  /**
+   * data for the native kernel, one column per data point: 
+   * dependent values and their second derivatives (zero for linear interpolation)
+   */
+  arma::mat yt_, y2t_;
+  bool linear_;
+  bool nativeKernel_;
   
 //   Interpolator(const Interpolator&);
   void initialize(const arma::mat& xy, bool force_linear=false);
   
+  /**
+   * evaluate values (or derivatives) of all columns at locations x
+   * in a single sweep
+   */
+  arma::mat evaluateSorted(const arma::mat& x, bool derivative, OutOfBounds* outOfBounds) const;
+  
 public:
   Interpolator(const arma::mat& xy, bool force_linear=false);
   Interpolator(const arma::mat& x, const arma::mat& y, bool force_linear=false);
@@ -224,7 +280,8 @@ public:
   /**
    * interpolates all y values (row vector) 
    * at multiple locations given in x
-   * returns only the y values, no x-values in the first column
+   * returns only the y values, no x-values in the first column.
+   * outOfBounds reports IP_INBOUND only, if all locations are inside the data range.
    */
   arma::mat operator()(const arma::mat& x, OutOfBounds* outOfBounds=NULL) const;
   /**
@@ -247,6 +304,9 @@ public:
   inline double lastX() const { return last_(0); }
 
   inline int ncol() const { return spline.size(); }
+  
+  inline void setNativeKernel(bool native=true) { nativeKernel_=native; }
+  inline bool nativeKernel() const { return nativeKernel_; }
 };
 
 arma::mat integrate(const arma::mat& xy);
@@ -50,7 +50,8 @@ ParameterStudy<BaseAnalysis,var_params>::ParameterStudy
   const ParameterSet& ps,
   const boost::filesystem::path& exePath
 )
-  : Analysis ( name, description, ps, exePath )
+  : Analysis ( name, description, ps, exePath ),
+    scheduler_(NULL)
 {}
 
 
@@ -82,7 +83,52 @@ ParameterSet ParameterStudy<BaseAnalysis,var_params>::defaultParameters()
     "numthread", 
     std::auto_ptr<IntParameter>
     (
-      new IntParameter(4, "Maximum number of parallel threads to run at the same time")
+      new IntParameter(4, "Maximum number of instances to run at the same time (0: no limit)")
+    ) 
+  );
+  
+  dfp.getSubset(subname).insert
+  (
+    "numcores", 
+    std::auto_ptr<IntParameter>
+    (
+      new IntParameter(0, "Number of CPU cores to use for the instances. The number of cores, which each instance occupies, is taken from its parameters (e.g. run/np). 0: all cores available to this process")
+    ) 
+  );
+  
+  dfp.getSubset(subname).insert
+  (
+    "memory", 
+    std::auto_ptr<DoubleParameter>
+    (
+      new DoubleParameter(0, "Memory in MB to use for the instances. 0: physical memory of the host, negative: do not consider memory demand")
+    ) 
+  );
+  
+  dfp.getSubset(subname).insert
+  (
+    "pinCPUs", 
+    std::auto_ptr<BoolParameter>
+    (
+      new BoolParameter(false, "Whether to pin each instance to its own set of CPUs")
+    ) 
+  );
+  
+  dfp.getSubset(subname).insert
+  (
+    "useresultcache", 
+    std::auto_ptr<BoolParameter>
+    (
+      new BoolParameter(false, "Whether to reuse the results of instances, which have been computed before with identical parameters. Modifications of files referenced by path parameters and of the analysis code itself are not detected: clear the cache after such changes")
+    ) 
+  );
+  
+  dfp.getSubset(subname).insert
+  (
+    "resultcache", 
+    std::auto_ptr<PathParameter>
+    (
+      new PathParameter("", "Directory of the result cache. If empty, the subdirectory resultcache of the study directory is used")
     ) 
   );
         
@@ -143,7 +189,21 @@ void ParameterStudy<BaseAnalysis,var_params>::generateInstances
     AnalysisPtr newinst( /*baseAnalysis_->clone()*/ Analysis::lookup(BaseAnalysis::typeName, *newp, ep) );
     newinst -> setKeepExecutionDirectory();
 //     newinst->setParameters(*newp);
-    instances.enqueue( AnalysisInstance( n.str(), newinst, emptyresset ));
+    
+    if 
+    (
+      resultCache_ 
+      && 
+      resultCache_->lookup(*newinst, *cacheKeyParameters(newinst->parameters()), *emptyresset) 
+    )
+    {
+      std::cout<<"Results of "<<n.str()<<" found in result cache, skipping computation."<<std::endl;
+      instances.addProcessed( AnalysisInstance( n.str(), newinst, emptyresset ));
+    }
+    else
+    {
+      instances.enqueue( AnalysisInstance( n.str(), newinst, emptyresset ));
+    }
 
   }
   else
@@ -159,12 +219,65 @@ void ParameterStudy<BaseAnalysis,var_params>::generateInstances
 
 
 
+template<
+  class BaseAnalysis,
+  const RangeParameterList& var_params
+>
+ParameterSetPtr ParameterStudy<BaseAnalysis,var_params>::cacheKeyParameters(const ParameterSet& instanceParameters) const
+{
+  ParameterSetPtr kp( instanceParameters.cloneParameterSet() );
+  if (kp->contains("run"))
+  {
+    ParameterSet& rp = kp->getSubset("run");
+    const char* execution_only[] = { "numthread", "numcores", "memory", "pinCPUs", "useresultcache", "resultcache" };
+    BOOST_FOREACH(const char* pn, execution_only)
+    {
+      rp.erase(pn);
+    }
+  }
+  return kp;
+}
+
+
+
+
+template<
+  class BaseAnalysis,
+  const RangeParameterList& var_params
+>
+void ParameterStudy<BaseAnalysis,var_params>::storeInResultCache(const AnalysisInstance& ai)
+{
+  if (resultCache_)
+  {
+    const AnalysisPtr& a = get<1>(ai);
+    try
+    {
+      resultCache_->insert(*a, *cacheKeyParameters(a->parameters()), *get<2>(ai));
+    }
+    catch (const insight::Exception& e)
+    {
+      insight::Warning("Could not store results of "+get<0>(ai)+" in result cache: "+e.message());
+    }
+    catch (const std::exception& e)
+    {
+      insight::Warning("Could not store results of "+get<0>(ai)+" in result cache: "+e.what());
+    }
+  }
+}
+
+
+
+
 template<
   class BaseAnalysis,
   const RangeParameterList& var_params
 >
 void ParameterStudy<BaseAnalysis,var_params>::cancel()
 {
+  {
+    boost::mutex::scoped_lock lock(schedulerMutex_);
+    if (scheduler_) scheduler_->cancel();
+  }
   workers_.interrupt_all();
   queue_.cancelAll();
 }
@@ -229,6 +342,17 @@ void ParameterStudy<BaseAnalysis,var_params>::setupQueue()
 {
   DoubleRangeParameter::RangeList::const_iterator iters[var_params.size()];
   
+  resultCache_.reset();
+  if (parameters().getBool("run/useresultcache"))
+  {
+    path cachedir = parameters().getPath("run/resultcache");
+    if (cachedir.empty())
+    {
+      cachedir = executionPath()/"resultcache";
+    }
+    resultCache_.reset(new AnalysisResultCache(cachedir));
+  }
+  
   queue_.clear();
   generateInstances(queue_, parameters(), 0, iters);
 }
@@ -242,21 +366,32 @@ template<
 >
 void ParameterStudy<BaseAnalysis,var_params>::processQueue(insight::ProgressDisplayer* displayer)
 {
-  int nt = std::min( parameters().getInt("run/numthread"), int(queue_.n_instances()) );
+  ResourceAwareAnalysisScheduler scheduler
+  (
+    &queue_, 
+    displayer,
+    parameters().getInt("run/numcores"),
+    parameters().getDouble("run/memory"),
+    parameters().getInt("run/numthread"),
+    parameters().getBool("run/pinCPUs")
+  );
+  scheduler.setCompletionHandler
+  (
+    boost::bind(&ParameterStudy<BaseAnalysis,var_params>::storeInResultCache, this, _1)
+  );
   
-  boost::ptr_vector<AnalysisWorkerThread> threads;
-  for (int i=0; i<nt; i++)
   {
-    threads.push_back(new AnalysisWorkerThread(&queue_, displayer));
+    boost::mutex::scoped_lock lock(schedulerMutex_);
+    scheduler_=&scheduler;
   }
   
-  BOOST_FOREACH(AnalysisWorkerThread& t, threads)
+  // start instances as resources become free and wait for computation to finish
+  scheduler.run(workers_);
+  
   {
-    workers_.create_thread(boost::ref(t));
+    boost::mutex::scoped_lock lock(schedulerMutex_);
+    scheduler_=NULL;
   }
-  
-  //wait for computation to finish
-  workers_.join_all();
 }
 
 
@@ -22,6 +22,7 @@
 #define INSIGHT_PARAMETERSTUDY_H
 
 #include <base/analysis.h>
+#include <base/resultcache.h>
 
 namespace insight {
 
@@ -47,6 +48,16 @@ protected:
   
   SynchronisedAnalysisQueue queue_;
   boost::thread_group workers_;
+  boost::mutex schedulerMutex_;
+  ResourceAwareAnalysisScheduler* scheduler_;
+  std::shared_ptr<AnalysisResultCache> resultCache_;
+
+  /**
+   * the parameters of an instance, which enter the result cache key.
+   * Removes the parameters of the study, which control only the execution.
+   */
+  virtual ParameterSetPtr cacheKeyParameters(const ParameterSet& instanceParameters) const;
+  void storeInResultCache(const AnalysisInstance& ai);
 
   
 public:
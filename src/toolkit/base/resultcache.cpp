@@ -0,0 +1,160 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "base/resultcache.h"
+#include "base/analysis.h"
+#include "base/exception.h"
+
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace boost;
+using namespace boost::filesystem;
+
+namespace insight
+{
+
+
+
+AnalysisResultCache::AnalysisResultCache(const boost::filesystem::path& store)
+: store_(store)
+{}
+
+
+std::string AnalysisResultCache::moduleVersion(const Analysis& analysis)
+{
+  Dl_info info;
+  if ( dladdr( reinterpret_cast<const void*>(&typeid(analysis)), &info ) && info.dli_fname )
+  {
+    path lib(info.dli_fname);
+    boost::system::error_code ec;
+    std::ostringstream v;
+    v << lib.filename().string();
+    boost::uintmax_t s=file_size(lib, ec);
+    if (!ec) v << ":" << s;
+    std::time_t t=last_write_time(lib, ec);
+    if (!ec) v << ":" << t;
+    return v.str();
+  }
+  return "unknown";
+}
+
+
+std::string AnalysisResultCache::canonicalKey(const Analysis& analysis, const ParameterSet& ps)
+{
+  std::ostringstream key;
+  key << "type: " << analysis.type() << "\n";
+  key << "version: " << moduleVersion(analysis) << "\n";
+  // fixed base path, so that path parameters appear independent of execution directory
+  ps.saveToStream(key, "/", analysis.type());
+  return key.str();
+}
+
+
+std::string AnalysisResultCache::hash(const std::string& key)
+{
+  boost::uint64_t h=14695981039346656037ULL;
+  for (std::string::const_iterator i=key.begin(); i!=key.end(); ++i)
+  {
+    h ^= static_cast<unsigned char>(*i);
+    h *= 1099511628211ULL;
+  }
+  return str( format("%016x") % h );
+}
+
+
+namespace
+{
+
+std::string readFile(const path& file)
+{
+  std::ifstream in(file.c_str());
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+}
+
+
+bool AnalysisResultCache::lookup(const Analysis& analysis, const ParameterSet& ps, ResultSet& results) const
+{
+  std::string key=canonicalKey(analysis, ps);
+  path entry=store_/hash(key);
+
+  if ( !exists(entry/"results.isr") || !exists(entry/"key") )
+    return false;
+
+  if ( readFile(entry/"key") != key )
+  {
+    insight::Warning("Hash collision in result cache "+store_.string()+" for entry "+entry.filename().string()+". Ignoring cached results.");
+    return false;
+  }
+
+  try
+  {
+    results.readFromFile(entry/"results.isr");
+  }
+  catch (...)
+  {
+    insight::Warning("Could not read cached results from "+entry.string()+". Ignoring cached results.");
+    return false;
+  }
+
+  return true;
+}
+
+
+void AnalysisResultCache::insert(const Analysis& analysis, const ParameterSet& ps, const ResultSet& results) const
+{
+  std::string key=canonicalKey(analysis, ps);
+  path entry=store_/hash(key);
+
+  if (exists(entry)) 
+    return;
+
+  // write into temporary directory and rename, so that 
+  // incomplete entries are never visible (e.g. on interruption)
+  create_directories(store_);
+  path tmp = store_/unique_path(".incomplete-%%%%-%%%%-%%%%");
+  create_directory(tmp);
+  {
+    std::ofstream f( (tmp/"key").c_str() );
+    f << key;
+  }
+  results.saveToFile(tmp/"results.isr");
+
+  boost::system::error_code ec;
+  rename(tmp, entry, ec);
+  if (ec) 
+  {
+    // concurrently inserted by someone else
+    remove_all(tmp, ec);
+  }
+}
+
+
+
+}
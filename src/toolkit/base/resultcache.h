@@ -0,0 +1,93 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef INSIGHT_RESULTCACHE_H
+#define INSIGHT_RESULTCACHE_H
+
+#include <string>
+
+#include "base/boost_include.h"
+
+namespace insight 
+{
+
+class Analysis;
+class ParameterSet;
+class ResultSet;
+
+
+
+/**
+ * Content-addressed store for the results of analyses.
+ *
+ * The key of an entry is a canonical text representation of the analysis
+ * type, the analysis module version and the parameter set. Each entry is a
+ * directory below the store, named after the hash of the key. It contains
+ * the key itself (to detect hash collisions) and the saved result set.
+ *
+ * Note: only the parameter values enter the key. If a path parameter refers
+ * to a file, which is not packed into the parameter set, a modification of
+ * that file's contents is not detected. Result elements which refer to
+ * files (images) still point into the execution directory of the original run.
+ */
+class AnalysisResultCache
+{
+  boost::filesystem::path store_;
+
+public:
+  AnalysisResultCache(const boost::filesystem::path& store);
+
+  inline const boost::filesystem::path& store() const { return store_; }
+
+  /**
+   * Identification of the code which produced the results.
+   * It is built from the file name, size and modification time of the 
+   * shared library, which contains the analysis class.
+   * Rebuilding a module thus invalidates its cached results.
+   */
+  static std::string moduleVersion(const Analysis& analysis);
+
+  /**
+   * canonical text representation of analysis type, module version and parameters
+   */
+  static std::string canonicalKey(const Analysis& analysis, const ParameterSet& ps);
+
+  /**
+   * 64 bit FNV-1a hash of the key as hex string
+   */
+  static std::string hash(const std::string& key);
+
+  /**
+   * Look up the results of the given analysis. If found, the result elements
+   * are inserted into results and true is returned.
+   */
+  bool lookup(const Analysis& analysis, const ParameterSet& ps, ResultSet& results) const;
+  
+  /**
+   * Store the results of the given analysis.
+   */
+  void insert(const Analysis& analysis, const ParameterSet& ps, const ResultSet& results) const;
+};
+
+
+
+}
+
+#endif // INSIGHT_RESULTCACHE_H
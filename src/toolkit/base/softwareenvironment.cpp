@@ -21,10 +21,228 @@
 
 #include "base/softwareenvironment.h"
 
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
 using namespace std;
 
 namespace insight
 {
+  
+  
+  
+  
+CommandOutputCapture::CommandOutputCapture(bool echo)
+: echo_(echo),
+  keptLines_(0)
+{
+}
+
+void CommandOutputCapture::keepLastLines(size_t n)
+{
+  keptLines_.set_capacity(n);
+}
+
+std::vector<std::string> CommandOutputCapture::keptLines() const
+{
+  return std::vector<std::string>(keptLines_.begin(), keptLines_.end());
+}
+
+void CommandOutputCapture::spillToFile(const boost::filesystem::path& f)
+{
+  spillFile_.reset(new std::ofstream(f.c_str()));
+  if (!spillFile_->good())
+  {
+    throw insight::Exception("CommandOutputCapture::spillToFile(): Could not open file "+f.string()+" for writing!");
+  }
+}
+
+void CommandOutputCapture::processLine(const std::string& line, bool isStderr)
+{
+  if (echo_)
+  {
+    echoBuffer_ += echoPrefix_;
+    echoBuffer_ += line;
+    echoBuffer_ += '\n';
+  }
+  
+  if (isStderr)
+  {
+    if (stderrCallback_) stderrCallback_(line);
+  }
+  else
+  {
+    if (spillFile_) (*spillFile_) << line << '\n';
+    if (keptLines_.capacity()>0) keptLines_.push_back(line);
+    if (stdoutCallback_) stdoutCallback_(line);
+  }
+}
+
+void CommandOutputCapture::flushEcho()
+{
+  if (!echoBuffer_.empty())
+  {
+    std::cout.write(echoBuffer_.data(), echoBuffer_.size());
+    std::cout.flush();
+    echoBuffer_.clear();
+  }
+}
+
+int CommandOutputCapture::run(const std::vector<std::string>& argv)
+{
+  if (argv.size()<1)
+  {
+    throw insight::Exception("CommandOutputCapture::run(): no command given!");
+  }
+  
+  std::vector<char*> args;
+  for (const std::string& a: argv)
+  {
+    args.push_back(const_cast<char*>(a.c_str()));
+  }
+  args.push_back(NULL);
+  
+  // pipes for stdout, stderr and for reporting exec failures
+  int fds[6] = { -1, -1, -1, -1, -1, -1 };
+  int *pout=fds, *perr=fds+2, *pck=fds+4;
+  if ( ::pipe(pout) || ::pipe(perr) || ::pipe(pck) )
+  {
+    int e=errno;
+    for (int i=0; i<6; i++) if (fds[i]>=0) ::close(fds[i]);
+    throw insight::Exception("CommandOutputCapture::run(): Could not create pipes: "+std::string(strerror(e)));
+  }
+  ::fcntl(pck[1], F_SETFD, FD_CLOEXEC);
+  
+  pid_t pid=::fork();
+  if (pid<0)
+  {
+    int e=errno;
+    for (int i=0; i<6; i++) ::close(fds[i]);
+    throw insight::Exception("CommandOutputCapture::run(): Failed to fork: "+std::string(strerror(e)));
+  }
+  else if (pid==0)
+  {
+    // child
+    ::dup2(pout[1], STDOUT_FILENO);
+    ::dup2(perr[1], STDERR_FILENO);
+    ::close(pout[0]); ::close(pout[1]);
+    ::close(perr[0]); ::close(perr[1]);
+    ::close(pck[0]);
+    ::execvp(args[0], &args[0]);
+    int e=errno;
+    ssize_t ignored=::write(pck[1], &e, sizeof(e));
+    (void)ignored;
+    ::_exit(127);
+  }
+  
+  // parent
+  ::close(pout[1]);
+  ::close(perr[1]);
+  ::close(pck[1]);
+  
+  int execerr=0;
+  ssize_t nck;
+  do { nck=::read(pck[0], &execerr, sizeof(execerr)); } while (nck<0 && errno==EINTR);
+  ::close(pck[0]);
+  
+  int status=0;
+  
+  if (nck==sizeof(execerr))
+  {
+    ::close(pout[0]);
+    ::close(perr[0]);
+    while ( (::waitpid(pid, &status, 0)<0) && (errno==EINTR) ) ;
+    throw insight::Exception
+    (
+      "CommandOutputCapture::run(): Failed to launch subprocess "+argv[0]+": "+std::string(strerror(execerr))
+    );
+  }
+  
+  struct pollfd pfd[2];
+  pfd[0].fd=pout[0]; pfd[0].events=POLLIN;
+  pfd[1].fd=perr[0]; pfd[1].events=POLLIN;
+  std::string partial[2];
+  std::vector<char> buf(65536);
+  int nopen=2;
+  
+  try
+  {
+    while (nopen>0)
+    {
+      int r=::poll(pfd, 2, 200);
+      
+      if (r<0)
+      {
+        if (errno==EINTR) continue;
+        throw insight::Exception("CommandOutputCapture::run(): poll failed: "+std::string(strerror(errno)));
+      }
+      
+      for (int i=0; i<2; i++)
+      {
+        if ( (pfd[i].fd>=0) && (pfd[i].revents & (POLLIN|POLLHUP|POLLERR)) )
+        {
+          ssize_t n=::read(pfd[i].fd, &buf[0], buf.size());
+          if (n>0)
+          {
+            std::string& p=partial[i];
+            p.append(&buf[0], n);
+            size_t start=0, pos;
+            while ( (pos=p.find('\n', start)) != std::string::npos )
+            {
+              processLine(p.substr(start, pos-start), i==1);
+              start=pos+1;
+            }
+            p.erase(0, start);
+          }
+          else if ( (n==0) || ((errno!=EINTR) && (errno!=EAGAIN)) )
+          {
+            // end of stream
+            if (!partial[i].empty())
+            {
+              processLine(partial[i], i==1);
+              partial[i].clear();
+            }
+            ::close(pfd[i].fd);
+            pfd[i].fd=-1;
+            nopen--;
+          }
+        }
+      }
+      
+      if ( (r==0) || (echoBuffer_.size()>65536) )
+      {
+        flushEcho();
+      }
+      
+      if (stopCheck_ && stopCheck_())
+      {
+        break;
+      }
+    }
+  }
+  catch (...)
+  {
+    for (int i=0; i<2; i++) if (pfd[i].fd>=0) ::close(pfd[i].fd);
+    while ( (::waitpid(pid, &status, 0)<0) && (errno==EINTR) ) ;
+    flushEcho();
+    throw;
+  }
+  
+  for (int i=0; i<2; i++) if (pfd[i].fd>=0) ::close(pfd[i].fd);
+  while ( (::waitpid(pid, &status, 0)<0) && (errno==EINTR) ) ;
+  flushEcho();
+  
+  return status;
+}
+
+
+
+
 
 SoftwareEnvironment::SoftwareEnvironment()
 : executionMachine_("")
@@ -47,31 +265,119 @@ int SoftwareEnvironment::version() const
   return -1;
 }
 
-void SoftwareEnvironment::executeCommand
+std::string SoftwareEnvironment::environmentSetupCommands() const
+{
+  return std::string();
+}
+
+const std::vector<std::string>& SoftwareEnvironment::preparedEnvironment() const
+{
+  static const std::vector<std::string> empty;
+  return empty;
+}
+
+std::vector<std::string> SoftwareEnvironment::inheritedEnvironment()
+{
+  std::vector<std::string> result;
+  std::vector<std::string> keepvars = boost::assign::list_of("DISPLAY")("HOME")("USER")("SHELL")("INSIGHT_BINDIR")("INSIGHT_LIBDIR")("INSIGHT_OFES");
+  for (const std::string& varname: keepvars)
+  {
+    if (char* varvalue=getenv(varname.c_str()))
+    {
+      result.push_back(varname+"="+std::string(varvalue));
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> SoftwareEnvironment::commandLine
 (
   const std::string& cmd, 
   std::vector<std::string> argv,
-  std::vector<std::string>* output,
   std::string *ovr_machine
 ) const
 {
-  redi::ipstream p_in;
+  std::string machine=executionMachine_;
+  if (ovr_machine) machine=*ovr_machine;
   
-  forkCommand(p_in, cmd, argv, ovr_machine);
-    
-  std::string line;
-  while (std::getline(p_in.out(), line))
+  if (machine=="")
+    {
+        const std::vector<std::string>& penv = preparedEnvironment();
+        if (!penv.empty())
+        {
+            // environment is already set up, skip the setup commands
+            argv.insert(argv.begin(), cmd);
+            argv.insert(argv.begin(), "-c");
+            argv.insert(argv.begin(), "bash");
+            argv.insert(argv.begin(), penv.begin(), penv.end());
+        }
+        else
+        {
+            argv.insert(argv.begin(), environmentSetupCommands()+cmd);
+            argv.insert(argv.begin(), "-lc");
+            argv.insert(argv.begin(), "bash");
+            // keep only a selected set of environment variables
+            std::vector<std::string> keepvars = inheritedEnvironment();
+            argv.insert(argv.begin(), keepvars.begin(), keepvars.end());
+        }
+        argv.insert(argv.begin(), "-i");
+        argv.insert(argv.begin(), "env");
+    }
+  else if (boost::starts_with(machine, "qrsh-wrap"))
   {
-    cout<<line<<endl;
-    if (output) output->push_back(line);
+    argv.insert(argv.begin(), environmentSetupCommands()+cmd);
+    //argv.insert(argv.begin(), "n");
+    //argv.insert(argv.begin(), "-now");
+    argv.insert(argv.begin(), "qrsh-wrap");
   }
-  while (std::getline(p_in.err(), line))
+  else
+  {
+    argv.insert(argv.begin(), environmentSetupCommands()+cmd);
+    argv.insert(argv.begin(), machine);
+    argv.insert(argv.begin(), "ssh");
+  }
+  
+  return argv;
+}
+
+int SoftwareEnvironment::runCommand
+(
+  CommandOutputCapture& capture,
+  const std::string& cmd, 
+  std::vector<std::string> argv,
+  std::string *ovr_machine
+) const
+{
+  // the full command line contains the environment, don't print it
+  std::ostringstream dbgs;
+  dbgs<<cmd;
+  for (const std::string& a: argv)
+    dbgs<<" "<<a;
+  std::cout<<"Executing "<<dbgs.str()<<std::endl;
+  
+  return capture.run(commandLine(cmd, argv, ovr_machine));
+}
+
+void SoftwareEnvironment::executeCommand
+(
+  const std::string& cmd, 
+  std::vector<std::string> argv,
+  std::vector<std::string>* output,
+  std::string *ovr_machine
+) const
+{
+  CommandOutputCapture capture;
+  if (output)
   {
-    cout<<line<<endl;
+    capture.setStdoutCallback
+    (
+      [output](const std::string& line) { output->push_back(line); }
+    );
   }
-  p_in.close();
+  
+  int status=runCommand(capture, cmd, argv, ovr_machine);
 
-  if (p_in.rdbuf()->status()!=0)
+  if (status!=0)
   {
     std::ostringstream os;
     os << cmd;
@@ -81,8 +387,6 @@ void SoftwareEnvironment::executeCommand
     }
     throw insight::Exception("SoftwareEnvironment::executeCommand(): command failed with nonzero return code.\n(Command was \""+os.str()+"\"");
   }
-  
-  //return p_in.rdbuf()->status();
 }
 
 /*
@@ -26,17 +26,85 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <memory>
 
 #include "pstreams/pstream.h"
 
 // #include "boost/foreach.hpp"
 // #include "boost/algorithm/string.hpp"
 #include "base/boost_include.h"
+#include "boost/circular_buffer.hpp"
 
 #include "base/exception.h"
 
 namespace insight
 {
+  
+  
+  
+  
+/**
+ * Runs a subprocess and reads its stdout and stderr simultaneously (poll-based),
+ * so that the process never stalls on a full pipe.
+ * The output is streamed line by line to callbacks. Only a configurable number
+ * of lines is kept in memory, optionally all stdout lines are spilled to a file.
+ * The console echo is written in batches.
+ */
+class CommandOutputCapture
+{
+public:
+  typedef boost::function<void(const std::string&)> LineCallback;
+  typedef boost::function<bool()> StopCheck;
+  
+protected:
+  LineCallback stdoutCallback_, stderrCallback_;
+  StopCheck stopCheck_;
+  
+  bool echo_;
+  std::string echoPrefix_;
+  std::string echoBuffer_;
+  
+  boost::circular_buffer<std::string> keptLines_;
+  std::shared_ptr<std::ofstream> spillFile_;
+  
+  void processLine ( const std::string& line, bool isStderr );
+  void flushEcho();
+  
+public:
+  CommandOutputCapture ( bool echo = true );
+  
+  inline void setStdoutCallback ( LineCallback cb ) { stdoutCallback_=cb; }
+  inline void setStderrCallback ( LineCallback cb ) { stderrCallback_=cb; }
+  
+  /**
+   * checked periodically, reading is stopped and the process is closed, 
+   * if it returns true
+   */
+  inline void setStopCheck ( StopCheck sc ) { stopCheck_=sc; }
+  
+  inline void setEchoPrefix ( const std::string& prefix ) { echoPrefix_=prefix; }
+  
+  /**
+   * keep the last n lines of stdout in memory
+   */
+  void keepLastLines ( size_t n );
+  std::vector<std::string> keptLines() const;
+  
+  /**
+   * write all stdout lines into file f
+   */
+  void spillToFile ( const boost::filesystem::path& f );
+  
+  /**
+   * launch the process with the argument list argv and process its output, until it terminates.
+   * @return exit status of the process (as reported by waitpid)
+   */
+  int run ( const std::vector<std::string>& argv );
+};
+  
+  
+  
 
 class SoftwareEnvironment
 {
@@ -53,6 +121,36 @@ public:
     
     virtual int version() const;
     
+    /**
+     * shell commands, which need to be executed before each command
+     * to set up the environment
+     */
+    virtual std::string environmentSetupCommands() const;
+    
+    /**
+     * Complete set of environment variables (VAR=value) after execution of the setup commands.
+     * If non-empty, local commands are executed directly in this environment
+     * and the setup commands are skipped.
+     */
+    virtual const std::vector<std::string>& preparedEnvironment() const;
+    
+    /**
+     * the selected set of environment variables, which is passed
+     * from the calling process into the command's environment
+     */
+    static std::vector<std::string> inheritedEnvironment();
+    
+    /**
+     * assemble the complete argument list for the execution of cmd
+     * on the selected machine
+     */
+    std::vector<std::string> commandLine
+    (
+      const std::string& cmd, 
+      std::vector<std::string> argv = std::vector<std::string>(),
+      std::string *ovr_machine=NULL
+    ) const;
+    
     virtual void executeCommand
     (  
       const std::string& cmd, 
@@ -61,6 +159,18 @@ public:
       std::string *ovr_machine=NULL
     ) const;
     
+    /**
+     * execute cmd and pass its output to the capture object
+     * @return exit status of the process (as reported by waitpid)
+     */
+    virtual int runCommand
+    (
+      CommandOutputCapture& capture,
+      const std::string& cmd, 
+      std::vector<std::string> argv = std::vector<std::string>(),
+      std::string *ovr_machine=NULL
+    ) const;
+    
     template<class stream>
     void forkCommand
     (
@@ -71,39 +181,7 @@ public:
     ) const
     {
       
-      std::string machine=executionMachine_;
-      if (ovr_machine) machine=*ovr_machine;
-      
-      argv.insert(argv.begin(), cmd);
-      
-      if (machine=="")
-        {
-            argv.insert(argv.begin(), "-lc");
-            argv.insert(argv.begin(), "bash");
-            // keep only a selected set of environment variables
-            std::vector<std::string> keepvars = boost::assign::list_of("DISPLAY")("HOME")("USER")("SHELL")("INSIGHT_BINDIR")("INSIGHT_LIBDIR")("INSIGHT_OFES");
-            for (const std::string& varname: keepvars)
-            {
-                if (char* varvalue=getenv(varname.c_str()))
-                {
-                    // shellcmd+="export "+varname+"=\""+std::string(varvalue)+"\";";
-                    argv.insert(argv.begin(), varname+"="+std::string(varvalue));
-                }
-            }
-            argv.insert(argv.begin(), "-i");
-            argv.insert(argv.begin(), "env");
-        }
-      else if (boost::starts_with(machine, "qrsh-wrap"))
-      {
-	//argv.insert(argv.begin(), "n");
-	//argv.insert(argv.begin(), "-now");
-	argv.insert(argv.begin(), "qrsh-wrap");
-      }
-      else
-      {
-	argv.insert(argv.begin(), machine);
-	argv.insert(argv.begin(), "ssh");
-      }
+      argv=commandLine(cmd, argv, ovr_machine);
       
       std::ostringstream dbgs;
       for (const std::string& a: argv)
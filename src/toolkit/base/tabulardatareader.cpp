@@ -0,0 +1,432 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "base/tabulardatareader.h"
+#include "base/exception.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace boost;
+using namespace boost::filesystem;
+
+namespace insight
+{
+
+
+
+bool fastParseDouble(const char*& p, const char* end, double& value)
+{
+  static const double pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  const char* s=p;
+  const char* q=p;
+
+  bool neg=false;
+  if ( (q<end) && ((*q=='-')||(*q=='+')) )
+  {
+    neg=(*q=='-');
+    q++;
+  }
+
+  std::uint64_t m=0;
+  int nsig=0, exp10=0;
+  bool anydigit=false, exact=true;
+
+  while ( (q<end) && (*q>='0') && (*q<='9') )
+  {
+    anydigit=true;
+    if (nsig<19)
+    {
+      m=10*m+(*q-'0');
+      if (m>0) nsig++;
+    }
+    else
+    {
+      exp10++;
+      exact=false;
+    }
+    q++;
+  }
+
+  if ( (q<end) && (*q=='.') )
+  {
+    q++;
+    while ( (q<end) && (*q>='0') && (*q<='9') )
+    {
+      anydigit=true;
+      if (nsig<19)
+      {
+        m=10*m+(*q-'0');
+        if (m>0) nsig++;
+        exp10--;
+      }
+      else
+      {
+        exact=false;
+      }
+      q++;
+    }
+  }
+
+  if (anydigit && (q<end) && ((*q=='e')||(*q=='E')) )
+  {
+    const char* qe=q+1;
+    bool eneg=false;
+    if ( (qe<end) && ((*qe=='-')||(*qe=='+')) )
+    {
+      eneg=(*qe=='-');
+      qe++;
+    }
+    if ( (qe<end) && (*qe>='0') && (*qe<='9') )
+    {
+      int e=0;
+      while ( (qe<end) && (*qe>='0') && (*qe<='9') )
+      {
+        if (e<10000) e=10*e+(*qe-'0');
+        qe++;
+      }
+      exp10 += eneg ? -e : e;
+      q=qe;
+    }
+  }
+
+  if ( anydigit && exact && (m <= (std::uint64_t(1)<<53)) && (exp10>=-22) && (exp10<=22) )
+  {
+    // both m and 10^|exp10| are exactly representable: 
+    // the result is correctly rounded
+    double v=double(m);
+    if (exp10<0) v/=pow10[-exp10]; else v*=pow10[exp10];
+    value = neg ? -v : v;
+    p=q;
+    return true;
+  }
+
+  // slow path: many digits, large exponents, nan, inf.
+  // The buffer is not NUL-terminated, strtod works on a copy of the token
+  const char* te=s;
+  while ( (te<end) && ( isalnum(static_cast<unsigned char>(*te))
+                        || (*te=='+') || (*te=='-') || (*te=='.') ) )
+  {
+    te++;
+  }
+  char sbuf[64];
+  std::string lbuf;
+  const char* t;
+  size_t tn=te-s;
+  if (tn<sizeof(sbuf))
+  {
+    memcpy(sbuf, s, tn);
+    sbuf[tn]=0;
+    t=sbuf;
+  }
+  else
+  {
+    lbuf.assign(s, tn);
+    t=lbuf.c_str();
+  }
+
+  char* se;
+  double v=strtod(t, &se);
+  if (se==t) return false;
+  value=v;
+  p=s+(se-t);
+  return true;
+}
+
+
+
+
+TabularDataReader::TabularDataReader
+(
+  const boost::filesystem::path& file, 
+  const std::string& separators, 
+  char commentChar, 
+  size_t nHeaderLines
+)
+: file_(file),
+  commentChar_(commentChar),
+  nHeaderLines_(nHeaderLines),
+  expectedCols_(0),
+  nCols_(0),
+  bracketGroupSize_(1),
+  nSkippedRows_(0),
+  offset_(0),
+  restarted_(false)
+{
+  std::fill(isSeparator_, isSeparator_+256, false);
+  isSeparator_[int(' ')]=true;
+  isSeparator_[int('\t')]=true;
+  isSeparator_[int('\r')]=true;
+  for (char c: separators)
+  {
+    isSeparator_[static_cast<unsigned char>(c)]=true;
+  }
+}
+
+void TabularDataReader::setExpectedColumns(arma::uword nc)
+{
+  expectedCols_=nc;
+  nCols_=nc;
+}
+
+void TabularDataReader::reset()
+{
+  headerLines_.clear();
+  // the layout may be different after a rewrite
+  nCols_=expectedCols_;
+  bracketGroupSize_=1;
+  nSkippedRows_=0;
+  offset_=0;
+}
+
+arma::mat TabularDataReader::readAll()
+{
+  reset();
+  return read(true);
+}
+
+arma::mat TabularDataReader::readNewRows()
+{
+  return read(false);
+}
+
+arma::mat TabularDataReader::read(bool finalRead)
+{
+  int fd=::open(file_.c_str(), O_RDONLY);
+  if (fd<0)
+  {
+    throw insight::Exception("TabularDataReader: Could not open file "+file_.string()+": "+std::string(strerror(errno)));
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st)!=0)
+  {
+    ::close(fd);
+    throw insight::Exception("TabularDataReader: Could not stat file "+file_.string());
+  }
+  std::uint64_t size=st.st_size;
+
+  restarted_=false;
+  if (size<offset_)
+  {
+    // file was truncated or rewritten
+    reset();
+    restarted_=true;
+  }
+  if (size==offset_)
+  {
+    ::close(fd);
+    return arma::zeros(0, nCols_);
+  }
+
+  // map from page-aligned position before offset_
+  std::uint64_t pagesize=::sysconf(_SC_PAGESIZE);
+  std::uint64_t mapstart=offset_ - (offset_%pagesize);
+  size_t maplen=size-mapstart;
+  void* map=::mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, mapstart);
+  ::close(fd);
+  if (map==MAP_FAILED)
+  {
+    throw insight::Exception("TabularDataReader: Could not map file "+file_.string()+": "+std::string(strerror(errno)));
+  }
+  ::madvise(map, maplen, MADV_SEQUENTIAL);
+
+  const char* begin = static_cast<const char*>(map) + (offset_-mapstart);
+  const char* end = static_cast<const char*>(map) + maplen;
+
+  // only complete lines are parsed
+  const char* le=end;
+  if (!finalRead)
+  {
+    while ( (le>begin) && (*(le-1)!='\n') ) le--;
+  }
+
+  // end of the line starting at l
+  auto lineEnd = [&le](const char* l)
+  {
+    const char* e=static_cast<const char*>(memchr(l, '\n', le-l));
+    return e ? e : le;
+  };
+
+  const char* p=begin;
+
+  // header lines
+  while ( (headerLines_.size()<nHeaderLines_) && (p<le) )
+  {
+    const char* e=lineEnd(p);
+    std::string hl(p, e);
+    if (!hl.empty() && hl[hl.size()-1]=='\r') hl.erase(hl.size()-1);
+    headerLines_.push_back(hl);
+    p=e+1;
+  }
+
+  const char* datastart=p;
+
+  // first pass: count data lines, determine number of columns
+  size_t nlines=0;
+  while (p<le)
+  {
+    const char* e=lineEnd(p);
+    const char* q=p;
+    while ( (q<e) && isSeparator_[static_cast<unsigned char>(*q)] && (*q!='(') ) q++;
+    if ( (q<e) && (*q!=commentChar_) )
+    {
+      if (nCols_==0)
+      {
+        // first data line
+        arma::uword nc=0, ng=0;
+        bool inbr=false, firstgroup=true;
+        for (const char* c=p; c<e; )
+        {
+          if ( (*c=='(') && isSeparator_[int('(')] ) { inbr=true; c++; continue; }
+          if ( (*c==')') && isSeparator_[int(')')] ) { if (inbr && firstgroup) { bracketGroupSize_=ng; firstgroup=false; } inbr=false; c++; continue; }
+          if (isSeparator_[static_cast<unsigned char>(*c)]) { c++; continue; }
+          double v;
+          if (!fastParseDouble(c, e, v)) break;
+          nc++;
+          if (inbr && firstgroup) ng++;
+        }
+        nCols_=nc;
+      }
+      nlines++;
+    }
+    p=e+1;
+  }
+
+  // second pass: parse values directly into column-major storage
+  arma::mat data(nlines, nCols_);
+  double* mem=data.memptr();
+  arma::uword row=0;
+  p=datastart;
+  while (p<le)
+  {
+    const char* e=lineEnd(p);
+    const char* q=p;
+    while ( (q<e) && isSeparator_[static_cast<unsigned char>(*q)] && (*q!='(') ) q++;
+    if ( (q<e) && (*q!=commentChar_) )
+    {
+      arma::uword k=0;
+      bool ok=true;
+      q=p;
+      while (ok)
+      {
+        while ( (q<e) && isSeparator_[static_cast<unsigned char>(*q)] ) q++;
+        if (q>=e) break;
+        double v;
+        if ( (k>=nCols_) || !fastParseDouble(q, e, v) )
+        {
+          ok=false;
+        }
+        else if ( (q<e) && !isSeparator_[static_cast<unsigned char>(*q)] )
+        {
+          ok=false; // garbage behind number
+        }
+        else
+        {
+          mem[k*nlines+row]=v;
+          k++;
+        }
+      }
+      if (ok && (k==nCols_))
+      {
+        row++;
+      }
+      else
+      {
+        nSkippedRows_++;
+      }
+    }
+    p=e+1;
+  }
+
+  offset_ += (le-begin);
+  ::munmap(map, maplen);
+
+  if (row<nlines)
+  {
+    data.resize(row, nCols_);
+  }
+
+  return data;
+}
+
+
+
+
+IncrementalTabularFile::IncrementalTabularFile
+(
+  const boost::filesystem::path& file, 
+  const std::string& separators, 
+  char commentChar, 
+  size_t nHeaderLines
+)
+: reader_(file, separators, commentChar, nHeaderLines),
+  nRows_(0)
+{
+}
+
+arma::uword IncrementalTabularFile::update()
+{
+  arma::mat nr=reader_.readNewRows();
+
+  if ( reader_.restarted() || (data_.n_cols!=nr.n_cols) )
+  {
+    nRows_=0;
+    data_.set_size(std::max<arma::uword>(2*nr.n_rows, 16), nr.n_cols);
+  }
+
+  if (nr.n_rows>0)
+  {
+    if (nRows_+nr.n_rows > data_.n_rows)
+    {
+      // grow geometrically
+      data_.resize(std::max(2*data_.n_rows, nRows_+nr.n_rows), data_.n_cols);
+    }
+    data_.rows(nRows_, nRows_+nr.n_rows-1)=nr;
+    nRows_+=nr.n_rows;
+  }
+
+  return nr.n_rows;
+}
+
+arma::mat IncrementalTabularFile::data() const
+{
+  if (nRows_==0)
+  {
+    return arma::zeros(0, data_.n_cols);
+  }
+  return data_.rows(0, nRows_-1);
+}
+
+
+
+}
@@ -0,0 +1,177 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef INSIGHT_TABULARDATAREADER_H
+#define INSIGHT_TABULARDATAREADER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <armadillo>
+
+#include "base/boost_include.h"
+
+namespace insight 
+{
+
+
+
+/**
+ * Reader for numeric tables in text files (OpenFOAM postProcessing output, CSV files).
+ *
+ * The file is memory-mapped and tokenized in place. Brackets, commas and whitespace 
+ * are treated as separators (configurable), so that vector and tensor valued columns
+ * are flattened into consecutive scalar columns. Lines starting with the comment char are skipped.
+ * The values are written directly into a preallocated matrix (one row per line).
+ *
+ * The reader remembers the byte offset of the first unparsed line. Subsequent calls
+ * of readNewRows() parse only the lines, which were appended in the meantime. 
+ * Incomplete lines at the end of the file are left for the next call.
+ */
+class TabularDataReader
+{
+  boost::filesystem::path file_;
+  bool isSeparator_[256];
+  char commentChar_;
+  size_t nHeaderLines_;
+  
+  std::vector<std::string> headerLines_;
+  arma::uword expectedCols_, nCols_, bracketGroupSize_;
+  size_t nSkippedRows_;
+  std::uint64_t offset_;
+  bool restarted_;
+  
+  /**
+   * parse from offset_ to the end of the last complete line.
+   * A final read also consumes a last line without line break.
+   */
+  arma::mat read(bool finalRead);
+
+public:
+  /**
+   * @param file the file to read
+   * @param separators chars, which separate values (in addition to whitespace)
+   * @param commentChar lines starting with this char are skipped
+   * @param nHeaderLines number of lines at the beginning of the file, which are stored as header lines
+   */
+  TabularDataReader
+  (
+    const boost::filesystem::path& file, 
+    const std::string& separators = "(),", 
+    char commentChar = '#', 
+    size_t nHeaderLines = 0
+  );
+  
+  /**
+   * set the number of columns. Lines with a different number of values are skipped.
+   * If not set, the number of columns is determined from the first data line.
+   */
+  void setExpectedColumns(arma::uword nc);
+  
+  /**
+   * parse all complete lines, which were appended since the last call.
+   * Starts over from the beginning, if the file was truncated in the meantime.
+   * @return one row per line
+   */
+  arma::mat readNewRows();
+  
+  /**
+   * parse the complete file, including an unterminated last line
+   */
+  arma::mat readAll();
+  
+  /**
+   * forget everything read so far, including the detected number of columns
+   */
+  void reset();
+  
+  inline const std::vector<std::string>& headerLines() const { return headerLines_; }
+  inline arma::uword nCols() const { return nCols_; }
+  
+  /**
+   * number of values in the first bracketed group of the first data line, 
+   * e.g. 3 for vector-valued probe data. 1, if there are no brackets.
+   */
+  inline arma::uword bracketGroupSize() const { return bracketGroupSize_; }
+  
+  /**
+   * number of lines, which were skipped since they did not contain 
+   * the expected number of values
+   */
+  inline size_t nSkippedRows() const { return nSkippedRows_; }
+  
+  inline std::uint64_t offset() const { return offset_; }
+  
+  /**
+   * true, if the file was found truncated during the last call to readNewRows()
+   * and was read again from the beginning
+   */
+  inline bool restarted() const { return restarted_; }
+};
+
+
+
+
+/**
+ * Keeps the contents of a growing tabular data file in memory
+ * and parses only the appended lines on update.
+ */
+class IncrementalTabularFile
+{
+  TabularDataReader reader_;
+  arma::mat data_;
+  arma::uword nRows_;
+  
+public:
+  IncrementalTabularFile
+  (
+    const boost::filesystem::path& file, 
+    const std::string& separators = "(),", 
+    char commentChar = '#', 
+    size_t nHeaderLines = 0
+  );
+  
+  /**
+   * read the appended rows
+   * @return number of new rows
+   */
+  arma::uword update();
+  
+  inline arma::uword n_rows() const { return nRows_; }
+  arma::mat data() const;
+  
+  inline const TabularDataReader& reader() const { return reader_; }
+};
+
+
+
+
+/**
+ * Fast conversion of the number at p. Uses an exact fast path for numbers 
+ * with up to 19 significant digits and small exponents and falls back to strtod otherwise.
+ * On success, p is advanced behind the number.
+ */
+bool fastParseDouble(const char*& p, const char* end, double& value);
+
+
+}
+
+#endif // INSIGHT_TABULARDATAREADER_H
@@ -0,0 +1,896 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "taskspoolerclient.h"
+#include "base/exception.h"
+
+#include "boost/process.hpp"
+#include "boost/regex.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace insight
+{
+
+
+namespace
+{
+
+/**
+ * keep in sync with enum msg_types in taskspooler/main.h
+ */
+enum MessageType
+{
+    KILL_SERVER,
+    NEWJOB,
+    NEWJOB_OK,
+    RUNJOB,
+    RUNJOB_OK,
+    ENDJOB,
+    LIST,
+    LIST_LINE,
+    CLEAR_FINISHED,
+    ASK_OUTPUT,
+    ANSWER_OUTPUT,
+    REMOVEJOB,
+    REMOVEJOB_OK,
+    WAITJOB,
+    WAIT_RUNNING_JOB,
+    WAITJOB_OK,
+    URGENT,
+    URGENT_OK,
+    GET_STATE,
+    ANSWER_STATE,
+    SWAP_JOBS,
+    SWAP_JOBS_OK,
+    INFO,
+    INFO_DATA,
+    SET_MAX_SLOTS,
+    GET_MAX_SLOTS,
+    GET_MAX_SLOTS_OK,
+    GET_VERSION,
+    VERSION,
+    NEWJOB_NOK
+};
+
+
+/**
+ * binary layout of struct msg in taskspooler/main.h
+ */
+struct Message
+{
+    int type;
+
+    union
+    {
+        struct {
+            int command_size;
+            int store_output;
+            int should_keep_finished;
+            int label_size;
+            int env_size;
+            int do_depend;
+            int depend_on;
+            int wait_enqueuing;
+            int num_slots;
+        } newjob;
+        struct {
+            int ofilename_size;
+            int store_output;
+            int pid;
+        } output;
+        int jobid;
+        struct {
+            int errorlevel;
+            int died_by_signal;
+            int signal;
+            float user_ms;
+            float system_ms;
+            float real_ms;
+            int skipped;
+        } result;
+        int size;
+        int state;
+        struct {
+            int jobid1;
+            int jobid2;
+        } swap;
+        int last_errorlevel;
+        int max_slots;
+        int version;
+    } u;
+
+    Message(int t=0)
+    {
+        memset(this, 0, sizeof(*this));
+        type=t;
+    }
+};
+
+
+/**
+ * closes the connection at the end of the request
+ */
+struct Connection
+{
+    int fd;
+
+    Connection(int s) : fd(s) {}
+    ~Connection() { close(fd); }
+};
+
+
+void sendBytes(int fd, const void* data, size_t n)
+{
+    const char* p=static_cast<const char*>(data);
+    while (n>0)
+    {
+        ssize_t r=send(fd, p, n, MSG_NOSIGNAL);
+        if (r<0)
+        {
+            if (errno==EINTR) continue;
+            throw insight::Exception(std::string("Could not send to task spooler server: ")+strerror(errno));
+        }
+        p+=r;
+        n-=r;
+    }
+}
+
+
+/**
+ * returns false, if the server closed the connection before the first byte
+ */
+bool receiveBytes(int fd, void* data, size_t n)
+{
+    char* p=static_cast<char*>(data);
+    size_t nr=0;
+    while (nr<n)
+    {
+        ssize_t r=recv(fd, p+nr, n-nr, 0);
+        if (r<0)
+        {
+            if (errno==EINTR) continue;
+            throw insight::Exception(std::string("Could not receive from task spooler server: ")+strerror(errno));
+        }
+        if (r==0)
+        {
+            if (nr==0) return false;
+            throw insight::Exception("Incomplete answer from task spooler server!");
+        }
+        nr+=r;
+    }
+    return true;
+}
+
+
+void sendMessage(int fd, const Message& m)
+{
+    sendBytes(fd, &m, sizeof(m));
+}
+
+
+bool receiveMessage(int fd, Message& m)
+{
+    return receiveBytes(fd, &m, sizeof(m));
+}
+
+
+Message request(int fd, const Message& m)
+{
+    sendMessage(fd, m);
+    Message a;
+    if (!receiveMessage(fd, a))
+    {
+        throw insight::Exception("Task spooler server closed the connection without an answer!");
+    }
+    return a;
+}
+
+
+/**
+ * text following a LIST_LINE message
+ */
+std::string receiveLine(int fd, const Message& m)
+{
+    std::vector<char> buf(std::max(0, m.u.size)+1, 0);
+    if (m.u.size>0)
+    {
+        if (!receiveBytes(fd, &buf[0], m.u.size))
+            throw insight::Exception("Incomplete answer from task spooler server!");
+    }
+    return boost::algorithm::trim_copy(std::string(&buf[0]));
+}
+
+
+/**
+ * The server reports errors as a single line of text
+ */
+void throwRequestError(int fd, const Message& a, const std::string& what)
+{
+    if (a.type==LIST_LINE)
+    {
+        throw insight::Exception("Task spooler: "+what+" failed: "+receiveLine(fd, a));
+    }
+    throw insight::Exception("Task spooler: unexpected answer to "+what+" (message type "
+                             +boost::lexical_cast<std::string>(a.type)+")");
+}
+
+
+TaskSpoolerClient::JobState jobState(int s)
+{
+    switch (s)
+    {
+        case 0: return TaskSpoolerClient::Queued;
+        case 1: return TaskSpoolerClient::Running;
+        case 2: return TaskSpoolerClient::Finished;
+        case 3: return TaskSpoolerClient::Skipped;
+        case 4: return TaskSpoolerClient::HoldingClient;
+    }
+    return TaskSpoolerClient::Unknown;
+}
+
+
+TaskSpoolerClient::JobState jobState(const std::string& s)
+{
+    if (s=="queued") return TaskSpoolerClient::Queued;
+    else if (s=="running") return TaskSpoolerClient::Running;
+    else if (s=="finished") return TaskSpoolerClient::Finished;
+    else if (s=="skipped") return TaskSpoolerClient::Skipped;
+    return TaskSpoolerClient::Unknown;
+}
+
+}
+
+
+
+
+const int TaskSpoolerClient::protocolVersion=730;
+
+
+
+
+boost::filesystem::path TaskSpoolerClient::defaultSocket()
+{
+  if (const char* s=getenv("TS_SOCKET"))
+  {
+    return s;
+  }
+  const char* tmpdir=getenv("TMPDIR");
+  return boost::filesystem::path(tmpdir ? tmpdir : "/tmp")
+          / ("socket-ts."+boost::lexical_cast<std::string>(getuid()));
+}
+
+
+
+
+TaskSpoolerClient::TaskSpoolerClient(const boost::filesystem::path& socket)
+: socket_(socket),
+  versionChecked_(false)
+{}
+
+
+
+
+int TaskSpoolerClient::connectSocket() const
+{
+  std::string p=socket_.string();
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  if (p.size()>=sizeof(addr.sun_path))
+  {
+    throw insight::Exception("Task spooler socket path too long: "+p);
+  }
+  strcpy(addr.sun_path, p.c_str());
+
+  int s=::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s<0)
+  {
+    throw insight::Exception(std::string("Could not create socket: ")+strerror(errno));
+  }
+  if (::connect(s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))!=0)
+  {
+    int err=errno;
+    close(s);
+    if ( (err==ENOENT) || (err==ECONNREFUSED) )
+    {
+      return -1;
+    }
+    throw insight::Exception("Could not connect to task spooler server at "+p+": "+strerror(err));
+  }
+  return s;
+}
+
+
+
+
+void TaskSpoolerClient::checkVersion(int s) const
+{
+  if (!versionChecked_)
+  {
+    Message a=request(s, Message(GET_VERSION));
+    if ( (a.type!=VERSION) || (a.u.version!=protocolVersion) )
+    {
+      throw insight::Exception(boost::str(boost::format(
+        "Wrong task spooler server version at %s: received %d, expecting %d")
+         % socket_.string() % a.u.version % protocolVersion));
+    }
+    versionChecked_=true;
+  }
+}
+
+
+
+
+int TaskSpoolerClient::connect() const
+{
+  int s=connectSocket();
+  if (s<0)
+  {
+    throw insight::Exception("Could not connect to task spooler server at "+socket_.string()+"!");
+  }
+
+  try
+  {
+    checkVersion(s);
+  }
+  catch (...)
+  {
+    close(s);
+    throw;
+  }
+
+  return s;
+}
+
+
+
+
+bool TaskSpoolerClient::serverRunning() const
+{
+  int s=connectSocket();
+  if (s<0)
+  {
+    return false;
+  }
+  Connection c(s);
+  checkVersion(c.fd);
+  return true;
+}
+
+
+
+
+std::vector<TaskSpoolerClient::JobInfo> TaskSpoolerClient::jobs() const
+{
+  Connection c(connect());
+  sendMessage(c.fd, Message(LIST));
+
+  // the server closes the connection after the last line
+  std::vector<JobInfo> jl;
+  boost::regex re("^([0-9]+) +([^ ]+) +([^ ]+) +(.*)$");
+  Message m;
+  while (receiveMessage(c.fd, m))
+  {
+    if (m.type!=LIST_LINE)
+    {
+      throwRequestError(c.fd, m, "job listing");
+    }
+    std::string line=receiveLine(c.fd, m);
+    boost::smatch r;
+    if (boost::regex_match(line, r, re)) // not the header
+    {
+      JobInfo j;
+      j.id=boost::lexical_cast<int>(r[1]);
+      j.state=jobState(std::string(r[2]));
+      j.output=r[3];
+      j.remainder=r[4];
+      jl.push_back(j);
+    }
+  }
+  return jl;
+}
+
+
+
+
+TaskSpoolerClient::JobState TaskSpoolerClient::state(int jobid) const
+{
+  Connection c(connect());
+  Message m(GET_STATE);
+  m.u.jobid=jobid;
+  Message a=request(c.fd, m);
+  if (a.type!=ANSWER_STATE)
+  {
+    throwRequestError(c.fd, a, "state query");
+  }
+  return jobState(a.u.state);
+}
+
+
+
+
+int TaskSpoolerClient::pid(int jobid) const
+{
+  Connection c(connect());
+  Message m(ASK_OUTPUT);
+  m.u.jobid=jobid;
+  Message a=request(c.fd, m);
+  if (a.type!=ANSWER_OUTPUT)
+  {
+    throwRequestError(c.fd, a, "pid query");
+  }
+  return a.u.output.pid;
+}
+
+
+
+
+int TaskSpoolerClient::enqueue(const std::vector<std::string>& command, const std::string& label) const
+{
+  boost::filesystem::path tsp=boost::process::search_path("tsp");
+  if (tsp.empty())
+  {
+    throw insight::Exception("Could not find task spooler executable!");
+  }
+
+  std::vector<std::string> args;
+  if (!label.empty())
+  {
+    args.push_back("-L");
+    args.push_back(label);
+  }
+  args.insert(args.end(), command.begin(), command.end());
+
+  boost::process::environment env=boost::this_process::environment();
+  env["TS_SOCKET"]=socket_.string();
+
+  // tsp prints the job id and continues in the background
+  boost::process::ipstream is;
+  boost::process::child c(tsp, boost::process::args(args), env, boost::process::std_out > is);
+  std::string line;
+  std::getline(is, line);
+  c.wait();
+
+  try
+  {
+    return boost::lexical_cast<int>(boost::algorithm::trim_copy(line));
+  }
+  catch (...)
+  {
+    throw insight::Exception("Could not enqueue job, unexpected output of task spooler: "+line);
+  }
+}
+
+
+
+
+void TaskSpoolerClient::remove(int jobid) const
+{
+  Connection c(connect());
+  Message m(REMOVEJOB);
+  m.u.jobid=jobid;
+  Message a=request(c.fd, m);
+  if (a.type!=REMOVEJOB_OK)
+  {
+    throwRequestError(c.fd, a, "removal of job "+boost::lexical_cast<std::string>(jobid));
+  }
+}
+
+
+
+
+bool TaskSpoolerClient::kill(int jobid) const
+{
+  // the server also reports the pid of finished jobs,
+  // whose process group might have been reused meanwhile
+  if (state(jobid)!=Running)
+  {
+    return false;
+  }
+  int p=pid(jobid);
+  if (p<=0)
+  {
+    throw insight::Exception(boost::str(boost::format(
+      "Task spooler: job %d has no process (pid %d)") % jobid % p));
+  }
+  // the pid is that of the process group
+  if ( (::kill(-p, SIGTERM)!=0) && (errno!=ESRCH) )
+  {
+    throw insight::Exception(boost::str(boost::format(
+      "Task spooler: could not terminate job %d (pid %d): %s") % jobid % p % strerror(errno)));
+  }
+  return true;
+}
+
+
+
+
+void TaskSpoolerClient::clearFinished() const
+{
+  Connection c(connect());
+  sendMessage(c.fd, Message(CLEAR_FINISHED));
+}
+
+
+
+
+bool TaskSpoolerClient::wait(int jobid, int* errorlevel, int timeout) const
+{
+  Connection c(connect());
+  Message m(WAITJOB);
+  m.u.jobid=jobid;
+  sendMessage(c.fd, m);
+
+  struct pollfd pfd;
+  pfd.fd=c.fd;
+  pfd.events=POLLIN;
+  int r;
+  do
+  {
+    r=poll(&pfd, 1, timeout);
+  }
+  while ( (r<0) && (errno==EINTR) );
+  if (r==0) return false;
+
+  Message a;
+  if (!receiveMessage(c.fd, a))
+  {
+    throw insight::Exception("Task spooler server closed the connection without an answer!");
+  }
+  if (a.type!=WAITJOB_OK)
+  {
+    throwRequestError(c.fd, a, "waiting for job "+boost::lexical_cast<std::string>(jobid));
+  }
+  if (errorlevel) *errorlevel=a.u.result.errorlevel;
+  return true;
+}
+
+
+
+
+void TaskSpoolerClient::cancelAllJobs(int timeout) const
+{
+  std::vector<JobInfo> jl=jobs();
+
+  // dequeue first, so that no queued job is started by the termination of a running one
+  std::vector<int> running;
+  for (const JobInfo& j: jl)
+  {
+    if (j.state==Queued)
+    {
+      try
+      {
+        remove(j.id);
+      }
+      catch (const insight::Exception&)
+      {
+        running.push_back(j.id); // has been started meanwhile
+      }
+    }
+    else if (j.state==Running)
+    {
+      running.push_back(j.id);
+    }
+  }
+
+  for (int id: running)
+  {
+    try
+    {
+      if (!kill(id)) continue; // finished meanwhile
+      if (!wait(id, NULL, timeout))
+      {
+        insight::Warning(boost::str(boost::format("Task spooler job %d did not terminate!") % id));
+      }
+    }
+    catch (const insight::Exception& e)
+    {
+      insight::Warning(e.what());
+    }
+  }
+
+  clearFinished();
+}
+
+
+
+
+TaskSpoolerJobWatcher::TaskSpoolerJobWatcher
+(
+    const TaskSpoolerClient& client,
+    FinishedCallback finished,
+    size_t maxConnections,
+    int pollInterval
+)
+: client_(client),
+  finished_(finished),
+  maxConnections_(maxConnections),
+  pollInterval_(pollInterval),
+  nConnections_(0),
+  nWatched_(0),
+  stop_(false)
+{
+  if (pipe(wakeup_)!=0)
+  {
+    throw insight::Exception(std::string("Could not create pipe: ")+strerror(errno));
+  }
+  thread_=std::thread(&TaskSpoolerJobWatcher::run, this);
+}
+
+
+
+
+TaskSpoolerJobWatcher::~TaskSpoolerJobWatcher()
+{
+  stop_=true;
+  wakeup();
+  thread_.join();
+
+  for (const auto& p: pending_) close(p.first);
+  close(wakeup_[0]);
+  close(wakeup_[1]);
+}
+
+
+
+
+void TaskSpoolerJobWatcher::wakeup()
+{
+  char c=0;
+  while ( (write(wakeup_[1], &c, 1)<0) && (errno==EINTR) ) ;
+}
+
+
+
+
+void TaskSpoolerJobWatcher::watch(int jobid)
+{
+  bool connection=false;
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    if (nConnections_>=maxConnections_)
+    {
+      polled_.insert(jobid);
+      ++nWatched_;
+    }
+    else
+    {
+      // reserve a connection
+      ++nConnections_;
+      connection=true;
+    }
+  }
+
+  if (connection)
+  {
+    int s=-1;
+    try
+    {
+      s=client_.connect();
+      Message m(WAITJOB);
+      m.u.jobid=jobid;
+      sendMessage(s, m);
+    }
+    catch (...)
+    {
+      if (s>=0) close(s);
+      std::lock_guard<std::mutex> l(mtx_);
+      --nConnections_;
+      throw;
+    }
+
+    std::lock_guard<std::mutex> l(mtx_);
+    pending_[s]=jobid;
+    ++nWatched_;
+  }
+  wakeup();
+}
+
+
+
+
+void TaskSpoolerJobWatcher::notifyFinished(int jobid, int errorlevel)
+{
+  --nWatched_;
+  try
+  {
+    finished_(jobid, errorlevel);
+  }
+  catch (const std::exception& e)
+  {
+    insight::Warning(std::string("Task spooler job watcher: error in callback: ")+e.what());
+  }
+}
+
+
+
+
+void TaskSpoolerJobWatcher::pollStates()
+{
+  std::set<int> jobs;
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    jobs=polled_;
+  }
+
+  std::map<int, int> finished; // jobid => errorlevel
+  try
+  {
+    Connection c(client_.connect());
+    for (int jobid: jobs)
+    {
+      Message m(GET_STATE);
+      m.u.jobid=jobid;
+      Message a=request(c.fd, m);
+      if (a.type!=ANSWER_STATE)
+      {
+        // e.g. removed from the queue
+        try
+        {
+          throwRequestError(c.fd, a, "state query of job "+boost::lexical_cast<std::string>(jobid));
+        }
+        catch (const insight::Exception& e)
+        {
+          insight::Warning(e.what());
+        }
+        finished[jobid]=-1;
+      }
+      else
+      {
+        TaskSpoolerClient::JobState st=jobState(a.u.state);
+        if ( (st==TaskSpoolerClient::Finished) || (st==TaskSpoolerClient::Skipped) )
+        {
+          // answered at once for finished jobs
+          Message w(WAITJOB);
+          w.u.jobid=jobid;
+          Message r=request(c.fd, w);
+          if (r.type!=WAITJOB_OK)
+          {
+            throwRequestError(c.fd, r, "waiting for job "+boost::lexical_cast<std::string>(jobid));
+          }
+          finished[jobid]=r.u.result.errorlevel;
+        }
+      }
+    }
+  }
+  catch (const insight::Exception& e)
+  {
+    // the server is gone: the remaining jobs will never be reported
+    insight::Warning(std::string("Task spooler job watcher: polling job states failed: ")+e.what());
+    for (int jobid: jobs)
+    {
+      finished.insert(std::make_pair(jobid, -1));
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    for (const auto& f: finished) polled_.erase(f.first);
+  }
+  for (const auto& f: finished)
+  {
+    notifyFinished(f.first, f.second);
+  }
+}
+
+
+
+
+void TaskSpoolerJobWatcher::run()
+{
+  std::vector<struct pollfd> fds;
+  auto lastPoll=std::chrono::steady_clock::now();
+
+  while (!stop_)
+  {
+    bool anyPolled;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      watched_.insert(pending_.begin(), pending_.end());
+      pending_.clear();
+      anyPolled=!polled_.empty();
+    }
+
+    fds.resize(1+watched_.size());
+    fds[0].fd=wakeup_[0];
+    fds[0].events=POLLIN;
+    size_t k=1;
+    for (const auto& w: watched_)
+    {
+      fds[k].fd=w.first;
+      fds[k].events=POLLIN;
+      k++;
+    }
+
+    if (poll(&fds[0], fds.size(), anyPolled ? pollInterval_ : -1)<0)
+    {
+      if (errno==EINTR) continue;
+      insight::Warning(std::string("Task spooler job watcher: poll failed: ")+strerror(errno));
+      break;
+    }
+
+    if (fds[0].revents)
+    {
+      char buf[64];
+      if (read(wakeup_[0], buf, sizeof(buf))<0) {}
+    }
+
+    for (k=1; k<fds.size(); k++)
+    {
+      if (!fds[k].revents) continue;
+
+      int s=fds[k].fd;
+      int jobid=watched_[s];
+      int errorlevel=-1;
+      try
+      {
+        Message a;
+        if (!receiveMessage(s, a))
+        {
+          throw insight::Exception(boost::str(boost::format(
+            "Task spooler server closed the connection without reporting the end of job %d!") % jobid));
+        }
+        if (a.type!=WAITJOB_OK)
+        {
+          throwRequestError(s, a, "waiting for job "+boost::lexical_cast<std::string>(jobid));
+        }
+        errorlevel=a.u.result.errorlevel;
+      }
+      catch (const insight::Exception& e)
+      {
+        insight::Warning(e.what());
+      }
+
+      close(s);
+      watched_.erase(s);
+      {
+        std::lock_guard<std::mutex> l(mtx_);
+        --nConnections_;
+      }
+
+      // also called, if the result is unknown, so that nobody waits forever
+      notifyFinished(jobid, errorlevel);
+    }
+
+    if ( anyPolled && !stop_
+         && (std::chrono::steady_clock::now()-lastPoll >= std::chrono::milliseconds(pollInterval_)) )
+    {
+      pollStates();
+      lastPoll=std::chrono::steady_clock::now();
+    }
+  }
+
+  for (const auto& w: watched_) close(w.first);
+  watched_.clear();
+}
+
+
+}
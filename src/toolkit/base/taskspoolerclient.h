@@ -0,0 +1,222 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#ifndef INSIGHT_TASKSPOOLERCLIENT_H
+#define INSIGHT_TASKSPOOLERCLIENT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "base/boost_include.h"
+
+namespace insight
+{
+
+
+/**
+ * Client for the task spooler server (src/taskspooler), which exchanges
+ * the binary messages of the server protocol directly over its socket,
+ * instead of running the "tsp" executable for each request.
+ *
+ * Each request uses a new connection, as the server closes some of them
+ * after the answer. Only enqueuing launches "tsp": in the task spooler
+ * design, the enqueuing client process executes the job and reports its end.
+ */
+class TaskSpoolerClient
+{
+public:
+  /**
+   * keep in sync with enum Jobstate in taskspooler/main.h
+   */
+  enum JobState { Queued, Running, Finished, Skipped, HoldingClient, Unknown };
+
+  struct JobInfo
+  {
+    int id;
+    JobState state;
+    std::string output;
+    /**
+     * errorlevel, times and command, as listed by the server
+     */
+    std::string remainder;
+  };
+
+  /**
+   * version of the server protocol, which is understood by this client
+   */
+  static const int protocolVersion;
+
+protected:
+  boost::filesystem::path socket_;
+  mutable std::atomic<bool> versionChecked_;
+
+  /**
+   * socket connected to the server, -1 if no server is listening
+   * (socket file missing or connection refused)
+   */
+  int connectSocket() const;
+
+  /**
+   * throws, if the server speaks a different protocol version.
+   * Asks only once per client.
+   */
+  void checkVersion(int s) const;
+
+  /**
+   * connection to the server, checks the protocol version at first use
+   */
+  int connect() const;
+
+  friend class TaskSpoolerJobWatcher;
+
+public:
+  /**
+   * socket path as used by tsp: $TS_SOCKET or $TMPDIR/socket-ts.<uid>
+   */
+  static boost::filesystem::path defaultSocket();
+
+  TaskSpoolerClient(const boost::filesystem::path& socket = defaultSocket());
+
+  inline const boost::filesystem::path& socket() const { return socket_; }
+
+  /**
+   * true, if a server is listening on the socket.
+   * Throws, if the server has an incompatible protocol version.
+   */
+  bool serverRunning() const;
+
+  /**
+   * all jobs known to the server (queued, running, finished)
+   */
+  std::vector<JobInfo> jobs() const;
+
+  JobState state(int jobid) const;
+
+  /**
+   * pid of the process group of a running job
+   */
+  int pid(int jobid) const;
+
+  /**
+   * queue a command (by "tsp", which holds the job until it is run),
+   * returns the job id
+   */
+  int enqueue(const std::vector<std::string>& command, const std::string& label="") const;
+
+  /**
+   * remove a queued (or finished) job
+   */
+  void remove(int jobid) const;
+
+  /**
+   * terminate a running job (SIGTERM to its process group).
+   * Returns false, if the job is not running (anymore).
+   */
+  bool kill(int jobid) const;
+
+  void clearFinished() const;
+
+  /**
+   * Block until the job is finished and store its exit code in errorlevel
+   * (the server reports nothing else at this point).
+   * Returns false, if the timeout [ms] expired before (negative: no timeout).
+   */
+  bool wait(int jobid, int* errorlevel=NULL, int timeout=-1) const;
+
+  /**
+   * remove the queued jobs, terminate the running ones and clear the list.
+   * Waits at most timeout [ms] for each terminated job.
+   */
+  void cancelAllJobs(int timeout=10000) const;
+};
+
+
+
+
+/**
+ * Event subscription: calls a function, as soon as watched jobs have finished.
+ *
+ * A single thread waits on one server connection per watched job,
+ * the server answers on each connection at the end of the job.
+ * The server accepts only a limited number of connections (at most 1000,
+ * less with a lower descriptor limit) and each queued job holds one of them.
+ * So at most maxConnections jobs are watched this way. The states of all
+ * further jobs are polled every pollInterval [ms] over a single connection.
+ *
+ * The callback is executed in the watcher thread. If the result could not
+ * be received, a warning is issued and the callback gets errorlevel -1.
+ */
+class TaskSpoolerJobWatcher
+{
+public:
+  typedef std::function<void(int jobid, int errorlevel)> FinishedCallback;
+
+protected:
+  const TaskSpoolerClient& client_;
+  FinishedCallback finished_;
+  size_t maxConnections_;
+  int pollInterval_;
+
+  std::mutex mtx_;
+  std::map<int, int> pending_; // socket => jobid, not yet polled
+  std::map<int, int> watched_; // socket => jobid
+  std::set<int> polled_; // jobids beyond the connection limit
+  size_t nConnections_;
+  std::atomic<size_t> nWatched_;
+  std::atomic<bool> stop_;
+  int wakeup_[2];
+  std::thread thread_;
+
+  void run();
+  void wakeup();
+
+  /**
+   * query the states of the jobs in polled_ and report the finished ones
+   */
+  void pollStates();
+  void notifyFinished(int jobid, int errorlevel);
+
+public:
+  TaskSpoolerJobWatcher
+  (
+      const TaskSpoolerClient& client,
+      FinishedCallback finished,
+      size_t maxConnections=32,
+      int pollInterval=1000
+  );
+  ~TaskSpoolerJobWatcher();
+
+  void watch(int jobid);
+
+  inline size_t nWatched() const { return nWatched_; }
+};
+
+
+}
+
+#endif // INSIGHT_TASKSPOOLERCLIENT_H
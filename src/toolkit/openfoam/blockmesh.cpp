@@ -70,22 +70,96 @@ void Point::operator=(const arma::mat& m)
   mat::operator=(m);
 }*/
 
-bool compare(const Point& v1, const Point& v2)
+const double PointMap::tolerance=SMALL;
+
+namespace
 {
-  if ( fabs(v1(0) - v2(0))<SMALL )
-    {
-      if ( fabs(v1(1) - v2(1))<SMALL )
+// hash grid cell size, much larger than the tolerance
+const double cellSize=1e4*SMALL;
+}
+
+
+size_t PointMap::CellHash::operator()(const Cell& c) const
+{
+  size_t h=0;
+  boost::hash_combine(h, c[0]);
+  boost::hash_combine(h, c[1]);
+  boost::hash_combine(h, c[2]);
+  return h;
+}
+
+PointMap::Cell PointMap::cell(const Point& p, double ofs)
+{
+  Cell c;
+  for (int k=0; k<3; k++)
+  {
+    c[k]=static_cast<long long>(std::floor((p(k)+ofs)/cellSize));
+  }
+  return c;
+}
+
+bool PointMap::samePoint(const Point& p1, const Point& p2)
+{
+  return (fabs(p1(0)-p2(0))<tolerance)
+      && (fabs(p1(1)-p2(1))<tolerance)
+      && (fabs(p1(2)-p2(2))<tolerance);
+}
+
+int PointMap::index(const Point& p) const
+{
+  // the tolerance box touches at most two cells per direction
+  Cell lo=cell(p, -tolerance), hi=cell(p, tolerance), c;
+  int found=-1;
+  for (c[0]=lo[0]; c[0]<=hi[0]; c[0]++)
+    for (c[1]=lo[1]; c[1]<=hi[1]; c[1]++)
+      for (c[2]=lo[2]; c[2]<=hi[2]; c[2]++)
+      {
+        auto g=grid_.find(c);
+        if (g!=grid_.end())
         {
-          if (fabs(v1(2)-v2(2))<SMALL)
+          for (int i: g->second)
           {
-              //return v1.instance_ < v2.instance_;
-              return false;
+            if ( ((found<0)||(i<found)) && samePoint(points_[i].first, p) )
+              found=i;
           }
-          else return v1(2)<v2(2);
         }
-      else return v1(1)<v2(1);
-    }
-  else return v1(0)<v2(0);
+      }
+  return found;
+}
+
+PointMap::iterator PointMap::find(const Point& p)
+{
+  int i=index(p);
+  return i<0 ? points_.end() : points_.begin()+i;
+}
+
+PointMap::const_iterator PointMap::find(const Point& p) const
+{
+  int i=index(p);
+  return i<0 ? points_.end() : points_.begin()+i;
+}
+
+int& PointMap::operator[](const Point& p)
+{
+  int i=index(p);
+  if (i<0)
+  {
+    i=points_.size();
+    points_.push_back(value_type(p, 0));
+    grid_[cell(p)].push_back(i);
+  }
+  return points_[i].second;
+}
+
+
+void EdgeIndex::insert(int i0, int i1)
+{
+  edges_.insert(std::make_pair(std::min(i0, i1), std::max(i0, i1)));
+}
+
+bool EdgeIndex::contains(int i0, int i1) const
+{
+  return edges_.count(std::make_pair(std::min(i0, i1), std::max(i0, i1)))>0;
 }
 
 
@@ -478,7 +552,7 @@ mat wedge2D::rvs(const mat& p) const
 Block2D::Block2D
 (
   transform2D& t2d, 
-  PointList corners, 
+  const std::vector<arma::mat>& corners, 
   int resx, int resy, 
   GradingList grading, 
   std::string zone, 
@@ -1051,7 +1125,7 @@ Patch2D::Patch2D(const transform2D& t2d, std::string typ)
 {
 }
 
-void Patch2D::addFace(const Point& c0, const Point& c1)
+void Patch2D::addFace(const arma::mat& c0, const arma::mat& c1)
 {
     Patch::addFace
     (
@@ -1129,8 +1203,7 @@ blockMesh::blockMesh(OpenFOAMCase& c)
 : OpenFOAMCaseElement(c, "blockMesh"),
   scaleFactor_(1.0),
   defaultPatchName_("defaultFaces"),
-  defaultPatchType_("wall"),
-  allPoints_(compare)
+  defaultPatchType_("wall")
 {
 }
 
@@ -1192,12 +1265,8 @@ void blockMesh::numberVertices(PointMap& pts) const
 
 bool blockMesh::hasEdgeBetween(const Point& p1, const Point& p2) const
 {
-  for (const auto& e: allEdges_)
-    {
-      if (e.connectsPoints(p1, p2))
-        return true;
-    }
-  return false;
+  int i0=allPoints_.index(p1), i1=allPoints_.index(p2);
+  return (i0>=0) && (i1>=0) && edgeIndex_.contains(i0, i1);
 }
 
 OFDictData::dict& blockMesh::getBlockMeshDict(insight::OFdicts& dictionaries) const
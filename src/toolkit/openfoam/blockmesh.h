@@ -32,8 +32,13 @@
 #include <cmath>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
 #include <armadillo>
 
+#include "boost/functional/hash.hpp"
+
 namespace insight {
   
 namespace bmd
@@ -47,18 +52,86 @@ class blockMesh;
 
 
 
-typedef arma::mat Point;
+/**
+ * fixed size, no heap allocation
+ */
+typedef arma::vec::fixed<3> Point;
 
 
 
-typedef bool (*Comp)(const Point& v1, const Point& v2);
-bool compare(const Point& v1, const Point& v2);
 
+typedef std::vector<Point> PointList;
 
 
 
-typedef std::vector<Point> PointList;
-typedef std::map<Point, int, Comp> PointMap;
+
+/**
+ * Vertex directory: points, which coincide within a small tolerance
+ * (in each coordinate), are merged into the first inserted one.
+ *
+ * The points are kept in insertion order. The lookup uses a hash grid,
+ * whose cells are larger than the tolerance, so that only the cells
+ * touched by the tolerance box around the query point need to be searched.
+ */
+class PointMap
+{
+public:
+  typedef std::pair<Point, int> value_type;
+  typedef std::vector<value_type>::iterator iterator;
+  typedef std::vector<value_type>::const_iterator const_iterator;
+
+  static const double tolerance;
+
+protected:
+  typedef std::array<long long, 3> Cell;
+
+  struct CellHash
+  {
+    size_t operator()(const Cell& c) const;
+  };
+
+  std::vector<value_type> points_;
+  std::unordered_map<Cell, std::vector<int>, CellHash> grid_;
+
+  static Cell cell(const Point& p, double ofs=0.);
+
+public:
+  static bool samePoint(const Point& p1, const Point& p2);
+
+  /**
+   * position of the (merged) point in insertion order, -1 if not present
+   */
+  int index(const Point& p) const;
+
+  iterator find(const Point& p);
+  const_iterator find(const Point& p) const;
+
+  /**
+   * value of the point. The point is inserted, if not present.
+   */
+  int& operator[](const Point& p);
+
+  inline iterator begin() { return points_.begin(); }
+  inline iterator end() { return points_.end(); }
+  inline const_iterator begin() const { return points_.begin(); }
+  inline const_iterator end() const { return points_.end(); }
+  inline size_t size() const { return points_.size(); }
+};
+
+
+
+
+/**
+ * Edges, identified by the unordered pair of their vertex indices
+ */
+class EdgeIndex
+{
+  std::unordered_set<std::pair<int, int>, boost::hash<std::pair<int, int> > > edges_;
+
+public:
+  void insert(int i0, int i1);
+  bool contains(int i0, int i1) const;
+};
 
 
 
@@ -254,7 +327,7 @@ public:
     Block2D
     (
       transform2D& t2d, 
-      PointList corners, 
+      const std::vector<arma::mat>& corners, 
       int resx, int resy, 
       GradingList grading = GradingList(3, 1), 
       std::string zone="", 
@@ -440,7 +513,7 @@ protected:
   
 public:
     Patch2D(const transform2D& t2d, std::string typ="patch");   
-    void addFace(const Point& c0, const Point& c1);
+    void addFace(const arma::mat& c0, const arma::mat& c1);
 };
 
 /*
@@ -521,6 +594,7 @@ protected:
   PointMap allPoints_;
   boost::ptr_vector<Block> allBlocks_;
   boost::ptr_vector<Edge> allEdges_;
+  EdgeIndex edgeIndex_;
   PatchMap allPatches_;
   
 public:
@@ -554,6 +628,7 @@ public:
   inline Edge& addEdge(Edge *edge) 
   { 
     edge->registerPoints(*this);
+    edgeIndex_.insert(allPoints_.index(edge->c0()), allPoints_.index(edge->c1()));
     allEdges_.push_back(edge);
     return *edge;
   }
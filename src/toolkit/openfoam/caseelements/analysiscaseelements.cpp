@@ -21,6 +21,7 @@
 #include "openfoam/caseelements/analysiscaseelements.h"
 #include "openfoam/openfoamcase.h"
 #include "openfoam/openfoamtools.h"
+#include "base/tabulardatareader.h"
 
 #include <utility>
 #include "boost/assign.hpp"
@@ -166,20 +167,6 @@ OFDictData::dict probes::functionObjectDict() const
 }
 
 
-arma::mat readTensor(std::istream& is)
-{
-  std::vector<double> data;
-  string s;
-  do {
-    is >> s;
-    if (is.fail()) break;
-    double d; std::istringstream(s) >> d;
-    data.push_back(d);
-  } while (!is.eof() && !ends_with(s, ")"));
-  
-  return arma::mat(data.data(), 1, data.size());
-}
-
 arma::cube probes::readProbes 
 ( 
     const OpenFOAMCase& c,
@@ -188,13 +175,6 @@ arma::cube probes::readProbes
     const std::string& fieldName 
 )
 {
-  typedef std::vector<arma::mat> Instant;
-  typedef std::map<double, Instant> History;
-  
-  History sample_history;
-  int ncmpt=-1, npts=-1;
-  
-  
   path fp = absolute ( location ) /"postProcessing"/foName;
   
   if ( c.OFversion() < 400 )
@@ -203,90 +183,82 @@ arma::cube probes::readProbes
   if (!exists(fp))
       throw insight::Exception("data path of function object "+foName+" does not exist!");
   
-  // find all time directories
+  // read the data from all time directories
+  std::vector<arma::mat> parts;
+  arma::uword ncols=0, ncmpt=1;
+  
   TimeDirectoryList tdl=listTimeDirectories ( fp );
   for ( const TimeDirectoryList::value_type& td: tdl )
   {
     boost::filesystem::path ffp = td.second/fieldName;
 
     if (!exists(ffp))
+    {
         insight::Warning("field "+fieldName+" was not found in time directory "+td.second.string()+" of probes function object "+foName+"!");
-        
-    std::ifstream f( ffp.c_str() );
-    while ( !f.eof() )
+        continue;
+    }
+    
+    TabularDataReader reader(ffp);
+    if (ncols>0) reader.setExpectedColumns(ncols);
+    arma::mat d = reader.readAll();
+    
+    if (reader.nSkippedRows()>0)
+        throw insight::Exception(str(format(
+            "incorrect number of values in %d lines of probes data file %s! (expected %d)"
+        ) % reader.nSkippedRows() % ffp.string() % reader.nCols() ));
+    
+    if (d.n_rows>0)
     {
-        std::string line;
-
-        getline ( f, line );
-        if ( f.fail() ) break;
-        if ( !starts_with ( line, "#" ) )
+        if (ncols==0)
         {
-            std::istringstream os(line);
-
-            double time;
-            os >> time;
-
-            Instant cur_data;
-            while (!os.eof())
-            {
-                arma::mat v;
-                char c;
-                os >> c;
-                if (c=='(')
-                {
-                    v = readTensor(os);
-                }
-                else
-                {
-                    os.unget();
-                    v=arma::zeros(1);
-                    os >> v(0);
-                }
-
-                if (ncmpt>0) // check num of compt
-                {
-                    if (ncmpt!=v.n_elem)
-                        throw std::string("incorrect number of components in probes data! (@time %g: found %d, expected %d)");
-                }
-                else
-                {
-                    ncmpt=v.n_elem;
-                }
-
-                cur_data.push_back(v);
-            }
-
-            if (npts>0) // check number of sample points
-            {
-                if (npts!=cur_data.size())
-                    throw std::string("incorrect number of sample points in probes data! (@time %g: found %d, expected %d)");
-            }
-            else
-            {
-                npts=cur_data.size();
-            }
-
-            sample_history[time]=cur_data;
-
+            ncols=reader.nCols();
+            ncmpt=reader.bracketGroupSize();
         }
+        parts.push_back(d);
     }
   }
+  
+  if ( (ncols==0) || ((ncols-1)%ncmpt!=0) )
+  {
+      return arma::cube();
+  }
+  arma::uword npts=(ncols-1)/ncmpt;
+  
+  arma::mat all;
+  if (parts.size()==1) 
+  {
+      all=parts[0];
+  }
+  else
+  {
+      for (const arma::mat& part: parts) 
+          all=arma::join_cols(all, part);
+  }
+  parts.clear();
 
-  int ninstants=sample_history.size();
+  // sort by time, keep the last (i.e. the most recent) sample of duplicate times
+  arma::uvec idx=arma::stable_sort_index(all.col(0));
+  std::vector<arma::uword> sel;
+  sel.reserve(idx.n_elem);
+  for (arma::uword i=0; i<idx.n_elem; i++)
+  {
+      if ( (i+1<idx.n_elem) && (all(idx(i+1),0)==all(idx(i),0)) ) continue;
+      sel.push_back(idx(i));
+  }
 
-  arma::cube data = arma::zeros(ninstants, npts+1, ncmpt);
-  int i=0;
-  for (const History::value_type& instant: sample_history)
+  arma::uword ninstants=sel.size();
+  arma::cube data(ninstants, npts+1, ncmpt);
+  for (arma::uword k=0; k<ncmpt; k++)
   {
-    int j=0;
-    for (int k=0; k<ncmpt; k++) data(i, 0, k)=instant.first;
-        
-    for (const Instant::value_type& sample: instant.second)
-    {
-        for (int k=0; k<ncmpt; k++) data(i, j+1, k)=sample(k);
-        j+=1;
-    }
-    i+=1;
+      for (arma::uword i=0; i<ninstants; i++)
+          data(i, 0, k)=all(sel[i], 0);
+      
+      for (arma::uword j=0; j<npts; j++)
+      {
+          const double* src=all.colptr(1+j*ncmpt+k);
+          for (arma::uword i=0; i<ninstants; i++)
+              data(i, j+1, k)=src[sel[i]];
+      }
   }
     
   return data;
@@ -721,48 +693,6 @@ void forces::addIntoDictionaries(OFdicts& dictionaries) const
 }
 
 
-arma::mat readForcesLine(std::istream& f, int nc_expected, bool& skip)
-{
-  std::string line;
-
-  getline ( f, line );
-//   std::cout<<"RAW: "<<line<<std::endl;
-  
-  if ( f.fail() ) return arma::mat();
-
-  if ( starts_with ( line, "#" ) ) { skip=true; return arma::mat(); };
-
-  erase_all ( line, "(" );
-  erase_all ( line, ")" );
-  replace_all ( line, ",", " " );
-  replace_all ( line, "\t", " " );
-  while (line.find("  ")!=std::string::npos)
-  {
-    replace_all ( line, "  ", " " );
-  }
-//   std::cout<<"CLEAN: "<<line<<std::endl;
-
-  std::vector<string> strs;
-  boost::split ( strs, line, boost::is_any_of ( " " ) );
-
-  if ( strs.size() != nc_expected ) 
-  {
-//       std::cout<<"found "<<strs.size()<<" fields, expected "<<nc_expected<<std::endl;
-      return arma::mat();
-  }
-
-  arma::mat row;
-  row.set_size ( 1, strs.size() );
-
-  int k=0;
-  for ( const string& e: strs )
-  {
-    row ( 0, k++ ) =lexical_cast<double> ( e );
-  }
-  
-  return row;
-}
-
 arma::mat forces::readForces ( const OpenFOAMCase& c, const boost::filesystem::path& location, const std::string& foName )
 {
   arma::mat fl;
@@ -781,85 +711,53 @@ arma::mat forces::readForces ( const OpenFOAMCase& c, const boost::filesystem::p
 
   for ( const TimeDirectoryList::value_type& td: tdl )
   {
-    std::ifstream f, f2;
+    arma::mat rows;
+    
     if ( c.OFversion() >=300 )
       {
-        f.open ( ( td.second/"force.dat" ).c_str() );
-        f2.open ( ( td.second/"moment.dat" ).c_str() );
+        if ( !exists(td.second/"force.dat") || !exists(td.second/"moment.dat") ) continue;
+        
+        TabularDataReader fr ( td.second/"force.dat" ), mr ( td.second/"moment.dat" );
+        fr.setExpectedColumns(ncexp);
+        mr.setExpectedColumns(ncexp);
+        arma::mat r1=fr.readAll();
+        arma::mat r2=mr.readAll();
+        
+        arma::uword n=std::min(r1.n_rows, r2.n_rows);
+        if (n>0)
+        {
+          // make compatible with earlier OF versions:
+          // remove total force, total moment and time column of moments
+          rows=arma::join_rows
+          (
+            arma::join_rows( r1.submat(0, 0, n-1, 0), r1.submat(0, 4, n-1, ncexp-1) ),
+            r2.submat(0, 4, n-1, ncexp-1)
+          );
+        }
       }
     else
       {
-        f.open ( ( td.second/"forces.dat" ).c_str() );
-      }
-
-    while ( !f.eof() )
-      {
-
-        bool skip=false;
-
-        arma::mat row;
-        if ( c.OFversion() >=300 )
-          {
-            arma::mat r1=readForcesLine ( f, ncexp, skip );
-            arma::mat r2=readForcesLine ( f2, ncexp, skip );
-//             std::cout<<r1<<r2<<std::endl;
-            if ( (r1.n_cols==0) || (r2.n_cols==0) )
-            {
-                if ( !skip ) break;
-            }
-            else
-            {
-                // make compatible with earlier OF versions
-                r1.shed_cols(1,3); // remove total force
-                r2.shed_cols(1,3); // remove total moment
-                r2.shed_col(0); // remove time column
-//                 if (r1.n_cols==7) // append porosity columns, if not present
-//                 {
-//                     arma::mat rm=arma::join_rows(r1, arma::zeros(1,3));
-//                     r1=rm;
-//                 }
-//                 if (r2.n_cols==7) // append porosity columns, if not present
-//                 {
-//                     arma::mat rm=arma::join_rows(r2, arma::zeros(1,3));
-//                     r2=rm;
-//                 }
-                
-                row=arma::join_rows ( r1, r2 );
-//     std::cout<<"r="<<row<<std::endl;
-                
-            }
-          }
-        else
-          {
-            row=readForcesLine ( f, ncexp, skip );
-            if ( row.n_cols==0 )
-            {
-                if ( !skip ) break;
-            }
-            else
-            {
-                if ( c.OFversion() >=220 )
-                {
-                    // remove porous forces
-                    row.shed_cols ( 16,18 );
-                    row.shed_cols ( 7,9 );
-                } 
-            }
-        }
-
-        if (row.n_cols>0)
+        if ( !exists(td.second/"forces.dat") ) continue;
+        
+        TabularDataReader fr ( td.second/"forces.dat" );
+        fr.setExpectedColumns(ncexp);
+        rows=fr.readAll();
+        
+        if ( (rows.n_rows>0) && (c.OFversion() >=220) )
         {
-         if ( fl.n_rows==0 )
-           {
-             fl=row;
-           }
-         else
-           {
-             fl.resize ( fl.n_rows+1, fl.n_cols );
-             fl.row ( fl.n_rows-1 ) = row;
-           }
-        }
+            // remove porous forces
+            rows.shed_cols ( 16,18 );
+            rows.shed_cols ( 7,9 );
+        } 
       }
+
+    if (rows.n_rows>0)
+    {
+      if ( fl.n_rows==0 )
+        fl=rows;
+      else
+        fl=arma::join_cols(fl, rows);
+    }
   }
 
 //   if ( c.OFversion() >=220 )
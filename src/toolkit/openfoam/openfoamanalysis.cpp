@@ -25,6 +25,8 @@
 
 #include "base/boost_include.h"
 
+#include <fstream>
+
 using namespace boost;
 using namespace boost::assign;
 using namespace boost::filesystem;
@@ -62,6 +64,65 @@ void OpenFOAMAnalysis::cancel()
   stopFlag_=true;
 }
 
+
+namespace
+{
+
+/**
+ * read the cell count from the note in the header of polyMesh/owner
+ */
+double readNumberOfCellsFromOwnerHeader(const boost::filesystem::path& polyMeshDir)
+{
+  path owner=polyMeshDir/"owner";
+  if (!exists(owner)) return 0;
+  
+  std::ifstream f(owner.c_str());
+  std::string line;
+  for (int i=0; i<30 && getline(f, line); i++)
+  {
+    std::string::size_type j=line.find("nCells:");
+    if (j!=std::string::npos)
+    {
+      return atof(line.c_str()+j+7);
+    }
+  }
+  return 0;
+}
+
+}
+
+double OpenFOAMAnalysis::expectedNumberOfCells() const
+{
+  Parameters p(parameters_);
+  
+  if (!p.mesh.linkmesh.empty())
+  {
+    return readNumberOfCellsFromOwnerHeader(p.mesh.linkmesh/"constant"/"polyMesh");
+  }
+  
+  if (executionPath_!="")
+  {
+    return readNumberOfCellsFromOwnerHeader(executionPath_/"constant"/"polyMesh");
+  }
+  
+  return 0;
+}
+
+double OpenFOAMAnalysis::requiredMemory() const
+{
+  return 1e-3*expectedNumberOfCells();
+}
+
+double OpenFOAMAnalysis::expectedCost() const
+{
+  double nc=expectedNumberOfCells();
+  if (nc>0)
+  {
+    return nc;
+  }
+  return Analysis::expectedCost();
+}
+
 OpenFOAMAnalysis::OpenFOAMAnalysis
 (        
     const std::string& name,
@@ -150,6 +211,15 @@ void OpenFOAMAnalysis::applyCustomOptions(OpenFOAMCase& cm, std::shared_ptr<OFdi
 
 void OpenFOAMAnalysis::writeDictsToDisk(OpenFOAMCase& cm, std::shared_ptr<OFdicts>& dicts)
 {
+  Parameters p(parameters_);
+
+  dicts->setFieldFormat
+  (
+    p.run.fieldFormat==Parameters::run_type::fieldFormat_type::binary ?
+      OFDictData::dictFile::Binary : OFDictData::dictFile::ASCII,
+    p.run.compressFields
+  );
+
   cm.createOnDisk(executionPath(), dicts);
   cm.modifyCaseOnDisk(executionPath());
 }
@@ -262,8 +332,7 @@ void OpenFOAMAnalysis::runSolver(ProgressDisplayer* displayer, OpenFOAMCase& cm)
   
   {
     OFDictData::dict controlDict;
-    std::ifstream cdf( (executionPath()/"system"/"controlDict").c_str() );
-    readOpenFOAMDict(cdf, controlDict);
+    readOpenFOAMDict(executionPath()/"system"/"controlDict", controlDict);
     solverName=controlDict.getString("application");
   }
 
@@ -46,6 +46,8 @@ run = set
  mapFrom 	= 	path 	"" 	"Map solution from specified case, if not empty. potentialinit is skipped if specified."
  potentialinit 	= 	bool 	false 	"Whether to initialize the flow field by potentialFoam when no mapping is done"
  evaluateonly	= 	bool 	false 	"Whether to skip solver run and do only the evaluation"
+ fieldFormat	=	selection ( ascii binary ) ascii "Format of the field files, which are written during case creation"
+ compressFields	=	bool 	false 	"Whether to write the field files gzip compressed"
 } "Execution parameters"
 
 mesh = set
@@ -84,6 +86,23 @@ public:
     
     virtual void cancel();
     
+    /**
+     * Number of cells of the mesh. Read from the mesh on disk (or the linked mesh), if present.
+     * Derived analyses may override this by an estimate from their mesh parameters.
+     * Returns 0, if unknown.
+     */
+    virtual double expectedNumberOfCells() const;
+    
+    /**
+     * memory estimate of about 1kB per cell
+     */
+    virtual double requiredMemory() const;
+    
+    /**
+     * cost estimate from the number of cells, if known
+     */
+    virtual double expectedCost() const;
+    
     static ParameterSet defaultParameters();
     virtual boost::filesystem::path setupExecutionEnvironment();
     
@@ -100,6 +119,10 @@ public:
      */
     virtual void applyCustomOptions(OpenFOAMCase& cm, std::shared_ptr<OFdicts>& dicts);
     
+    /**
+     * write the dictionaries, the field files in the format selected by
+     * run/fieldFormat and run/compressFields
+     */
     virtual void writeDictsToDisk(OpenFOAMCase& cm, std::shared_ptr<OFdicts>& dicts);
     
     /**
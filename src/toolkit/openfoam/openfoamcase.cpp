@@ -25,6 +25,12 @@
 #include <base/analysis.h>
 #include "openfoam/openfoamcaseelements.h"
 #include "openfoam/openfoamdict.h"
+#include "openfoam/openfoamdictcache.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <exception>
 
 
 using namespace std;
@@ -91,6 +97,22 @@ OFDictData::dictFile& OFdicts::lookupDict(const std::string& key)
   return *(i->second);
 }
 
+
+
+
+void OFdicts::setFieldFormat(OFDictData::dictFile::Format format, bool compressed)
+{
+  for (OFdicts::iterator i=begin(); i!=end(); i++)
+  {
+    const std::string& cn=i->second->className;
+    if ( (cn.size()>5) && (cn.compare(cn.size()-5, 5, "Field")==0) )
+    {
+      i->second->format=format;
+      i->second->compressed=compressed;
+    }
+  }
+}
+
   
   
   
@@ -111,6 +133,69 @@ const boost::filesystem::path& OFEnvironment::bashrc() const
   return bashrc_;
 }
 
+std::string OFEnvironment::environmentSetupCommands() const
+{
+  return 
+    "source "+bashrc_.string()+";"
+    "export PATH=$PATH:$INSIGHT_BINDIR/$WM_PROJECT-$WM_PROJECT_VERSION;"
+    "export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:$INSIGHT_LIBDIR/$WM_PROJECT-$WM_PROJECT_VERSION;";
+}
+
+const std::vector<std::string>& OFEnvironment::preparedEnvironment() const
+{
+  static boost::mutex mtx;
+  static std::map<std::string, std::vector<std::string> > preparedEnvironments;
+  static std::set<std::string> failedCaptures;
+  
+  boost::mutex::scoped_lock lock(mtx);
+  
+  std::vector<std::string>& penv = preparedEnvironments[bashrc_.string()];
+  
+  if ( penv.empty() 
+       && !failedCaptures.count(bashrc_.string())
+       && !getenv("INSIGHT_NO_ENVIRONMENT_CACHE") )
+  {
+    std::vector<std::string> argv = SoftwareEnvironment::inheritedEnvironment();
+    argv.insert(argv.begin(), "-i");
+    argv.insert(argv.begin(), "env");
+    argv.push_back("bash");
+    argv.push_back("-lc");
+    argv.push_back(environmentSetupCommands()+"env -0");
+    
+    redi::ipstream p_in(argv[0], argv);
+    std::string envdata
+    (
+      (std::istreambuf_iterator<char>(p_in.out())),
+      std::istreambuf_iterator<char>()
+    );
+    p_in.close();
+    
+    if ( p_in.rdbuf()->status()==0 )
+    {
+      std::vector<std::string> vars;
+      boost::split(vars, envdata, boost::is_any_of(std::string(1, '\0')));
+      for (const std::string& v: vars)
+      {
+        // skip variables, which are maintained by the shell itself
+        if ( !v.empty() 
+             && !starts_with(v, "_=") && !starts_with(v, "SHLVL=") 
+             && !starts_with(v, "PWD=") && !starts_with(v, "OLDPWD=") )
+        {
+          penv.push_back(v);
+        }
+      }
+    }
+    
+    if (penv.empty())
+    {
+      failedCaptures.insert(bashrc_.string());
+      insight::Warning("Could not capture the environment of OpenFOAM installation "+bashrc_.string()+". The bashrc will be sourced before each command.");
+    }
+  }
+  
+  return penv;
+}
+
 
 
 
@@ -434,158 +519,250 @@ turbulenceModel::turbulenceModel(OpenFOAMCase& c, const ParameterSet&)
 
 
 
+namespace 
+{
+
+inline const char* skipSpaces(const char* s, const char* e)
+{
+  while ( (s<e) && (*s==' ') ) s++;
+  return s;
+}
+
+/**
+ * returns the position after the literal, if s starts with it, NULL otherwise.
+ * The first char of the literal is matched case insensitive.
+ */
+inline const char* startsWith(const char* s, const char* e, const char* lit, bool ignoreCaseOfFirst=false)
+{
+  if (s>=e) return NULL;
+  if (ignoreCaseOfFirst)
+  {
+    if (tolower(*s)!=tolower(*lit)) return NULL;
+    s++; lit++;
+  }
+  while (*lit)
+  {
+    if ( (s>=e) || (*s!=*lit) ) return NULL;
+    s++; lit++;
+  }
+  return s;
+}
+
+inline bool endsWith(const char* s, const char* e, const char* lit)
+{
+  size_t l=strlen(lit);
+  return ( size_t(e-s)>=l ) && ( strncmp(e-l, lit, l)==0 );
+}
+
+inline bool parseDouble(const char*& s, const char* e, double& v)
+{
+  char* end;
+  v=strtod(s, &end);
+  if ( (end==s) || (end>e) ) return false;
+  s=end;
+  return true;
+}
+
+}
+
+
+
+
+SolverOutputAnalyzer::RuleList& SolverOutputAnalyzer::defaultRules()
+{
+  static RuleList rules;
+  return rules;
+}
+
+void SolverOutputAnalyzer::addDefaultRule(const std::string& trigger, const std::string& pattern, RuleAction action)
+{
+  Rule r;
+  r.trigger=trigger;
+  r.pattern=boost::regex(pattern);
+  r.action=action;
+  defaultRules().push_back(r);
+}
+
 SolverOutputAnalyzer::SolverOutputAnalyzer(ProgressDisplayer& pdisp)
 : pdisp_(pdisp),
   curTime_(nan("NAN")),
   curforcename_(""),
-  curforcesection_(1)
+  curforcesection_(1),
+  rules_(defaultRules())
 {
 }
 
-void SolverOutputAnalyzer::update(const string& line)
+void SolverOutputAnalyzer::addRule(const std::string& trigger, const std::string& pattern, RuleAction action)
 {
-    boost::smatch match;
-    
-    boost::regex p_pattern("^ *[Pp]ressure *: *\\((.*) (.*) (.*)\\)$");
-    boost::regex v_pattern("^ *[Vv]iscous *: *\\((.*) (.*) (.*)\\)$");
-    boost::regex por_pattern("^ *[Pp]orous *: *\\((.*) (.*) (.*)\\)$");
-    boost::regex time_pattern("^Time = (.+)$");
-    boost::regex solver_pattern("^(.+): +Solving for (.+), Initial residual = (.+), Final residual = (.+), No Iterations (.+)$");
-    boost::regex cont_pattern("^time step continuity errors : sum local = (.+), global = (.+), cumulative = (.+)$");
-    boost::regex force_pattern("^(extendedForces|forces) (.+) (output|write):$");
-    boost::regex sw_pattern("^ *[Ss]um of moments");
-    
-        if ( boost::regex_search( line, match, sw_pattern, boost::match_default ) && !curforcename_.empty() )
-        {
-//             std::cout<<"moments:"<<std::endl;
-            curforcesection_=2;
-        }
-        else if ( boost::regex_search( line, match, p_pattern, boost::match_default ) && !curforcename_.empty()  )
-        {
-            double px=lexical_cast<double>(match[1]);
-            double py=lexical_cast<double>(match[2]);
-            double pz=lexical_cast<double>(match[3]);
-            std::cout<<"pres ("<<curforcesection_<<") : "<<px<<" "<<py<<" "<<pz<<std::endl;
-            if (curforcesection_==1)
-            {
-                // force
-                curforcevalue_(0)=px;
-                curforcevalue_(1)=py;
-                curforcevalue_(2)=pz;
-            }
-            else if (curforcesection_==2)
-            {
-                // moment
-                curforcevalue_(6)=px;
-                curforcevalue_(7)=py;
-                curforcevalue_(8)=pz;
-            }
-        }
-        else if ( boost::regex_search( line, match, v_pattern, boost::match_default ) && !curforcename_.empty()  )
-        {
-            double vx=lexical_cast<double>(match[1]);
-            double vy=lexical_cast<double>(match[2]);
-            double vz=lexical_cast<double>(match[3]);
-            std::cout<<"visc ("<<curforcesection_<<") : "<<vx<<" "<<vy<<" "<<vz<<std::endl;
-            if (curforcesection_==1)
-            {
-                // force
-                curforcevalue_(3)=vx;
-                curforcevalue_(4)=vy;
-                curforcevalue_(5)=vz;
-            }
-            else if (curforcesection_==2)
-            {
-                // moment
-                curforcevalue_(9)=vx;
-                curforcevalue_(10)=vy;
-                curforcevalue_(11)=vz;
-            }
-        }
-        else if ( boost::regex_search( line, match, por_pattern, boost::match_default ) && !curforcename_.empty()  )
-        {
-            //
-//       std::cout<<"por ("<<curforcesection_<<") "<<std::endl;
+  Rule r;
+  r.trigger=trigger;
+  r.pattern=boost::regex(pattern);
+  r.action=action;
+  rules_.push_back(r);
+}
 
+void SolverOutputAnalyzer::storeCurrentForce()
+{
+  if (curforcename_.empty()) return;
+  
+  std::cout<<"force="<<curforcevalue_<<std::endl;
+  
+  std::map<std::string, std::vector<std::string> >::iterator k = forceKeys_.find(curforcename_);
+  if (k==forceKeys_.end())
+  {
+    const char* suffixes[] = {
+      "_fpx", "_fpy", "_fpz", "_fvx", "_fvy", "_fvz",
+      "_mpx", "_mpy", "_mpz", "_mvx", "_mvy", "_mvz"
+    };
+    std::vector<std::string> keys;
+    for (int i=0; i<12; i++) keys.push_back(curforcename_+suffixes[i]);
+    k=forceKeys_.insert(std::make_pair(curforcename_, keys)).first;
+  }
+  
+  for (int i=0; i<12; i++)
+  {
+    curProgVars_[k->second[i]]=curforcevalue_(i);
+  }
+  
+  // reset tracker
+  curforcename_="";
+  curforcesection_=1;
+  curforcevalue_=arma::zeros(12);
+}
 
-        }
-        else if ( boost::regex_search( line, match, force_pattern, boost::match_default ) )
-        {
-            std::cout<<"force output recog"<<std::endl;
-            
-            if (!curforcename_.empty()) //(curforcesection_==2)
-            {
-                // end active 
-                std::cout<<"force="<<curforcevalue_<<std::endl;
-
-                // store
-                curProgVars_[curforcename_+"_fpx"]=curforcevalue_(0);
-                curProgVars_[curforcename_+"_fpy"]=curforcevalue_(1);
-                curProgVars_[curforcename_+"_fpz"]=curforcevalue_(2);
-                curProgVars_[curforcename_+"_fvx"]=curforcevalue_(3);
-                curProgVars_[curforcename_+"_fvy"]=curforcevalue_(4);
-                curProgVars_[curforcename_+"_fvz"]=curforcevalue_(5);
-                curProgVars_[curforcename_+"_mpx"]=curforcevalue_(6);
-                curProgVars_[curforcename_+"_mpy"]=curforcevalue_(7);
-                curProgVars_[curforcename_+"_mpz"]=curforcevalue_(8);
-                curProgVars_[curforcename_+"_mvx"]=curforcevalue_(9);
-                curProgVars_[curforcename_+"_mvy"]=curforcevalue_(10);
-                curProgVars_[curforcename_+"_mvz"]=curforcevalue_(11);
-
-                // reset tracker
-                curforcename_="";
-            }
-            
-            curforcename_=match[2];
-            curforcesection_=1;
-            curforcevalue_=arma::zeros(12);
-        }
-        else if ( boost::regex_search( line, match, time_pattern, boost::match_default ) )
-        {
-            if (!curforcename_.empty()) //(curforcesection_==2)
-            {
-                // end active 
-                std::cout<<"force="<<curforcevalue_<<std::endl;
-
-                // store
-                curProgVars_[curforcename_+"_fpx"]=curforcevalue_(0);
-                curProgVars_[curforcename_+"_fpy"]=curforcevalue_(1);
-                curProgVars_[curforcename_+"_fpz"]=curforcevalue_(2);
-                curProgVars_[curforcename_+"_fvx"]=curforcevalue_(3);
-                curProgVars_[curforcename_+"_fvy"]=curforcevalue_(4);
-                curProgVars_[curforcename_+"_fvz"]=curforcevalue_(5);
-                curProgVars_[curforcename_+"_mpx"]=curforcevalue_(6);
-                curProgVars_[curforcename_+"_mpy"]=curforcevalue_(7);
-                curProgVars_[curforcename_+"_mpz"]=curforcevalue_(8);
-                curProgVars_[curforcename_+"_mvx"]=curforcevalue_(9);
-                curProgVars_[curforcename_+"_mvy"]=curforcevalue_(10);
-                curProgVars_[curforcename_+"_mvz"]=curforcevalue_(11);
-
-                // reset tracker
-                curforcename_="";
-                curforcesection_=1;
-                curforcevalue_=arma::zeros(12);
-            }
-            
-            if (curTime_ == curTime_)
-            {
-                pdisp_.update( ProgressState(curTime_, curProgVars_));
-                curProgVars_.clear();
-            }
-            curTime_=lexical_cast<double>(match[1]);
-        }
-        else if ( boost::regex_search( line, match, solver_pattern, boost::match_default ) )
-        {
-            curProgVars_[match[2]] = lexical_cast<double>(match[3]);
-        }
-        else if ( boost::regex_search( line, match, cont_pattern, boost::match_default ) )
-        {
-            /*
-            curProgVars_["local cont. err"] = lexical_cast<double>(match[1]);
-            curProgVars_["global cont. err"] = lexical_cast<double>(match[2]);
-            curProgVars_["cumul cont. err"] = lexical_cast<double>(match[3]);
-            */
-        }
+bool SolverOutputAnalyzer::parseForceLine(const char* s, const char* e)
+{
+  // ^ *([Pp]ressure|[Vv]iscous|[Pp]orous) *: *\((.*) (.*) (.*)\)$
+  // ^ *[Ss]um of moments
+  s=skipSpaces(s, e);
+  
+  if (startsWith(s, e, "sum of moments", true))
+  {
+    curforcesection_=2;
+    return true;
+  }
+  
+  const char *p;
+  int ofs=-1;
+  std::string lbl;
+  if ( (p=startsWith(s, e, "pressure", true)) ) { ofs=0; lbl="pres"; }
+  else if ( (p=startsWith(s, e, "viscous", true)) ) { ofs=3; lbl="visc"; }
+  else if ( (p=startsWith(s, e, "porous", true)) ) { ofs=-1; }
+  else return false;
+  
+  p=skipSpaces(p, e);
+  if ( (p>=e) || (*p!=':') ) return false;
+  p=skipSpaces(p+1, e);
+  if ( (p>=e) || (*p!='(') ) return false;
+  p++;
+  
+  double x, y, z;
+  if (!parseDouble(p, e, x)) return false;
+  if (!parseDouble(p, e, y)) return false;
+  if (!parseDouble(p, e, z)) return false;
+  if ( (p+1!=e) || (*p!=')') ) return false;
+  
+  if (ofs>=0)
+  {
+    std::cout<<lbl<<" ("<<curforcesection_<<") : "<<x<<" "<<y<<" "<<z<<std::endl;
+    if (curforcesection_==2) ofs+=6; // moment
+    if (curforcesection_==1 || curforcesection_==2)
+    {
+      curforcevalue_(ofs)=x;
+      curforcevalue_(ofs+1)=y;
+      curforcevalue_(ofs+2)=z;
+    }
+  }
+  return true;
+}
+
+bool SolverOutputAnalyzer::parseTimeLine(const char* s, const char* e)
+{
+  // ^Time = (.+)$
+  const char* p=startsWith(s, e, "Time = ");
+  if (!p) return false;
+  
+  double t;
+  if (!parseDouble(p, e, t)) return false;
+  
+  storeCurrentForce();
+  
+  if (curTime_ == curTime_)
+  {
+    pdisp_.update( ProgressState(curTime_, curProgVars_));
+    curProgVars_.clear();
+  }
+  curTime_=t;
+  
+  return true;
+}
+
+bool SolverOutputAnalyzer::parseSolverLine(const char* s, const char* e)
+{
+  // ^(.+): +Solving for (.+), Initial residual = (.+), Final residual = (.+), No Iterations (.+)$
+  const char* sf=strstr(s, "Solving for ");
+  if (!sf) return false;
+  
+  // expect colon, followed by at least one space, before "Solving for"
+  const char* c=sf;
+  while ( (c>s) && (*(c-1)==' ') ) c--;
+  if ( (c==sf) || (c-1<=s) || (*(c-1)!=':') ) return false;
+  
+  const char* n0=sf+12;
+  const char* n1=strstr(n0, ", Initial residual = ");
+  if (!n1 || (n1==n0)) return false;
+  
+  const char* p=n1+strlen(", Initial residual = ");
+  double r;
+  if (!parseDouble(p, e, r)) return false;
+  if (!startsWith(p, e, ", Final residual = ")) return false;
+  
+  curProgVars_[std::string(n0, n1)] = r;
+  return true;
+}
+
+void SolverOutputAnalyzer::update(const string& line)
+{
+  const char *s=line.c_str(), *e=s+line.size();
+  
+  if ( !curforcename_.empty() && parseForceLine(s, e) )
+  {
+    return;
+  }
+  else if ( ( startsWith(s, e, "forces ") || startsWith(s, e, "extendedForces ") )
+       && ( endsWith(s, e, " output:") || endsWith(s, e, " write:") ) )
+  {
+    // ^(extendedForces|forces) (.+) (output|write):$
+    std::cout<<"force output recog"<<std::endl;
+    
+    const char* n0=strchr(s, ' ')+1;
+    const char* n1=e-(endsWith(s, e, " output:") ? 8 : 7);
+    if (n1>n0)
+    {
+      storeCurrentForce();
+      curforcename_=std::string(n0, n1);
+      curforcesection_=1;
+      curforcevalue_=arma::zeros(12);
+      return;
+    }
+  }
+  else if ( parseTimeLine(s, e) || parseSolverLine(s, e) )
+  {
+    return;
+  }
+  
+  for (const Rule& r: rules_)
+  {
+    if ( r.trigger.empty() || (line.find(r.trigger)!=std::string::npos) )
+    {
+      boost::smatch match;
+      if ( boost::regex_search( line, match, r.pattern, boost::match_default ) )
+      {
+        r.action(match, curProgVars_);
+        return;
+      }
+    }
+  }
 }
 
 bool SolverOutputAnalyzer::stopRun() const 
@@ -722,11 +899,11 @@ void OpenFOAMCase::createOnDisk
 {
   boost::filesystem::path basepath(location);
 
+  std::vector<std::pair<boost::filesystem::path, const OFDictData::dictFile*> > toCreate;
   for (OFdicts::const_iterator i=dictionaries->begin();
       i!=dictionaries->end(); i++)
   {
     boost::filesystem::path dictpath = basepath / i->first;
-    std::cout<<"FILE "<<dictpath<<": ";
     
     bool ok_to_create=true;
     
@@ -745,16 +922,56 @@ void OpenFOAMCase::createOnDisk
         {
           boost::filesystem::create_directories(dictpath.parent_path());
         }
-        
-        {
-          std::ofstream f(dictpath.c_str());
-          i->second->write(dictpath);
-        }
-        std::cout<<"CREATED."<<std::endl;
+        toCreate.push_back(std::make_pair(dictpath, i->second));
     } else
     {
-        std::cout<<"SKIPPED."<<std::endl;
+        std::cout<<"FILE "<<dictpath<<": SKIPPED."<<std::endl;
+    }
+  }
+
+  // the files are independent: write them concurrently
+  std::atomic<size_t> next(0);
+  boost::mutex errorMtx;
+  std::exception_ptr error;
+  auto writer = [&]()
+  {
+    for (size_t k=next++; k<toCreate.size(); k=next++)
+    {
+      try
+      {
+        toCreate[k].second->write(toCreate[k].first);
+      }
+      catch (...)
+      {
+        boost::mutex::scoped_lock l(errorMtx);
+        if (!error) error=std::current_exception();
+      }
+    }
+  };
+
+  size_t nThreads=std::max<size_t>(1, std::min<size_t>(boost::thread::hardware_concurrency(), toCreate.size()));
+  if (nThreads==1)
+  {
+    writer();
+  }
+  else
+  {
+    boost::thread_group threads;
+    for (size_t k=0; k<nThreads; k++)
+    {
+      threads.create_thread(writer);
     }
+    threads.join_all();
+  }
+
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+
+  for (const auto& f: toCreate)
+  {
+    std::cout<<"FILE "<<f.first<<": CREATED."<<std::endl;
   }
 }
 
@@ -997,10 +1214,7 @@ boost::filesystem::path OpenFOAMCase::boundaryDictPath(const boost::filesystem::
 
 void OpenFOAMCase::parseBoundaryDict(const boost::filesystem::path& location, OFDictData::dict& boundaryDict) const
 {
-  boost::filesystem::path dictpath = boundaryDictPath(location);
-  std::ifstream f(dictpath.c_str());
-  if (!readOpenFOAMBoundaryDict(f, boundaryDict))
-      throw insight::Exception("Failed to parse boundary dict "+dictpath.string());
+  boundaryDict = *openFOAMDictCache.get(boundaryDictPath(location), OpenFOAMDictCache::BoundaryDictionary);
 }
 
 
@@ -1014,10 +1228,8 @@ const
 {
   std::string shellcmd="";
   
+  // the environment setup is prepended by OFEnvironment, if required
   shellcmd += 
-    "source "+env_.bashrc().string()+";"
-    "export PATH=$PATH:$INSIGHT_BINDIR/$WM_PROJECT-$WM_PROJECT_VERSION;"
-    "export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:$INSIGHT_LIBDIR/$WM_PROJECT-$WM_PROJECT_VERSION;"
     "cd \""+boost::filesystem::absolute(location).string()+"\";"
     + cmd;
   for (std::string& arg: argv)
@@ -1060,8 +1272,6 @@ void OpenFOAMCase::runSolver
 {
   if (stopFlag) *stopFlag=false;
   
-  redi::ipstream p_in;
-  
   string cmd=solverName;
   std::vector<std::string> argv;
   if (np>1)
@@ -1071,27 +1281,32 @@ void OpenFOAMCase::runSolver
   }
   std::copy(addopts.begin(), addopts.end(), back_inserter(argv));
 
-  //env_.forkCommand( p_in, "bash", boost::assign::list_of<std::string>("-c")(shellcmd) );
-  env_.forkCommand( p_in, cmdString(location, cmd, argv) );
-
-  std::string line;
-  while (std::getline(p_in, line))
-  {
-    cout<<">> "<<line<<endl;
-    analyzer.update(line);
-    
-    if (analyzer.stopRun())
+  // the solver log is only streamed through the analyzer, nothing is kept in memory
+  CommandOutputCapture capture;
+  capture.setEchoPrefix(">> ");
+  capture.setStdoutCallback
+  (
+    [&](const std::string& line)
     {
-      std::ofstream f( (location/"wnowandstop").c_str() );
-      f<<"STOP"<<std::endl;
+      analyzer.update(line);
+      
+      if (analyzer.stopRun())
+      {
+        std::ofstream f( (location/"wnowandstop").c_str() );
+        f<<"STOP"<<std::endl;
+      }
+      
+      boost::this_thread::interruption_point();
     }
-    
-    boost::this_thread::interruption_point();
-    if (stopFlag) { if (*stopFlag) break; }
-  }
-  p_in.close();
+  );
+  capture.setStopCheck
+  (
+    [stopFlag]() { return stopFlag && *stopFlag; }
+  );
+
+  int status = env_.runCommand( capture, cmdString(location, cmd, argv) );
 
-  if (p_in.rdbuf()->status()!=0)
+  if (status!=0)
     throw insight::Exception("OpenFOAMCase::runSolver(): solver execution failed with nonzero exit code!");
 }
 
@@ -86,6 +86,11 @@ struct OFdicts
   OFDictData::dictFile& addDictionaryIfNonexistent(const std::string& key);
   OFDictData::dictFile& addFieldIfNonexistent(const std::string& key, const FieldInfo& fi);
   OFDictData::dictFile& lookupDict(const std::string& key);
+
+  /**
+   * set the output format of all field files
+   */
+  void setFieldFormat(OFDictData::dictFile::Format format, bool compressed=false);
 };
 
 
@@ -108,6 +113,15 @@ public:
 
     virtual int version() const;
     virtual const boost::filesystem::path& bashrc() const;
+    
+    virtual std::string environmentSetupCommands() const;
+    
+    /**
+     * The bashrc is sourced only once per process and OpenFOAM installation.
+     * The resulting environment is captured and reused for all subsequent local commands.
+     * Can be disabled by setting the environment variable INSIGHT_NO_ENVIRONMENT_CACHE.
+     */
+    virtual const std::vector<std::string>& preparedEnvironment() const;
     //virtual int executeCommand(const std::vector<std::string>& args) const;
 };
 
@@ -275,8 +289,40 @@ public:
 
 
 
+/**
+ * Extracts progress information from the solver output, line by line.
+ *
+ * The known OpenFOAM line formats (Time, Solving for, forces/extendedForces blocks)
+ * are recognized by a hand-written single-pass tokenizer without any regular expressions.
+ * Additional line formats can be added by rules. The regular expression of a rule is
+ * compiled only once and evaluated only on lines, which contain the rule's trigger string.
+ */
 class SolverOutputAnalyzer
 {
+public:
+    /**
+     * action of a rule: receives the match result and the progress variables
+     * of the current time step
+     */
+    typedef boost::function<void ( const boost::smatch&, std::map<std::string, double>& )> RuleAction;
+
+    struct Rule
+    {
+        /**
+         * literal string, which needs to be contained in a line, before the pattern is evaluated
+         */
+        std::string trigger;
+        boost::regex pattern;
+        RuleAction action;
+    };
+
+    typedef std::vector<Rule> RuleList;
+
+    /**
+     * rules, which are added to every newly created analyzer
+     */
+    static RuleList& defaultRules();
+    static void addDefaultRule ( const std::string& trigger, const std::string& pattern, RuleAction action );
 
 protected:
     ProgressDisplayer& pdisp_;
@@ -292,11 +338,23 @@ protected:
     int curforcesection_;
     arma::mat curforcevalue_;
 
-//   std::map<std::string, std::vector<arma::mat> > trackedForces_;
+    /**
+     * interned progress variable names of the force outputs
+     */
+    std::map<std::string, std::vector<std::string> > forceKeys_;
+
+    RuleList rules_;
+
+    void storeCurrentForce();
+    bool parseForceLine ( const char* s, const char* e );
+    bool parseTimeLine ( const char* s, const char* e );
+    bool parseSolverLine ( const char* s, const char* e );
 
 public:
     SolverOutputAnalyzer ( ProgressDisplayer& pdisp );
 
+    void addRule ( const std::string& trigger, const std::string& pattern, RuleAction action );
+
     void update ( const std::string& line );
 
     bool stopRun() const;
@@ -20,6 +20,7 @@
 
 
 #include "openfoamdict.h"
+#include "openfoamdictcache.h"
 
 #define BOOST_SPIRIT_DEBUG
 
@@ -29,6 +30,9 @@
 
 #include "boost/lexical_cast.hpp"
 
+#include <cstdio>
+#include <cstdint>
+
 #include "boost/iostreams/filtering_stream.hpp"
 #include "boost/iostreams/filter/gzip.hpp"
 
@@ -150,8 +154,9 @@ bool parseOpenFOAMDict(Iterator first, Iterator last, Result& d)
     bool r=false;
     try
     {
-        Parser parser;
-        skip_grammar<Iterator> skip;
+        // constructing the grammar is expensive, reuse it within each thread
+        static thread_local Parser parser;
+        static thread_local skip_grammar<Iterator> skip;
 
         r = qi::phrase_parse(
                      first,
@@ -178,32 +183,8 @@ bool parseOpenFOAMDict(Iterator first, Iterator last, Result& d)
 
 void readOpenFOAMDict(const boost::filesystem::path& dictFile, OFDictData::dict& d)
 {
-    boost::filesystem::path compressedDictFile = dictFile;
-    compressedDictFile.replace_extension(".gz");
-    
-    if (exists(dictFile))
-    {
-//         cout<<"reading ascii dictionary "<<dictFile.string()<<endl;
-        std::ifstream f(dictFile.string());
-        if (!readOpenFOAMDict(f, d))
-            throw insight::Exception("Failed to read dictionary "+dictFile.string());
-    }
-    else if (exists(compressedDictFile))
-    {
-//         cout<<"reading gz dictionary "<<compressedDictFile.string()<<endl;
-        std::ifstream compressedDict(compressedDictFile.string());
-        boost::iostreams::filtering_streambuf<boost::iostreams::input> in;
-        in.push(boost::iostreams::gzip_decompressor());
-        in.push(compressedDict);     
-
-        std::istream f(&in);
-        if (!readOpenFOAMDict(f, d))
-            throw insight::Exception("Failed to read dictionary "+compressedDictFile.string());
-    }
-    else
-    {
-        throw insight::Exception("Neither dictionary "+dictFile.string()+" nor "+compressedDictFile.string()+" exist!");
-    }
+    // copy, the cached snapshot is shared
+    d = *openFOAMDictCache.get(dictFile);
 }
 
 
@@ -244,24 +225,189 @@ void writeOpenFOAMDict(const boost::filesystem::path& dictpath, const OFDictData
   writeOpenFOAMDict( out, dict, boost::filesystem::basename(dictpath) );
 }
 
+namespace
+{
+
+std::string nonuniformListType(const arma::mat& v)
+{
+  switch (v.n_cols)
+  {
+    case 1: return "scalar";
+    case 3: return "vector";
+    case 6: return "symmTensor";
+    case 9: return "tensor";
+  }
+  throw insight::Exception("There is no list type with "+lexical_cast<std::string>(v.n_cols)+" components!");
+}
+
+
+/**
+ * the element type from the placeholder "nonuniform List<type>",
+ * if present, otherwise from the number of components
+ */
+std::string nonuniformListType(const OFDictData::data& placeholder, const arma::mat& v)
+{
+  if (const std::string* s=boost::get<std::string>(&placeholder))
+  {
+    size_t b=s->find("List<"), e=s->rfind('>');
+    if ( (b!=std::string::npos) && (e!=std::string::npos) && (e>b+5) )
+      return s->substr(b+5, e-b-5);
+  }
+  return nonuniformListType(v);
+}
+
+
+/**
+ * number of components of the list element type
+ */
+arma::uword nonuniformListComponents(const std::string& type)
+{
+  if ( (type=="scalar") || (type=="label") || (type=="sphericalTensor") ) return 1;
+  else if (type=="vector") return 3;
+  else if (type=="symmTensor") return 6;
+  else if (type=="tensor") return 9;
+  throw insight::Exception("Unsupported element type "+type+" of nonuniform list!");
+}
+
+
+/**
+ * converts the rows block-wise into a contiguous buffer of T
+ * and writes each block in one call
+ */
+template<class T>
+void writeBinaryListData(std::ostream& out, const arma::mat& v, arma::uword blockRows)
+{
+  const arma::uword n=v.n_rows, nc=v.n_cols;
+  std::vector<T> buf(blockRows*nc);
+  for (arma::uword i0=0; i0<n; i0+=blockRows)
+  {
+    arma::uword i1=std::min(n, i0+blockRows);
+    T *b=buf.data();
+    for (arma::uword i=i0; i<i1; i++)
+      for (arma::uword j=0; j<nc; j++)
+        *(b++)=T(v(i,j));
+    out.write(reinterpret_cast<const char*>(buf.data()), (i1-i0)*nc*sizeof(T));
+  }
+}
+
+
+/**
+ * Writes "nonuniform List<type> n(...)".
+ * The rows are converted block-wise into contiguous buffers,
+ * which are written in one call each: raw data in binary format
+ * (32 bit integers for labels, doubles otherwise, as declared in the header),
+ * formatted lines in ascii format.
+ */
+void writeNonuniformList(std::ostream& out, const std::string& type, const arma::mat& v, bool binary)
+{
+  const arma::uword n=v.n_rows, nc=v.n_cols;
+  const arma::uword blockRows=std::max<arma::uword>(1, 65536/std::max<arma::uword>(1, nc));
+
+  if (nonuniformListComponents(type)!=nc)
+  {
+    throw insight::Exception(boost::str(boost::format("Nonuniform List<%s> cannot hold %d components!") % type % nc));
+  }
+
+  out<<"nonuniform List<"<<type<<"> "<<n;
+  if (binary)
+  {
+    out<<"(";
+    if (type=="label")
+      writeBinaryListData<int32_t>(out, v, blockRows);
+    else
+      writeBinaryListData<double>(out, v, blockRows);
+    out<<")";
+  }
+  else
+  {
+    out<<"\n(\n";
+    std::string buf;
+    char num[32];
+    for (arma::uword i0=0; i0<n; i0+=blockRows)
+    {
+      arma::uword i1=std::min(n, i0+blockRows);
+      buf.clear();
+      for (arma::uword i=i0; i<i1; i++)
+      {
+        if (nc>1) buf+='(';
+        for (arma::uword j=0; j<nc; j++)
+        {
+          if (j>0) buf+=' ';
+          buf.append(num, snprintf(num, sizeof(num), "%.17g", v(i,j)));
+        }
+        if (nc>1) buf+=')';
+        buf+='\n';
+      }
+      out.write(buf.data(), buf.size());
+    }
+    out<<")\n";
+  }
+}
+
+
+void writeOpenFOAMDictEntries
+(
+  std::ostream& out,
+  const OFDictData::dict& d,
+  const OFDictData::dictFile& df,
+  const std::string& prefix,
+  int indentLevel
+)
+{
+  std::string pren(indentLevel, ' ');
+  for (const OFDictData::dict::value_type& e: d)
+  {
+    std::string path = prefix.empty() ? e.first : prefix+"/"+e.first;
+    out << pren << e.first << OFDictData::SPACE;
+
+    std::map<std::string, arma::mat>::const_iterator l=df.nonuniformLists.find(path);
+    if (l!=df.nonuniformLists.end())
+    {
+      writeNonuniformList
+      (
+        out, nonuniformListType(e.second, l->second), l->second,
+        df.format==OFDictData::dictFile::Binary
+      );
+      out << ";\n";
+    }
+    else if (const OFDictData::dict *sd = boost::get<OFDictData::dict>(&e.second))
+    {
+      out << "\n" << pren << "{\n";
+      writeOpenFOAMDictEntries(out, *sd, df, path, indentLevel+1);
+      out << pren << "}\n";
+    }
+    else
+    {
+      out << e.second << ";\n";
+    }
+  }
+}
+
+}
+
+
 void writeOpenFOAMDict(std::ostream& out, const OFDictData::dictFile& d, const std::string& objname)
 {
   out /*<< std::scientific*/ << std::setprecision(18);
     out<<"FoamFile"<<endl
        <<"{"<<endl
-       <<" version     "+lexical_cast<std::string>(d.dictVersion)+";"<<endl
-       <<" format      ascii;"<<endl
-       <<" class       "+d.className+";"<<endl
+       <<" version     "+lexical_cast<std::string>(d.dictVersion)+";"<<endl;
+    if (d.format==OFDictData::dictFile::Binary)
+    {
+      const int one=1;
+      bool lsb = *reinterpret_cast<const char*>(&one)==1;
+      out<<" format      binary;"<<endl
+         <<" arch        \""<<(lsb?"LSB":"MSB")<<";label=32;scalar=64\";"<<endl;
+    }
+    else
+    {
+      out<<" format      ascii;"<<endl;
+    }
+    out<<" class       "+d.className+";"<<endl
        <<" object      " << objname << ";"<<endl
        <<"}"<<endl;
 
-    for (OFDictData::dict::const_iterator i=d.begin(); i!=d.end(); i++)
-    {
-      out<< i->first << " " << i->second;
-      const OFDictData::data* o=&(i->second);
-      if (!boost::get<OFDictData::dict>(o)) out<<";";
-      out << "\n";
-    }
+    writeOpenFOAMDictEntries(out, d, d, "", 0);
 }
 
 bool readOpenFOAMBoundaryDict(std::istream& in, OFDictData::dict& d)
@@ -465,23 +611,71 @@ OFDictData::dictFile::dictFile()
 : className("dictionary"),
   dictVersion(2),
   OFversion(-1),
-  isSequential(false)
+  isSequential(false),
+  format(ASCII),
+  compressed(false)
 {
 }
 
+void OFDictData::dictFile::setNonuniformList(const std::string& path, const arma::mat& values, const std::string& type)
+{
+  std::vector<std::string> keys;
+  boost::split(keys, path, boost::is_any_of("/"));
+  dict* d=this;
+  for (size_t i=0; i+1<keys.size(); i++)
+  {
+    d=&d->addSubDictIfNonexistent(keys[i]);
+  }
+  (*d)[keys.back()] = "nonuniform List<"+(type.empty() ? nonuniformListType(values) : type)+">";
+  nonuniformLists[path]=values;
+}
+
 void OFDictData::dictFile::write(const boost::filesystem::path& dictPath) const
 {
   if (!exists(dictPath.parent_path())) 
   {
     boost::filesystem::create_directories(dictPath.parent_path());
   }
+
+  openFOAMDictCache.invalidate(dictPath);
+
+  // OpenFOAM would prefer an outdated uncompressed file over the compressed one
+  boost::filesystem::path fn(dictPath), other(dictPath.string()+".gz");
+  if (compressed) std::swap(fn, other);
+  if (exists(other))
+  {
+    boost::filesystem::remove(other);
+  }
   
   {
-    std::ofstream f(dictPath.c_str());
+    std::ofstream f(fn.c_str(), std::ios::binary);
+    if (!f.good())
+    {
+      throw insight::Exception("Could not open file "+fn.string()+" for writing!");
+    }
+
+    boost::iostreams::filtering_ostream gz;
+    std::ostream* out=&f;
+    if (compressed)
+    {
+      gz.push(boost::iostreams::gzip_compressor());
+      gz.push(f);
+      out=&gz;
+    }
+
     if (isSequential)
-      writeOpenFOAMSequentialDict(f, *this, boost::filesystem::basename(dictPath));
+      writeOpenFOAMSequentialDict(*out, *this, boost::filesystem::basename(dictPath));
     else
-      writeOpenFOAMDict(f, *this, boost::filesystem::basename(dictPath));
+      writeOpenFOAMDict(*out, *this, boost::filesystem::basename(dictPath));
+
+    if (compressed)
+    {
+      gz.reset();
+    }
+    if (!f.good())
+    {
+      throw insight::Exception("Error while writing file "+fn.string()+"!");
+    }
   }
 }
 
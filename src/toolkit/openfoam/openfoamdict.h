@@ -202,13 +202,42 @@ struct dict
 struct dictFile
 : public dict
 {
+  enum Format { ASCII, Binary };
+
   std::string className;
   int dictVersion;
   int OFversion;
   bool isSequential;
+
+  /**
+   * format of the nonuniform lists
+   */
+  Format format;
+
+  /**
+   * write gzip compressed file (".gz" is appended to the file name)
+   */
+  bool compressed;
+
+  /**
+   * values of nonuniform list entries, e.g. of "internalField" or "boundaryField/inlet/value".
+   * One row per element, one column per component.
+   * The dict contains the placeholder string "nonuniform List<type>" at the respective path.
+   */
+  std::map<std::string, arma::mat> nonuniformLists;
   
   dictFile();
+
+  /**
+   * insert a nonuniform list entry at the given path ("/"-separated keys).
+   * The type is derived from the number of columns, if it is not specified.
+   */
+  void setNonuniformList(const std::string& path, const arma::mat& values, const std::string& type="");
   
+  /**
+   * writes the dictionary. If compressed, ".gz" is appended to dictPath
+   * and an uncompressed file of the same name is removed (and vice versa).
+   */
   void write(const boost::filesystem::path& dictPath) const;
 };
 
@@ -245,7 +274,8 @@ std::ostream& operator<<(std::ostream& os, const list& l);
 
 /**
  * reads OF dict
- * filename without possible ".gz". Will detect compressed dict and uncompress in temp dir
+ * filename without possible ".gz". Will detect compressed dict.
+ * The parsed contents are cached (see OpenFOAMDictCache), d receives a copy.
  */
 void readOpenFOAMDict(const boost::filesystem::path& dictFile, OFDictData::dict& d);
 
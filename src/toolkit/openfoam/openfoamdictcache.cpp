@@ -0,0 +1,160 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "openfoamdictcache.h"
+
+#include "boost/iostreams/filtering_stream.hpp"
+#include "boost/iostreams/filter/gzip.hpp"
+
+#include <sys/stat.h>
+
+namespace insight
+{
+
+
+OpenFOAMDictCache openFOAMDictCache;
+
+
+
+
+namespace
+{
+
+bool fileStat(const boost::filesystem::path& f, struct stat& st)
+{
+  return (stat(f.c_str(), &st)==0) && S_ISREG(st.st_mode);
+}
+
+}
+
+
+
+
+boost::filesystem::path OpenFOAMDictCache::key(const boost::filesystem::path& dictFile)
+{
+  boost::filesystem::path dir=boost::filesystem::absolute(dictFile).parent_path();
+  boost::system::error_code ec;
+  boost::filesystem::path cdir=boost::filesystem::canonical(dir, ec);
+  return (ec ? dir : cdir) / dictFile.filename();
+}
+
+
+
+
+OpenFOAMDictCache::OpenFOAMDictCache()
+{
+  statistics_.hits=statistics_.misses=0;
+}
+
+
+
+
+OpenFOAMDictCache::DictPtr OpenFOAMDictCache::get(const boost::filesystem::path& dictFile, Type type)
+{
+  boost::filesystem::path compressedDictFile = dictFile.string()+".gz";
+
+  struct stat st;
+  bool compressed=false;
+  if (!fileStat(dictFile, st))
+  {
+    if (!fileStat(compressedDictFile, st))
+    {
+      throw insight::Exception("Neither dictionary "+dictFile.string()+" nor "+compressedDictFile.string()+" exist!");
+    }
+    compressed=true;
+  }
+
+  Key k(key(dictFile), type);
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto i=entries_.find(k);
+    if ( (i!=entries_.end())
+         && (i->second.compressed==compressed)
+         && (i->second.size==uintmax_t(st.st_size))
+         && (i->second.mtime==st.st_mtim.tv_sec)
+         && (i->second.mtime_nsec==st.st_mtim.tv_nsec) )
+    {
+      statistics_.hits++;
+      return i->second.dict;
+    }
+    statistics_.misses++;
+  }
+
+  // parse outside of the lock, different files may be parsed concurrently
+  const boost::filesystem::path& fn = compressed ? compressedDictFile : dictFile;
+  std::ifstream f(fn.c_str(), std::ios::binary);
+  boost::iostreams::filtering_istream in;
+  if (compressed)
+  {
+    in.push(boost::iostreams::gzip_decompressor());
+  }
+  in.push(f);
+
+  std::shared_ptr<OFDictData::dict> d(new OFDictData::dict);
+  bool ok = (type==BoundaryDictionary) ? readOpenFOAMBoundaryDict(in, *d) : readOpenFOAMDict(in, *d);
+  if (!ok)
+  {
+    throw insight::Exception("Failed to read dictionary "+fn.string());
+  }
+
+  Entry e;
+  e.size=st.st_size;
+  e.mtime=st.st_mtim.tv_sec;
+  e.mtime_nsec=st.st_mtim.tv_nsec;
+  e.compressed=compressed;
+  e.dict=d;
+
+  std::lock_guard<std::mutex> l(mtx_);
+  entries_[k]=e;
+  return e.dict;
+}
+
+
+
+
+void OpenFOAMDictCache::invalidate(const boost::filesystem::path& dictFile)
+{
+  boost::filesystem::path p=key(dictFile);
+  std::lock_guard<std::mutex> l(mtx_);
+  entries_.erase(Key(p, Dictionary));
+  entries_.erase(Key(p, BoundaryDictionary));
+}
+
+
+
+
+void OpenFOAMDictCache::clear()
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  entries_.clear();
+}
+
+
+
+
+OpenFOAMDictCache::Statistics OpenFOAMDictCache::statistics() const
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  return statistics_;
+}
+
+
+}
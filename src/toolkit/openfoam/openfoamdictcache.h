@@ -0,0 +1,104 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#ifndef INSIGHT_OPENFOAMDICTCACHE_H
+#define INSIGHT_OPENFOAMDICTCACHE_H
+
+#include "openfoam/openfoamdict.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ctime>
+
+namespace insight
+{
+
+
+/**
+ * Process-wide cache of parsed dictionaries (boundary dict, system dicts etc.).
+ *
+ * A dictionary is parsed only once, as long as size and modification time of
+ * the file (or of its compressed variant) are unchanged. The parsed
+ * dictionaries are handed out as immutable shared snapshots. Callers, which
+ * need to modify the contents, have to work on a copy
+ * (e.g. by readOpenFOAMDict(path, dict)).
+ *
+ * Files written by OFDictData::dictFile::write are invalidated explicitly,
+ * since rewrites in quick succession might not change size and mtime.
+ */
+class OpenFOAMDictCache
+{
+public:
+  typedef std::shared_ptr<const OFDictData::dict> DictPtr;
+
+  enum Type { Dictionary, BoundaryDictionary };
+
+  struct Statistics
+  {
+    size_t hits, misses;
+  };
+
+protected:
+  struct Entry
+  {
+    uintmax_t size;
+    std::time_t mtime;
+    long mtime_nsec;
+    bool compressed;
+    DictPtr dict;
+  };
+
+  typedef std::pair<boost::filesystem::path, Type> Key;
+
+  mutable std::mutex mtx_;
+  std::map<Key, Entry> entries_;
+  Statistics statistics_;
+
+  static boost::filesystem::path key(const boost::filesystem::path& dictFile);
+
+public:
+  OpenFOAMDictCache();
+
+  /**
+   * parsed contents of dictFile or, if that does not exist, of dictFile.gz.
+   * Throws, if neither exists or the file cannot be parsed.
+   */
+  DictPtr get(const boost::filesystem::path& dictFile, Type type=Dictionary);
+
+  /**
+   * forget the parsed contents of the file
+   */
+  void invalidate(const boost::filesystem::path& dictFile);
+
+  void clear();
+
+  Statistics statistics() const;
+};
+
+
+extern OpenFOAMDictCache openFOAMDictCache;
+
+
+}
+
+#endif // INSIGHT_OPENFOAMDICTCACHE_H
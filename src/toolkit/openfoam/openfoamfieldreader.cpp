@@ -0,0 +1,668 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "openfoamfieldreader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+
+#include "boost/lexical_cast.hpp"
+#include "boost/iostreams/filtering_stream.hpp"
+#include "boost/iostreams/filter/gzip.hpp"
+
+namespace insight
+{
+
+
+namespace
+{
+
+/**
+ * character-level access to the stream buffer of an OpenFOAM file
+ */
+class FoamTokenizer
+{
+  std::istream& in_;
+  std::streambuf* sb_;
+  bool seekable_;
+
+public:
+  FoamTokenizer(std::istream& in, bool seekable)
+  : in_(in), sb_(in.rdbuf()), seekable_(seekable)
+  {}
+
+  inline int peek() { return sb_->sgetc(); }
+  inline int get() { return sb_->sbumpc(); }
+
+  /**
+   * skip white space and comments.
+   * Returns true, if anything was skipped
+   */
+  bool skipSpace()
+  {
+    bool skipped=false;
+    for (;;)
+    {
+      int c=peek();
+      if (c==EOF) return skipped;
+      if (isspace(c))
+      {
+        get();
+      }
+      else if (c=='/')
+      {
+        get();
+        int c2=peek();
+        if (c2=='/')
+        {
+          while ( ((c=get())!=EOF) && (c!='\n') ) ;
+        }
+        else if (c2=='*')
+        {
+          get();
+          int p=0;
+          while ( (c=get())!=EOF )
+          {
+            if ( (p=='*') && (c=='/') ) break;
+            p=c;
+          }
+        }
+        else
+        {
+          sb_->sungetc();
+          return skipped;
+        }
+      }
+      else
+      {
+        return skipped;
+      }
+      skipped=true;
+    }
+  }
+
+  void expect(char ec, const std::string& context)
+  {
+    skipSpace();
+    int c=get();
+    if (c!=ec)
+    {
+      throw insight::Exception
+      (
+        std::string("expected '")+ec+"' in "+context+", found "
+        +(c==EOF ? std::string("end of file") : "'"+std::string(1, char(c))+"'")
+      );
+    }
+  }
+
+  std::string word()
+  {
+    std::string w;
+    for (int c=peek(); (c!=EOF) && !isspace(c) && !strchr(";{}()[]\"", c); c=peek())
+    {
+      w+=char(get());
+    }
+    return w;
+  }
+
+  /**
+   * read quoted string, including the quotes
+   */
+  std::string quoted()
+  {
+    std::string s(1, char(get()));
+    int c;
+    while ( (c=get())!=EOF )
+    {
+      s+=char(c);
+      if (c=='\\')
+      {
+        if ( (c=get())!=EOF ) s+=char(c);
+      }
+      else if (c=='"')
+      {
+        break;
+      }
+    }
+    return s;
+  }
+
+  /**
+   * collect the text of an entry up to the terminating semicolon
+   */
+  std::string entryText(const std::string& context)
+  {
+    std::string text;
+    int depth=0;
+    for (;;)
+    {
+      if (skipSpace()) text+=' ';
+      int c=peek();
+      if (c==EOF)
+      {
+        throw insight::Exception("unexpected end of file in entry "+context);
+      }
+      else if (c=='"')
+      {
+        text+=quoted();
+      }
+      else if ( (c==';') && (depth==0) )
+      {
+        get();
+        return text;
+      }
+      else if ( (c=='#') && text.empty() )
+      {
+        // verbatim code block #{ ... #}
+        text+=char(get());
+        if (peek()=='{')
+        {
+          int p=0;
+          while ( (c=get())!=EOF )
+          {
+            text+=char(c);
+            if ( (p=='#') && (c=='}') ) break;
+            p=c;
+          }
+        }
+      }
+      else
+      {
+        if ( (c=='(') || (c=='[') || (c=='{') ) depth++;
+        else if ( (c==')') || (c==']') || (c=='}') ) depth--;
+        text+=char(get());
+      }
+    }
+  }
+
+  void restOfLine()
+  {
+    int c;
+    while ( ((c=get())!=EOF) && (c!='\n') ) ;
+  }
+
+  double number(const std::string& context)
+  {
+    skipSpace();
+    char buf[64];
+    int n=0;
+    for (int c=peek();
+         (c!=EOF) && (n<63) && (isalnum(c) || (c=='.') || (c=='-') || (c=='+'));
+         c=peek())
+    {
+      buf[n++]=char(get());
+    }
+    buf[n]=0;
+    char* end;
+    double v=strtod(buf, &end);
+    if ( (n==0) || (*end!=0) )
+    {
+      throw insight::Exception("invalid number \""+std::string(buf)+"\" in "+context);
+    }
+    return v;
+  }
+
+  void read(char* buf, size_t n, const std::string& context)
+  {
+    if (size_t(sb_->sgetn(buf, n))!=n)
+    {
+      throw insight::Exception("unexpected end of file in binary list "+context);
+    }
+  }
+
+  void skip(size_t n, const std::string& context)
+  {
+    if (seekable_)
+    {
+      if (sb_->pubseekoff(n, std::ios_base::cur, std::ios_base::in) != std::streampos(-1))
+        return;
+    }
+    std::vector<char> buf(std::min<size_t>(n, 1<<16));
+    while (n>0)
+    {
+      size_t k=std::min(n, buf.size());
+      read(&buf[0], k, context);
+      n-=k;
+    }
+  }
+
+  /**
+   * skip up to and including the closing parenthesis of an ascii list
+   */
+  void skipAsciiList(const std::string& context)
+  {
+    int depth=1, c;
+    while ( (depth>0) && ((c=get())!=EOF) )
+    {
+      if (c=='(') depth++;
+      else if (c==')') depth--;
+    }
+    if (depth>0)
+    {
+      throw insight::Exception("unexpected end of file in list "+context);
+    }
+  }
+};
+
+
+
+template<class T>
+void decodeBinary(const std::vector<char>& buf, double* dest, size_t n)
+{
+  const T* src=reinterpret_cast<const T*>(&buf[0]);
+  for (size_t i=0; i<n; i++) dest[i]=double(src[i]);
+}
+
+
+
+class FieldParser
+{
+  FoamTokenizer& tok_;
+  const OpenFOAMFieldReader::Selector& select_;
+  OpenFOAMFieldReader::Lists& lists_;
+
+public:
+  bool binary;
+  int labelSize, scalarSize;
+
+  FieldParser(FoamTokenizer& tok, const OpenFOAMFieldReader::Selector& select, OpenFOAMFieldReader::Lists& lists)
+  : tok_(tok), select_(select), lists_(lists),
+    binary(false), labelSize(32), scalarSize(64)
+  {}
+
+  void setFormat(const OFDictData::dict& header)
+  {
+    auto f=header.find("format");
+    if (f!=header.end())
+    {
+      if (const std::string* fs=boost::get<std::string>(&f->second))
+        binary = (*fs=="binary");
+    }
+    auto a=header.find("arch");
+    if (a!=header.end())
+    {
+      if (const std::string* as=boost::get<std::string>(&a->second))
+      {
+        if (as->find("MSB")!=std::string::npos)
+          throw insight::Exception("big endian binary OpenFOAM files are not supported!");
+        size_t i;
+        if ( (i=as->find("label="))!=std::string::npos ) labelSize=atoi(as->c_str()+i+6);
+        if ( (i=as->find("scalar="))!=std::string::npos ) scalarSize=atoi(as->c_str()+i+7);
+      }
+    }
+  }
+
+  void readList(const std::string& path, const std::string& listType)
+  {
+    size_t b=listType.find('<'), e=listType.rfind('>');
+    if ( (b==std::string::npos) || (e==std::string::npos) || (e<b) )
+    {
+      throw insight::Exception("invalid list type "+listType+" in "+path);
+    }
+    std::string type=listType.substr(b+1, e-b-1);
+    int nc=OpenFOAMFieldReader::nComponents(type);
+    bool isLabel = (type=="label");
+    bool sel = !select_ || select_(path);
+
+    tok_.skipSpace();
+    long n=-1;
+    if (tok_.peek()!='(')
+    {
+      std::string ns=tok_.word();
+      try
+      {
+        n=boost::lexical_cast<long>(ns);
+      }
+      catch (...)
+      {
+        throw insight::Exception("invalid list size \""+ns+"\" in "+path);
+      }
+    }
+
+    tok_.skipSpace();
+    int c=tok_.get();
+
+    arma::mat values;
+    if ( (c=='{') && (n>=0) )
+    {
+      // uniform list: N{value}
+      arma::rowvec v(nc);
+      readAsciiElement(v.memptr(), nc, path);
+      tok_.expect('}', path);
+      if (sel) values=arma::repmat(v, n, 1);
+    }
+    else if (c!='(')
+    {
+      throw insight::Exception("expected list in "+path);
+    }
+    else if (binary && (n>0))
+    {
+      size_t es = (isLabel ? labelSize : scalarSize)/8;
+      size_t nv=size_t(n)*nc;
+      if (sel)
+      {
+        std::vector<char> buf(nv*es);
+        tok_.read(&buf[0], buf.size(), path);
+        // one column per element, transposed afterwards
+        values.set_size(nc, n);
+        double* d=values.memptr();
+        if (isLabel)
+        {
+          if (es==8) decodeBinary<int64_t>(buf, d, nv); else decodeBinary<int32_t>(buf, d, nv);
+        }
+        else
+        {
+          if (es==4) decodeBinary<float>(buf, d, nv); else decodeBinary<double>(buf, d, nv);
+        }
+        arma::inplace_trans(values, "lowmem");
+      }
+      else
+      {
+        tok_.skip(nv*es, path);
+      }
+      tok_.expect(')', path);
+    }
+    else if (!sel)
+    {
+      tok_.skipAsciiList(path);
+    }
+    else if (n>=0)
+    {
+      values.set_size(nc, n);
+      for (long i=0; i<n; i++)
+      {
+        readAsciiElement(values.colptr(i), nc, path);
+      }
+      tok_.expect(')', path);
+      arma::inplace_trans(values, "lowmem");
+    }
+    else
+    {
+      // list without size
+      std::vector<double> v;
+      for (tok_.skipSpace(); tok_.peek()!=')'; tok_.skipSpace())
+      {
+        v.resize(v.size()+nc);
+        readAsciiElement(&v[v.size()-nc], nc, path);
+      }
+      tok_.get();
+      if (v.empty())
+      {
+        values.set_size(0, nc);
+      }
+      else
+      {
+        values=arma::mat(&v[0], nc, v.size()/nc);
+        arma::inplace_trans(values, "lowmem");
+      }
+    }
+
+    tok_.expect(';', path);
+
+    if (sel)
+    {
+      lists_[path]=values;
+    }
+  }
+
+  void readAsciiElement(double* dest, int nc, const std::string& path)
+  {
+    if (nc==1)
+    {
+      *dest=tok_.number(path);
+    }
+    else
+    {
+      tok_.expect('(', path);
+      for (int j=0; j<nc; j++)
+      {
+        dest[j]=tok_.number(path);
+      }
+      tok_.expect(')', path);
+    }
+  }
+
+  void readDict(OFDictData::dict& d, const std::string& path, bool top)
+  {
+    for (;;)
+    {
+      tok_.skipSpace();
+      int c=tok_.peek();
+      if (c==EOF)
+      {
+        if (top) return;
+        throw insight::Exception("unexpected end of file in dictionary "+path);
+      }
+      else if (c=='}')
+      {
+        if (top) throw insight::Exception("unexpected '}' at top level");
+        tok_.get();
+        return;
+      }
+      else if (c==';')
+      {
+        tok_.get();
+        continue;
+      }
+
+      std::string key = (c=='"') ? tok_.quoted() : tok_.word();
+      if (key.empty())
+      {
+        throw insight::Exception
+        (
+          "unexpected character '"+std::string(1, char(c))+"' in dictionary "
+          +(path.empty()?std::string("(top level)"):path)
+        );
+      }
+      if (key[0]=='#')
+      {
+        // directives like #include are not evaluated
+        tok_.restOfLine();
+        continue;
+      }
+
+      std::string kpath = path.empty() ? key : path+"/"+key;
+
+      tok_.skipSpace();
+      if (tok_.peek()=='{')
+      {
+        tok_.get();
+        OFDictData::dict sd;
+        readDict(sd, kpath, false);
+        if (top && (key=="FoamFile")) setFormat(sd);
+        d[key]=sd;
+        continue;
+      }
+
+      std::string text;
+      if (isalpha(tok_.peek()))
+      {
+        std::string w=tok_.word();
+        if (w=="nonuniform")
+        {
+          tok_.skipSpace();
+          std::string listType=tok_.word();
+          readList(kpath, listType);
+          d[key]=std::string("nonuniform "+listType);
+          continue;
+        }
+        text=w;
+      }
+      text+=tok_.entryText(kpath);
+
+      // small entries are interpreted by the generic dictionary parser
+      OFDictData::dict ed;
+      std::istringstream is("entry "+text+";");
+      if (readOpenFOAMDict(is, ed) && (ed.size()==1))
+      {
+        d[key]=ed.begin()->second;
+      }
+      else
+      {
+        d[key]=text;
+      }
+    }
+  }
+};
+
+
+}
+
+
+
+
+OpenFOAMFieldReader::OpenFOAMFieldReader(const boost::filesystem::path& file, Selector select)
+: select_(select),
+  binary_(false),
+  labelSize_(32),
+  scalarSize_(64)
+{
+  if (boost::filesystem::exists(file))
+  {
+    std::ifstream f(file.c_str(), std::ios::binary);
+    read(f, true);
+  }
+  else
+  {
+    boost::filesystem::path cf=file;
+    cf.replace_extension(file.extension().string()+".gz");
+    if (!boost::filesystem::exists(cf))
+    {
+      throw insight::Exception("Neither file "+file.string()+" nor "+cf.string()+" exist!");
+    }
+    std::ifstream compressed(cf.c_str(), std::ios::binary);
+    boost::iostreams::filtering_istream f;
+    f.push(boost::iostreams::gzip_decompressor());
+    f.push(compressed);
+    read(f, false);
+  }
+}
+
+
+
+
+OpenFOAMFieldReader::OpenFOAMFieldReader(std::istream& in, Selector select)
+: select_(select),
+  binary_(false),
+  labelSize_(32),
+  scalarSize_(64)
+{
+  read(in, false);
+}
+
+
+
+
+void OpenFOAMFieldReader::read(std::istream& in, bool seekable)
+{
+  FoamTokenizer tok(in, seekable);
+  FieldParser p(tok, select_, lists_);
+  p.readDict(dict_, "", true);
+
+  binary_=p.binary;
+  labelSize_=p.labelSize;
+  scalarSize_=p.scalarSize;
+
+  auto i=dict_.find("FoamFile");
+  if (i!=dict_.end())
+  {
+    header_=boost::get<OFDictData::dict>(i->second);
+    dict_.erase(i);
+  }
+}
+
+
+
+
+bool OpenFOAMFieldReader::hasList(const std::string& path) const
+{
+  return lists_.find(path)!=lists_.end();
+}
+
+
+
+
+const arma::mat& OpenFOAMFieldReader::list(const std::string& path) const
+{
+  auto i=lists_.find(path);
+  if (i==lists_.end())
+  {
+    throw insight::Exception("list "+path+" was not read!");
+  }
+  return i->second;
+}
+
+
+
+
+int OpenFOAMFieldReader::nComponents(const std::string& type)
+{
+  if ( (type=="scalar") || (type=="label") || (type=="sphericalTensor") ) return 1;
+  else if (type=="vector") return 3;
+  else if (type=="symmTensor") return 6;
+  else if (type=="tensor") return 9;
+  else
+  {
+    throw insight::Exception("unsupported list element type "+type);
+  }
+}
+
+
+
+
+arma::mat readOpenFOAMInternalField(const boost::filesystem::path& fieldFile)
+{
+  OpenFOAMFieldReader r
+  (
+    fieldFile,
+    [](const std::string& path) { return path=="internalField"; }
+  );
+
+  if (r.hasList("internalField"))
+  {
+    return r.list("internalField");
+  }
+
+  std::string f=r.dict().getString("internalField");
+  if (f.compare(0, 7, "uniform")!=0)
+  {
+    throw insight::Exception("unrecognized internal field specification: "+f);
+  }
+  for (char& c: f)
+  {
+    if ( (c=='(') || (c==')') ) c=' ';
+  }
+  std::istringstream is(f.substr(7));
+  std::vector<double> v;
+  double x;
+  while (is>>x) v.push_back(x);
+  if (v.empty())
+  {
+    throw insight::Exception("unrecognized internal field specification: "+f);
+  }
+  return arma::rowvec(v);
+}
+
+
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of Insight CAE, a workbench for Computer-Aided Engineering 
+ * Copyright (C) 2014  Hannes Kroeger <hannes@kroegeronline.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef INSIGHT_OPENFOAMFIELDREADER_H
+#define INSIGHT_OPENFOAMFIELDREADER_H
+
+#include "openfoam/openfoamdict.h"
+
+#include <functional>
+#include <map>
+
+namespace insight
+{
+
+
+/**
+ * Streaming reader for OpenFOAM field files (and other dictionaries,
+ * which contain large lists).
+ *
+ * The contents of "nonuniform List<T>" entries are decoded directly into
+ * matrices (one row per element, one column per component), without
+ * creating an element of the generic dictionary tree per value.
+ * Both the ascii and the binary write format are supported,
+ * as well as gzip compressed files.
+ *
+ * Lists are identified by their path in the dictionary, e.g. "internalField"
+ * or "boundaryField/inlet/value". Lists, which are not selected, are skipped
+ * without being decoded. All other entries are small and are
+ * stored in the generic dictionary tree. There, the list entries are
+ * represented by their type (e.g. "nonuniform List<vector>").
+ */
+class OpenFOAMFieldReader
+{
+public:
+  /**
+   * returns true, if the list with the given path is to be read
+   */
+  typedef std::function<bool(const std::string&)> Selector;
+
+  typedef std::map<std::string, arma::mat> Lists;
+
+protected:
+  OFDictData::dict header_, dict_;
+  Lists lists_;
+  Selector select_;
+
+  bool binary_;
+  int labelSize_, scalarSize_;
+
+  void read(std::istream& in, bool seekable);
+
+public:
+  /**
+   * read file. If it does not exist, the file with extension ".gz" is read.
+   * By default, all lists are read.
+   */
+  OpenFOAMFieldReader(const boost::filesystem::path& file, Selector select = Selector());
+  OpenFOAMFieldReader(std::istream& in, Selector select = Selector());
+
+  /**
+   * the contents of the FoamFile header
+   */
+  inline const OFDictData::dict& header() const { return header_; }
+
+  /**
+   * all entries, except the contents of the nonuniform lists
+   */
+  inline const OFDictData::dict& dict() const { return dict_; }
+
+  inline bool isBinary() const { return binary_; }
+
+  inline const Lists& lists() const { return lists_; }
+  bool hasList(const std::string& path) const;
+  const arma::mat& list(const std::string& path) const;
+
+  /**
+   * number of components of the OpenFOAM type (e.g. 3 for vector)
+   */
+  static int nComponents(const std::string& type);
+};
+
+
+/**
+ * read the internal field values from an OpenFOAM field file.
+ * A uniform internal field is returned as a single row.
+ */
+arma::mat readOpenFOAMInternalField(const boost::filesystem::path& fieldFile);
+
+
+}
+
+#endif // INSIGHT_OPENFOAMFIELDREADER_H
@@ -22,6 +22,7 @@
 #include "openfoam/openfoamcaseelements.h"
 #include "base/analysis.h"
 #include "base/linearalgebra.h"
+#include "base/tabulardatareader.h"
 #include "base/boost_include.h"
 #include "openfoam/snappyhexmesh.h"
 #include "boost/regex.hpp"
@@ -1669,6 +1670,254 @@ size_t patchIntegrate::n() const
   return t_.n_rows;
 }
 
+batchedPatchIntegrate::batchedPatchIntegrate
+(
+  const OpenFOAMCase& cm, 
+  const boost::filesystem::path& location,
+  const std::vector<std::string>& fieldNames, 
+  const std::vector<std::string>& patchNamePatterns,
+  const std::vector<std::string>& addopts
+)
+: fields_(fieldNames)
+{
+  std::vector<boost::regex> pats;
+  for (const std::string& pn: patchNamePatterns)
+  {
+    pats.push_back(boost::regex(pn));
+  }
+
+  // get all matching patch names
+  OFDictData::dict boundaryDict;
+  cm.parseBoundaryDict ( location, boundaryDict );
+
+  for ( const OFDictData::dict::value_type& de: boundaryDict )
+  {
+    for (const boost::regex& pat: pats)
+    {
+      if ( regex_match ( de.first, pat ) )
+      {
+        patches_.push_back ( de.first );
+        break;
+      }
+    }
+  }
+  
+  if ( patches_.size()==0 || fields_.size()==0 ) return;
+
+  std::vector<double> times;
+  std::map<std::string, std::vector<double> > areas;
+  std::map<std::string, std::map<std::string, std::vector<arma::mat> > > values;
+
+  if (cm.OFversion()<400)
+  {
+    // the old patchIntegrate utility handles only a single field and patch
+    for (const std::string& patchName: patches_)
+    {
+      for (const std::string& fieldName: fields_)
+      {
+        patchIntegrate pi(cm, location, fieldName, patchName, addopts);
+        if (times.size()==0)
+        {
+          times=arma::conv_to<std::vector<double> >::from(pi.t_);
+        }
+        areas[patchName]=arma::conv_to<std::vector<double> >::from(pi.A_);
+        std::vector<arma::mat>& v = values[fieldName][patchName];
+        for (arma::uword i=0; i<pi.integral_values_.n_rows; i++)
+        {
+          v.push_back(pi.integral_values_.row(i));
+        }
+      }
+    }
+  }
+  else
+  {
+    // one function object per combination, all executed in a single run
+    std::string funcs="(";
+    for (const std::string& patchName: patches_)
+    {
+      for (const std::string& fieldName: fields_)
+      {
+        funcs += boost::str( boost::format("patchIntegrate(name=%s,%s) ") % patchName % fieldName );
+      }
+    }
+    funcs+=")";
+    
+    std::vector<std::string> opts;
+    opts.push_back("-funcs");
+    opts.push_back(funcs);
+    copy ( addopts.begin(), addopts.end(), back_inserter ( opts ) );
+
+    std::vector<std::string> output;
+    cm.executeCommand ( location, "postProcess", opts, &output );
+
+    readPostProcessOutput(output, times, areas, values);
+  }
+
+  assemble(times, areas, values);
+}
+
+batchedPatchIntegrate::batchedPatchIntegrate
+(
+  const std::vector<std::string>& fieldNames,
+  const std::vector<std::string>& patchNames,
+  const std::vector<std::string>& postProcessOutput
+)
+: fields_(fieldNames),
+  patches_(patchNames)
+{
+  std::vector<double> times;
+  AreaHistory areas;
+  ValueHistory values;
+  readPostProcessOutput(postProcessOutput, times, areas, values);
+  assemble(times, areas, values);
+}
+
+void batchedPatchIntegrate::readPostProcessOutput
+(
+  const std::vector<std::string>& output,
+  std::vector<double>& times, AreaHistory& areas, ValueHistory& values
+)
+{
+  boost::regex 
+      re_time ( "^ *Time = (.+)$" ),
+      re_func ( "^ *[^ ]+ +([^ ]+)( write)?:$" ),
+      re_mag_int4 ( "^ *areaIntegrate\\((.+)\\) of (.+) = (.+)$" ),
+      re_area4 ( "^ *total area *= (.+)$" )
+      ;
+
+  // the area is only reported at initialisation and after mesh changes,
+  // below the name of the respective function object
+  std::map<std::string, double> funcArea;
+  std::string func;
+
+  boost::match_results<std::string::const_iterator> what;
+  for ( const std::string& line: output )
+  {
+    if ( boost::regex_match ( line, what, re_time ) )
+    {
+      times.push_back ( lexical_cast<double> ( what[1] ) );
+    }
+    else if ( boost::regex_match ( line, what, re_func ) )
+    {
+      func=what[1];
+    }
+    else if ( boost::regex_match ( line, what, re_area4 ) )
+    {
+      funcArea[func]=lexical_cast<double> ( what[1] );
+    }
+    else if ( boost::regex_match ( line, what, re_mag_int4 ) )
+    {
+      std::string patchName=what[1], fieldName=what[2];
+      values[fieldName][patchName].push_back(matchValue(what[3]));
+
+      std::map<std::string, double>::const_iterator fa=funcArea.find(func);
+      if (fa==funcArea.end())
+        throw insight::Exception("batchedPatchIntegrate: no area reported for patch "+patchName+" (function object \""+func+"\")!");
+
+      std::vector<double>& a=areas[patchName];
+      while ( a.size() < times.size() ) a.push_back(fa->second);
+    }
+  }
+}
+
+void batchedPatchIntegrate::assemble
+(
+  const std::vector<double>& times, AreaHistory& areas, ValueHistory& values
+)
+{
+  // assemble result arrays
+  t_=arma::vec(times);
+  A_=arma::zeros(times.size(), patches_.size());
+  for (size_t j=0; j<patches_.size(); j++)
+  {
+    const std::vector<double>& a=areas[patches_[j]];
+    if (a.size()!=times.size())
+      throw insight::Exception ( boost::str(boost::format(
+          "Inconsistent information returned by patchIntegrate: number of areas (%d) of patch %s not equal to number of times (%d)."
+          ) % a.size() % patches_[j] % times.size() ) );
+    for (size_t i=0; i<times.size(); i++) A_(i,j)=a[i];
+  }
+  
+  for (const std::string& fieldName: fields_)
+  {
+    for (const std::string& patchName: patches_)
+    {
+      const std::vector<arma::mat>& data = values[fieldName][patchName];
+      if ( data.size()!=times.size() )
+        throw insight::Exception ( boost::str(boost::format(
+            "Inconsistent information returned by patchIntegrate: number of values (%d) of field %s on patch %s not equal to number of times (%d)."
+            ) % data.size() % fieldName % patchName % times.size() ) );
+      
+      arma::mat& res = integral_values_[fieldName][patchName];
+      res=arma::zeros(data.size(), data.size()>0 ? data[0].n_elem : 0);
+      for (size_t i=0; i<data.size(); i++)
+      {
+        for (arma::uword j=0; j<res.n_cols; j++)
+        {
+          res(i,j)=data[i](j);
+        }
+      }
+    }
+  }
+}
+
+size_t batchedPatchIntegrate::n() const
+{
+  return t_.n_rows;
+}
+
+const arma::mat& batchedPatchIntegrate::integral(const std::string& fieldName, const std::string& patchName) const
+{
+  std::map<std::string, std::map<std::string, arma::mat> >::const_iterator i=integral_values_.find(fieldName);
+  if (i!=integral_values_.end())
+  {
+    std::map<std::string, arma::mat>::const_iterator j=i->second.find(patchName);
+    if (j!=i->second.end()) return j->second;
+  }
+  throw insight::Exception("batchedPatchIntegrate::integral(): no result for field "+fieldName+" on patch "+patchName+"!");
+}
+
+arma::mat batchedPatchIntegrate::area(const std::string& patchName) const
+{
+  std::vector<std::string>::const_iterator i=std::find(patches_.begin(), patches_.end(), patchName);
+  if (i==patches_.end())
+    throw insight::Exception("batchedPatchIntegrate::area(): no result for patch "+patchName+"!");
+  return A_.col(i-patches_.begin());
+}
+
+arma::mat batchedPatchIntegrate::table(std::vector<std::string>* columnNames) const
+{
+  arma::mat result=t_;
+  if (columnNames)
+  {
+    columnNames->clear();
+    columnNames->push_back("t");
+  }
+  
+  for (size_t j=0; j<patches_.size(); j++)
+  {
+    result=arma::join_rows(result, A_.col(j));
+    if (columnNames) columnNames->push_back("A_"+patches_[j]);
+    
+    for (const std::string& fieldName: fields_)
+    {
+      const arma::mat& iv = integral(fieldName, patches_[j]);
+      result=arma::join_rows(result, iv);
+      for (arma::uword k=0; k<iv.n_cols; k++)
+      {
+        if (columnNames) 
+          columnNames->push_back
+          (
+            "int_"+fieldName+"_"+patches_[j]
+            +(iv.n_cols>1 ? "_"+lexical_cast<std::string>(k) : std::string())
+          );
+      }
+    }
+  }
+  
+  return result;
+}
+
 patchArea::patchArea(const OpenFOAMCase& cm, const boost::filesystem::path& location,
                     const std::string& patchName)
 {
@@ -1707,39 +1956,28 @@ patchArea::patchArea(const OpenFOAMCase& cm, const boost::filesystem::path& loca
 
 arma::mat readParaviewCSV(const boost::filesystem::path& file, std::map<std::string, int>* headers)
 {
-//   boost::filesystem::path file=filetemplate.parent_path() 
-//     / (filetemplate.filename().stem().string() + lexical_cast<string>(num) + filetemplate.filename().extension().string());
-
   cout << "Reading "<<file<<endl;
-    
-  std::ifstream f(file.c_str());
   
-  std::vector<double> data;
+  TabularDataReader reader(file, ",", '#', 1);
+  arma::mat data = reader.readAll();
   
-  std::string headerline;
-  getline(f, headerline);
-  std::vector<std::string> colnames;
-  boost::split(colnames, headerline, boost::is_any_of(","));
-  for(size_t i=0; i<colnames.size(); i++)
+  if (reader.headerLines().size()>0)
   {
-    (*headers)[colnames[i]]=i;
+    std::vector<std::string> colnames;
+    boost::split(colnames, reader.headerLines()[0], boost::is_any_of(","));
+    for(size_t i=0; i<colnames.size(); i++)
+    {
+      (*headers)[colnames[i]]=i;
+    }
   }
   
-  while(!f.eof())
+  if (reader.nSkippedRows()>0)
   {
-    std::string line;
-    getline(f, line);
-    if (f.fail()) break;
-    
-    std::vector<std::string> cols;
-    boost::split(cols, line, boost::is_any_of(","));
-    for(size_t i=0; i<cols.size(); i++)
-    {
-      data.push_back(lexical_cast<double>(cols[i]));
-    }
+    throw insight::Exception(str(format("readParaviewCSV: %d lines of file %s could not be parsed!") 
+        % reader.nSkippedRows() % file.string()));
   }
   
-  return arma::mat(data.data(), colnames.size(), data.size()/colnames.size()).t();
+  return data;
 }
 
 typedef std::map<std::string, int> ColumnDescription;
@@ -1871,8 +2109,7 @@ std::vector<arma::mat> readParaviewCSVs(const boost::filesystem::path& filetempl
 std::string readSolverName(const boost::filesystem::path& ofcloc)
 {
   OFDictData::dict controlDict;
-  std::ifstream cdf( (ofcloc/"system"/"controlDict").c_str() );
-  readOpenFOAMDict(cdf, controlDict);
+  readOpenFOAMDict(ofcloc/"system"/"controlDict", controlDict);
   return controlDict.getString("application");
 }
 
@@ -1888,8 +2125,7 @@ int readDecomposeParDict(const boost::filesystem::path& ofcloc)
 std::string readTurbulenceModelName(const OpenFOAMCase& c, const boost::filesystem::path& ofcloc)
 {
   OFDictData::dict RASPropertiesDict;
-  std::ifstream cdf( (ofcloc/"constant"/"RASProperties").c_str() );
-  readOpenFOAMDict(cdf, RASPropertiesDict);
+  readOpenFOAMDict(ofcloc/"constant"/"RASProperties", RASPropertiesDict);
   //cout<<decomposeParDict<<endl;
   if (c.OFversion()<300)
   {
@@ -2141,8 +2377,7 @@ void currentNumericalSettingsReport
     try
     {
       OFDictData::dict cdict;
-      std::ifstream cdf( (location/dictname).c_str() );
-      readOpenFOAMDict(cdf, cdict);
+      readOpenFOAMDict(location/dictname, cdict);
 //       cout<<cdict<<endl;
       
       std::ostringstream latexCode;
@@ -599,6 +599,79 @@ public:
 
 
 
+/**
+ * Integrates several fields over several patches in a single postProcess run.
+ * All patches, whose names match any of the given patterns, are evaluated.
+ * The mesh and fields are loaded only once for all patch/field combinations.
+ */
+class batchedPatchIntegrate
+{
+protected:
+  typedef std::map<std::string, std::vector<double> > AreaHistory;
+  typedef std::map<std::string, std::map<std::string, std::vector<arma::mat> > > ValueHistory;
+
+  /**
+   * extract times, areas and integrals from the log of postProcess (OpenFOAM>=4)
+   */
+  static void readPostProcessOutput
+  (
+      const std::vector<std::string>& output,
+      std::vector<double>& times, AreaHistory& areas, ValueHistory& values
+  );
+
+  void assemble(const std::vector<double>& times, AreaHistory& areas, ValueHistory& values);
+
+public:
+  batchedPatchIntegrate(const OpenFOAMCase& cm, const boost::filesystem::path& location,
+                        const std::vector<std::string>& fieldNames, 
+                        const std::vector<std::string>& patchNamePatterns,
+                        const std::vector<std::string>& addopts=boost::assign::list_of<std::string>("-latestTime")
+                       );
+
+  /**
+   * evaluate the captured output of a postProcess run (OpenFOAM>=4)
+   * with patchIntegrate function objects for the given fields and patches
+   */
+  batchedPatchIntegrate(const std::vector<std::string>& fieldNames,
+                        const std::vector<std::string>& patchNames,
+                        const std::vector<std::string>& postProcessOutput);
+
+  /**
+   * time/iteration values for subsequent arrays
+   */
+  arma::mat t_;
+
+  /**
+   * names of the evaluated fields and matched patches
+   */
+  std::vector<std::string> fields_, patches_;
+
+  /**
+   * areas for different times/iterations, one column per patch
+   */
+  arma::mat A_;
+
+  /**
+   * integral values for different times/iterations
+   * indexed by field name and patch name, one column per component
+   */
+  std::map<std::string, std::map<std::string, arma::mat> > integral_values_;
+
+  size_t n() const;
+  
+  const arma::mat& integral(const std::string& fieldName, const std::string& patchName) const;
+  arma::mat area(const std::string& patchName) const;
+  
+  /**
+   * all results in one table: 
+   * time, then for each patch: area and the components of each field
+   */
+  arma::mat table(std::vector<std::string>* columnNames=NULL) const;
+};
+
+
+
+
 class patchArea
 {
 public:
@@ -35,72 +35,45 @@ bool TaskSpoolerInterface::JobList::hasQueuedJobs() const
 
 
 TaskSpoolerInterface::TaskSpoolerInterface(const boost::filesystem::path& socket)
-  : socket_(socket),
-    env_(boost::this_process::environment())
-{
-  env_["TS_SOCKET"]=socket.string();
-}
+  : client_(socket)
+{}
 
 TaskSpoolerInterface::JobList TaskSpoolerInterface::jobs() const
 {
   JobList jl;
-  boost::process::ipstream is;
-  boost::process::child c("tsp", env_, boost::process::std_out > is);
 
-  if (!c.running())
-    throw insight::Exception("Could not execute task spooler executable!");
+  // no server, no jobs
+  if (!client_.serverRunning())
+    return jl;
 
-  std::vector<std::string> data;
-  std::string line;
-  int i=0;
-  boost::regex re("^([^ ]*) +([^ ]*) +([^ ]*) +(.*)$");
-  while (std::getline(is, line))
+  for (const TaskSpoolerClient::JobInfo& ji: client_.jobs())
   {
-    std::cout<<line<<std::endl;
-    if (i>0)
-    {
-      boost::smatch m;
-      if (boost::regex_match(line, m, re))
-      {
-        Job j;
-
-        j.id=boost::lexical_cast<int>(m[1]);
-
-        if (m[2]=="running")
-          j.state=Running;
-        else if (m[2]=="queued")
-          j.state=Queued;
-        else if (m[2]=="finished")
-          j.state=Finished;
-        else
-          j.state=Unknown;
-
-        j.output=boost::filesystem::path(m[3]);
-
-        j.remainder=m[4];
-
-        jl.push_back(j);
-      }
-    }
-    i++;
+    Job j;
+    j.id=ji.id;
+
+    if (ji.state==TaskSpoolerClient::Running)
+      j.state=Running;
+    else if (ji.state==TaskSpoolerClient::Queued)
+      j.state=Queued;
+    else if (ji.state==TaskSpoolerClient::Finished)
+      j.state=Finished;
+    else
+      j.state=Unknown;
+
+    j.output=boost::filesystem::path(ji.output);
+    j.remainder=ji.remainder;
+
+    jl.push_back(j);
   }
 
-  c.wait();
-
   return jl;
 }
 
 
 void TaskSpoolerInterface::cancelAllJobs()
 {
-  while ( boost::process::system(boost::process::search_path("tsp"),
-                                 boost::process::args("-k"),
-                                 env_/*, boost::process::std_out > boost::process::null*/) == 0 )
-  {
-    boost::process::system(boost::process::search_path("tsp"),
-                           boost::process::args("-C"),
-                           env_);
-  }
+  if (client_.serverRunning())
+    client_.cancelAllJobs();
 }
 
 
@@ -3,6 +3,7 @@
 
 #include "base/boost_include.h"
 #include "boost/process.hpp"
+#include "base/taskspoolerclient.h"
 
 namespace insight
 {
@@ -10,8 +11,7 @@ namespace insight
 
 class TaskSpoolerInterface
 {
-  boost::filesystem::path socket_;
-  boost::process::environment env_;
+  TaskSpoolerClient client_;
 
 public:
   enum JobState { Running, Queued, Finished, Unknown };